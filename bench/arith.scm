@@ -0,0 +1,24 @@
+(define fib
+  (lambda (n)
+    (if (< n 2)
+        n
+        (+ (fib (- n 1)) (fib (- n 2))))))
+
+(define sum-of-squares
+  (lambda (n)
+    (let loop ((i 0) (acc 0))
+      (if (= i n)
+          acc
+          (loop (+ i 1) (+ acc (* i i)))))))
+
+(define polynomial
+  (lambda (n)
+    (do ((i 0 (+ i 1))
+         (acc 0 (+ acc (- (* 3 (* i i)) (+ (* 2 i) 1)))))
+        ((>= i n) acc))))
+
+(define start (clock))
+(displayln (fib 27))
+(displayln (sum-of-squares 3000000))
+(displayln (polynomial 3000000))
+(displayln (- (clock) start))
@@ -0,0 +1,25 @@
+(define escape
+  (lambda (cr ci limit)
+    (let iterate ((zr 0) (zi 0) (i 0))
+      (cond ((= i limit) 1)
+            ((> (+ (* zr zr) (* zi zi)) 4) 0)
+            (else (iterate (+ (- (* zr zr) (* zi zi)) cr)
+                           (+ (* 2 (* zr zi)) ci)
+                           (+ i 1)))))))
+
+(define mandelbrot
+  (lambda (size limit)
+    (let ((step (* 2 (/ size))))
+      (let rows ((y 0) (inside 0))
+        (if (= y size)
+            inside
+            (rows (+ y 1)
+                  (let columns ((x 0) (inside inside))
+                    (if (= x size)
+                        inside
+                        (columns (+ x 1)
+                                 (+ inside (escape (- (* x step) 1.5) (- (* y step) 1) limit)))))))))))
+
+(define start (clock))
+(displayln (mandelbrot 200 200))
+(displayln (- (clock) start))
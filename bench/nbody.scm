@@ -0,0 +1,55 @@
+(define sun-mass 39.47841760435743)
+(define jupiter-mass 0.03769367487038949)
+(define saturn-mass 0.01128632613196877)
+
+(define energy
+  (lambda (x1 y1 z1 vx1 vy1 vz1 x2 y2 z2 vx2 vy2 vz2 x3 y3 z3 vx3 vy3 vz3)
+    (let ((kinetic (+ (* (* 0.5 sun-mass) (+ (* vx1 vx1) (+ (* vy1 vy1) (* vz1 vz1))))
+                      (+ (* (* 0.5 jupiter-mass) (+ (* vx2 vx2) (+ (* vy2 vy2) (* vz2 vz2))))
+                         (* (* 0.5 saturn-mass) (+ (* vx3 vx3) (+ (* vy3 vy3) (* vz3 vz3)))))))
+          (d12 (sqrt (+ (* (- x1 x2) (- x1 x2)) (+ (* (- y1 y2) (- y1 y2)) (* (- z1 z2) (- z1 z2))))))
+          (d13 (sqrt (+ (* (- x1 x3) (- x1 x3)) (+ (* (- y1 y3) (- y1 y3)) (* (- z1 z3) (- z1 z3))))))
+          (d23 (sqrt (+ (* (- x2 x3) (- x2 x3)) (+ (* (- y2 y3) (- y2 y3)) (* (- z2 z3) (- z2 z3)))))))
+      (- kinetic
+         (+ (* (* sun-mass jupiter-mass) (/ d12))
+            (+ (* (* sun-mass saturn-mass) (/ d13))
+               (* (* jupiter-mass saturn-mass) (/ d23))))))))
+
+(define advance
+  (lambda (steps dt)
+    (let simulate ((n 0)
+                   (x1 0) (y1 0) (z1 0)
+                   (vx1 -0.00028994933689683) (vy1 -0.00320679364784576) (vz1 0.00002167234021893)
+                   (x2 4.8414314424647209) (y2 -1.16032004402742839) (z2 -0.10362204447112311)
+                   (vx2 0.60632639299583202) (vy2 2.81198684491626016) (vz2 -0.02521836165988763)
+                   (x3 8.34336671824457987) (y3 4.12479856412430479) (z3 -0.40352341711432138)
+                   (vx3 -1.01077434617879236) (vy3 1.82566237123041186) (vz3 0.00841576137658415))
+      (if (= n steps)
+          (energy x1 y1 z1 vx1 vy1 vz1 x2 y2 z2 vx2 vy2 vz2 x3 y3 z3 vx3 vy3 vz3)
+          (let ((dx12 (- x1 x2)) (dy12 (- y1 y2)) (dz12 (- z1 z2))
+                (dx13 (- x1 x3)) (dy13 (- y1 y3)) (dz13 (- z1 z3))
+                (dx23 (- x2 x3)) (dy23 (- y2 y3)) (dz23 (- z2 z3)))
+            (let ((d12 (+ (* dx12 dx12) (+ (* dy12 dy12) (* dz12 dz12))))
+                  (d13 (+ (* dx13 dx13) (+ (* dy13 dy13) (* dz13 dz13))))
+                  (d23 (+ (* dx23 dx23) (+ (* dy23 dy23) (* dz23 dz23)))))
+              (let ((m12 (* dt (/ (* d12 (sqrt d12)))))
+                    (m13 (* dt (/ (* d13 (sqrt d13)))))
+                    (m23 (* dt (/ (* d23 (sqrt d23))))))
+                (let ((vx1 (- vx1 (+ (* dx12 (* jupiter-mass m12)) (* dx13 (* saturn-mass m13)))))
+                      (vy1 (- vy1 (+ (* dy12 (* jupiter-mass m12)) (* dy13 (* saturn-mass m13)))))
+                      (vz1 (- vz1 (+ (* dz12 (* jupiter-mass m12)) (* dz13 (* saturn-mass m13)))))
+                      (vx2 (- (+ vx2 (* dx12 (* sun-mass m12))) (* dx23 (* saturn-mass m23))))
+                      (vy2 (- (+ vy2 (* dy12 (* sun-mass m12))) (* dy23 (* saturn-mass m23))))
+                      (vz2 (- (+ vz2 (* dz12 (* sun-mass m12))) (* dz23 (* saturn-mass m23))))
+                      (vx3 (+ vx3 (+ (* dx13 (* sun-mass m13)) (* dx23 (* jupiter-mass m23)))))
+                      (vy3 (+ vy3 (+ (* dy13 (* sun-mass m13)) (* dy23 (* jupiter-mass m23)))))
+                      (vz3 (+ vz3 (+ (* dz13 (* sun-mass m13)) (* dz23 (* jupiter-mass m23))))))
+                  (simulate (+ n 1)
+                            (+ x1 (* dt vx1)) (+ y1 (* dt vy1)) (+ z1 (* dt vz1)) vx1 vy1 vz1
+                            (+ x2 (* dt vx2)) (+ y2 (* dt vy2)) (+ z2 (* dt vz2)) vx2 vy2 vz2
+                            (+ x3 (* dt vx3)) (+ y3 (* dt vy3)) (+ z3 (* dt vz3)) vx3 vy3 vz3)))))))))
+
+(define start (clock))
+(displayln (advance 0 0.01))
+(displayln (advance 300000 0.01))
+(displayln (- (clock) start))
@@ -0,0 +1,30 @@
+(define n 100000)
+(define a (make-f64vector n 1.5))
+(define b (make-f64vector n 2))
+
+(define dot-loop
+  (lambda (a b)
+    (let loop ((i 0) (acc 0.0))
+      (if (< i n)
+          (loop (+ i 1) (+ acc (* (f64vector-ref a i) (f64vector-ref b i))))
+          acc))))
+
+(define scale!
+  (lambda (v k)
+    (do ((i 0 (+ i 1)))
+        ((>= i n) v)
+      (f64vector-set! v i (* k (f64vector-ref v i))))))
+
+(define repeat
+  (lambda (k thunk)
+    (let loop ((j 0) (r 0))
+      (if (< j k)
+          (loop (+ j 1) (thunk))
+          r))))
+
+(define start (clock))
+(displayln (repeat 50 (lambda () (dot-loop a b))))
+(displayln (f64vector-ref (repeat 50 (lambda () (scale! b 1.0))) 0))
+(displayln (repeat 50 (lambda () (f64vector-dot a b))))
+(displayln (f64vector-sum (repeat 50 (lambda () (f64vector-mul a b)))))
+(displayln (- (clock) start))
@@ -0,0 +1,415 @@
+#include <aot/aot.h>
+#include <compiler/compiler.h>
+#include <serialize/serialize.h>
+#include <memory/memory.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static ObjFunction *aot_nested_function(Value constant)
+{
+    if (OBJECT_IS_FUNCTION(constant))
+        return OBJECT_AS_FUNCTION(constant);
+
+    // Lambdas without free variables are compiled to a closure.
+    if (OBJECT_IS_CLOSURE(constant))
+        return OBJECT_AS_CLOSURE(constant)->function;
+
+    return NULL;
+}
+
+/* Emitting */
+
+// Compiles the functions that are otherwise compiled on their first call,
+// since the program is emitted before it runs.
+static bool aot_compile_all(ObjFunction *function)
+{
+    if (function->source != NULL && !compiler_compile_lazy(function))
+        return false;
+
+    for (int i = 0; i < function->chunk.constants.count; i++)
+    {
+        ObjFunction *nested = aot_nested_function(function->chunk.constants.values[i]);
+
+        if (nested != NULL && !aot_compile_all(nested))
+            return false;
+    }
+
+    return true;
+}
+
+static uint32_t aot_read_long(uint8_t *ip)
+{
+    return (uint32_t)((ip[1] << 16) | (ip[2] << 8) | ip[3]);
+}
+
+static uint16_t aot_read_short(uint8_t *ip)
+{
+    return (uint16_t)((ip[1] << 8) | ip[2]);
+}
+
+static void aot_emit_register_operand(FILE *out, uint8_t operand)
+{
+    if (operand & CHUNK_REGISTER_CONSTANT)
+        fprintf(out, "constants[%d]", operand & CHUNK_REGISTER_MAX);
+    else
+        fprintf(out, "slots[%d]", operand);
+}
+
+static void aot_emit_register_instruction(FILE *out, uint8_t *ip, int offset)
+{
+    const char *overflow = NULL;
+    const char *op;
+    const char *primitive;
+
+    switch (CHUNK_CHECKED_REGISTER(ip[0]))
+    {
+    case OP_ADD:
+        overflow = "__builtin_add_overflow";
+        op = "+";
+        primitive = "primitive_add";
+        break;
+    case OP_SUBTRACT:
+        overflow = "__builtin_sub_overflow";
+        op = "-";
+        primitive = "primitive_sub";
+        break;
+    case OP_MULTIPLY:
+        overflow = "__builtin_mul_overflow";
+        op = "*";
+        primitive = "primitive_mup";
+        break;
+    case OP_EQUAL:
+        op = "==";
+        primitive = "primitive_num_eq";
+        break;
+    case OP_LESS:
+        op = "<";
+        primitive = "primitive_num_le";
+        break;
+    case OP_GREATER:
+        op = ">";
+        primitive = "primitive_num_ge";
+        break;
+    case OP_LESS_EQUAL:
+        op = "<=";
+        primitive = "primitive_num_leq";
+        break;
+    default:
+        op = ">=";
+        primitive = "primitive_num_geq";
+        break;
+    }
+
+    fprintf(out, "%s(%d, %d, ", overflow != NULL ? "AOT_ARITHMETIC" : "AOT_COMPARISON", offset, ip[1]);
+    aot_emit_register_operand(out, ip[2]);
+    fprintf(out, ", ");
+    aot_emit_register_operand(out, ip[3]);
+    if (overflow != NULL)
+        fprintf(out, ", %s", overflow);
+    fprintf(out, ", %s, %s, %s);\n", op, primitive, CHUNK_CHECKED_REGISTER(ip[0]) == ip[0] ? "true" : "false");
+}
+
+// Writes the statement for the instruction at offset. The ones the
+// procedures leave to the interpreter return its address.
+static void aot_emit_instruction(FILE *out, Chunk *chunk, int offset)
+{
+    uint8_t *ip = chunk->code + offset;
+
+    switch (ip[0])
+    {
+    case OP_CONSTANT:
+        fprintf(out, "AOT_PUSH(constants[%d]);\n", ip[1]);
+        break;
+    case OP_CONSTANT_LONG:
+        fprintf(out, "AOT_PUSH(constants[%u]);\n", aot_read_long(ip));
+        break;
+    case OP_NULL:
+        fprintf(out, "AOT_PUSH(VALUE_NULL_VAL);\n");
+        break;
+    case OP_TRUE:
+        fprintf(out, "AOT_PUSH(VALUE_BOOL_VAL(true));\n");
+        break;
+    case OP_FALSE:
+        fprintf(out, "AOT_PUSH(VALUE_BOOL_VAL(false));\n");
+        break;
+    case OP_POP:
+        fprintf(out, "vm.stack_top--;\n");
+        break;
+    case OP_POPN:
+        fprintf(out, "vm.stack_top -= %d;\n", ip[1]);
+        break;
+    case OP_GET_LOCAL:
+        fprintf(out, "AOT_PUSH(slots[%d]);\n", ip[1]);
+        break;
+    case OP_GET_LOCAL_LONG:
+        fprintf(out, "AOT_PUSH(slots[%d]);\n", aot_read_short(ip));
+        break;
+    case OP_SET_LOCAL:
+        fprintf(out, "slots[%d] = vm.stack_top[-1];\n", ip[1]);
+        break;
+    case OP_SET_LOCAL_LONG:
+        fprintf(out, "slots[%d] = vm.stack_top[-1];\n", aot_read_short(ip));
+        break;
+    // Global slots are only known once the program is loaded, so they are
+    // read from the linked bytecode.
+    case OP_GET_GLOBAL:
+        fprintf(out, "AOT_PUSH(table_get(&vm.globals, AOT_GLOBAL(%d)));\n", offset);
+        break;
+    case OP_GLOBAL_UNCHANGED:
+        fprintf(out, "AOT_PUSH(VALUE_BOOL_VAL(table_is_unchanged(&vm.globals, AOT_GLOBAL(%d))));\n", offset);
+        break;
+    case OP_SET_GLOBAL:
+        fprintf(out, "table_set(&vm.globals, AOT_GLOBAL(%d), vm.stack_top[-1]);\n", offset);
+        break;
+    case OP_GET_UPVALUE:
+        fprintf(out, "AOT_PUSH(frame->closure->upvalues[%d]);\n", ip[1]);
+        break;
+    case OP_GET_UPVALUE_LONG:
+        fprintf(out, "AOT_PUSH(frame->closure->upvalues[%d]);\n", aot_read_short(ip));
+        break;
+    case OP_GET_BOXED_UPVALUE:
+        fprintf(out, "AOT_PUSH(*AOT_BOX(%d));\n", ip[1]);
+        break;
+    case OP_GET_BOXED_UPVALUE_LONG:
+        fprintf(out, "AOT_PUSH(*AOT_BOX(%d));\n", aot_read_short(ip));
+        break;
+    case OP_SET_UPVALUE:
+        fprintf(out, "*AOT_BOX(%d) = vm.stack_top[-1];\n", ip[1]);
+        break;
+    case OP_SET_UPVALUE_LONG:
+        fprintf(out, "*AOT_BOX(%d) = vm.stack_top[-1];\n", aot_read_short(ip));
+        break;
+    case OP_ADD:
+    case OP_SUBTRACT:
+    case OP_MULTIPLY:
+    case OP_EQUAL:
+    case OP_LESS:
+    case OP_GREATER:
+    case OP_LESS_EQUAL:
+    case OP_GREATER_EQUAL:
+    case OP_ADD_UNCHECKED:
+    case OP_SUBTRACT_UNCHECKED:
+    case OP_MULTIPLY_UNCHECKED:
+    case OP_EQUAL_UNCHECKED:
+    case OP_LESS_UNCHECKED:
+    case OP_GREATER_UNCHECKED:
+    case OP_LESS_EQUAL_UNCHECKED:
+    case OP_GREATER_EQUAL_UNCHECKED:
+        aot_emit_register_instruction(out, ip, offset);
+        break;
+    case OP_VECTOR_REF:
+        fprintf(out, "AOT_VECTOR_REF(%d, (VectorKind)%d);\n", offset, ip[1]);
+        break;
+    case OP_VECTOR_SET:
+        fprintf(out, "AOT_VECTOR_SET(%d, (VectorKind)%d);\n", offset, ip[1]);
+        break;
+    case OP_JUMP:
+        fprintf(out, "goto L%d;\n", offset + 3 + aot_read_short(ip));
+        break;
+    case OP_JUMP_LONG:
+        fprintf(out, "goto L%u;\n", offset + 4 + aot_read_long(ip));
+        break;
+    case OP_LOOP:
+        fprintf(out, "goto L%d;\n", offset + 3 - aot_read_short(ip));
+        break;
+    case OP_LOOP_LONG:
+        fprintf(out, "goto L%d;\n", offset + 4 - (int)aot_read_long(ip));
+        break;
+    case OP_JUMP_IF_FALSE:
+        fprintf(out, "if (AOT_IS_FALSE(vm.stack_top[-1]))\n        goto L%d;\n",
+                offset + 3 + aot_read_short(ip));
+        break;
+    case OP_JUMP_IF_FALSE_LONG:
+        fprintf(out, "if (AOT_IS_FALSE(vm.stack_top[-1]))\n        goto L%u;\n",
+                offset + 4 + aot_read_long(ip));
+        break;
+    case OP_POP_JUMP_IF_FALSE:
+        fprintf(out, "vm.stack_top--;\n    if (AOT_IS_FALSE(vm.stack_top[0]))\n        goto L%d;\n",
+                offset + 3 + aot_read_short(ip));
+        break;
+    case OP_POP_JUMP_IF_FALSE_LONG:
+        fprintf(out, "vm.stack_top--;\n    if (AOT_IS_FALSE(vm.stack_top[0]))\n        goto L%u;\n",
+                offset + 4 + aot_read_long(ip));
+        break;
+    default:
+        fprintf(out, "return code + %d;\n", offset);
+        break;
+    }
+}
+
+static int aot_instruction_count(Chunk *chunk)
+{
+    int count = 0;
+
+    for (int offset = 0; offset < chunk->count; offset += chunk_instruction_size(chunk, offset))
+        count++;
+
+    return count;
+}
+
+// Writes the procedure of the function and then those of the functions in
+// its constants, numbered in that order from count on. A function too long
+// for the C compiler to digest in reasonable time is left to the
+// interpreter, and has no procedure.
+static void aot_emit_procedures(FILE *out, ObjFunction *function, bool *emitted, int *count)
+{
+    Chunk *chunk = &function->chunk;
+    int index = (*count)++;
+
+    emitted[index] = aot_instruction_count(chunk) <= AOT_INSTRUCTIONS_MAX;
+
+    if (emitted[index])
+    {
+        fprintf(out, "\nstatic uint8_t *aot_procedure_%d(CallFrame *frame)\n{\n", index);
+        fprintf(out, "    AOT_PROLOGUE();\n\n    switch (AOT_OFFSET())\n    {\n");
+
+        for (int offset = 0; offset < chunk->count; offset += chunk_instruction_size(chunk, offset))
+            fprintf(out, "    case %d:\n        goto L%d;\n", offset, offset);
+
+        fprintf(out, "    default:\n        return frame->ip;\n    }\n\n");
+
+        for (int offset = 0; offset < chunk->count; offset += chunk_instruction_size(chunk, offset))
+        {
+            fprintf(out, "L%d:\n    ", offset);
+            aot_emit_instruction(out, chunk, offset);
+        }
+
+        fprintf(out, "}\n");
+    }
+
+    for (int i = 0; i < chunk->constants.count; i++)
+    {
+        ObjFunction *nested = aot_nested_function(chunk->constants.values[i]);
+
+        if (nested != NULL)
+            aot_emit_procedures(out, nested, emitted, count);
+    }
+}
+
+// The number of functions in the program.
+static int aot_function_count(ObjFunction *function)
+{
+    int count = 1;
+
+    for (int i = 0; i < function->chunk.constants.count; i++)
+    {
+        ObjFunction *nested = aot_nested_function(function->chunk.constants.values[i]);
+
+        if (nested != NULL)
+            count += aot_function_count(nested);
+    }
+
+    return count;
+}
+
+bool aot_emit_c(const char *path, const char *source, FILE *out)
+{
+    ObjFunction *function = compiler_compile(source);
+
+    if (function == NULL)
+        return false;
+
+    vm_push(VALUE_OBJ_VAL(function));
+
+    Writer program;
+    serialize_init_writer(&program);
+
+    bool emitted = aot_compile_all(function) && serialize_write_program(&program, function);
+
+    if (emitted)
+    {
+        int count = 0;
+        bool *procedures = (bool *)malloc(sizeof(bool) * aot_function_count(function));
+
+        fprintf(out, "// Compiled by lisb --emit-c from %s\n\n#include <aot/aot.h>\n", path);
+        aot_emit_procedures(out, function, procedures, &count);
+
+        fprintf(out, "\nstatic const JitProcedure aot_procedures[] = {\n");
+        for (int i = 0; i < count; i++)
+        {
+            if (procedures[i])
+                fprintf(out, "    aot_procedure_%d,\n", i);
+            else
+                fprintf(out, "    NULL,\n");
+        }
+
+        free(procedures);
+        fprintf(out, "};\n\nstatic const uint8_t aot_program[] = {");
+
+        for (size_t i = 0; i < program.count; i++)
+            fprintf(out, "%s0x%02x,", i % 12 == 0 ? "\n    " : " ", program.bytes[i]);
+
+        fprintf(out, "\n};\n\nint main(void)\n{\n"
+                     "    return aot_main(aot_program, sizeof(aot_program), aot_procedures,\n"
+                     "                    (int)(sizeof(aot_procedures) / sizeof(aot_procedures[0])));\n"
+                     "}\n");
+    }
+    else
+    {
+        fprintf(stderr, "Could not compile \"%s\" to C.\n", path);
+    }
+
+    serialize_free_writer(&program);
+    vm_pop();
+
+    return emitted;
+}
+
+/* Running */
+
+// Hands out the procedures in the order they were emitted in.
+static bool aot_attach(ObjFunction *function, const JitProcedure *procedures, int count, int *next)
+{
+    if (*next == count)
+        return false;
+
+    JitProcedure procedure = procedures[(*next)++];
+
+    if (procedure != NULL)
+        jit_attach_procedure(function, procedure);
+
+    for (int i = 0; i < function->chunk.constants.count; i++)
+    {
+        ObjFunction *nested = aot_nested_function(function->chunk.constants.values[i]);
+
+        if (nested != NULL && !aot_attach(nested, procedures, count, next))
+            return false;
+    }
+
+    return true;
+}
+
+int aot_main(const uint8_t *program, size_t size, const JitProcedure *procedures, int count)
+{
+    vm_init_vm();
+
+    Reader reader = {program, size, 0, false};
+    ObjFunction *function = serialize_read_program(&reader);
+    int next = 0;
+
+    if (function != NULL)
+    {
+        vm_push(VALUE_OBJ_VAL(function));
+
+        if (!aot_attach(function, procedures, count, &next) || next != count)
+            function = NULL;
+
+        vm_pop();
+    }
+
+    if (function == NULL)
+    {
+        fprintf(stderr, "Could not load the program.\n");
+        return 65;
+    }
+
+    InterpretResult result = vm_interpret_function(function);
+
+    if (result == VM_RUNTIME_ERROR)
+        return 70;
+
+    vm_free_vm();
+    return 0;
+}
\ No newline at end of file
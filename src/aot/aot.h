@@ -0,0 +1,99 @@
+#ifndef _AOT_H
+#define _AOT_H
+
+#include <common/common.h>
+#include <vm/vm.h>
+#include <jit/jit.h>
+#include <table/table.h>
+#include <primitive/primitive.h>
+#include <vector/vector.h>
+
+#include <stdio.h>
+
+// `lisb --emit-c prog.scm > prog.c` writes a C program with a procedure for
+// every function of prog.scm, which is run instead of its bytecode. It
+// builds against the runtime library:
+//
+//   make runtime
+//   cc -I src prog.c bin/liblisb.a -lm -o prog
+//
+// The procedures leave calls, returns, closures and call/cc to the
+// interpreter, which also keeps tail calls proper, and return to it after
+// each one. The bytecode is still embedded in the program for those and for
+// the stack traces of runtime errors.
+// Longer functions are left to the interpreter.
+#define AOT_INSTRUCTIONS_MAX 10000
+
+bool aot_emit_c(const char *path, const char *source, FILE *out);
+
+// The main function of the emitted program.
+int aot_main(const uint8_t *program, size_t size, const JitProcedure *procedures, int count);
+
+// What the emitted procedures are written in.
+#define AOT_PROLOGUE()                                                     \
+    uint8_t *code = frame->closure->function->chunk.code;                  \
+    Value *constants = frame->closure->function->chunk.constants.values; \
+    Value *slots = frame->slots;                                           \
+    (void)constants;                                                       \
+    (void)slots
+
+#define AOT_OFFSET() ((int)(frame->ip - code))
+#define AOT_PUSH(value) (*vm.stack_top++ = (value))
+#define AOT_GLOBAL(offset) ((code[(offset) + 1] << 8) | code[(offset) + 2])
+#define AOT_BOX(slot) (OBJECT_AS_UPVALUE(frame->closure->upvalues[slot])->location)
+#define AOT_IS_FALSE(value) (VALUE_IS_BOOL(value) && !VALUE_AS_BOOL(value))
+
+// A register op, as the interpreter runs it. The checked ones return to the
+// interpreter, which reports the error, unless both operands are numbers.
+#define AOT_ARITHMETIC(offset, target, a, b, overflow, op, primitive, checked)                              \
+    do                                                                                                      \
+    {                                                                                                       \
+        Value operands[2] = {a, b};                                                                         \
+        int64_t result;                                                                                     \
+        if (VALUE_IS_FIXNUM(operands[0]) && VALUE_IS_FIXNUM(operands[1]) &&                                 \
+            !overflow(VALUE_AS_FIXNUM(operands[0]), VALUE_AS_FIXNUM(operands[1]), &result))                 \
+            slots[target] = VALUE_FIXNUM_VAL(result);                                                       \
+        else if (VALUE_IS_FLONUM(operands[0]) && VALUE_IS_FLONUM(operands[1]))                              \
+            slots[target] = VALUE_FLONUM_VAL(VALUE_AS_FLONUM(operands[0]) op VALUE_AS_FLONUM(operands[1])); \
+        else if (!(checked) || (OBJECT_IS_NUMBER(operands[0]) && OBJECT_IS_NUMBER(operands[1])))            \
+            slots[target] = primitive(2, operands);                                                         \
+        else                                                                                                \
+            return code + (offset);                                                                         \
+        vm.stack_top = slots + (target) + 1;                                                                \
+    } while (false)
+#define AOT_COMPARISON(offset, target, a, b, op, primitive, checked)                                      \
+    do                                                                                                    \
+    {                                                                                                     \
+        Value operands[2] = {a, b};                                                                       \
+        if (VALUE_IS_FIXNUM(operands[0]) && VALUE_IS_FIXNUM(operands[1]))                                 \
+            slots[target] = VALUE_BOOL_VAL(VALUE_AS_FIXNUM(operands[0]) op VALUE_AS_FIXNUM(operands[1])); \
+        else if (VALUE_IS_FLONUM(operands[0]) && VALUE_IS_FLONUM(operands[1]))                            \
+            slots[target] = VALUE_BOOL_VAL(VALUE_AS_FLONUM(operands[0]) op VALUE_AS_FLONUM(operands[1])); \
+        else if (!(checked) || (OBJECT_IS_NUMBER(operands[0]) && OBJECT_IS_NUMBER(operands[1])))          \
+            slots[target] = primitive(2, operands);                                                       \
+        else                                                                                              \
+            return code + (offset);                                                                       \
+        vm.stack_top = slots + (target) + 1;                                                              \
+    } while (false)
+
+// The accessors of numeric vectors, which return to the interpreter for
+// anything but the common case of vector_ref and vector_set.
+#define AOT_VECTOR_REF(offset, kind)                                         \
+    do                                                                       \
+    {                                                                        \
+        Value element;                                                       \
+        if (!vector_ref(vm.stack_top[-2], vm.stack_top[-1], kind, &element)) \
+            return code + (offset);                                          \
+        vm.stack_top -= 2;                                                   \
+        AOT_PUSH(element);                                                   \
+    } while (false)
+#define AOT_VECTOR_SET(offset, kind)                                                 \
+    do                                                                               \
+    {                                                                                \
+        if (!vector_set(vm.stack_top[-3], vm.stack_top[-2], kind, vm.stack_top[-1])) \
+            return code + (offset);                                                  \
+        vm.stack_top -= 3;                                                           \
+        AOT_PUSH(VALUE_VOID_VAL);                                                    \
+    } while (false)
+
+#endif
\ No newline at end of file
@@ -0,0 +1,117 @@
+#ifndef _AOT_TEST_H
+#define _AOT_TEST_H
+
+#include <aot/aot.h>
+#include <CUnit/Basic.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The C that aot_emit_c writes for source, or NULL if it fails. The caller
+// frees it.
+static char *aot_test_emit(const char *source)
+{
+    FILE *out = tmpfile();
+
+    if (out == NULL)
+        return NULL;
+
+    vm_init_vm();
+    bool emitted = aot_emit_c("test.scm", source, out);
+    vm_free_vm();
+
+    long length = ftell(out);
+    char *text = NULL;
+
+    if (emitted && length > 0)
+    {
+        text = (char *)malloc(length + 1);
+        rewind(out);
+        text[fread(text, 1, length, out)] = '\0';
+    }
+
+    fclose(out);
+    return text;
+}
+
+// Reads the bytes of aot_program back from the emitted C, and counts the
+// entries of aot_procedures.
+static uint8_t *aot_test_program(const char *text, size_t *size, int *count)
+{
+    const char *table = strstr(text, "aot_procedures[] = {");
+    const char *program = strstr(text, "aot_program[] = {");
+
+    if (table == NULL || program == NULL)
+        return NULL;
+
+    *count = 0;
+    for (const char *entry = strstr(table, ",\n"); entry != NULL && entry < program; entry = strstr(entry + 1, ",\n"))
+        (*count)++;
+
+    uint8_t *bytes = (uint8_t *)malloc(strlen(program));
+    *size = 0;
+
+    for (const char *byte = strstr(program, "0x"); byte != NULL; byte = strstr(byte + 2, "0x"))
+        bytes[(*size)++] = (uint8_t)strtol(byte, NULL, 16);
+
+    return bytes;
+}
+
+void aot_emit_test()
+{
+    char *text = aot_test_emit("(define result\n"
+                               "  (let ((square (lambda (x) (* x x))))\n"
+                               "    (+ (square 3) (square 4))))");
+    CU_ASSERT_PTR_NOT_NULL_FATAL(text);
+
+    CU_ASSERT_PTR_NOT_NULL(strstr(text, "#include <aot/aot.h>"));
+    CU_ASSERT_PTR_NOT_NULL(strstr(text, "static uint8_t *aot_procedure_0(CallFrame *frame)"));
+    CU_ASSERT_PTR_NOT_NULL(strstr(text, "static uint8_t *aot_procedure_1(CallFrame *frame)"));
+    CU_ASSERT_PTR_NOT_NULL(strstr(text, "AOT_PROLOGUE();"));
+    CU_ASSERT_PTR_NOT_NULL(strstr(text, "int main(void)"));
+    CU_ASSERT_PTR_NOT_NULL(strstr(text, "aot_main(aot_program, sizeof(aot_program), aot_procedures,"));
+
+    // The embedded program runs as it is, without any of the procedures
+    size_t size;
+    int count;
+    uint8_t *program = aot_test_program(text, &size, &count);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(program);
+    CU_ASSERT_EQUAL(count, 2);
+    CU_ASSERT_TRUE(size > 0);
+
+    JitProcedure procedures[2] = {NULL, NULL};
+    CU_ASSERT_EQUAL(aot_main(program, size, procedures, count), 0);
+
+    free(program);
+    free(text);
+}
+
+void aot_emit_registers_test()
+{
+    compiler_set_register_code(true);
+
+    char *text = aot_test_emit("(define result\n"
+                               "  (let loop ((i 0) (sum 0))\n"
+                               "    (if (< i 10) (loop (+ i 1) (+ sum i)) sum)))");
+    CU_ASSERT_PTR_NOT_NULL(text);
+
+    // Register ops are written out with the interpreter's checks
+    if (text != NULL)
+    {
+        CU_ASSERT_PTR_NOT_NULL(strstr(text, "AOT_ARITHMETIC("));
+        CU_ASSERT_PTR_NOT_NULL(strstr(text, "AOT_COMPARISON("));
+    }
+
+    free(text);
+    compiler_set_register_code(false);
+}
+
+void aot_emit_failure_test()
+{
+    // Nothing is written for a program that doesn't compile
+    CU_ASSERT_PTR_NULL(aot_test_emit("(define result (+ 1 2)"));
+    CU_ASSERT_PTR_NULL(aot_test_emit("(lambda)"));
+}
+
+#endif
\ No newline at end of file
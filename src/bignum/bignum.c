@@ -0,0 +1,715 @@
+#include <bignum/bignum.h>
+#include <memory/memory.h>
+#include <vm/vm.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BIGNUM_BASE 4294967296.0
+
+// Enough digits for the integral part of any flonum.
+#define BIGNUM_FLONUM_DIGITS 33
+
+// An exact integer as a sign and a magnitude without leading zeros. The
+// digits are those of a bignum, or of a fixnum held in the view itself, so
+// views are passed by pointer and never copied.
+typedef struct
+{
+    bool negative;
+    int count;
+    const uint32_t *digits;
+    uint32_t fixnum[2];
+} BignumView;
+
+static void bignum_view(Value value, BignumView *view)
+{
+    if (VALUE_IS_FIXNUM(value))
+    {
+        int64_t fixnum = VALUE_AS_FIXNUM(value);
+        uint64_t magnitude = fixnum < 0 ? 0 - (uint64_t)fixnum : (uint64_t)fixnum;
+
+        view->negative = fixnum < 0;
+        view->fixnum[0] = (uint32_t)magnitude;
+        view->fixnum[1] = (uint32_t)(magnitude >> 32);
+        view->count = view->fixnum[1] != 0 ? 2 : view->fixnum[0] != 0 ? 1 : 0;
+        view->digits = view->fixnum;
+        return;
+    }
+
+    ObjBignum *bignum = OBJECT_AS_BIGNUM(value);
+    view->negative = bignum->negative;
+    view->count = bignum->count;
+    view->digits = bignum->digits;
+}
+
+// Working digits live outside the collected heap, so that only the result
+// of an operation allocates and its operands can't be collected halfway.
+static uint32_t *bignum_allocate(int count)
+{
+    uint32_t *digits = (uint32_t *)malloc(sizeof(uint32_t) * (count > 0 ? count : 1));
+
+    if (digits == NULL)
+        exit(1);
+
+    return digits;
+}
+
+static int bignum_trim(const uint32_t *digits, int count)
+{
+    while (count > 0 && digits[count - 1] == 0)
+        count--;
+
+    return count;
+}
+
+// The integer of the digits, which may have leading zeros, as a fixnum when
+// it fits in one.
+static Value bignum_make(bool negative, const uint32_t *digits, int count)
+{
+    count = bignum_trim(digits, count);
+
+    if (count <= 2)
+    {
+        uint64_t magnitude = count == 0 ? 0 : count == 1 ? digits[0] : (uint64_t)digits[1] << 32 | digits[0];
+
+        if (magnitude <= INT64_MAX)
+            return VALUE_FIXNUM_VAL(negative ? -(int64_t)magnitude : (int64_t)magnitude);
+        if (negative && magnitude == (uint64_t)INT64_MAX + 1)
+            return VALUE_FIXNUM_VAL(INT64_MIN);
+    }
+
+    ObjBignum *bignum = object_new_bignum(negative, count);
+    memcpy(bignum->digits, digits, sizeof(uint32_t) * count);
+    return VALUE_OBJ_VAL(bignum);
+}
+
+/* Magnitudes */
+
+static int bignum_compare_digits(const uint32_t *a, int a_count, const uint32_t *b, int b_count)
+{
+    if (a_count != b_count)
+        return a_count < b_count ? -1 : 1;
+
+    for (int i = a_count - 1; i >= 0; i--)
+    {
+        if (a[i] != b[i])
+            return a[i] < b[i] ? -1 : 1;
+    }
+
+    return 0;
+}
+
+// Adds b to a, which has at least as many digits, and returns the carry out
+// of a.
+static uint32_t bignum_add_digits(uint32_t *a, int a_count, const uint32_t *b, int b_count)
+{
+    uint64_t carry = 0;
+
+    for (int i = 0; i < a_count && (i < b_count || carry != 0); i++)
+    {
+        uint64_t sum = (uint64_t)a[i] + (i < b_count ? b[i] : 0) + carry;
+        a[i] = (uint32_t)sum;
+        carry = sum >> 32;
+    }
+
+    return (uint32_t)carry;
+}
+
+// Subtracts b from a, which has at least as many digits, and returns the
+// borrow out of a.
+static uint32_t bignum_subtract_digits(uint32_t *a, int a_count, const uint32_t *b, int b_count)
+{
+    uint64_t borrow = 0;
+
+    for (int i = 0; i < a_count && (i < b_count || borrow != 0); i++)
+    {
+        uint64_t difference = (uint64_t)a[i] - (i < b_count ? b[i] : 0) - borrow;
+        a[i] = (uint32_t)difference;
+        borrow = difference >> 63;
+    }
+
+    return (uint32_t)borrow;
+}
+
+// Writes the digits shifted left by fewer than 32 bits, and returns the bits
+// shifted out.
+static uint32_t bignum_shift_left(const uint32_t *digits, int count, int shift, uint32_t *shifted)
+{
+    uint32_t carry = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        uint32_t digit = digits[i];
+        shifted[i] = digit << shift | carry;
+        carry = shift > 0 ? digit >> (32 - shift) : 0;
+    }
+
+    return carry;
+}
+
+static void bignum_multiply_schoolbook(const uint32_t *a, int a_count, const uint32_t *b, int b_count,
+                                       uint32_t *product)
+{
+    memset(product, 0, sizeof(uint32_t) * (a_count + b_count));
+
+    for (int i = 0; i < a_count; i++)
+    {
+        uint64_t carry = 0;
+
+        for (int j = 0; j < b_count; j++)
+        {
+            uint64_t digit = (uint64_t)a[i] * b[j] + product[i + j] + carry;
+            product[i + j] = (uint32_t)digit;
+            carry = digit >> 32;
+        }
+
+        product[i + b_count] = (uint32_t)carry;
+    }
+}
+
+// Writes the a_count + b_count digits of the product.
+static void bignum_multiply_digits(const uint32_t *a, int a_count, const uint32_t *b, int b_count,
+                                   uint32_t *product)
+{
+    if (a_count < b_count)
+    {
+        const uint32_t *digits = a;
+        a = b;
+        b = digits;
+
+        int count = a_count;
+        a_count = b_count;
+        b_count = count;
+    }
+
+    if (b_count < BIGNUM_KARATSUBA_THRESHOLD)
+    {
+        bignum_multiply_schoolbook(a, a_count, b, b_count, product);
+        return;
+    }
+
+    int half = (a_count + 1) / 2;
+    int count = a_count + b_count;
+
+    if (b_count <= half)
+    {
+        // b is too short to be split along with a, so it is multiplied by
+        // each half of a instead.
+        uint32_t *part = bignum_allocate(half + b_count);
+        memset(product, 0, sizeof(uint32_t) * count);
+
+        for (int i = 0; i < a_count; i += half)
+        {
+            int part_count = a_count - i < half ? a_count - i : half;
+            bignum_multiply_digits(a + i, part_count, b, b_count, part);
+            bignum_add_digits(product + i, count - i, part, part_count + b_count);
+        }
+
+        free(part);
+        return;
+    }
+
+    // With a = a1 B^half + a0 and b = b1 B^half + b0, the products a0 b0 and
+    // a1 b1 are the low and the high half of the product, to whose middle
+    // (a0 + a1)(b0 + b1) - a0 b0 - a1 b1 is added.
+    bignum_multiply_digits(a, half, b, half, product);
+    bignum_multiply_digits(a + half, a_count - half, b + half, b_count - half, product + 2 * half);
+
+    int sum_count = half + 1;
+    uint32_t *a_sum = bignum_allocate(4 * sum_count);
+    uint32_t *b_sum = a_sum + sum_count;
+    uint32_t *middle = b_sum + sum_count;
+
+    memcpy(a_sum, a, sizeof(uint32_t) * half);
+    a_sum[half] = 0;
+    bignum_add_digits(a_sum, sum_count, a + half, a_count - half);
+    memcpy(b_sum, b, sizeof(uint32_t) * half);
+    b_sum[half] = 0;
+    bignum_add_digits(b_sum, sum_count, b + half, b_count - half);
+
+    bignum_multiply_digits(a_sum, sum_count, b_sum, sum_count, middle);
+    bignum_subtract_digits(middle, 2 * sum_count, product, 2 * half);
+    bignum_subtract_digits(middle, 2 * sum_count, product + 2 * half, count - 2 * half);
+    bignum_add_digits(product + half, count - half, middle, bignum_trim(middle, 2 * sum_count));
+
+    free(a_sum);
+}
+
+// Divides a by b into a quotient of a_count - b_count + 1 digits and a
+// remainder of b_count digits. b has no leading zeros and at most as many
+// digits as a.
+static void bignum_divide_digits(const uint32_t *a, int a_count, const uint32_t *b, int b_count,
+                                 uint32_t *quotient, uint32_t *remainder)
+{
+    if (b_count == 1)
+    {
+        uint64_t rest = 0;
+
+        for (int i = a_count - 1; i >= 0; i--)
+        {
+            uint64_t current = rest << 32 | a[i];
+            quotient[i] = (uint32_t)(current / b[0]);
+            rest = current % b[0];
+        }
+
+        remainder[0] = (uint32_t)rest;
+        return;
+    }
+
+    // Knuth's algorithm D. Both are shifted until the top bit of b is set,
+    // which keeps each estimate of a quotient digit at most two too large.
+    int shift = __builtin_clz(b[b_count - 1]);
+    uint32_t *u = bignum_allocate(a_count + 1 + b_count);
+    uint32_t *v = u + a_count + 1;
+
+    bignum_shift_left(b, b_count, shift, v);
+    u[a_count] = bignum_shift_left(a, a_count, shift, u);
+
+    for (int j = a_count - b_count; j >= 0; j--)
+    {
+        uint64_t top = (uint64_t)u[j + b_count] << 32 | u[j + b_count - 1];
+        uint64_t estimate = top / v[b_count - 1];
+        uint64_t rest = top % v[b_count - 1];
+
+        while (estimate > UINT32_MAX || estimate * v[b_count - 2] > (rest << 32 | u[j + b_count - 2]))
+        {
+            estimate--;
+            rest += v[b_count - 1];
+
+            if (rest > UINT32_MAX)
+                break;
+        }
+
+        // Subtracts estimate times v from the digits of u at j.
+        int64_t borrow = 0;
+
+        for (int i = 0; i < b_count; i++)
+        {
+            uint64_t product = estimate * v[i];
+            int64_t difference = (int64_t)u[i + j] - borrow - (int64_t)(product & UINT32_MAX);
+            u[i + j] = (uint32_t)difference;
+            borrow = (int64_t)(product >> 32) - (difference >> 32);
+        }
+
+        int64_t difference = (int64_t)u[j + b_count] - borrow;
+        u[j + b_count] = (uint32_t)difference;
+
+        // The estimate was one too large, so v is added back.
+        if (difference < 0)
+        {
+            estimate--;
+            u[j + b_count] += bignum_add_digits(u + j, b_count, v, b_count);
+        }
+
+        quotient[j] = (uint32_t)estimate;
+    }
+
+    for (int i = 0; i < b_count; i++)
+        remainder[i] = shift > 0 ? u[i] >> shift | u[i + 1] << (32 - shift) : u[i];
+
+    free(u);
+}
+
+/* Arithmetic */
+
+// a + b, or a - b when negate is set.
+static Value bignum_add_views(const BignumView *a, const BignumView *b, bool negate)
+{
+    bool a_negative = a->negative;
+    bool b_negative = b->negative != negate;
+
+    // The larger magnitude comes first, so that the smaller one can be
+    // subtracted from it when the signs differ.
+    if (bignum_compare_digits(a->digits, a->count, b->digits, b->count) < 0)
+    {
+        const BignumView *view = a;
+        a = b;
+        b = view;
+
+        bool negative = a_negative;
+        a_negative = b_negative;
+        b_negative = negative;
+    }
+
+    int count = a->count + 1;
+    uint32_t *digits = bignum_allocate(count);
+    memcpy(digits, a->digits, sizeof(uint32_t) * a->count);
+    digits[a->count] = 0;
+
+    if (a_negative == b_negative)
+        bignum_add_digits(digits, count, b->digits, b->count);
+    else
+        bignum_subtract_digits(digits, count, b->digits, b->count);
+
+    Value result = bignum_make(a_negative, digits, count);
+    free(digits);
+    return result;
+}
+
+Value bignum_add(Value a, Value b)
+{
+    BignumView x, y;
+    bignum_view(a, &x);
+    bignum_view(b, &y);
+    return bignum_add_views(&x, &y, false);
+}
+
+Value bignum_subtract(Value a, Value b)
+{
+    BignumView x, y;
+    bignum_view(a, &x);
+    bignum_view(b, &y);
+    return bignum_add_views(&x, &y, true);
+}
+
+Value bignum_multiply(Value a, Value b)
+{
+    BignumView x, y;
+    bignum_view(a, &x);
+    bignum_view(b, &y);
+
+    if (x.count == 0 || y.count == 0)
+        return VALUE_FIXNUM_VAL(0);
+
+    int count = x.count + y.count;
+    uint32_t *product = bignum_allocate(count);
+    bignum_multiply_digits(x.digits, x.count, y.digits, y.count, product);
+
+    Value result = bignum_make(x.negative != y.negative, product, count);
+    free(product);
+    return result;
+}
+
+void bignum_divide(Value a, Value b, Value *quotient, Value *remainder)
+{
+    BignumView x, y;
+    bignum_view(a, &x);
+    bignum_view(b, &y);
+
+    if (bignum_compare_digits(x.digits, x.count, y.digits, y.count) < 0)
+    {
+        if (quotient != NULL)
+            *quotient = VALUE_FIXNUM_VAL(0);
+        if (remainder != NULL)
+            *remainder = a;
+        return;
+    }
+
+    int quotient_count = x.count - y.count + 1;
+    uint32_t *digits = bignum_allocate(quotient_count + y.count);
+    bignum_divide_digits(x.digits, x.count, y.digits, y.count, digits, digits + quotient_count);
+
+    Value result = VALUE_FIXNUM_VAL(0);
+
+    if (quotient != NULL)
+        result = bignum_make(x.negative != y.negative, digits, quotient_count);
+
+    if (remainder != NULL)
+    {
+        // The quotient is kept from being collected while the remainder is
+        // allocated.
+        vm_push(result);
+        *remainder = bignum_make(x.negative, digits + quotient_count, y.count);
+        vm_pop();
+    }
+
+    if (quotient != NULL)
+        *quotient = result;
+
+    free(digits);
+}
+
+// Newton's method on integers, from a power of two above the root, finds
+// the largest integer whose square is at most the value.
+bool bignum_square_root(Value value, Value *root)
+{
+    BignumView n;
+    bignum_view(value, &n);
+
+    if (n.count == 0)
+    {
+        *root = value;
+        return true;
+    }
+
+    int count = n.count;
+    uint32_t *x = bignum_allocate(6 * count + 3);
+    uint32_t *quotient = x + count;
+    uint32_t *remainder = quotient + count + 1;
+    uint32_t *next = remainder + count;
+    uint32_t *square = next + count + 2;
+
+    int bits = 32 * count - __builtin_clz(n.digits[count - 1]);
+    int bit = (bits + 1) / 2;
+    memset(x, 0, sizeof(uint32_t) * count);
+    x[bit / 32] = (uint32_t)1 << (bit % 32);
+
+    int x_count = bignum_trim(x, count);
+
+    for (;;)
+    {
+        int quotient_count = count - x_count + 1;
+        bignum_divide_digits(n.digits, count, x, x_count, quotient, remainder);
+
+        // next = (x + n / x) / 2
+        int next_count = (x_count > quotient_count ? x_count : quotient_count) + 1;
+        memset(next, 0, sizeof(uint32_t) * next_count);
+        memcpy(next, x, sizeof(uint32_t) * x_count);
+        bignum_add_digits(next, next_count, quotient, quotient_count);
+
+        for (int i = 0; i < next_count; i++)
+            next[i] = next[i] >> 1 | (i + 1 < next_count ? next[i + 1] << 31 : 0);
+
+        next_count = bignum_trim(next, next_count);
+
+        if (bignum_compare_digits(next, next_count, x, x_count) >= 0)
+            break;
+
+        memcpy(x, next, sizeof(uint32_t) * next_count);
+        x_count = next_count;
+    }
+
+    bignum_multiply_digits(x, x_count, x, x_count, square);
+    bool exact = bignum_compare_digits(square, bignum_trim(square, 2 * x_count), n.digits, count) == 0;
+
+    if (exact)
+        *root = bignum_make(false, x, x_count);
+
+    free(x);
+    return exact;
+}
+
+/* Comparison and conversion */
+
+static int bignum_compare_views(const BignumView *a, const BignumView *b)
+{
+    if (a->negative != b->negative)
+        return a->negative ? -1 : 1;
+
+    int order = bignum_compare_digits(a->digits, a->count, b->digits, b->count);
+    return a->negative ? -order : order;
+}
+
+int bignum_compare(Value a, Value b)
+{
+    BignumView x, y;
+    bignum_view(a, &x);
+    bignum_view(b, &y);
+    return bignum_compare_views(&x, &y);
+}
+
+// Writes the digits of the magnitude of an integral flonum, and returns
+// their count. Dividing by the base is exact, so no digit is rounded.
+static int bignum_flonum_digits(double whole, uint32_t *digits)
+{
+    int count = 0;
+
+    for (double rest = fabs(whole); rest >= 1; rest = floor(rest / BIGNUM_BASE))
+        digits[count++] = (uint32_t)fmod(rest, BIGNUM_BASE);
+
+    return count;
+}
+
+// The integral part is compared first, and the fraction settles a tie.
+int bignum_compare_flonum(Value a, double b)
+{
+    if (isinf(b))
+        return b > 0 ? -1 : 1;
+
+    double whole = floor(b);
+    uint32_t digits[BIGNUM_FLONUM_DIGITS];
+    BignumView x, y;
+
+    bignum_view(a, &x);
+    y.negative = whole < 0;
+    y.count = bignum_flonum_digits(whole, digits);
+    y.digits = digits;
+
+    int order = bignum_compare_views(&x, &y);
+    return order != 0 ? order : whole < b ? -1 : 0;
+}
+
+// The top 64 bits are converted, with the lowest one set when any bit below
+// them is, so that the conversion rounds as if it saw every bit.
+double bignum_to_flonum(Value value)
+{
+    BignumView view;
+    bignum_view(value, &view);
+
+    if (view.count == 0)
+        return 0;
+
+    const uint32_t *digits = view.digits;
+    int top = view.count - 1;
+    int shift = __builtin_clz(digits[top]);
+    uint64_t bits = (uint64_t)digits[top] << (32 + shift);
+    bool sticky = false;
+
+    if (top >= 1)
+        bits |= (uint64_t)digits[top - 1] << shift;
+
+    if (top >= 2)
+    {
+        if (shift > 0)
+            bits |= digits[top - 2] >> (32 - shift);
+        sticky = (shift > 0 ? digits[top - 2] << shift : digits[top - 2]) != 0;
+    }
+
+    for (int i = 0; i < top - 2 && !sticky; i++)
+        sticky = digits[i] != 0;
+
+    double magnitude = ldexp((double)(bits | sticky), 32 * top - 32 - shift);
+    return view.negative ? -magnitude : magnitude;
+}
+
+Value bignum_from_flonum(double flonum)
+{
+    uint32_t digits[BIGNUM_FLONUM_DIGITS];
+    int count = bignum_flonum_digits(flonum, digits);
+    return bignum_make(flonum < 0, digits, count);
+}
+
+static const char bignum_numerals[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+
+// The largest power of the radix that fits in a digit, and its exponent.
+static uint32_t bignum_radix_power(int radix, int *exponent)
+{
+    uint32_t power = (uint32_t)radix;
+    *exponent = 1;
+
+    while (power <= UINT32_MAX / radix)
+    {
+        power *= radix;
+        (*exponent)++;
+    }
+
+    return power;
+}
+
+// Reads as many characters at a time as fit in a digit.
+Value bignum_from_chars(const char *chars, int length, int radix)
+{
+    bool negative = length > 0 && chars[0] == '-';
+    int exponent;
+    bignum_radix_power(radix, &exponent);
+
+    // No numeral is worth more than six bits.
+    uint32_t *digits = bignum_allocate(6 * length / 32 + 2);
+    int count = 0;
+
+    for (int i = negative ? 1 : 0; i < length;)
+    {
+        uint32_t scale = 1;
+        uint32_t chunk = 0;
+
+        for (int end = i + exponent; i < length && i < end; i++)
+        {
+            const char *numeral = strchr(bignum_numerals, chars[i] | 0x20);
+            chunk = chunk * radix + (uint32_t)(numeral - bignum_numerals);
+            scale *= radix;
+        }
+
+        uint64_t carry = chunk;
+
+        for (int j = 0; j < count; j++)
+        {
+            uint64_t digit = (uint64_t)digits[j] * scale + carry;
+            digits[j] = (uint32_t)digit;
+            carry = digit >> 32;
+        }
+
+        if (carry != 0)
+            digits[count++] = (uint32_t)carry;
+    }
+
+    Value result = bignum_make(negative, digits, count);
+    free(digits);
+    return result;
+}
+
+// Divides by the largest power of the radix in a digit, and writes out the
+// remainder, from the last numeral back.
+char *bignum_to_chars(Value value, int radix, int *length)
+{
+    BignumView view;
+    bignum_view(value, &view);
+
+    int exponent;
+    uint32_t power = bignum_radix_power(radix, &exponent);
+
+    // A digit is at most 32 numerals, which leaves room for the sign.
+    int capacity = 32 * view.count + 2;
+    char *text = (char *)malloc(capacity);
+    uint32_t *rest = bignum_allocate(view.count);
+    int count = view.count;
+    int position = capacity - 1;
+
+    if (text == NULL)
+        exit(1);
+
+    memcpy(rest, view.digits, sizeof(uint32_t) * count);
+    text[position] = '\0';
+
+    while (count > 0)
+    {
+        uint64_t remainder = 0;
+
+        for (int i = count - 1; i >= 0; i--)
+        {
+            uint64_t current = remainder << 32 | rest[i];
+            rest[i] = (uint32_t)(current / power);
+            remainder = current % power;
+        }
+
+        count = bignum_trim(rest, count);
+
+        // Leading zeros are written for all but the most significant part.
+        for (int i = 0; i < exponent && (count > 0 || remainder > 0); i++)
+        {
+            text[--position] = bignum_numerals[remainder % radix];
+            remainder /= radix;
+        }
+    }
+
+    if (position == capacity - 1)
+        text[--position] = '0';
+    if (view.negative)
+        text[--position] = '-';
+
+    *length = capacity - 1 - position;
+    char *chars = MEMORY_ALLOCATE(char, *length + 1);
+    memcpy(chars, text + position, *length + 1);
+
+    free(text);
+    free(rest);
+    return chars;
+}
+
+void bignum_print(ObjBignum *bignum)
+{
+    int length;
+    char *chars = bignum_to_chars(VALUE_OBJ_VAL(bignum), 10, &length);
+    printf("%s", chars);
+    MEMORY_FREE_ARRAY(char, chars, length + 1);
+}
+
+bool bignum_equal(ObjBignum *a, ObjBignum *b)
+{
+    return a->negative == b->negative && a->count == b->count &&
+           memcmp(a->digits, b->digits, sizeof(uint32_t) * a->count) == 0;
+}
+
+uint32_t bignum_hash(ObjBignum *bignum)
+{
+    uint32_t hash = 2166136261u ^ bignum->negative;
+
+    for (int i = 0; i < bignum->count; i++)
+    {
+        hash ^= bignum->digits[i];
+        hash *= 16777619;
+    }
+
+    return hash;
+}
\ No newline at end of file
@@ -0,0 +1,45 @@
+#ifndef _BIGNUM_H
+#define _BIGNUM_H
+
+#include <common/common.h>
+#include <object/object.h>
+
+// Exact integers of any size. Fixnum arithmetic that overflows goes on in
+// bignums, and any result that fits a fixnum again is one, so that no
+// bignum holds a fixnum's value and the common case allocates nothing.
+//
+// The functions take and return exact integers, fixnums or bignums. They
+// allocate the bignums they return, so operands that are not reachable from
+// the VM stack must be pushed onto it while calling them.
+
+// Products of numbers with this many digits or more are split in halves,
+// and computed from three products of those instead of four (Karatsuba).
+#define BIGNUM_KARATSUBA_THRESHOLD 32
+
+Value bignum_add(Value a, Value b);
+Value bignum_subtract(Value a, Value b);
+Value bignum_multiply(Value a, Value b);
+// Divides a by b, which is not zero, with the quotient truncated and the
+// remainder taking the sign of a. Either result may be NULL.
+void bignum_divide(Value a, Value b, Value *quotient, Value *remainder);
+// Whether a non-negative integer is a square, and its root if so.
+bool bignum_square_root(Value value, Value *root);
+
+int bignum_compare(Value a, Value b);
+// Compares exactly with a flonum that is not a NaN.
+int bignum_compare_flonum(Value a, double b);
+
+double bignum_to_flonum(Value value);
+// The integer of an integral flonum that is finite.
+Value bignum_from_flonum(double flonum);
+
+// Reads the digits in the radix, from 2 to 36, after an optional '-'.
+Value bignum_from_chars(const char *chars, int length, int radix);
+// Writes the digits in the radix to a new array of length + 1 chars.
+char *bignum_to_chars(Value value, int radix, int *length);
+void bignum_print(ObjBignum *bignum);
+
+bool bignum_equal(ObjBignum *a, ObjBignum *b);
+uint32_t bignum_hash(ObjBignum *bignum);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,245 @@
+#ifndef _BIGNUM_TEST_H
+#define _BIGNUM_TEST_H
+
+#include <bignum/bignum.h>
+#include <memory/memory.h>
+#include <primitive/primitive.h>
+#include <vm/vm.h>
+#include <CUnit/Basic.h>
+
+#include <string.h>
+
+// The integer written in decimal, kept on the VM stack until vm_free_vm.
+static Value bignum_test_read(const char *text)
+{
+    Value value = bignum_from_chars(text, (int)strlen(text), 10);
+    vm_push(value);
+    return value;
+}
+
+// Whether value is written as text in the radix.
+static bool bignum_test_written(Value value, int radix, const char *text)
+{
+    int length;
+    char *chars = bignum_to_chars(value, radix, &length);
+    bool written = length == (int)strlen(text) && strcmp(chars, text) == 0;
+    MEMORY_FREE_ARRAY(char, chars, length + 1);
+    return written;
+}
+
+// n!, kept on the VM stack until vm_free_vm.
+static Value bignum_test_factorial(int n)
+{
+    Value product = VALUE_FIXNUM_VAL(1);
+    vm_push(product);
+
+    for (int i = 2; i <= n; i++)
+    {
+        product = bignum_multiply(product, VALUE_FIXNUM_VAL(i));
+        vm_pop();
+        vm_push(product);
+    }
+
+    return product;
+}
+
+void bignum_fixnum_boundary_test()
+{
+    vm_init_vm();
+
+    Value max = VALUE_FIXNUM_VAL(INT64_MAX);
+    Value min = VALUE_FIXNUM_VAL(INT64_MIN);
+    Value one = VALUE_FIXNUM_VAL(1);
+
+    // Results beyond the fixnums are bignums
+    Value above = bignum_add(max, one);
+    vm_push(above);
+    CU_ASSERT_TRUE(OBJECT_IS_BIGNUM(above));
+    CU_ASSERT_TRUE(bignum_test_written(above, 10, "9223372036854775808"));
+
+    Value below = bignum_subtract(min, one);
+    vm_push(below);
+    CU_ASSERT_TRUE(OBJECT_IS_BIGNUM(below));
+    CU_ASSERT_TRUE(bignum_test_written(below, 10, "-9223372036854775809"));
+
+    Value negated = bignum_multiply(min, VALUE_FIXNUM_VAL(-1));
+    vm_push(negated);
+    CU_ASSERT_TRUE(OBJECT_IS_BIGNUM(negated));
+    CU_ASSERT_EQUAL(bignum_compare(negated, above), 0);
+
+    Value quotient;
+    bignum_divide(min, VALUE_FIXNUM_VAL(-1), &quotient, NULL);
+    vm_push(quotient);
+    CU_ASSERT_EQUAL(bignum_compare(quotient, above), 0);
+
+    // Results that fit a fixnum again are fixnums
+    Value back = bignum_subtract(above, one);
+    CU_ASSERT_TRUE(VALUE_IS_FIXNUM(back));
+    CU_ASSERT_EQUAL(VALUE_AS_FIXNUM(back), INT64_MAX);
+
+    back = bignum_add(below, one);
+    CU_ASSERT_TRUE(VALUE_IS_FIXNUM(back));
+    CU_ASSERT_EQUAL(VALUE_AS_FIXNUM(back), INT64_MIN);
+
+    back = bignum_add(above, below);
+    CU_ASSERT_TRUE(VALUE_IS_FIXNUM(back));
+    CU_ASSERT_EQUAL(VALUE_AS_FIXNUM(back), -1);
+
+    Value read = bignum_test_read("-9223372036854775808");
+    CU_ASSERT_TRUE(VALUE_IS_FIXNUM(read));
+    CU_ASSERT_EQUAL(VALUE_AS_FIXNUM(read), INT64_MIN);
+
+    read = bignum_test_read("9223372036854775808");
+    CU_ASSERT_TRUE(OBJECT_IS_BIGNUM(read));
+
+    vm_free_vm();
+}
+
+void bignum_karatsuba_test()
+{
+    vm_init_vm();
+
+    // Both factors are far above BIGNUM_KARATSUBA_THRESHOLD digits
+    Value a = bignum_test_factorial(700);
+    Value b = bignum_test_factorial(650);
+    Value product = bignum_multiply(a, b);
+    vm_push(product);
+
+    int length;
+    char *chars = bignum_to_chars(product, 10, &length);
+    CU_ASSERT_EQUAL(length, 3238);
+    CU_ASSERT_EQUAL(strncmp(chars, "1959080156267453546791796642593348125573", 40), 0);
+    CU_ASSERT_EQUAL(strncmp(chars + length - 356, "31208083074864644096", 20), 0);
+    CU_ASSERT_EQUAL(strspn(chars + length - 336, "0"), 336);
+    MEMORY_FREE_ARRAY(char, chars, length + 1);
+
+    Value remainder;
+    bignum_divide(product, VALUE_FIXNUM_VAL(1000000007), NULL, &remainder);
+    CU_ASSERT_TRUE(VALUE_IS_FIXNUM(remainder));
+    CU_ASSERT_EQUAL(VALUE_AS_FIXNUM(remainder), 515051263);
+
+    bignum_divide(product, VALUE_FIXNUM_VAL(2305843009213693951), NULL, &remainder);
+    CU_ASSERT_TRUE(VALUE_IS_FIXNUM(remainder));
+    CU_ASSERT_EQUAL(VALUE_AS_FIXNUM(remainder), 1571917047256176702);
+
+    // The sign of a product is that of a schoolbook one
+    Value negative = bignum_subtract(VALUE_FIXNUM_VAL(0), a);
+    vm_push(negative);
+    Value negated = bignum_multiply(negative, b);
+    vm_push(negated);
+    CU_ASSERT_EQUAL(bignum_compare(bignum_add(negated, product), VALUE_FIXNUM_VAL(0)), 0);
+
+    vm_free_vm();
+}
+
+void bignum_divide_test()
+{
+    vm_init_vm();
+
+    // A divisor of two digits
+    Value n = bignum_test_read("340282366920938463463374607431768211456");
+    Value d = bignum_test_read("18446744073709551615");
+    Value quotient, remainder;
+
+    bignum_divide(n, d, &quotient, &remainder);
+    vm_push(quotient);
+    CU_ASSERT_TRUE(bignum_test_written(quotient, 10, "18446744073709551617"));
+    CU_ASSERT_TRUE(VALUE_IS_FIXNUM(remainder));
+    CU_ASSERT_EQUAL(VALUE_AS_FIXNUM(remainder), 1);
+
+    // Long division by a divisor of many digits leaves nothing over
+    Value a = bignum_test_factorial(700);
+    Value b = bignum_test_factorial(650);
+    Value product = bignum_multiply(a, b);
+    vm_push(product);
+
+    bignum_divide(product, b, &quotient, &remainder);
+    vm_push(quotient);
+    CU_ASSERT_EQUAL(bignum_compare(quotient, a), 0);
+    CU_ASSERT_TRUE(VALUE_IS_FIXNUM(remainder));
+    CU_ASSERT_EQUAL(VALUE_AS_FIXNUM(remainder), 0);
+
+    // and otherwise n = q * d + r with r less than d
+    Value divisor = bignum_add(b, VALUE_FIXNUM_VAL(1));
+    vm_push(divisor);
+    bignum_divide(a, divisor, &quotient, &remainder);
+    vm_push(quotient);
+    vm_push(remainder);
+    CU_ASSERT_TRUE(bignum_compare(remainder, VALUE_FIXNUM_VAL(0)) > 0);
+    CU_ASSERT_TRUE(bignum_compare(remainder, divisor) < 0);
+
+    Value multiple = bignum_multiply(quotient, divisor);
+    vm_push(multiple);
+    CU_ASSERT_EQUAL(bignum_compare(bignum_add(multiple, remainder), a), 0);
+
+    vm_free_vm();
+}
+
+void bignum_division_signs_test()
+{
+    vm_init_vm();
+
+    const char *dividends[] = {"10000000000000000000000000000000000012345",
+                               "-10000000000000000000000000000000000012345"};
+    const char *divisors[] = {"100000000000000000007", "-100000000000000000007"};
+
+    // Truncated quotients, remainders with the sign of the dividend and
+    // modulos with that of the divisor, for each combination of signs
+    const char *quotients[] = {"99999999999999999993", "-99999999999999999993", "-99999999999999999993",
+                               "99999999999999999993"};
+    int64_t remainders[] = {12394, 12394, -12394, -12394};
+    const char *modulos[] = {"12394", "-99999999999999987613", "99999999999999987613", "-12394"};
+
+    for (int i = 0; i < 2; i++)
+    {
+        for (int j = 0; j < 2; j++)
+        {
+            Value args[2] = {bignum_test_read(dividends[i]), bignum_test_read(divisors[j])};
+            int k = 2 * i + j;
+
+            Value quotient = primitive_quotient(2, args);
+            CU_ASSERT_TRUE(bignum_test_written(quotient, 10, quotients[k]));
+
+            Value remainder = primitive_remainder(2, args);
+            CU_ASSERT_TRUE(VALUE_IS_FIXNUM(remainder));
+            CU_ASSERT_EQUAL(VALUE_AS_FIXNUM(remainder), remainders[k]);
+
+            Value modulo = primitive_modulo(2, args);
+            CU_ASSERT_TRUE(bignum_test_written(modulo, 10, modulos[k]));
+        }
+    }
+
+    vm_free_vm();
+}
+
+void bignum_radix_test()
+{
+    vm_init_vm();
+
+    Value power = bignum_test_read("1267650600228229401496703205376");
+    CU_ASSERT_TRUE(bignum_test_written(power, 10, "1267650600228229401496703205376"));
+    CU_ASSERT_TRUE(bignum_test_written(power, 16, "10000000000000000000000000"));
+
+    char binary[102] = "1";
+    memset(binary + 1, '0', 100);
+    binary[101] = '\0';
+    CU_ASSERT_TRUE(bignum_test_written(power, 2, binary));
+
+    Value read = bignum_from_chars(binary, 101, 2);
+    CU_ASSERT_EQUAL(bignum_compare(read, power), 0);
+
+    // Numerals of any case, and a sign
+    read = bignum_from_chars("-ZZZZZZZZZZzzzzzzzzzz", 21, 36);
+    vm_push(read);
+    CU_ASSERT_TRUE(bignum_test_written(read, 10, "-13367494538843734067838845976575"));
+    CU_ASSERT_TRUE(bignum_test_written(read, 36, "-zzzzzzzzzzzzzzzzzzzz"));
+
+    // Zeros within and below the most significant part are written out
+    read = bignum_test_read("100000000000000000000000000000000000000000000000000000000000000000000000000001");
+    CU_ASSERT_TRUE(
+        bignum_test_written(read, 10, "100000000000000000000000000000000000000000000000000000000000000000000000000001"));
+
+    vm_free_vm();
+}
+
+#endif
\ No newline at end of file
@@ -1,23 +1,30 @@
 #include <chunk/chunk.h>
 #include <memory/memory.h>
 #include <vm/vm.h>
+#include <object/object.h>
 
 #include <stdlib.h>
+#include <string.h>
 
 void chunk_init_chunk(Chunk *chunk)
 {
     chunk->count = 0;
     chunk->capacity = 0;
     chunk->code = NULL;
+    chunk->line_count = 0;
+    chunk->line_capacity = 0;
     chunk->lines = NULL;
     value_init_value_array(&chunk->constants);
+    chunk->constant_index = NULL;
+    chunk->constant_index_capacity = 0;
 }
 
 void chunk_free_chunk(Chunk *chunk)
 {
     MEMORY_FREE_ARRAY(uint8_t, chunk->code, chunk->capacity);
-    MEMORY_FREE_ARRAY(int, chunk->lines, chunk->capacity);
+    MEMORY_FREE_ARRAY(LineRun, chunk->lines, chunk->line_capacity);
     value_free_value_array(&chunk->constants);
+    chunk_free_constant_index(chunk);
     chunk_init_chunk(chunk);
 }
 
@@ -28,21 +35,298 @@ void chunk_write_chunk(Chunk *chunk, uint8_t byte, int line)
         int old_capacity = chunk->capacity;
         chunk->capacity = MEMORY_GROW_CAPACITY(old_capacity);
         chunk->code = MEMORY_GROW_ARRAY(uint8_t, chunk->code, old_capacity, chunk->capacity);
-        chunk->lines = MEMORY_GROW_ARRAY(int, chunk->lines, old_capacity, chunk->capacity);
     }
 
     chunk->code[chunk->count] = byte;
-    chunk->lines[chunk->count] = line;
+    chunk_add_line(chunk, chunk->count, line);
     chunk->count++;
 }
 
+// Opens a gap of count bytes at offset. Line runs starting at or after the
+// offset move with the code.
+void chunk_insert_bytes(Chunk *chunk, int offset, int count)
+{
+    if (chunk->capacity < chunk->count + count)
+    {
+        int old_capacity = chunk->capacity;
+        while (chunk->capacity < chunk->count + count)
+            chunk->capacity = MEMORY_GROW_CAPACITY(chunk->capacity);
+        chunk->code = MEMORY_GROW_ARRAY(uint8_t, chunk->code, old_capacity, chunk->capacity);
+    }
+
+    memmove(chunk->code + offset + count, chunk->code + offset, chunk->count - offset);
+    chunk->count += count;
+
+    for (int i = 0; i < chunk->line_count; i++)
+    {
+        if (chunk->lines[i].offset >= offset)
+            chunk->lines[i].offset += count;
+    }
+}
+
+// Starts a new run at offset unless the line is the same as the last run's.
+// Offsets must be added in increasing order.
+void chunk_add_line(Chunk *chunk, int offset, int line)
+{
+    if (chunk->line_count > 0 && chunk->lines[chunk->line_count - 1].line == line)
+        return;
+
+    if (chunk->line_capacity < chunk->line_count + 1)
+    {
+        int old_capacity = chunk->line_capacity;
+        chunk->line_capacity = MEMORY_GROW_CAPACITY(old_capacity);
+        chunk->lines = MEMORY_GROW_ARRAY(LineRun, chunk->lines, old_capacity, chunk->line_capacity);
+    }
+
+    chunk->lines[chunk->line_count].offset = offset;
+    chunk->lines[chunk->line_count].line = line;
+    chunk->line_count++;
+}
+
+// Only used to report errors, so a binary search over the runs is plenty.
+int chunk_get_line(Chunk *chunk, int offset)
+{
+    int low = 0, high = chunk->line_count - 1;
+
+    if (high < 0)
+        return 0;
+
+    while (low < high)
+    {
+        int middle = low + (high - low + 1) / 2;
+
+        if (chunk->lines[middle].offset <= offset)
+            low = middle;
+        else
+            high = middle - 1;
+    }
+
+    return chunk->lines[low].line;
+}
+
+// Returns the bucket holding an identical constant, or the empty bucket
+// ending its probe sequence.
+static int chunk_find_constant(Chunk *chunk, Value value)
+{
+    int mask = chunk->constant_index_capacity - 1;
+    int bucket = (int)(value_hash_value(value) & (uint32_t)mask);
+
+    for (;;)
+    {
+        int constant = chunk->constant_index[bucket];
+
+        if (constant == -1 ||
+            value_values_identical(chunk->constants.values[constant], value))
+            return bucket;
+
+        bucket = (bucket + 1) & mask;
+    }
+}
+
+static void chunk_grow_constant_index(Chunk *chunk)
+{
+    int old_capacity = chunk->constant_index_capacity;
+    MEMORY_FREE_ARRAY(int, chunk->constant_index, old_capacity);
+
+    chunk->constant_index_capacity = old_capacity < 16 ? 16 : old_capacity * 2;
+    chunk->constant_index = MEMORY_ALLOCATE(int, chunk->constant_index_capacity);
+
+    for (int i = 0; i < chunk->constant_index_capacity; i++)
+        chunk->constant_index[i] = -1;
+
+    for (int i = 0; i < chunk->constants.count; i++)
+        chunk->constant_index[chunk_find_constant(chunk, chunk->constants.values[i])] = i;
+}
+
+// Returns the index of an identical constant already in the pool, or appends
+// the value.
 int chunk_add_constant(Chunk *chunk, Value value)
 {
     // Push and pop the value so it doesn't get garbage collected before written
-    // to the constant table.
+    // to the constant table, which growing the index may trigger as well.
     vm_push(value);
-    value_write_value_array(&chunk->constants, value);
+
+    if ((chunk->constants.count + 1) * 2 > chunk->constant_index_capacity)
+        chunk_grow_constant_index(chunk);
+
+    int bucket = chunk_find_constant(chunk, value);
+
+    if (chunk->constant_index[bucket] == -1)
+    {
+        value_write_value_array(&chunk->constants, value);
+        chunk->constant_index[bucket] = chunk->constants.count - 1;
+    }
+
     vm_pop();
+    return chunk->constant_index[bucket];
+}
+
+void chunk_free_constant_index(Chunk *chunk)
+{
+    MEMORY_FREE_ARRAY(int, chunk->constant_index, chunk->constant_index_capacity);
+    chunk->constant_index = NULL;
+    chunk->constant_index_capacity = 0;
+}
+
+int chunk_instruction_size(Chunk *chunk, int offset)
+{
+    switch (chunk->code[offset])
+    {
+    case OP_CONSTANT_LONG:
+    case OP_JUMP_LONG:
+    case OP_JUMP_IF_FALSE_LONG:
+    case OP_POP_JUMP_IF_FALSE_LONG:
+    case OP_LOOP_LONG:
+        return 4;
+    case OP_GET_GLOBAL:
+    case OP_GLOBAL_UNCHANGED:
+    case OP_SET_GLOBAL:
+    case OP_GET_LOCAL_LONG:
+    case OP_SET_LOCAL_LONG:
+    case OP_GET_UPVALUE_LONG:
+    case OP_GET_BOXED_UPVALUE_LONG:
+    case OP_SET_UPVALUE_LONG:
+    case OP_JUMP:
+    case OP_JUMP_IF_FALSE:
+    case OP_POP_JUMP_IF_FALSE:
+    case OP_LOOP:
+    case OP_CLOSE_LOCAL:
+        return 3;
+    case OP_CONSTANT:
+    case OP_POPN:
+    case OP_GET_LOCAL:
+    case OP_SET_LOCAL:
+    case OP_GET_UPVALUE:
+    case OP_GET_BOXED_UPVALUE:
+    case OP_SET_UPVALUE:
+    case OP_CALL:
+    case OP_TAIL_CALL:
+    case OP_VECTOR_REF:
+    case OP_VECTOR_SET:
+        return 2;
+    case OP_ADD:
+    case OP_SUBTRACT:
+    case OP_MULTIPLY:
+    case OP_EQUAL:
+    case OP_LESS:
+    case OP_GREATER:
+    case OP_LESS_EQUAL:
+    case OP_GREATER_EQUAL:
+    case OP_ADD_UNCHECKED:
+    case OP_SUBTRACT_UNCHECKED:
+    case OP_MULTIPLY_UNCHECKED:
+    case OP_EQUAL_UNCHECKED:
+    case OP_LESS_UNCHECKED:
+    case OP_GREATER_UNCHECKED:
+    case OP_LESS_EQUAL_UNCHECKED:
+    case OP_GREATER_EQUAL_UNCHECKED:
+        return 4;
+    case OP_SWITCH:
+    {
+        int size = (chunk->code[offset + 2] << 8) | chunk->code[offset + 3];
+        return CHUNK_SWITCH_HEADER + size * (CHUNK_SWITCH_IS_DENSE(chunk->code[offset + 1]) ? 4 : 7);
+    }
+    case OP_CLOSURE:
+    {
+        // The constant is followed by a (flags, index) pair per upvalue.
+        Value function = chunk->constants.values[chunk->code[offset + 1]];
+        return 2 + 2 * OBJECT_AS_FUNCTION(function)->upvalue_count;
+    }
+    case OP_CLOSURE_LONG:
+    {
+        // A 24-bit constant, then flags and a 16-bit index per upvalue.
+        int constant = (chunk->code[offset + 1] << 16) |
+                       (chunk->code[offset + 2] << 8) |
+                       chunk->code[offset + 3];
+        Value function = chunk->constants.values[constant];
+        return 4 + 3 * OBJECT_AS_FUNCTION(function)->upvalue_count;
+    }
+    case OP_STACK_CLOSURE:
+    {
+        // Like OP_CLOSURE, with a 16-bit arena offset after the constant.
+        Value function = chunk->constants.values[chunk->code[offset + 1]];
+        return 4 + 2 * OBJECT_AS_FUNCTION(function)->upvalue_count;
+    }
+    case OP_STACK_CLOSURE_LONG:
+    {
+        int constant = (chunk->code[offset + 1] << 16) |
+                       (chunk->code[offset + 2] << 8) |
+                       chunk->code[offset + 3];
+        Value function = chunk->constants.values[constant];
+        return 6 + 3 * OBJECT_AS_FUNCTION(function)->upvalue_count;
+    }
+    default:
+        return 1;
+    }
+}
+
+// Unlike value_hash_value this doesn't depend on where strings are allocated,
+// so that tables stay valid in cached and imaged code.
+uint32_t chunk_switch_hash(Value key)
+{
+    if (OBJECT_IS_STRING(key))
+        return OBJECT_AS_STRING(key)->hash;
+    return value_hash_value(key);
+}
+
+// The fixnum = to an integral flonum, so that a numeric switch can find it
+// by the same key.
+Value chunk_switch_number(Value key)
+{
+    // The range is checked first, which also rules out NaN and infinities,
+    // since converting a flonum outside it is undefined.
+    if (VALUE_IS_FLONUM(key) && VALUE_AS_FLONUM(key) >= -9223372036854775808.0 &&
+        VALUE_AS_FLONUM(key) < 9223372036854775808.0 &&
+        VALUE_AS_FLONUM(key) == (double)(int64_t)VALUE_AS_FLONUM(key))
+        return VALUE_FIXNUM_VAL((int64_t)VALUE_AS_FLONUM(key));
+    return key;
+}
+
+static uint32_t chunk_read_u32(const uint8_t *bytes)
+{
+    return ((uint32_t)bytes[0] << 24) | (bytes[1] << 16) | (bytes[2] << 8) | bytes[3];
+}
+
+// The distance from the OP_SWITCH at offset to the code for key.
+uint32_t chunk_switch_distance(Chunk *chunk, int offset, Value key)
+{
+    const uint8_t *code = &chunk->code[offset];
+    const uint8_t *table = code + CHUNK_SWITCH_HEADER;
+    uint32_t size = (code[2] << 8) | code[3];
+
+    if (code[1] & CHUNK_SWITCH_NUMERIC)
+        key = chunk_switch_number(key);
+
+    if (CHUNK_SWITCH_IS_DENSE(code[1]))
+    {
+        int low = (code[4] << 16) | (code[5] << 8) | code[6];
+
+        // Keys of a dense table are within INT32_MAX / 2 of each other, so
+        // the index of a key in range can't overflow.
+        if (VALUE_IS_FIXNUM(key) && VALUE_AS_FIXNUM(key) > INT64_MIN / 2 && VALUE_AS_FIXNUM(key) < INT64_MAX / 2)
+        {
+            int64_t index = VALUE_AS_FIXNUM(key) - VALUE_AS_FIXNUM(chunk->constants.values[low]);
+
+            if (index >= 0 && index < size)
+                return chunk_read_u32(table + 4 * index);
+        }
+    }
+    else
+    {
+        uint32_t mask = size - 1;
+
+        for (uint32_t slot = chunk_switch_hash(key) & mask;; slot = (slot + 1) & mask)
+        {
+            const uint8_t *entry = table + 7 * slot;
+            int constant = (entry[0] << 16) | (entry[1] << 8) | entry[2];
+
+            if (constant == CHUNK_SWITCH_EMPTY)
+                break;
+
+            if (value_values_identical(chunk->constants.values[constant], key))
+                return chunk_read_u32(entry + 3);
+        }
+    }
 
-    return chunk->constants.count - 1;
+    return chunk_read_u32(code + 7);
 }
\ No newline at end of file
@@ -4,41 +4,142 @@
 #include <common/common.h>
 #include <value/value.h>
 
+// The _LONG variants take a 24-bit constant or jump operand, or a 16-bit
+// local or upvalue slot. The compiler picks them only when the short form
+// does not fit.
 typedef enum
 {
     OP_CONSTANT,
+    OP_CONSTANT_LONG,
     OP_NULL,
     OP_TRUE,
     OP_FALSE,
     OP_POP,
+    OP_POPN,
     OP_GET_LOCAL,
+    OP_GET_LOCAL_LONG,
     OP_GET_GLOBAL,
+    OP_GLOBAL_UNCHANGED,
     OP_SET_LOCAL,
+    OP_SET_LOCAL_LONG,
     OP_SET_GLOBAL,
     OP_GET_UPVALUE,
+    OP_GET_UPVALUE_LONG,
+    OP_GET_BOXED_UPVALUE,
+    OP_GET_BOXED_UPVALUE_LONG,
     OP_SET_UPVALUE,
+    OP_SET_UPVALUE_LONG,
+    OP_ADD,
+    OP_SUBTRACT,
+    OP_MULTIPLY,
+    OP_EQUAL,
+    OP_LESS,
+    OP_GREATER,
+    OP_LESS_EQUAL,
+    OP_GREATER_EQUAL,
+    OP_ADD_UNCHECKED,
+    OP_SUBTRACT_UNCHECKED,
+    OP_MULTIPLY_UNCHECKED,
+    OP_EQUAL_UNCHECKED,
+    OP_LESS_UNCHECKED,
+    OP_GREATER_UNCHECKED,
+    OP_LESS_EQUAL_UNCHECKED,
+    OP_GREATER_EQUAL_UNCHECKED,
+    OP_VECTOR_REF,
+    OP_VECTOR_SET,
     OP_JUMP,
+    OP_JUMP_LONG,
     OP_JUMP_IF_FALSE,
+    OP_JUMP_IF_FALSE_LONG,
+    OP_POP_JUMP_IF_FALSE,
+    OP_POP_JUMP_IF_FALSE_LONG,
+    OP_LOOP,
+    OP_LOOP_LONG,
+    OP_SWITCH,
     OP_CALL,
     OP_TAIL_CALL,
     OP_CLOSURE,
+    OP_CLOSURE_LONG,
+    OP_STACK_CLOSURE,
+    OP_STACK_CLOSURE_LONG,
     OP_CONTINUATION,
     OP_CLOSE_UPVALUE,
+    OP_CLOSE_LOCAL,
     OP_RETURN,
 } OpCode;
 
+// Flags of each variable captured by OP_CLOSURE. Variables that are never
+// assigned are copied into the closure, the others are shared through an
+// ObjUpvalue box.
+#define CHUNK_CAPTURE_LOCAL 0x01
+#define CHUNK_CAPTURE_BOXED 0x02
+
+// OP_ADD to OP_GREATER_EQUAL are three-address instructions that apply the
+// primitive of the same name to two operands. The first byte is the slot the
+// result goes to, which becomes the top of the stack, the other two name a
+// slot of the frame, or a constant when CHUNK_REGISTER_CONSTANT is set.
+// The _UNCHECKED variants are emitted by the optimizer where both operands
+// are known to be numbers, and skip checking that they are.
+#define CHUNK_REGISTER_CONSTANT 0x80
+#define CHUNK_REGISTER_MAX 0x7f
+#define CHUNK_IS_REGISTER(op) ((op) >= OP_ADD && (op) <= OP_GREATER_EQUAL_UNCHECKED)
+#define CHUNK_CHECKED_REGISTER(op) ((op) > OP_GREATER_EQUAL ? (op) - (OP_ADD_UNCHECKED - OP_ADD) : (op))
+
+// OP_VECTOR_REF pops a vector and an index and pushes the element there, and
+// OP_VECTOR_SET pops a vector, an index and an element and pushes void. The
+// operand of both is the VectorKind the vector must be, see vector.h.
+
+// OP_SWITCH pops a key and jumps through the table that follows it:
+//
+//   kind (u8), size (u16), lowest key (u24 constant), default (u32)
+//   dense:  size targets (u32), for the integers from the lowest key on
+//   hashed: size slots of a key (u24 constant) and its target (u32)
+//
+// Targets are distances from the opcode. The hashed table is open addressed
+// with chunk_switch_hash, a size that is a power of two and at least one
+// empty slot, whose key is CHUNK_SWITCH_EMPTY. The kind of a switch over =
+// tests also has CHUNK_SWITCH_NUMERIC, and its keys must be numbers, which go
+// through chunk_switch_number. Dense tables only have fixnum keys.
+#define CHUNK_SWITCH_DENSE 0
+#define CHUNK_SWITCH_HASHED 1
+#define CHUNK_SWITCH_NUMERIC 2
+#define CHUNK_SWITCH_IS_DENSE(kind) (((kind) & CHUNK_SWITCH_HASHED) == 0)
+#define CHUNK_SWITCH_HEADER 11
+#define CHUNK_SWITCH_EMPTY 0xffffff
+
+// A run of bytecode sharing one source line, starting at offset.
+typedef struct
+{
+    int offset;
+    int line;
+} LineRun;
+
 typedef struct
 {
     int count;
     int capacity;
     uint8_t *code;
-    int *lines;
+    int line_count;
+    int line_capacity;
+    LineRun *lines;
     ValueArray constants;
+    // Open addressed index of the constants, -1 marks an empty bucket. Only
+    // kept while the chunk is being compiled.
+    int *constant_index;
+    int constant_index_capacity;
 } Chunk;
 
 void chunk_init_chunk(Chunk *chunk);
 void chunk_free_chunk(Chunk *chunk);
 void chunk_write_chunk(Chunk *chunk, uint8_t byte, int line);
+void chunk_insert_bytes(Chunk *chunk, int offset, int count);
+void chunk_add_line(Chunk *chunk, int offset, int line);
+int chunk_get_line(Chunk *chunk, int offset);
 int chunk_add_constant(Chunk *chunk, Value value);
+void chunk_free_constant_index(Chunk *chunk);
+int chunk_instruction_size(Chunk *chunk, int offset);
+uint32_t chunk_switch_hash(Value key);
+Value chunk_switch_number(Value key);
+uint32_t chunk_switch_distance(Chunk *chunk, int offset, Value key);
 
 #endif
\ No newline at end of file
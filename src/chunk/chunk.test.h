@@ -2,7 +2,203 @@
 #define _CHUNK_TEST_H
 
 #include <chunk/chunk.h>
+#include <compiler/compiler.h>
+#include <object/object.h>
+#include <vm/vm.h>
 #include <CUnit/Basic.h>
 
+#include <math.h>
+
+// The offset of the first OP_SWITCH of the chunk, or -1.
+static int chunk_test_find_switch(Chunk *chunk)
+{
+    for (int offset = 0; offset < chunk->count; offset += chunk_instruction_size(chunk, offset))
+    {
+        if (chunk->code[offset] == OP_SWITCH)
+            return offset;
+    }
+
+    return -1;
+}
+
+// Compiles source, kept on the VM stack until vm_free_vm, and returns the
+// offset of its OP_SWITCH, or -1.
+static int chunk_test_compile_switch(const char *source, Chunk **chunk)
+{
+    ObjFunction *script = compiler_compile(source);
+
+    if (script == NULL)
+        return -1;
+
+    vm_push(VALUE_OBJ_VAL(script));
+
+    *chunk = &script->chunk;
+    return chunk_test_find_switch(*chunk);
+}
+
+void chunk_switch_number_test()
+{
+    Value two = chunk_switch_number(VALUE_FLONUM_VAL(2.0));
+    CU_ASSERT_TRUE(VALUE_IS_FIXNUM(two));
+    CU_ASSERT_EQUAL(VALUE_AS_FIXNUM(two), 2);
+
+    Value negative = chunk_switch_number(VALUE_FLONUM_VAL(-4096.0));
+    CU_ASSERT_TRUE(VALUE_IS_FIXNUM(negative));
+    CU_ASSERT_EQUAL(VALUE_AS_FIXNUM(negative), -4096);
+
+    // Flonums that aren't integers, or don't fit a fixnum, stay flonums
+    CU_ASSERT_TRUE(VALUE_IS_FLONUM(chunk_switch_number(VALUE_FLONUM_VAL(2.5))));
+    CU_ASSERT_TRUE(VALUE_IS_FLONUM(chunk_switch_number(VALUE_FLONUM_VAL(NAN))));
+    CU_ASSERT_TRUE(VALUE_IS_FLONUM(chunk_switch_number(VALUE_FLONUM_VAL(INFINITY))));
+    CU_ASSERT_TRUE(VALUE_IS_FLONUM(chunk_switch_number(VALUE_FLONUM_VAL(-INFINITY))));
+    CU_ASSERT_TRUE(VALUE_IS_FLONUM(chunk_switch_number(VALUE_FLONUM_VAL(9223372036854775808.0))));
+
+    Value min = chunk_switch_number(VALUE_FLONUM_VAL(-9223372036854775808.0));
+    CU_ASSERT_TRUE(VALUE_IS_FIXNUM(min));
+    CU_ASSERT_EQUAL(VALUE_AS_FIXNUM(min), INT64_MIN);
+
+    // Anything else is its own key
+    Value fixnum = chunk_switch_number(VALUE_FIXNUM_VAL(7));
+    CU_ASSERT_TRUE(VALUE_IS_FIXNUM(fixnum));
+    CU_ASSERT_EQUAL(VALUE_AS_FIXNUM(fixnum), 7);
+}
+
+void chunk_dense_switch_test()
+{
+    vm_init_vm();
+
+    Chunk *chunk;
+    int offset = chunk_test_compile_switch("(define k 0)\n"
+                                           "(case k ((1) 10) ((2 3) 20) ((5) 30) (else 40))",
+                                           &chunk);
+    CU_ASSERT_FATAL(offset != -1);
+    CU_ASSERT_TRUE(CHUNK_SWITCH_IS_DENSE(chunk->code[offset + 1]));
+    CU_ASSERT_FALSE(chunk->code[offset + 1] & CHUNK_SWITCH_NUMERIC);
+
+    uint32_t one = chunk_switch_distance(chunk, offset, VALUE_FIXNUM_VAL(1));
+    uint32_t two = chunk_switch_distance(chunk, offset, VALUE_FIXNUM_VAL(2));
+    uint32_t three = chunk_switch_distance(chunk, offset, VALUE_FIXNUM_VAL(3));
+    uint32_t five = chunk_switch_distance(chunk, offset, VALUE_FIXNUM_VAL(5));
+    uint32_t otherwise = chunk_switch_distance(chunk, offset, VALUE_BOOL_VAL(true));
+
+    CU_ASSERT_EQUAL(two, three);
+    CU_ASSERT_NOT_EQUAL(one, two);
+    CU_ASSERT_NOT_EQUAL(two, five);
+    CU_ASSERT_NOT_EQUAL(five, otherwise);
+    CU_ASSERT_NOT_EQUAL(one, otherwise);
+
+    // The gap, the keys around the table and keys of other types
+    CU_ASSERT_EQUAL(chunk_switch_distance(chunk, offset, VALUE_FIXNUM_VAL(4)), otherwise);
+    CU_ASSERT_EQUAL(chunk_switch_distance(chunk, offset, VALUE_FIXNUM_VAL(0)), otherwise);
+    CU_ASSERT_EQUAL(chunk_switch_distance(chunk, offset, VALUE_FIXNUM_VAL(6)), otherwise);
+    CU_ASSERT_EQUAL(chunk_switch_distance(chunk, offset, VALUE_FIXNUM_VAL(INT64_MIN)), otherwise);
+    CU_ASSERT_EQUAL(chunk_switch_distance(chunk, offset, VALUE_FIXNUM_VAL(INT64_MAX)), otherwise);
+
+    // case compares with eqv?, so 2.0 isn't 2
+    CU_ASSERT_EQUAL(chunk_switch_distance(chunk, offset, VALUE_FLONUM_VAL(2.0)), otherwise);
+
+    vm_free_vm();
+}
+
+void chunk_hashed_switch_test()
+{
+    vm_init_vm();
+
+    Chunk *chunk;
+    int offset = chunk_test_compile_switch("(define k 0)\n"
+                                           "(case k ((1 1000000) 10) ((1000) 20) ((\"b\" 2.5) 30) (else 40))",
+                                           &chunk);
+    CU_ASSERT_FATAL(offset != -1);
+    CU_ASSERT_FALSE(CHUNK_SWITCH_IS_DENSE(chunk->code[offset + 1]));
+
+    uint32_t one = chunk_switch_distance(chunk, offset, VALUE_FIXNUM_VAL(1));
+    uint32_t thousand = chunk_switch_distance(chunk, offset, VALUE_FIXNUM_VAL(1000));
+    uint32_t b = chunk_switch_distance(chunk, offset, VALUE_OBJ_VAL(object_copy_string("b", 1)));
+    uint32_t otherwise = chunk_switch_distance(chunk, offset, VALUE_FIXNUM_VAL(2));
+
+    CU_ASSERT_EQUAL(chunk_switch_distance(chunk, offset, VALUE_FIXNUM_VAL(1000000)), one);
+    CU_ASSERT_EQUAL(chunk_switch_distance(chunk, offset, VALUE_FLONUM_VAL(2.5)), b);
+    CU_ASSERT_NOT_EQUAL(one, thousand);
+    CU_ASSERT_NOT_EQUAL(thousand, b);
+    CU_ASSERT_NOT_EQUAL(b, otherwise);
+    CU_ASSERT_NOT_EQUAL(one, otherwise);
+
+    CU_ASSERT_EQUAL(chunk_switch_distance(chunk, offset, VALUE_OBJ_VAL(object_copy_string("a", 1))), otherwise);
+    CU_ASSERT_EQUAL(chunk_switch_distance(chunk, offset, VALUE_FLONUM_VAL(1000.0)), otherwise);
+    CU_ASSERT_EQUAL(chunk_switch_distance(chunk, offset, VALUE_FLONUM_VAL(NAN)), otherwise);
+
+    vm_free_vm();
+}
+
+void chunk_numeric_switch_test()
+{
+    vm_init_vm();
+
+    Chunk *chunk;
+    int offset = chunk_test_compile_switch("(define k 0)\n"
+                                           "(cond ((= k 1) 10) ((= k 2) 20) ((= 3 k) 30) (else 40))",
+                                           &chunk);
+    CU_ASSERT_FATAL(offset != -1);
+    CU_ASSERT_TRUE(CHUNK_SWITCH_IS_DENSE(chunk->code[offset + 1]));
+    CU_ASSERT_TRUE(chunk->code[offset + 1] & CHUNK_SWITCH_NUMERIC);
+
+    uint32_t two = chunk_switch_distance(chunk, offset, VALUE_FIXNUM_VAL(2));
+    uint32_t otherwise = chunk_switch_distance(chunk, offset, VALUE_FIXNUM_VAL(4));
+    CU_ASSERT_NOT_EQUAL(two, otherwise);
+
+    // = takes integral flonums for fixnums, and nothing else
+    CU_ASSERT_EQUAL(chunk_switch_distance(chunk, offset, VALUE_FLONUM_VAL(2.0)), two);
+    CU_ASSERT_EQUAL(chunk_switch_distance(chunk, offset, VALUE_FLONUM_VAL(2.5)), otherwise);
+    CU_ASSERT_EQUAL(chunk_switch_distance(chunk, offset, VALUE_FLONUM_VAL(NAN)), otherwise);
+    CU_ASSERT_EQUAL(chunk_switch_distance(chunk, offset, VALUE_FLONUM_VAL(INFINITY)), otherwise);
+    CU_ASSERT_EQUAL(chunk_switch_distance(chunk, offset, VALUE_FLONUM_VAL(1e300)), otherwise);
+
+    // Keys too far apart for a dense table
+    offset = chunk_test_compile_switch("(define k 0)\n"
+                                       "(cond ((= k 1) 10) ((= k 1000000) 20) ((= k 2.5) 30) (else 40))",
+                                       &chunk);
+    CU_ASSERT_FATAL(offset != -1);
+    CU_ASSERT_FALSE(CHUNK_SWITCH_IS_DENSE(chunk->code[offset + 1]));
+    CU_ASSERT_TRUE(chunk->code[offset + 1] & CHUNK_SWITCH_NUMERIC);
+
+    uint32_t million = chunk_switch_distance(chunk, offset, VALUE_FIXNUM_VAL(1000000));
+    uint32_t fraction = chunk_switch_distance(chunk, offset, VALUE_FLONUM_VAL(2.5));
+    otherwise = chunk_switch_distance(chunk, offset, VALUE_FIXNUM_VAL(2));
+    CU_ASSERT_NOT_EQUAL(million, fraction);
+    CU_ASSERT_NOT_EQUAL(million, otherwise);
+    CU_ASSERT_NOT_EQUAL(fraction, otherwise);
+
+    CU_ASSERT_EQUAL(chunk_switch_distance(chunk, offset, VALUE_FLONUM_VAL(1000000.0)), million);
+    CU_ASSERT_EQUAL(chunk_switch_distance(chunk, offset, VALUE_FLONUM_VAL(NAN)), otherwise);
+    CU_ASSERT_EQUAL(chunk_switch_distance(chunk, offset, VALUE_FLONUM_VAL(-INFINITY)), otherwise);
+
+    vm_free_vm();
+}
+
+void chunk_switch_dispatch_test()
+{
+    vm_init_vm();
+
+    // Each key through the VM, cases and conds of both kinds of table
+    InterpretResult result = vm_interpret(
+        "(define result\n"
+        "  (let ((f (lambda (k)\n"
+        "             (+ (case k ((1) 1) ((2 3) 2) ((5) 3) (else 0))\n"
+        "                (case k ((1 1000000) 10) ((1000) 20) ((2.5) 30) (else 0))\n"
+        "                (cond ((= k 1) 100) ((= k 2) 200) ((= 3 k) 300) (else 0))\n"
+        "                (cond ((= k 1) 1000) ((= k 1000000) 2000) ((= k 2.5) 3000) (else 0))))))\n"
+        "    (+ (f 0) (f 1) (f 2) (f 3) (f 4) (f 5) (f 1000) (f 1000000) (f 2.0) (f 2.5))))");
+    CU_ASSERT_EQUAL(result, VM_OK);
+
+    int slot = table_find_entry(&vm.globals, "result", 6);
+    CU_ASSERT_FATAL(slot != -1);
+
+    Value sum = table_get(&vm.globals, slot);
+    CU_ASSERT_TRUE(VALUE_IS_FIXNUM(sum));
+    CU_ASSERT_EQUAL(VALUE_AS_FIXNUM(sum), 1 + 2 + 2 + 3 + 10 + 20 + 10 + 30 + 100 + 200 + 300 + 200 + 1000 + 2000 +
+                                              3000);
+
+    vm_free_vm();
+}
 
 #endif
\ No newline at end of file
@@ -2,30 +2,68 @@
 #include <common/common.h>
 #include <parser/parser.h>
 #include <object/object.h>
+#include <bignum/bignum.h>
+#include <vector/vector.h>
 #include <memory/memory.h>
+#include <optimizer/optimizer.h>
 
 #ifdef DEBUG_PRINT_CODE
 #include <debug/debug.h>
 #endif
 
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
 
+// Largest operand of the _LONG instructions that take 24 bits.
+#define COMPILER_LONG_MAX 0xffffff
+
+// Largest procedure, in bytes of code, that is inlined at its call sites.
+#define COMPILER_INLINE_MAX 48
+
+// Shortest top-level lambda, in characters of source, whose body is compiled
+// on its first call rather than when the script is compiled.
+#define COMPILER_LAZY_MIN 128
+
 typedef struct
 {
     Token name;
     int depth;
-    bool is_captured;
+    bool is_captured; // Captured in a box that must be closed
+    bool is_boxed;    // Assigned with set!, so closures share it
 } Local;
 
 typedef struct
 {
-    uint8_t index;
+    uint16_t index;
     bool is_local;
+    bool is_boxed;
 } Upvalue;
 
+// Jumps are emitted in their short form and only get their final width and
+// distance once the function is complete, see compiler_resolve_jumps. The
+// entries of an OP_SWITCH table are jumps too, whose 32-bit distance counts
+// from the opcode.
+typedef struct
+{
+    int offset; // Offset of the operand
+    int target; // -1 until patched
+    int origin; // Offset of the OP_SWITCH of an entry, -1 for other jumps
+} Jump;
+
+// A named let or do whose iterations run in the current function. Calls of
+// the loop jump back to its head, see compiler_compile_loop_call.
+typedef struct Loop
+{
+    struct Loop *enclosing;
+    Token name; // Empty for do, which is never called by name
+    int head;   // Offset of the code that starts an iteration
+    int base;   // Slot of the first loop variable
+    int count;
+} Loop;
+
 typedef enum
 {
     TYPE_FUNCTION,
@@ -38,15 +76,57 @@ typedef struct Environment
     ObjFunction *function;
     FunctionType type;
 
-    Local locals[UINT8_COUNT];
+    Local *locals;
     int local_count;
-    Upvalue upvalues[UINT8_COUNT];
+    int local_capacity;
+    Upvalue *upvalues;
+    int upvalue_capacity;
+    Jump *jumps;
+    int jump_count;
+    int jump_capacity;
     int scope_depth;
+    Loop *loop; // Innermost loop being compiled
 } Environment;
 
+// A global procedure whose code is copied to its call sites. The copy is
+// guarded by OP_GLOBAL_UNCHANGED, so that calls go through the global again
+// once it has been assigned.
+typedef struct
+{
+    int global;
+    ObjFunction *function;
+} Inline;
+
+// A global defined or assigned somewhere in the program being compiled, as
+// found by compiler_scan_program before any of it is compiled. A global the
+// program defines once and never assigns is constant.
+typedef struct
+{
+    Token name;
+    uint32_t hash;
+    int definitions;
+    bool is_assigned;
+    int global;    // Slot of a constant global once it is defined, else -1
+    bool is_known; // Whether the definition compiled to a single constant
+    Value value;
+} Definition;
+
 typedef struct
 {
     bool failed;
+    bool partial; // More code may be compiled later, see compiler_set_whole_program
+    bool checking; // Code is compiled only for its errors, see compiler_check_lazy
+    int line;     // Source line of the expression being compiled
+    Definition *definitions;
+    int definition_count;
+    int definition_capacity;
+    // Kept between compilations, so that procedures defined at the REPL are
+    // inlined in the lines that follow.
+    Inline *inlines;
+    int inline_count;
+    int inline_capacity;
+    bool registers;     // Emit three-address code, see compiler_set_register_code
+    uint32_t redefined; // Primitives the whole program defines or assigns
 } Compiler;
 
 Compiler compiler;
@@ -55,7 +135,7 @@ Chunk *compiling_chunk;
 
 static void compiler_compile_expression(const SExpr *sexpr, bool tail);
 static void compiler_define_variable(const int global);
-static void compiler_compile_define(const SExpr *sexpr);
+static void compiler_compile_define(const SExpr *sexpr, const SExpr *scope);
 
 static Chunk *compiler_current_chunk()
 {
@@ -87,7 +167,7 @@ static void compiler_failed_at(Token *token, const char *message)
 
 static void compiler_failed(const char *message)
 {
-    fprintf(stderr, "[%d:%d] Compiler failed: %s\n", message);
+    fprintf(stderr, "[%d] Compiler failed: %s\n", compiler.line, message);
     compiler.failed = true;
 }
 
@@ -95,7 +175,7 @@ static void compiler_failed(const char *message)
 
 static void compiler_emit_byte(uint8_t byte)
 {
-    chunk_write_chunk(compiler_current_chunk(), byte, 0);
+    chunk_write_chunk(compiler_current_chunk(), byte, compiler.line);
 }
 
 static void compiler_emit_bytes(uint8_t byte1, uint8_t byte2)
@@ -110,12 +190,61 @@ static void compiler_emit_short(uint16_t bytes)
     compiler_emit_byte(bytes & 0xff);
 }
 
+static void compiler_emit_long(uint32_t bytes)
+{
+    compiler_emit_byte((bytes >> 16) & 0xff);
+    compiler_emit_byte((bytes >> 8) & 0xff);
+    compiler_emit_byte(bytes & 0xff);
+}
+
+// Emits the short instruction with a byte operand when it fits, otherwise the
+// long one with a short operand.
+static void compiler_emit_slot(uint8_t instruction, uint8_t long_instruction, int slot)
+{
+    if (slot <= UINT8_MAX)
+    {
+        compiler_emit_bytes(instruction, (uint8_t)slot);
+    }
+    else
+    {
+        compiler_emit_byte(long_instruction);
+        compiler_emit_short((uint16_t)slot);
+    }
+}
+
+// Records a jump whose operand is at offset. Returns a handle to pass to
+// compiler_patch_jump.
+static int compiler_add_jump(int offset, int origin)
+{
+    if (current->jump_capacity < current->jump_count + 1)
+    {
+        int old_capacity = current->jump_capacity;
+        current->jump_capacity = MEMORY_GROW_CAPACITY(old_capacity);
+        current->jumps = MEMORY_GROW_ARRAY(Jump, current->jumps, old_capacity, current->jump_capacity);
+    }
+
+    Jump *jump = &current->jumps[current->jump_count];
+    jump->offset = offset;
+    jump->target = -1;
+    jump->origin = origin;
+
+    return current->jump_count++;
+}
+
 static int compiler_emit_jump(uint8_t instruction)
 {
     compiler_emit_byte(instruction);
     compiler_emit_byte(0xff);
     compiler_emit_byte(0xff);
-    return compiler_current_chunk()->count - 2;
+
+    return compiler_add_jump(compiler_current_chunk()->count - 2, -1);
+}
+
+// Emits a jump back to head, an offset in the current chunk.
+static void compiler_emit_loop(int head)
+{
+    int jump = compiler_emit_jump(OP_LOOP);
+    current->jumps[jump].target = head;
 }
 
 static void compiler_emit_return()
@@ -123,64 +252,191 @@ static void compiler_emit_return()
     compiler_emit_byte(OP_RETURN);
 }
 
-static uint8_t compiler_make_constant(Value value)
+static int compiler_make_constant(Value value)
 {
     int constant = chunk_add_constant(compiler_current_chunk(), value);
-    if (constant > UINT8_MAX)
+    if (constant > COMPILER_LONG_MAX)
     {
-        // compiler_failed("Too many constants in one chunk.");
+        compiler_failed("Too many constants in one chunk.");
         return 0;
     }
 
-    return (uint8_t)constant;
+    return constant;
+}
+
+// Emits the short instruction with a byte operand when the constant fits,
+// otherwise the long one with a 24-bit operand.
+static void compiler_emit_constant_operand(uint8_t instruction, uint8_t long_instruction, int constant)
+{
+    if (constant <= UINT8_MAX)
+    {
+        compiler_emit_bytes(instruction, (uint8_t)constant);
+    }
+    else
+    {
+        compiler_emit_byte(long_instruction);
+        compiler_emit_long((uint32_t)constant);
+    }
 }
 
 static void compiler_emit_constant(Value value)
 {
-    compiler_emit_bytes(OP_CONSTANT, compiler_make_constant(value));
+    compiler_emit_constant_operand(OP_CONSTANT, OP_CONSTANT_LONG, compiler_make_constant(value));
 }
 
-static void compiler_patch_jump(int offset)
+static void compiler_patch_jump(int jump)
 {
-    // -2 to adjust for the bytecode for the jump offset itself.
-    int jump = compiler_current_chunk()->count - offset - 2;
+    current->jumps[jump].target = compiler_current_chunk()->count;
+}
 
-    if (jump > UINT16_MAX)
+// Returns the long form of a short jump instruction, or zero.
+static uint8_t compiler_long_jump(uint8_t instruction)
+{
+    switch (instruction)
     {
-        fprintf(stderr, "Too much code to jump over.");
-        exit(1);
+    case OP_JUMP:
+        return OP_JUMP_LONG;
+    case OP_JUMP_IF_FALSE:
+        return OP_JUMP_IF_FALSE_LONG;
+    case OP_POP_JUMP_IF_FALSE:
+        return OP_POP_JUMP_IF_FALSE_LONG;
+    case OP_LOOP:
+        return OP_LOOP_LONG;
+    default:
+        return 0;
     }
+}
 
-    // write the jump offset to code using some bit manipulation
-    compiler_current_chunk()->code[offset] = (jump >> 8) & 0xff;
-    compiler_current_chunk()->code[offset + 1] = jump & 0xff;
+// The distance of a jump of the given size, counted backward for OP_LOOP.
+static int compiler_jump_distance(Jump *jump, uint8_t instruction, int size)
+{
+    int end = jump->offset - 1 + size;
+
+    if (instruction == OP_LOOP || instruction == OP_LOOP_LONG)
+        return end - jump->target;
+    return jump->target - end;
 }
 
-static uint8_t compiler_identifier_constant(Token *name)
+// Writes the distance of every jump in the current function. Jumps that don't
+// fit 16 bits are widened, which moves the code after them and may push other
+// jumps over the limit, so this repeats until nothing changes.
+static void compiler_resolve_jumps()
 {
-    return compiler_make_constant(VALUE_OBJ_VAL(object_copy_string(name->start,
-                                                                   name->length)));
+    Chunk *chunk = compiler_current_chunk();
+    bool widened;
+
+    do
+    {
+        widened = false;
+
+        for (int i = 0; i < current->jump_count; i++)
+        {
+            Jump *jump = &current->jumps[i];
+            uint8_t *instruction = &chunk->code[jump->offset - 1];
+
+            if (jump->origin != -1 || compiler_long_jump(*instruction) == 0 ||
+                compiler_jump_distance(jump, *instruction, 3) <= UINT16_MAX)
+                continue;
+
+            *instruction = compiler_long_jump(*instruction);
+
+            int at = jump->offset + 2;
+            chunk_insert_bytes(chunk, at, 1);
+
+            for (int j = 0; j < current->jump_count; j++)
+            {
+                if (current->jumps[j].offset >= at)
+                    current->jumps[j].offset++;
+                if (current->jumps[j].target >= at)
+                    current->jumps[j].target++;
+                if (current->jumps[j].origin >= at)
+                    current->jumps[j].origin++;
+            }
+
+            widened = true;
+        }
+    } while (widened);
+
+    for (int i = 0; i < current->jump_count; i++)
+    {
+        Jump *jump = &current->jumps[i];
+        uint8_t *operand = &chunk->code[jump->offset];
+
+        if (jump->origin != -1)
+        {
+            int distance = jump->target - jump->origin;
+            operand[0] = (distance >> 24) & 0xff;
+            operand[1] = (distance >> 16) & 0xff;
+            operand[2] = (distance >> 8) & 0xff;
+            operand[3] = distance & 0xff;
+        }
+        else if (compiler_long_jump(operand[-1]) != 0)
+        {
+            int distance = compiler_jump_distance(jump, operand[-1], 3);
+            operand[0] = (distance >> 8) & 0xff;
+            operand[1] = distance & 0xff;
+        }
+        else
+        {
+            int distance = compiler_jump_distance(jump, operand[-1], 4);
+
+            if (distance > COMPILER_LONG_MAX)
+                compiler_failed("Too much code to jump over.");
+
+            operand[0] = (distance >> 16) & 0xff;
+            operand[1] = (distance >> 8) & 0xff;
+            operand[2] = distance & 0xff;
+        }
+    }
 }
 
-static bool compiler_identifiers_equal(Token *a, Token *b)
+static bool compiler_identifiers_equal(const Token *a, const Token *b)
 {
     if (a->length != b->length)
         return false;
     return memcmp(a->start, b->start, a->length) == 0;
 }
 
+// Temporaries are values the compiled code keeps on the stack, such as the
+// operator and arguments of a call being evaluated. They occupy a slot like
+// any local but can't be named.
+static Token compiler_temporary_name()
+{
+    Token name;
+    name.type = TOKEN_SYMBOL;
+    name.start = "";
+    name.length = 0;
+    name.line = compiler.line;
+    name.row = 0;
+    return name;
+}
+
 static void compiler_add_local(Token name)
 {
-    if (current->local_count == UINT8_COUNT)
+    if (current->local_count == UINT16_COUNT)
     {
         compiler_failed_at(&name, "Too many local variables in function.");
         return;
     }
 
+    if (current->local_capacity < current->local_count + 1)
+    {
+        int old_capacity = current->local_capacity;
+        current->local_capacity = MEMORY_GROW_CAPACITY(old_capacity);
+        current->locals = MEMORY_GROW_ARRAY(Local, current->locals, old_capacity, current->local_capacity);
+    }
+
     Local *local = &current->locals[current->local_count++];
     local->name = name;
     local->depth = -1;
     local->is_captured = false;
+    local->is_boxed = false;
+}
+
+static void compiler_add_temporary()
+{
+    compiler_add_local(compiler_temporary_name());
+    current->locals[current->local_count - 1].depth = current->scope_depth;
 }
 
 static int compiler_resolve_local(Environment *env, Token *name)
@@ -201,7 +457,7 @@ static int compiler_resolve_local(Environment *env, Token *name)
     return -1;
 }
 
-static int compiler_add_upvalue(Environment *env, uint8_t index, bool is_local)
+static int compiler_add_upvalue(Environment *env, uint16_t index, bool is_local, bool is_boxed)
 {
     int upvalue_count = env->function->upvalue_count;
 
@@ -214,13 +470,21 @@ static int compiler_add_upvalue(Environment *env, uint8_t index, bool is_local)
         }
     }
 
-    if (upvalue_count == UINT8_COUNT)
+    if (upvalue_count == UINT16_COUNT)
     {
         compiler_failed("Too many closure variables in function.");
         return 0;
     }
 
+    if (env->upvalue_capacity < upvalue_count + 1)
+    {
+        int old_capacity = env->upvalue_capacity;
+        env->upvalue_capacity = MEMORY_GROW_CAPACITY(old_capacity);
+        env->upvalues = MEMORY_GROW_ARRAY(Upvalue, env->upvalues, old_capacity, env->upvalue_capacity);
+    }
+
     env->upvalues[upvalue_count].is_local = is_local;
+    env->upvalues[upvalue_count].is_boxed = is_boxed;
     env->upvalues[upvalue_count].index = index;
     return env->function->upvalue_count++;
 }
@@ -234,21 +498,227 @@ static int compiler_resolve_upvalue(Environment *env, Token *name)
 
     if (local != -1)
     {
-        env->enclosing->locals[local].is_captured = true;
-        return compiler_add_upvalue(env, (uint8_t)local, true);
+        // Only boxed variables outlive their slot, the others are copied.
+        Local *captured = &env->enclosing->locals[local];
+        captured->is_captured = captured->is_captured || captured->is_boxed;
+        return compiler_add_upvalue(env, (uint16_t)local, true, captured->is_boxed);
     }
 
     int upvalue = compiler_resolve_upvalue(env->enclosing, name);
 
     if (upvalue != -1)
     {
-        return compiler_add_upvalue(env, (uint8_t)upvalue, false);
+        bool is_boxed = env->enclosing->upvalues[upvalue].is_boxed;
+        return compiler_add_upvalue(env, (uint16_t)upvalue, false, is_boxed);
     }
 
     return -1;
 }
 
-static int compiler_declare_variable(Token name)
+// Whether any expression in sexpr assigns name. Shadowing bindings are not
+// taken into account, which at worst boxes a variable that didn't need it.
+static bool compiler_is_assigned(const SExpr *sexpr, Token *name)
+{
+    for (; PARSER_IS_CONS(sexpr); sexpr = PARSER_CDR(sexpr))
+    {
+        const SExpr *expr = PARSER_CAR(sexpr);
+
+        if (!PARSER_IS_CONS(expr))
+            continue;
+
+        if (PARSER_IS_ATOM(PARSER_CAR(expr)) &&
+            PARSER_AS_ATOM(PARSER_CAR(expr)).type == TOKEN_SET &&
+            PARSER_IS_CONS(PARSER_CDR(expr)) &&
+            PARSER_IS_ATOM(PARSER_CDAR(expr)) &&
+            compiler_identifiers_equal(name, &PARSER_AS_ATOM(PARSER_CDAR(expr))))
+            return true;
+
+        if (compiler_is_assigned(expr, name))
+            return true;
+    }
+
+    return false;
+}
+
+static bool compiler_mentions(const SExpr *sexpr, Token *name)
+{
+    if (PARSER_IS_ATOM(sexpr))
+        return PARSER_AS_ATOM(sexpr).type == TOKEN_SYMBOL &&
+               compiler_identifiers_equal(name, &PARSER_AS_ATOM(sexpr));
+
+    for (; PARSER_IS_CONS(sexpr); sexpr = PARSER_CDR(sexpr))
+    {
+        if (compiler_mentions(PARSER_CAR(sexpr), name))
+            return true;
+    }
+
+    return false;
+}
+
+// Whether the value of name can't escape the expressions in sexpr: it must
+// only be called, and not be referenced from a nested lambda, which would
+// capture it. Like compiler_is_assigned this ignores shadowing, so it can
+// only err on the side of escaping.
+static bool compiler_is_only_called(const SExpr *sexpr, Token *name)
+{
+    for (; PARSER_IS_CONS(sexpr); sexpr = PARSER_CDR(sexpr))
+    {
+        const SExpr *expr = PARSER_CAR(sexpr);
+
+        if (PARSER_IS_ATOM(expr))
+        {
+            if (compiler_mentions(expr, name))
+                return false;
+            continue;
+        }
+
+        if (!PARSER_IS_CONS(expr))
+            continue;
+
+        const SExpr *operands = PARSER_CDR(expr);
+
+        if (PARSER_IS_ATOM(PARSER_CAR(expr)))
+        {
+            switch (PARSER_AS_ATOM(PARSER_CAR(expr)).type)
+            {
+            case TOKEN_LAMBDA:
+                if (compiler_mentions(expr, name))
+                    return false;
+                continue;
+            case TOKEN_DEFINE:
+                // The defined name is not a reference.
+                if (PARSER_IS_CONS(operands))
+                    operands = PARSER_CDR(operands);
+                break;
+            default:
+                // Calling the value, or any other operator, is fine.
+                break;
+            }
+        }
+        else if (!compiler_is_only_called(expr, name))
+        {
+            return false;
+        }
+
+        if (!compiler_is_only_called(operands, name))
+            return false;
+    }
+
+    return true;
+}
+
+static bool compiler_is_loop_body(const SExpr *body, Token *name, int arg_count, bool tail);
+
+// Whether every mention of name in sexpr is a call with arg_count arguments
+// in tail position, tail telling whether sexpr is in one. Such calls of a
+// named let can jump back to its head. Lambdas, nested loops and forms that
+// bind name again are not looked into, so they may not mention it at all.
+static bool compiler_is_loop_expression(const SExpr *sexpr, Token *name, int arg_count, bool tail)
+{
+    if (!PARSER_IS_CONS(sexpr))
+        return !compiler_mentions(sexpr, name);
+
+    const SExpr *head = PARSER_CAR(sexpr);
+    const SExpr *operands = PARSER_CDR(sexpr);
+
+    if (PARSER_IS_ATOM(head))
+    {
+        switch (PARSER_AS_ATOM(head).type)
+        {
+        case TOKEN_QUOTE:
+            return true;
+        case TOKEN_IF:
+            return compiler_is_loop_expression(PARSER_CDAR(sexpr), name, arg_count, false) &&
+                   compiler_is_loop_expression(PARSER_CDDAR(sexpr), name, arg_count, tail) &&
+                   compiler_is_loop_expression(PARSER_CDDDAR(sexpr), name, arg_count, tail);
+        case TOKEN_BEGIN:
+        case TOKEN_AND:
+        case TOKEN_OR:
+        case TOKEN_WHEN:
+        case TOKEN_UNLESS:
+            return compiler_is_loop_body(operands, name, arg_count, tail);
+        case TOKEN_CASE:
+            if (!compiler_is_loop_expression(PARSER_CAR(operands), name, arg_count, false))
+                return false;
+            for (const SExpr *clause = PARSER_CDR(operands); !PARSER_IS_NULL(clause); clause = PARSER_CDR(clause))
+            {
+                if (!compiler_is_loop_body(PARSER_CADR(clause), name, arg_count, tail))
+                    return false;
+            }
+            return true;
+        case TOKEN_COND:
+            for (const SExpr *clause = operands; !PARSER_IS_NULL(clause); clause = PARSER_CDR(clause))
+            {
+                if (!compiler_is_loop_expression(PARSER_CAAR(clause), name, arg_count, false) ||
+                    !compiler_is_loop_body(PARSER_CADR(clause), name, arg_count, tail))
+                    return false;
+            }
+            return true;
+        case TOKEN_LET:
+            if (!PARSER_IS_ATOM(PARSER_CAR(operands)))
+            {
+                bool shadowed = false;
+
+                for (const SExpr *bind = PARSER_CAR(operands); !PARSER_IS_NULL(bind); bind = PARSER_CDR(bind))
+                {
+                    if (!compiler_is_loop_expression(PARSER_CADAR(bind), name, arg_count, false))
+                        return false;
+                    shadowed = shadowed || compiler_identifiers_equal(name, &PARSER_AS_ATOM(PARSER_CAAR(bind)));
+                }
+
+                if (shadowed)
+                    return !compiler_mentions(PARSER_CDR(operands), name);
+                return compiler_is_loop_body(PARSER_CDR(operands), name, arg_count, tail);
+            }
+            return !compiler_mentions(sexpr, name);
+        case TOKEN_SYMBOL:
+            if (compiler_identifiers_equal(name, &PARSER_AS_ATOM(head)))
+            {
+                int count = 0;
+                for (const SExpr *expr = operands; !PARSER_IS_NULL(expr); expr = PARSER_CDR(expr))
+                    count++;
+
+                return tail && count == arg_count &&
+                       compiler_is_loop_body(operands, name, arg_count, false);
+            }
+            break;
+        case TOKEN_NUMBER:
+        case TOKEN_STRING:
+        case TOKEN_TRUE:
+        case TOKEN_FALSE:
+            break;
+        default:
+            return !compiler_mentions(sexpr, name);
+        }
+    }
+
+    return compiler_is_loop_body(sexpr, name, arg_count, false);
+}
+
+// Applies compiler_is_loop_expression to a sequence, the last expression of
+// which is in tail position if the sequence is.
+static bool compiler_is_loop_body(const SExpr *body, Token *name, int arg_count, bool tail)
+{
+    for (; PARSER_IS_CONS(body); body = PARSER_CDR(body))
+    {
+        if (!compiler_is_loop_expression(PARSER_CAR(body), name, arg_count,
+                                         tail && PARSER_IS_NULL(PARSER_CDR(body))))
+            return false;
+    }
+
+    return true;
+}
+
+static bool compiler_is_lambda(const SExpr *sexpr)
+{
+    return PARSER_IS_CONS(sexpr) &&
+           PARSER_IS_ATOM(PARSER_CAR(sexpr)) &&
+           PARSER_AS_ATOM(PARSER_CAR(sexpr)).type == TOKEN_LAMBDA;
+}
+
+// Declares name in the current scope. The scope holds the expressions the
+// variable is visible in; locals assigned there are boxed when captured.
+static int compiler_declare_variable(Token name, const SExpr *scope)
 {
     for (int i = current->local_count - 1; i >= 0; i--)
     {
@@ -270,6 +740,7 @@ static int compiler_declare_variable(Token name)
     }
 
     compiler_add_local(name);
+    current->locals[current->local_count - 1].is_boxed = compiler_is_assigned(scope, &name);
 
     return -1;
 }
@@ -305,30 +776,60 @@ static void compiler_init_environment(Environment *env, FunctionType type)
     env->enclosing = current;
     env->function = NULL;
     env->type = type;
+    env->locals = NULL;
     env->local_count = 0;
+    env->local_capacity = 0;
+    env->upvalues = NULL;
+    env->upvalue_capacity = 0;
+    env->jumps = NULL;
+    env->jump_count = 0;
+    env->jump_capacity = 0;
     env->scope_depth = 0;
+    env->loop = NULL;
     env->function = (type == TYPE_SCRIPT)
                         ? object_new_script()
                         : object_new_function();
     current = env;
 
-    Local *local = &current->locals[current->local_count++];
-    local->depth = 0;
-    local->is_captured = false;
-    local->name.start = "";
-    local->name.length = 0;
+    // Slot zero holds the closure being called.
+    compiler_add_local(compiler_temporary_name());
+    current->locals[0].depth = 0;
+}
+
+static void compiler_free_environment(Environment *env)
+{
+    MEMORY_FREE_ARRAY(Upvalue, env->upvalues, env->upvalue_capacity);
 }
 
 static ObjFunction *compiler_end_environment()
 {
     compiler_emit_return();
+    compiler_resolve_jumps();
     ObjFunction *function = current->function;
 
+    // Nothing is added to the pool once the function is complete.
+    chunk_free_constant_index(compiler_current_chunk());
+
+    // The upvalues are still needed to emit the closure, and are freed by
+    // compiler_free_environment.
+    MEMORY_FREE_ARRAY(Local, current->locals, current->local_capacity);
+    MEMORY_FREE_ARRAY(Jump, current->jumps, current->jump_capacity);
+
+#ifdef DEBUG_PRINT_CODE
+    char name[48] = {0};
+    sprintf(name, "#<procedure %u>", (unsigned)current->function->id);
+
+    if (!compiler.failed && !compiler.checking)
+        debug_disassemble_chunk(compiler_current_chunk(), name);
+#endif
+
+    if (!compiler.failed && !compiler.checking)
+        optimizer_optimize_chunk(compiler_current_chunk(), function->arity);
+
 #ifdef DEBUG_PRINT_CODE
-    if (!compiler.failed)
+    if (!compiler.failed && !compiler.checking)
     {
-        char name[32] = {0};
-        sprintf(name, "#<procedure %u>", (unsigned)current->function->id);
+        strcat(name, " optimized");
         debug_disassemble_chunk(compiler_current_chunk(), name);
     }
 #endif
@@ -347,16 +848,35 @@ static bool compiler_is_definition(const SExpr *sexpr)
         case TOKEN_DEFINE:
             return true;
             break;
+        default:
+            break;
         }
     }
 
     return false;
 }
 
+// Literals without a decimal point are exact, and bignums when they are too
+// large for a fixnum.
+static Value compiler_number_value(Token token)
+{
+    if (memchr(token.start, '.', token.length) == NULL)
+    {
+        errno = 0;
+        long long integer = strtoll(token.start, NULL, 10);
+
+        if (errno == 0)
+            return VALUE_FIXNUM_VAL(integer);
+
+        return bignum_from_chars(token.start, token.length, 10);
+    }
+
+    return VALUE_FLONUM_VAL(strtod(token.start, NULL));
+}
+
 static void compiler_compile_number(const SExpr *sexpr)
 {
-    double value = strtod(sexpr->value.atom.start, NULL);
-    compiler_emit_constant(VALUE_NUMBER_VAL(value));
+    compiler_emit_constant(compiler_number_value(PARSER_AS_ATOM(sexpr)));
 }
 
 static void compiler_mark_initialized()
@@ -369,23 +889,156 @@ static void compiler_mark_initialized()
 
 static int compiler_resolve_global(Environment *current, Token *name)
 {
+    (void)current;
     return table_find_entry(&vm.globals, name->start, name->length);
 }
 
+/* Whole-program analysis */
+
+static Definition *compiler_find_definition(Token *name)
+{
+    uint32_t hash = table_hash_string(name->start, name->length);
+
+    for (int i = 0; i < compiler.definition_count; i++)
+    {
+        Definition *definition = &compiler.definitions[i];
+        if (definition->hash == hash && compiler_identifiers_equal(name, &definition->name))
+            return definition;
+    }
+
+    return NULL;
+}
+
+static Definition *compiler_add_definition(Token *name)
+{
+    Definition *definition = compiler_find_definition(name);
+
+    if (definition != NULL)
+        return definition;
+
+    if (compiler.definition_capacity < compiler.definition_count + 1)
+    {
+        int old_capacity = compiler.definition_capacity;
+        compiler.definition_capacity = MEMORY_GROW_CAPACITY(old_capacity);
+        compiler.definitions = MEMORY_GROW_ARRAY(Definition, compiler.definitions,
+                                                 old_capacity, compiler.definition_capacity);
+    }
+
+    definition = &compiler.definitions[compiler.definition_count++];
+    definition->name = *name;
+    definition->hash = table_hash_string(name->start, name->length);
+    definition->definitions = 0;
+    definition->is_assigned = false;
+    definition->global = -1;
+    definition->is_known = false;
+    definition->value = VALUE_NULL_VAL;
+    return definition;
+}
+
+// Records the globals that sexpr defines, if it is a top-level form, and the
+// names it assigns anywhere. Shadowing bindings are not taken into account,
+// which at worst keeps a global from being constant.
+static void compiler_scan_form(const SExpr *sexpr, bool top_level)
+{
+    if (!PARSER_IS_CONS(sexpr))
+        return;
+
+    const SExpr *head = PARSER_CAR(sexpr);
+
+    if (PARSER_IS_ATOM(head) && PARSER_IS_CONS(PARSER_CDR(sexpr)) && PARSER_IS_ATOM(PARSER_CDAR(sexpr)))
+    {
+        Token *name = &PARSER_AS_ATOM(PARSER_CDAR(sexpr));
+
+        if (PARSER_AS_ATOM(head).type == TOKEN_SET)
+            compiler_add_definition(name)->is_assigned = true;
+        else if (PARSER_AS_ATOM(head).type == TOKEN_DEFINE && top_level)
+            compiler_add_definition(name)->definitions++;
+    }
+
+    for (; PARSER_IS_CONS(sexpr); sexpr = PARSER_CDR(sexpr))
+        compiler_scan_form(PARSER_CAR(sexpr), false);
+}
+
+// Parses the whole program once ahead of compiling it. Returns false, with
+// the error reported, if it doesn't parse.
+static bool compiler_scan_program(const char *source)
+{
+    SExpr *sexpr;
+    ParseResult result;
+
+    parser_init_parser(source);
+
+    while ((result = parser_parse(&sexpr)) == PARSER_OK)
+        compiler_scan_form(sexpr, true);
+
+    return result == PARSER_EOF;
+}
+
+// The definition of global, if the program never changes it.
+static Definition *compiler_find_constant(int global)
+{
+    // Code that is thrown away needn't be specialised.
+    if (compiler.checking)
+        return NULL;
+
+    for (int i = 0; i < compiler.definition_count; i++)
+    {
+        if (compiler.definitions[i].global == global)
+            return &compiler.definitions[i];
+    }
+
+    return NULL;
+}
+
+// Called after the value of the top-level definition of name, starting at
+// offset start of the chunk, has been compiled into global. A global that
+// already existed before this program may be assigned by code compiled
+// before it, so it is never constant.
+static void compiler_define_constant(Token *name, int global, bool fresh, int start)
+{
+    Definition *definition = compiler_find_definition(name);
+    Chunk *chunk = compiler_current_chunk();
+
+    if (definition == NULL || !fresh || definition->definitions != 1 || definition->is_assigned)
+        return;
+
+    definition->global = global;
+
+    if (chunk->count - start == 2 && chunk->code[start] == OP_CONSTANT)
+        definition->value = chunk->constants.values[chunk->code[start + 1]];
+    else if (chunk->count - start == 4 && chunk->code[start] == OP_CONSTANT_LONG)
+        definition->value = chunk->constants.values[(chunk->code[start + 1] << 16) |
+                                                    (chunk->code[start + 2] << 8) |
+                                                    chunk->code[start + 3]];
+    else if (chunk->count - start == 1 && chunk->code[start] == OP_TRUE)
+        definition->value = VALUE_BOOL_VAL(true);
+    else if (chunk->count - start == 1 && chunk->code[start] == OP_FALSE)
+        definition->value = VALUE_BOOL_VAL(false);
+    else
+        return;
+
+    definition->is_known = true;
+}
+
 static void compiler_compile_named_variable(Token name, bool assign)
 {
-    uint8_t get_op, set_op;
+    uint8_t get_op, set_op, get_long_op, set_long_op;
     int arg = compiler_resolve_local(current, &name);
 
     if (arg != -1)
     {
         get_op = OP_GET_LOCAL;
         set_op = OP_SET_LOCAL;
+        get_long_op = OP_GET_LOCAL_LONG;
+        set_long_op = OP_SET_LOCAL_LONG;
     }
     else if ((arg = compiler_resolve_upvalue(current, &name)) != -1)
     {
-        get_op = OP_GET_UPVALUE;
+        bool is_boxed = current->upvalues[arg].is_boxed;
+        get_op = is_boxed ? OP_GET_BOXED_UPVALUE : OP_GET_UPVALUE;
         set_op = OP_SET_UPVALUE;
+        get_long_op = is_boxed ? OP_GET_BOXED_UPVALUE_LONG : OP_GET_UPVALUE_LONG;
+        set_long_op = OP_SET_UPVALUE_LONG;
     }
     else if ((arg = compiler_resolve_global(current, &name)) != -1)
     {
@@ -396,6 +1049,14 @@ static void compiler_compile_named_variable(Token name, bool assign)
         }
         else
         {
+            Definition *constant = compiler_find_constant(arg);
+
+            if (constant != NULL && constant->is_known)
+            {
+                compiler_emit_constant(constant->value);
+                return;
+            }
+
             compiler_emit_byte(OP_GET_GLOBAL);
             compiler_emit_short((uint16_t)arg);
         }
@@ -404,31 +1065,34 @@ static void compiler_compile_named_variable(Token name, bool assign)
     else
     {
         compiler_failed_at(&name, "Undefined variable.");
+        return;
     }
 
     if (assign)
     {
-        compiler_emit_bytes(set_op, (uint8_t)arg);
+        compiler_emit_slot(set_op, set_long_op, arg);
     }
     else
     {
-        compiler_emit_bytes(get_op, (uint8_t)arg);
+        compiler_emit_slot(get_op, get_long_op, arg);
     }
 }
 
-static void compiler_compile_string(bool can_assign, Token token)
+static void compiler_compile_string(Token token)
 {
     compiler_emit_constant(VALUE_OBJ_VAL(object_copy_string(token.start + 1,
                                                             token.length - 2)));
 }
 
-static void compiler_compile_boolean(const SExpr *sexpr, const bool value)
+static void compiler_compile_boolean(const bool value)
 {
     compiler_emit_constant(VALUE_BOOL_VAL(value));
 }
 
 static void compiler_compile_atomic_expression(const SExpr *sexpr)
 {
+    compiler.line = PARSER_AS_ATOM(sexpr).line;
+
     switch (PARSER_AS_ATOM(sexpr).type)
     {
     case TOKEN_NUMBER:
@@ -438,13 +1102,13 @@ static void compiler_compile_atomic_expression(const SExpr *sexpr)
         compiler_compile_named_variable(PARSER_AS_ATOM(sexpr), false);
         break;
     case TOKEN_STRING:
-        compiler_compile_string(true, PARSER_AS_ATOM(sexpr));
+        compiler_compile_string(PARSER_AS_ATOM(sexpr));
         break;
     case TOKEN_TRUE:
-        compiler_compile_boolean(sexpr, true);
+        compiler_compile_boolean(true);
         break;
     case TOKEN_FALSE:
-        compiler_compile_boolean(sexpr, false);
+        compiler_compile_boolean(false);
         break;
     default:
         compiler_failed_at(&PARSER_AS_ATOM(PARSER_CAR(sexpr)),
@@ -453,33 +1117,39 @@ static void compiler_compile_atomic_expression(const SExpr *sexpr)
     }
 }
 
-static void compiler_compile_lambda_expression(const SExpr *sexpr)
+// Compiles a procedure and emits its closure. Each formal is a symbol, or a
+// binding of a named let whose variable becomes the parameter. A stack
+// procedure gets its closure allocated in the frame's arena. The caller must
+// ensure that the closure can't outlive the frame.
+static ObjFunction *compiler_compile_function(const SExpr *formals, const SExpr *body, bool stack)
 {
-    SExpr *def;
+    const SExpr *def;
     Environment env;
 
     compiler_init_environment(&env, TYPE_FUNCTION);
 
     compiler_begin_scope();
 
-    for (SExpr *formal = PARSER_CDAR(sexpr); !PARSER_IS_NULL(formal); formal = PARSER_CDR(formal))
+    for (const SExpr *formal = formals; !PARSER_IS_NULL(formal); formal = PARSER_CDR(formal))
     {
+        Token variable = PARSER_IS_ATOM(PARSER_CAR(formal)) ? PARSER_AS_ATOM(PARSER_CAR(formal))
+                                                            : PARSER_AS_ATOM(PARSER_CAAR(formal));
+
         current->function->arity++;
-        if (current->function->arity > 255)
+        if (current->function->arity == 256)
         {
-            compiler_failed_at(&PARSER_AS_ATOM(PARSER_CAR(formal)),
-                               "Can't have more than 255 parameters.");
+            compiler_failed_at(&variable, "Can't have more than 255 parameters.");
         }
-        int var = compiler_declare_variable(PARSER_AS_ATOM(PARSER_CAR(formal)));
+        int var = compiler_declare_variable(variable, body);
         compiler_define_variable(var);
     }
 
-    for (def = PARSER_CDDR(sexpr); compiler_is_definition(PARSER_CAR(def)); def = PARSER_CDR(def))
+    for (def = body; compiler_is_definition(PARSER_CAR(def)); def = PARSER_CDR(def))
     {
-        compiler_compile_define(PARSER_CAR(def));
+        compiler_compile_define(PARSER_CAR(def), body);
     }
 
-    for (SExpr *expr = def; !PARSER_IS_NULL(expr); expr = PARSER_CDR(expr))
+    for (const SExpr *expr = def; !PARSER_IS_NULL(expr); expr = PARSER_CDR(expr))
     {
         if (!PARSER_IS_NULL(PARSER_CDR(expr)))
         {
@@ -494,94 +1164,1548 @@ static void compiler_compile_lambda_expression(const SExpr *sexpr)
     // End the environment and emit implicit return
     ObjFunction *function = compiler_end_environment();
 
+    // Without free variables every evaluation can share one closure, which
+    // is made now and loaded as a constant.
+    if (function->upvalue_count == 0)
+    {
+        vm_push(VALUE_OBJ_VAL(function));
+        ObjClosure *closure = object_new_closure(function);
+        vm_pop();
+
+        compiler_emit_constant(VALUE_OBJ_VAL(closure));
+        compiler_free_environment(&env);
+        return function;
+    }
+
     // Push the function onto the stack
-    compiler_emit_bytes(OP_CLOSURE, compiler_make_constant(VALUE_OBJ_VAL(function)));
+    int constant = compiler_make_constant(VALUE_OBJ_VAL(function));
+    int arena = current->function->arena_size;
+    bool wide = constant > UINT8_MAX;
 
     for (int i = 0; i < function->upvalue_count; i++)
+        wide = wide || env.upvalues[i].index > UINT8_MAX;
+
+    stack = stack && arena + OBJECT_CLOSURE_SLOTS(function->upvalue_count) <= UINT16_MAX;
+
+    if (wide)
     {
-        compiler_emit_byte(env.upvalues[i].is_local ? 1 : 0);
-        compiler_emit_byte(env.upvalues[i].index);
+        compiler_emit_byte(stack ? OP_STACK_CLOSURE_LONG : OP_CLOSURE_LONG);
+        compiler_emit_long((uint32_t)constant);
     }
-}
-
-static void compiler_compile_set_expression(const SExpr *sexpr)
+    else
+    {
+        compiler_emit_bytes(stack ? OP_STACK_CLOSURE : OP_CLOSURE, (uint8_t)constant);
+    }
+
+    // Every site gets its own slots, which are reused only when the same
+    // lambda expression is evaluated again and its last closure is dead.
+    if (stack)
+    {
+        compiler_emit_short((uint16_t)arena);
+        current->function->arena_size += OBJECT_CLOSURE_SLOTS(function->upvalue_count);
+    }
+
+    for (int i = 0; i < function->upvalue_count; i++)
+    {
+        compiler_emit_byte((env.upvalues[i].is_local ? CHUNK_CAPTURE_LOCAL : 0) |
+                           (env.upvalues[i].is_boxed ? CHUNK_CAPTURE_BOXED : 0));
+
+        if (wide)
+            compiler_emit_short(env.upvalues[i].index);
+        else
+            compiler_emit_byte((uint8_t)env.upvalues[i].index);
+    }
+
+    compiler_free_environment(&env);
+    return function;
+}
+
+static ObjFunction *compiler_compile_lambda_expression(const SExpr *sexpr, bool stack)
+{
+    return compiler_compile_function(PARSER_CDAR(sexpr), PARSER_CDDR(sexpr), stack);
+}
+
+/* Lazy compilation */
+
+// Finds the atom of sexpr that comes last in the source, and how many lists
+// of sexpr enclose it.
+static const Token *compiler_last_token(const SExpr *sexpr, int *depth)
+{
+    const Token *last = NULL;
+
+    if (PARSER_IS_ATOM(sexpr))
+        return &PARSER_AS_ATOM(sexpr);
+
+    for (; PARSER_IS_CONS(sexpr); sexpr = PARSER_CDR(sexpr))
+    {
+        int inner = 0;
+        const Token *token = compiler_last_token(PARSER_CAR(sexpr), &inner);
+
+        if (token != NULL && (last == NULL || token->start > last->start))
+        {
+            last = token;
+            *depth = inner + 1;
+        }
+    }
+
+    return last;
+}
+
+// Compiles the lambda sexpr into a script of its own and throws the code
+// away, so that errors in a body left to compiler_compile_lazy are reported
+// with the rest of the program rather than on the first call. The optimizer
+// and the lookup of constant globals are skipped, which leaves most of the
+// cost of compiling to the first call.
+static void compiler_check_lazy(const SExpr *sexpr)
+{
+    Environment env;
+    size_t id = next_id;
+    compiler_init_environment(&env, TYPE_SCRIPT);
+
+    compiler.checking = true;
+    compiler_compile_lambda_expression(sexpr, false);
+    compiler_end_environment();
+    compiler.checking = false;
+
+    compiler_free_environment(&env);
+
+    // None of the functions compiled here are ever printed, so procedures
+    // are numbered the same whether or not their bodies were checked.
+    next_id = id;
+}
+
+// Compiles a lambda at the top level into a function holding just its
+// source, which compiler_compile_lazy turns into code on the first call.
+// Without enclosing locals its body can only refer to globals, so compiling
+// it later resolves the same names. Returns NULL, emitting nothing, when the
+// lambda is too short to be worth it or its extent can't be found.
+static ObjFunction *compiler_compile_lazy_lambda(const SExpr *sexpr)
+{
+    int depth = 0;
+    const Token *first = &PARSER_AS_ATOM(PARSER_CAR(sexpr));
+    const Token *last = compiler_last_token(sexpr, &depth);
+    const char *end = last->start + last->length;
+
+    // The closing parentheses follow the last atom, with only empty lists,
+    // whitespace and comments in between.
+    while (depth > 0)
+    {
+        if (*end == '(')
+            depth++;
+        else if (*end == ')')
+            depth--;
+        else if (*end == '/' && end[1] == ';')
+            end = strchr(end, '\n') != NULL ? strchr(end, '\n') : end + strlen(end) - 1;
+        else if (*end != ' ' && *end != '\t' && *end != '\r' && *end != '\n')
+            return NULL;
+        end++;
+    }
+
+    int length = (int)(end - first->start) + 1;
+
+    if (length < COMPILER_LAZY_MIN)
+        return NULL;
+
+    compiler_check_lazy(sexpr);
+
+    // The opening parenthesis is put back in front of the keyword, since
+    // whatever separates the two is not recorded.
+    char *chars = MEMORY_ALLOCATE(char, length + 1);
+    chars[0] = '(';
+    memcpy(chars + 1, first->start, length - 1);
+    chars[length] = '\0';
+
+    ObjFunction *function = object_new_function();
+    vm_push(VALUE_OBJ_VAL(function));
+    function->source = object_take_string(chars, length);
+    function->line = first->line;
+    ObjClosure *closure = object_new_closure(function);
+    vm_pop();
+
+    compiler_emit_constant(VALUE_OBJ_VAL(closure));
+    return function;
+}
+
+bool compiler_compile_lazy(ObjFunction *function)
+{
+    SExpr *sexpr;
+    Environment env;
+    ObjFunction *compiled = NULL;
+
+    parser_init_parser_at(function->source->chars, function->line);
+    compiler_init_environment(&env, TYPE_SCRIPT);
+
+    compiler.failed = false;
+    compiler.line = function->line;
+
+    if (parser_parse(&sexpr) == PARSER_OK)
+        compiled = compiler_compile_lambda_expression(sexpr, false);
+
+    // The compiled function is only reachable from the script until its
+    // code is moved over, which allocates nothing.
+    compiler_end_environment();
+    compiler_free_environment(&env);
+
+    if (compiled == NULL || compiler.failed)
+        return false;
+
+    function->arity = compiled->arity;
+    function->arena_size = compiled->arena_size;
+    function->chunk = compiled->chunk;
+    function->source = NULL;
+    chunk_init_chunk(&compiled->chunk);
+    return true;
+}
+
+/* Register code */
+
+// Whether name is bound by a local of any enclosing function.
+static bool compiler_is_lexical(Token *name)
+{
+    for (Environment *env = current; env != NULL; env = env->enclosing)
+    {
+        for (int i = 0; i < env->local_count; i++)
+        {
+            if (compiler_identifiers_equal(name, &env->locals[i].name))
+                return true;
+        }
+    }
+
+    return false;
+}
+
+// The primitives whose calls compile to an instruction of their own rather
+// than to pushes of the procedure and the arguments followed by a call: the
+// arithmetic of three-address instructions, which read their operands
+// straight from the frame, and the accessors of numeric vectors, whose
+// operand is the kind of vector.
+typedef struct
+{
+    const char *name;
+    uint8_t instruction;
+    uint8_t operand;
+} CompilerPrimitive;
+
+static const CompilerPrimitive compiler_primitives[] = {
+    {"+", OP_ADD, 0},
+    {"-", OP_SUBTRACT, 0},
+    {"*", OP_MULTIPLY, 0},
+    {"=", OP_EQUAL, 0},
+    {"<", OP_LESS, 0},
+    {">", OP_GREATER, 0},
+    {"<=", OP_LESS_EQUAL, 0},
+    {">=", OP_GREATER_EQUAL, 0},
+    {"f64vector-ref", OP_VECTOR_REF, VECTOR_F64},
+    {"f64vector-set!", OP_VECTOR_SET, VECTOR_F64},
+    {"s32vector-ref", OP_VECTOR_REF, VECTOR_S32},
+    {"s32vector-set!", OP_VECTOR_SET, VECTOR_S32},
+    {"u8vector-ref", OP_VECTOR_REF, VECTOR_U8},
+    {"u8vector-set!", OP_VECTOR_SET, VECTOR_U8},
+};
+
+#define COMPILER_PRIMITIVES (int)(sizeof(compiler_primitives) / sizeof(CompilerPrimitive))
+
+static int compiler_find_primitive(Token *name)
+{
+    for (int i = 0; i < COMPILER_PRIMITIVES; i++)
+    {
+        const char *chars = compiler_primitives[i].name;
+
+        if ((int)strlen(chars) == name->length && memcmp(chars, name->start, name->length) == 0)
+            return i;
+    }
+
+    return -1;
+}
+
+static void compiler_record_redefined()
+{
+    compiler.redefined = 0;
+
+    for (int i = 0; i < COMPILER_PRIMITIVES; i++)
+    {
+        const char *chars = compiler_primitives[i].name;
+        Token name = {TOKEN_SYMBOL, chars, (int)strlen(chars), 0, 0};
+
+        if (compiler_find_definition(&name) != NULL)
+            compiler.redefined |= (uint32_t)1 << i;
+    }
+}
+
+// The primitive of the table that name refers to and keeps referring to, or
+// -1: the whole program never defines or assigns it, and it hasn't been
+// assigned since the primitives were defined.
+static int compiler_resolve_primitive(Token *name)
+{
+    int primitive = compiler_find_primitive(name);
+
+    if (primitive == -1 || compiler.partial || (compiler.redefined & ((uint32_t)1 << primitive)) ||
+        compiler_is_lexical(name))
+        return -1;
+
+    int global = compiler_resolve_global(current, name);
+
+    if (global == -1 || !table_is_unchanged(&vm.globals, global))
+        return -1;
+
+    Value value = table_get(&vm.globals, global);
+
+    if (!OBJECT_IS_NATIVE(value) ||
+        strcmp(((ObjNative *)VALUE_AS_OBJ(value))->name, compiler_primitives[primitive].name) != 0)
+        return -1;
+
+    return primitive;
+}
+
+// The operand that reads arg in place, or -1 if it must be evaluated into a
+// slot first. A local that set! may change is only read in place when no code
+// runs between its turn to be evaluated and the instruction.
+static int compiler_register_operand(const SExpr *arg, bool last)
+{
+    if (!PARSER_IS_ATOM(arg))
+        return -1;
+
+    Token token = PARSER_AS_ATOM(arg);
+
+    if (token.type == TOKEN_NUMBER)
+    {
+        int constant = compiler_make_constant(compiler_number_value(token));
+        return constant <= CHUNK_REGISTER_MAX ? constant | CHUNK_REGISTER_CONSTANT : -1;
+    }
+
+    if (token.type == TOKEN_SYMBOL)
+    {
+        int slot = compiler_resolve_local(current, &token);
+
+        if (slot != -1 && slot <= CHUNK_REGISTER_MAX && (last || !current->locals[slot].is_boxed))
+            return slot;
+    }
+
+    return -1;
+}
+
+// Compiles a call of a register primitive with two arguments to a single
+// three-address instruction, whose result goes to the slot the call would
+// leave it in. Arguments that aren't locals or numbers are evaluated into
+// the slots above it first. Returns false, emitting nothing, for other calls.
+static bool compiler_compile_register_call(const SExpr *sexpr)
+{
+    const SExpr *operator = PARSER_CAR(sexpr);
+    const SExpr *args = PARSER_CDR(sexpr);
+    int base = current->local_count;
+
+    if (!compiler.registers || !PARSER_IS_ATOM(operator) || PARSER_AS_ATOM(operator).type != TOKEN_SYMBOL ||
+        PARSER_IS_NULL(args) || PARSER_IS_NULL(PARSER_CDR(args)) || !PARSER_IS_NULL(PARSER_CDDR(args)) ||
+        base + 2 > CHUNK_REGISTER_MAX)
+        return false;
+
+    Token name = PARSER_AS_ATOM(operator);
+    int primitive = compiler_resolve_primitive(&name);
+
+    if (primitive == -1 || !CHUNK_IS_REGISTER(compiler_primitives[primitive].instruction))
+        return false;
+
+    int line = compiler.line;
+    int operands[2];
+    const SExpr *arg = args;
+
+    for (int i = 0; i < 2; i++, arg = PARSER_CDR(arg))
+    {
+        operands[i] = compiler_register_operand(PARSER_CAR(arg), i == 1 || PARSER_IS_ATOM(PARSER_CDAR(args)));
+
+        if (operands[i] == -1)
+        {
+            compiler_compile_expression(PARSER_CAR(arg), false);
+            compiler_add_temporary();
+            operands[i] = current->local_count - 1;
+        }
+    }
+
+    current->local_count = base;
+
+    compiler.line = line;
+    compiler_emit_byte(compiler_primitives[primitive].instruction);
+    compiler_emit_byte((uint8_t)base);
+    compiler_emit_byte((uint8_t)operands[0]);
+    compiler_emit_byte((uint8_t)operands[1]);
+    return true;
+}
+
+// Compiles a call of an accessor of numeric vectors with the right number of
+// arguments to their pushes and the instruction of the accessor, see
+// vector.h. Returns false, emitting nothing, for other calls.
+static bool compiler_compile_vector_call(const SExpr *sexpr)
+{
+    const SExpr *operator = PARSER_CAR(sexpr);
+
+    if (!PARSER_IS_ATOM(operator) || PARSER_AS_ATOM(operator).type != TOKEN_SYMBOL)
+        return false;
+
+    Token name = PARSER_AS_ATOM(operator);
+    int primitive = compiler_resolve_primitive(&name);
+
+    if (primitive == -1 || CHUNK_IS_REGISTER(compiler_primitives[primitive].instruction))
+        return false;
+
+    uint8_t instruction = compiler_primitives[primitive].instruction;
+    int arity = instruction == OP_VECTOR_REF ? 2 : 3;
+    int arg_count = 0;
+
+    for (const SExpr *arg = PARSER_CDR(sexpr); !PARSER_IS_NULL(arg); arg = PARSER_CDR(arg))
+        arg_count++;
+
+    if (arg_count != arity)
+        return false;
+
+    int line = compiler.line;
+
+    for (const SExpr *arg = PARSER_CDR(sexpr); !PARSER_IS_NULL(arg); arg = PARSER_CDR(arg))
+    {
+        compiler_compile_expression(PARSER_CAR(arg), false);
+        compiler_add_temporary();
+    }
+
+    // The instruction replaces the arguments with its result.
+    current->local_count -= arg_count;
+
+    compiler.line = line;
+    compiler_emit_bytes(instruction, compiler_primitives[primitive].operand);
+    return true;
+}
+
+// The operand of copied register code, or -1 if it doesn't fit.
+static int compiler_rebase_operand(Chunk *chunk, uint8_t operand, int base)
+{
+    if (operand & CHUNK_REGISTER_CONSTANT)
+    {
+        int constant = compiler_make_constant(chunk->constants.values[operand & CHUNK_REGISTER_MAX]);
+        return constant <= CHUNK_REGISTER_MAX ? constant | CHUNK_REGISTER_CONSTANT : -1;
+    }
+
+    return base + operand <= CHUNK_REGISTER_MAX ? base + operand : -1;
+}
+
+// Whether the register code of function still fits its operands when copied
+// with its closure in slot base.
+static bool compiler_can_rebase(ObjFunction *function, int base)
+{
+    Chunk *chunk = &function->chunk;
+
+    for (int offset = 0; offset < chunk->count; offset += chunk_instruction_size(chunk, offset))
+    {
+        uint8_t *code = &chunk->code[offset];
+
+        if (CHUNK_IS_REGISTER(code[0]) &&
+            (compiler_rebase_operand(chunk, code[1], base) == -1 ||
+             compiler_rebase_operand(chunk, code[2], base) == -1 ||
+             compiler_rebase_operand(chunk, code[3], base) == -1))
+            return false;
+    }
+
+    return true;
+}
+
+/* Inlining */
+
+static bool compiler_is_inlinable(ObjFunction *function, int global)
+{
+    Chunk *chunk = &function->chunk;
+
+    if (function->source != NULL || function->upvalue_count > 0 || function->arena_size > 0 ||
+        chunk->count > COMPILER_INLINE_MAX)
+        return false;
+
+    for (int offset = 0; offset < chunk->count; offset += chunk_instruction_size(chunk, offset))
+    {
+        switch (chunk->code[offset])
+        {
+        case OP_GET_GLOBAL:
+            // Recursive procedures would be copied into themselves.
+            if (((chunk->code[offset + 1] << 8) | chunk->code[offset + 2]) == global)
+                return false;
+            break;
+        case OP_CONSTANT:
+        case OP_CONSTANT_LONG:
+        case OP_NULL:
+        case OP_TRUE:
+        case OP_FALSE:
+        case OP_POP:
+        case OP_POPN:
+        case OP_GET_LOCAL:
+        case OP_GET_LOCAL_LONG:
+        case OP_SET_LOCAL:
+        case OP_SET_LOCAL_LONG:
+        case OP_GLOBAL_UNCHANGED:
+        case OP_SET_GLOBAL:
+        case OP_JUMP:
+        case OP_JUMP_LONG:
+        case OP_JUMP_IF_FALSE:
+        case OP_JUMP_IF_FALSE_LONG:
+        case OP_POP_JUMP_IF_FALSE:
+        case OP_POP_JUMP_IF_FALSE_LONG:
+        case OP_CALL:
+        case OP_TAIL_CALL:
+        case OP_RETURN:
+        case OP_ADD:
+        case OP_SUBTRACT:
+        case OP_MULTIPLY:
+        case OP_EQUAL:
+        case OP_LESS:
+        case OP_GREATER:
+        case OP_LESS_EQUAL:
+        case OP_GREATER_EQUAL:
+        case OP_ADD_UNCHECKED:
+        case OP_SUBTRACT_UNCHECKED:
+        case OP_MULTIPLY_UNCHECKED:
+        case OP_EQUAL_UNCHECKED:
+        case OP_LESS_UNCHECKED:
+        case OP_GREATER_UNCHECKED:
+        case OP_LESS_EQUAL_UNCHECKED:
+        case OP_GREATER_EQUAL_UNCHECKED:
+        case OP_VECTOR_REF:
+        case OP_VECTOR_SET:
+            break;
+        default:
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Records the procedure defined in global. Only a global first declared by
+// this definition qualifies, since the guard can't tell which assignment a
+// global holds, only that it was assigned once.
+static void compiler_add_inline(int global, ObjFunction *function, bool fresh)
+{
+    for (int i = 0; i < compiler.inline_count; i++)
+    {
+        if (compiler.inlines[i].global == global)
+        {
+            compiler.inlines[i] = compiler.inlines[--compiler.inline_count];
+            break;
+        }
+    }
+
+    if (!fresh || !compiler_is_inlinable(function, global))
+        return;
+
+    if (compiler.inline_capacity < compiler.inline_count + 1)
+    {
+        int old_capacity = compiler.inline_capacity;
+        compiler.inline_capacity = MEMORY_GROW_CAPACITY(old_capacity);
+        compiler.inlines = MEMORY_GROW_ARRAY(Inline, compiler.inlines, old_capacity, compiler.inline_capacity);
+    }
+
+    compiler.inlines[compiler.inline_count].global = global;
+    compiler.inlines[compiler.inline_count].function = function;
+    compiler.inline_count++;
+}
+
+static Inline *compiler_find_inline(int global)
+{
+    for (int i = 0; i < compiler.inline_count; i++)
+    {
+        if (compiler.inlines[i].global == global)
+            return &compiler.inlines[i];
+    }
+
+    return NULL;
+}
+
+// Copies the code of function to the current chunk, as if it had been called
+// with its closure in slot base. Returns become jumps past the copy.
+static void compiler_emit_inlined_code(ObjFunction *function, int base)
+{
+    Chunk *chunk = &function->chunk;
+
+    // Jumps waiting for their target, an offset into the copied chunk.
+    int *handles = MEMORY_ALLOCATE(int, chunk->count);
+    int *targets = MEMORY_ALLOCATE(int, chunk->count);
+    int pending = 0;
+
+    for (int offset = 0; offset < chunk->count;)
+    {
+        uint8_t *code = &chunk->code[offset];
+        int next = offset + chunk_instruction_size(chunk, offset);
+
+        for (int i = 0; i < pending; i++)
+        {
+            if (targets[i] == offset)
+                compiler_patch_jump(handles[i]);
+        }
+
+        switch (code[0])
+        {
+        case OP_CONSTANT:
+            compiler_emit_constant(chunk->constants.values[code[1]]);
+            break;
+        case OP_CONSTANT_LONG:
+            compiler_emit_constant(chunk->constants.values[(code[1] << 16) | (code[2] << 8) | code[3]]);
+            break;
+        case OP_GET_LOCAL:
+            compiler_emit_slot(OP_GET_LOCAL, OP_GET_LOCAL_LONG, base + code[1]);
+            break;
+        case OP_ADD:
+        case OP_SUBTRACT:
+        case OP_MULTIPLY:
+        case OP_EQUAL:
+        case OP_LESS:
+        case OP_GREATER:
+        case OP_LESS_EQUAL:
+        case OP_GREATER_EQUAL:
+        case OP_ADD_UNCHECKED:
+        case OP_SUBTRACT_UNCHECKED:
+        case OP_MULTIPLY_UNCHECKED:
+        case OP_EQUAL_UNCHECKED:
+        case OP_LESS_UNCHECKED:
+        case OP_GREATER_UNCHECKED:
+        case OP_LESS_EQUAL_UNCHECKED:
+        case OP_GREATER_EQUAL_UNCHECKED:
+            // compiler_can_rebase has checked that the operands fit.
+            compiler_emit_byte(code[0]);
+            for (int i = 1; i < 4; i++)
+                compiler_emit_byte((uint8_t)compiler_rebase_operand(chunk, code[i], base));
+            break;
+        case OP_GET_LOCAL_LONG:
+            compiler_emit_slot(OP_GET_LOCAL, OP_GET_LOCAL_LONG, base + ((code[1] << 8) | code[2]));
+            break;
+        case OP_SET_LOCAL:
+            compiler_emit_slot(OP_SET_LOCAL, OP_SET_LOCAL_LONG, base + code[1]);
+            break;
+        case OP_SET_LOCAL_LONG:
+            compiler_emit_slot(OP_SET_LOCAL, OP_SET_LOCAL_LONG, base + ((code[1] << 8) | code[2]));
+            break;
+        case OP_JUMP:
+        case OP_JUMP_IF_FALSE:
+        case OP_POP_JUMP_IF_FALSE:
+            handles[pending] = compiler_emit_jump(code[0]);
+            targets[pending++] = next + ((code[1] << 8) | code[2]);
+            break;
+        case OP_JUMP_LONG:
+        case OP_JUMP_IF_FALSE_LONG:
+        case OP_POP_JUMP_IF_FALSE_LONG:
+            handles[pending] = compiler_emit_jump(code[0] == OP_JUMP_LONG            ? OP_JUMP
+                                                  : code[0] == OP_JUMP_IF_FALSE_LONG ? OP_JUMP_IF_FALSE
+                                                                                     : OP_POP_JUMP_IF_FALSE);
+            targets[pending++] = next + ((code[1] << 16) | (code[2] << 8) | code[3]);
+            break;
+        case OP_TAIL_CALL:
+            compiler_emit_bytes(OP_CALL, code[1]);
+            // Fall through.
+        case OP_RETURN:
+            if (next < chunk->count)
+            {
+                handles[pending] = compiler_emit_jump(OP_JUMP);
+                targets[pending++] = chunk->count;
+            }
+            break;
+        default:
+            for (int i = 0; i < next - offset; i++)
+                compiler_emit_byte(code[i]);
+            break;
+        }
+
+        offset = next;
+    }
+
+    for (int i = 0; i < pending; i++)
+    {
+        if (targets[i] == chunk->count)
+            compiler_patch_jump(handles[i]);
+    }
+
+    MEMORY_FREE_ARRAY(int, handles, chunk->count);
+    MEMORY_FREE_ARRAY(int, targets, chunk->count);
+}
+
+// Compiles a call of a procedure recorded for inlining. The arguments are
+// evaluated into the slots the call would give them, below which the result
+// is left. Returns false, emitting nothing, for any other call.
+static bool compiler_compile_inline_call(const SExpr *sexpr, bool tail)
+{
+    const SExpr *operator = PARSER_CAR(sexpr);
+    int arg_count = 0;
+    int line = compiler.line;
+
+    if (!PARSER_IS_ATOM(operator) || PARSER_AS_ATOM(operator).type != TOKEN_SYMBOL)
+        return false;
+
+    Token name = PARSER_AS_ATOM(operator);
+
+    if (compiler_is_lexical(&name))
+        return false;
+
+    int global = compiler_resolve_global(current, &name);
+    Inline *candidate = global == -1 ? NULL : compiler_find_inline(global);
+
+    if (candidate == NULL)
+        return false;
+
+    for (const SExpr *expr = PARSER_CDR(sexpr); !PARSER_IS_NULL(expr); expr = PARSER_CDR(expr))
+        arg_count++;
+
+    if (arg_count != candidate->function->arity)
+        return false;
+
+    ObjFunction *function = candidate->function;
+    int base = current->local_count;
+
+    if (!compiler_can_rebase(function, base))
+        return false;
+
+    compiler_emit_byte(OP_NULL);
+    compiler_add_temporary();
+
+    for (const SExpr *expr = PARSER_CDR(sexpr); !PARSER_IS_NULL(expr); expr = PARSER_CDR(expr))
+    {
+        compiler_compile_expression(PARSER_CAR(expr), false);
+        compiler_add_temporary();
+    }
+
+    // A constant global needs no guard, it holds this procedure for good.
+    bool guarded = compiler_find_constant(global) == NULL;
+    int slow_jump = -1;
+
+    if (guarded)
+    {
+        compiler.line = line;
+        compiler_emit_byte(OP_GLOBAL_UNCHANGED);
+        compiler_emit_short((uint16_t)global);
+        slow_jump = compiler_emit_jump(OP_JUMP_IF_FALSE);
+        compiler_emit_byte(OP_POP);
+    }
+
+    compiler_emit_inlined_code(function, base);
+
+    compiler_emit_slot(OP_SET_LOCAL, OP_SET_LOCAL_LONG, base);
+    for (int i = 0; i <= arg_count; i++)
+        compiler_emit_byte(OP_POP);
+
+    current->local_count -= arg_count + 1;
+
+    if (!guarded)
+        return true;
+
+    int end_jump = compiler_emit_jump(OP_JUMP);
+
+    // The global was assigned since, so call whatever it holds now.
+    compiler_patch_jump(slow_jump);
+    compiler_emit_byte(OP_POP);
+    compiler_emit_byte(OP_GET_GLOBAL);
+    compiler_emit_short((uint16_t)global);
+    compiler_emit_slot(OP_SET_LOCAL, OP_SET_LOCAL_LONG, base);
+    compiler_emit_byte(OP_POP);
+    compiler_emit_bytes((tail ? OP_TAIL_CALL : OP_CALL), (uint8_t)arg_count);
+
+    compiler_patch_jump(end_jump);
+    return true;
+}
+
+static void compiler_compile_set_expression(const SExpr *sexpr)
+{
+    compiler_compile_expression(PARSER_CDDAR(sexpr), false);
+    compiler_compile_named_variable(PARSER_AS_ATOM(PARSER_CDAR(sexpr)), true);
+}
+
+// Compiles the definitions and expressions of a let body, leaving the value
+// of the last expression on the stack.
+static void compiler_compile_let_body(const SExpr *body)
+{
+    const SExpr *def;
+
+    for (def = body; compiler_is_definition(PARSER_CAR(def)); def = PARSER_CDR(def))
+    {
+        compiler_compile_define(PARSER_CAR(def), body);
+    }
+
+    for (const SExpr *expr = def; !PARSER_IS_NULL(expr); expr = PARSER_CDR(expr))
+    {
+        compiler_compile_expression(PARSER_CAR(expr), false);
+        if (!PARSER_IS_NULL(PARSER_CDR(expr)))
+            compiler_emit_byte(OP_POP);
+    }
+}
+
+static void compiler_compile_let_expression(const SExpr *sexpr, bool tail)
+{
+    // The bindings are popped after the body, which is never a tail call.
+    (void)tail;
+
+    // Reserve the slot that receives the value of the body below the
+    // bindings, so they can be popped, and captured ones closed, from the
+    // top of the stack.
+    int result = current->local_count;
+    compiler_emit_byte(OP_NULL);
+    compiler_add_temporary();
+
+    compiler_begin_scope();
+
+    for (SExpr *bind = PARSER_CDAR(sexpr); !PARSER_IS_NULL(bind); bind = PARSER_CDR(bind))
+    {
+        Token name = PARSER_AS_ATOM(PARSER_CAAR(bind));
+
+        if (compiler_is_lambda(PARSER_CADAR(bind)) && compiler_is_only_called(PARSER_CDR(sexpr), &name))
+            compiler_compile_lambda_expression(PARSER_CADAR(bind), true);
+        else
+            compiler_compile_expression(PARSER_CADAR(bind), false);
+
+        // Declared once its value is on the stack, so that any locals of the
+        // initializer take the slots below it.
+        compiler_define_variable(compiler_declare_variable(name, PARSER_CDR(sexpr)));
+    }
+
+    compiler_compile_let_body(PARSER_CDDR(sexpr));
+
+    compiler_emit_slot(OP_SET_LOCAL, OP_SET_LOCAL_LONG, result);
+    compiler_emit_byte(OP_POP);
+
+    compiler_end_scope();
+
+    // The result is left as an ordinary value on the stack.
+    current->local_count--;
+}
+
+/* Loops */
+
+// Stores the values on top of the stack in the variables of loop, the last
+// value in the last variable, and jumps back to its head. Only the variables
+// marked in stored, or all of them if it is NULL, get a value. Whatever the
+// iteration left between the variables and top is popped.
+static void compiler_emit_loop_back(Loop *loop, int top, const bool *stored)
+{
+    for (int i = loop->count - 1; i >= 0; i--)
+    {
+        int slot = loop->base + i;
+
+        // Every iteration binds the variable anew, so closures made in this
+        // one keep the value they captured.
+        if (current->locals[slot].is_captured)
+        {
+            compiler_emit_byte(OP_CLOSE_LOCAL);
+            compiler_emit_short((uint16_t)slot);
+        }
+
+        if (stored == NULL || stored[i])
+        {
+            compiler_emit_slot(OP_SET_LOCAL, OP_SET_LOCAL_LONG, slot);
+            compiler_emit_byte(OP_POP);
+        }
+    }
+
+    for (int i = top - 1; i >= loop->base + loop->count; i--)
+    {
+        if (current->locals[i].is_captured)
+            compiler_emit_byte(OP_CLOSE_UPVALUE);
+        else
+            compiler_emit_byte(OP_POP);
+    }
+
+    compiler_emit_loop(loop->head);
+}
+
+// Compiles a call of an enclosing named let that runs as a loop. The
+// arguments are evaluated before any variable is assigned. Returns false,
+// emitting nothing, for any other call.
+static bool compiler_compile_loop_call(const SExpr *sexpr)
+{
+    const SExpr *operator = PARSER_CAR(sexpr);
+
+    if (!PARSER_IS_ATOM(operator) || PARSER_AS_ATOM(operator).type != TOKEN_SYMBOL)
+        return false;
+
+    Loop *loop = current->loop;
+
+    while (loop != NULL && !compiler_identifiers_equal(&loop->name, &PARSER_AS_ATOM(operator)))
+        loop = loop->enclosing;
+
+    if (loop == NULL)
+        return false;
+
+    int top = current->local_count;
+
+    for (const SExpr *expr = PARSER_CDR(sexpr); !PARSER_IS_NULL(expr); expr = PARSER_CDR(expr))
+    {
+        compiler_compile_expression(PARSER_CAR(expr), false);
+        compiler_add_temporary();
+    }
+
+    compiler_emit_loop_back(loop, top, NULL);
+
+    // The stack below the call is left as the next iteration expects it.
+    current->local_count = top;
+    return true;
+}
+
+// Compiles (let name ((var init) ...) body). When the body only calls name
+// in tail position, the calls store the new values in the variables and jump
+// back to the start of the body, so no procedure is made. Otherwise it is
+// compiled as ((letrec ((name (lambda (var ...) body))) name) init ...).
+static void compiler_compile_named_let_expression(const SExpr *sexpr)
+{
+    Token name = PARSER_AS_ATOM(PARSER_CDAR(sexpr));
+    const SExpr *bindings = PARSER_CDDAR(sexpr);
+    const SExpr *body = PARSER_CDDDR(sexpr);
+    int count = 0;
+    int line = compiler.line;
+
+    for (const SExpr *bind = bindings; !PARSER_IS_NULL(bind); bind = PARSER_CDR(bind))
+        count++;
+
+    // As in a let, the result goes below the variables.
+    int result = current->local_count;
+    compiler_emit_byte(OP_NULL);
+    compiler_add_temporary();
+
+    compiler_begin_scope();
+
+    if (compiler_is_loop_body(body, &name, count, true))
+    {
+        for (const SExpr *bind = bindings; !PARSER_IS_NULL(bind); bind = PARSER_CDR(bind))
+        {
+            compiler_compile_expression(PARSER_CADAR(bind), false);
+            compiler_define_variable(compiler_declare_variable(PARSER_AS_ATOM(PARSER_CAAR(bind)), body));
+        }
+
+        Loop loop = {current->loop, name, compiler_current_chunk()->count, result + 1, count};
+
+        current->loop = &loop;
+        compiler_compile_let_body(body);
+        current->loop = loop.enclosing;
+    }
+    else
+    {
+        // The procedure refers to itself through a boxed local.
+        int slot = current->local_count;
+        compiler_emit_byte(OP_NULL);
+        compiler_add_local(name);
+        current->locals[slot].is_boxed = true;
+        compiler_mark_initialized();
+
+        compiler_compile_function(bindings, body, compiler_is_only_called(body, &name));
+        compiler_emit_slot(OP_SET_LOCAL, OP_SET_LOCAL_LONG, slot);
+        compiler_emit_byte(OP_POP);
+
+        compiler_emit_slot(OP_GET_LOCAL, OP_GET_LOCAL_LONG, slot);
+        compiler_add_temporary();
+
+        for (const SExpr *bind = bindings; !PARSER_IS_NULL(bind); bind = PARSER_CDR(bind))
+        {
+            compiler_compile_expression(PARSER_CADAR(bind), false);
+            compiler_add_temporary();
+        }
+
+        // More than 255 bindings were reported as parameters of the
+        // procedure.
+        current->local_count -= count + 1;
+        compiler.line = line;
+        compiler_emit_bytes(OP_CALL, (uint8_t)count);
+    }
+
+    compiler_emit_slot(OP_SET_LOCAL, OP_SET_LOCAL_LONG, result);
+    compiler_emit_byte(OP_POP);
+
+    compiler_end_scope();
+
+    current->local_count--;
+}
+
+// Compiles (do ((var init step) ...) (test expr ...) command ...) as a loop
+// that evaluates the test at its head. Variables without a step keep their
+// value from one iteration to the next.
+static void compiler_compile_do_expression(const SExpr *sexpr)
+{
+    const SExpr *specs = PARSER_CDAR(sexpr);
+    const SExpr *clause = PARSER_CDDAR(sexpr);
+    int count = 0;
+
+    int result = current->local_count;
+    compiler_emit_byte(OP_NULL);
+    compiler_add_temporary();
+
+    compiler_begin_scope();
+
+    for (const SExpr *spec = specs; !PARSER_IS_NULL(spec); spec = PARSER_CDR(spec))
+    {
+        compiler_compile_expression(PARSER_CADAR(spec), false);
+        compiler_define_variable(compiler_declare_variable(PARSER_AS_ATOM(PARSER_CAAR(spec)), PARSER_CDR(sexpr)));
+        count++;
+    }
+
+    Loop loop = {NULL, compiler_temporary_name(), compiler_current_chunk()->count, result + 1, count};
+
+    compiler_compile_expression(PARSER_CAR(clause), false);
+    int body_jump = compiler_emit_jump(OP_JUMP_IF_FALSE);
+
+    // Without expressions the value of the test is the result.
+    for (const SExpr *expr = PARSER_CDR(clause); !PARSER_IS_NULL(expr); expr = PARSER_CDR(expr))
+    {
+        compiler_emit_byte(OP_POP);
+        compiler_compile_expression(PARSER_CAR(expr), false);
+    }
+
+    compiler_emit_slot(OP_SET_LOCAL, OP_SET_LOCAL_LONG, result);
+    compiler_emit_byte(OP_POP);
+    int exit_jump = compiler_emit_jump(OP_JUMP);
+
+    compiler_patch_jump(body_jump);
+    compiler_emit_byte(OP_POP);
+
+    for (const SExpr *command = PARSER_CDDDR(sexpr); !PARSER_IS_NULL(command); command = PARSER_CDR(command))
+    {
+        compiler_compile_expression(PARSER_CAR(command), false);
+        compiler_emit_byte(OP_POP);
+    }
+
+    int top = current->local_count;
+    bool *stored = MEMORY_ALLOCATE(bool, count);
+    int i = 0;
+
+    for (const SExpr *spec = specs; !PARSER_IS_NULL(spec); spec = PARSER_CDR(spec), i++)
+    {
+        const SExpr *step = PARSER_CADDR(spec);
+
+        stored[i] = !PARSER_IS_NULL(step);
+        if (stored[i])
+        {
+            compiler_compile_expression(PARSER_CAR(step), false);
+            compiler_add_temporary();
+        }
+    }
+
+    compiler_emit_loop_back(&loop, top, stored);
+    current->local_count = top;
+    MEMORY_FREE_ARRAY(bool, stored, count);
+
+    compiler_patch_jump(exit_jump);
+
+    compiler_end_scope();
+
+    current->local_count--;
+}
+
+static void compiler_compile_begin_expression(const SExpr *sexpr, bool tail)
+{
+    for (SExpr *expr = PARSER_CDR(sexpr); !PARSER_IS_NULL(expr); expr = PARSER_CDR(expr))
+    {
+        if (!PARSER_IS_NULL(PARSER_CDR(expr)))
+        {
+            compiler_compile_expression(PARSER_CAR(expr), false);
+            compiler_emit_byte(OP_POP);
+        }
+        else
+        {
+            compiler_compile_expression(PARSER_CAR(expr), tail);
+        }
+    }
+}
+
+static void compiler_compile_if_expression(const SExpr *sexpr, bool tail)
+{
+    SExpr *cond_expr, *then_expr, *else_expr;
+
+    cond_expr = PARSER_CDAR(sexpr);
+    then_expr = PARSER_CDDAR(sexpr);
+    else_expr = PARSER_CDDDAR(sexpr);
+
+    compiler_compile_expression(cond_expr, false);
+
+    int then_jump = compiler_emit_jump(OP_JUMP_IF_FALSE);
+    compiler_emit_byte(OP_POP);
+
+    compiler_compile_expression(then_expr, tail);
+
+    int else_jump = compiler_emit_jump(OP_JUMP);
+    compiler_patch_jump(then_jump);
+    compiler_emit_byte(OP_POP);
+
+    compiler_compile_expression(else_expr, tail);
+
+    compiler_patch_jump(else_jump);
+}
+
+// The constant for a datum of a case clause, or -1 if it can't be one.
+static int compiler_datum_constant(const SExpr *datum)
 {
-    compiler_compile_expression(PARSER_CDDAR(sexpr), false);
-    compiler_compile_named_variable(PARSER_AS_ATOM(PARSER_CDAR(sexpr)), true);
+    if (!PARSER_IS_ATOM(datum))
+        return -1;
+
+    Token token = PARSER_AS_ATOM(datum);
+
+    switch (token.type)
+    {
+    case TOKEN_NUMBER:
+        return compiler_make_constant(compiler_number_value(token));
+    case TOKEN_STRING:
+        return compiler_make_constant(VALUE_OBJ_VAL(object_copy_string(token.start + 1, token.length - 2)));
+    case TOKEN_TRUE:
+        return compiler_make_constant(VALUE_BOOL_VAL(true));
+    case TOKEN_FALSE:
+        return compiler_make_constant(VALUE_BOOL_VAL(false));
+    default:
+        return -1;
+    }
 }
 
-static void compiler_compile_let_expression(const SExpr *sexpr, bool tail)
+// Emits an OP_SWITCH over the distinct keys in constants, numeric for a cond
+// of = tests. Sets handles[i] to the jump for constants[i] and returns the
+// first of the jumps for the default, which run up to the current jump count.
+static int compiler_emit_switch(const int *constants, int count, bool numeric, int *handles)
 {
-    SExpr *def;
+    Chunk *chunk = compiler_current_chunk();
+    Value *values = chunk->constants.values;
+    int low = count > 0 ? constants[0] : 0;
+    int high = low;
+    bool dense = count > 0;
 
-    compiler_begin_scope();
+    for (int i = 0; i < count; i++)
+    {
+        Value key = values[constants[i]];
 
-    // Save index for return value
-    int result = current->local_count;
+        if (constants[i] == CHUNK_SWITCH_EMPTY)
+            compiler_failed("Too many constants in one chunk.");
 
-    for (SExpr *bind = PARSER_CDAR(sexpr); !PARSER_IS_NULL(bind); bind = PARSER_CDR(bind))
+        if (!VALUE_IS_FIXNUM(key) || VALUE_AS_FIXNUM(key) <= INT32_MIN / 2 || VALUE_AS_FIXNUM(key) >= INT32_MAX / 2)
+        {
+            dense = false;
+            continue;
+        }
+
+        if (VALUE_AS_FIXNUM(key) < VALUE_AS_FIXNUM(values[low]))
+            low = constants[i];
+        if (VALUE_AS_FIXNUM(key) > VALUE_AS_FIXNUM(values[high]))
+            high = constants[i];
+    }
+
+    // A dense table indexed by the key is used when at least half of it is
+    // taken, otherwise an open addressed one at most half full.
+    int span = dense ? (int)(VALUE_AS_FIXNUM(values[high]) - VALUE_AS_FIXNUM(values[low])) + 1 : 0;
+    int size = 2;
+
+    if (dense && span <= 2 * count)
+        size = span;
+    else
     {
-        int var = compiler_declare_variable(PARSER_AS_ATOM(PARSER_CAAR(bind)));
-        compiler_compile_expression(PARSER_CADAR(bind), false);
-        compiler_define_variable(var);
+        dense = false;
+        while (size < 2 * count)
+            size *= 2;
     }
 
-    for (def = PARSER_CDDR(sexpr); compiler_is_definition(PARSER_CAR(def)); def = PARSER_CDR(def))
+    if (size > UINT16_MAX)
     {
-        compiler_compile_define(PARSER_CAR(def));
+        compiler_failed("Too many cases in one switch.");
+        return current->jump_count;
     }
 
-    for (SExpr *expr = def; !PARSER_IS_NULL(expr); expr = PARSER_CDR(expr))
+    int origin = chunk->count;
+    compiler_emit_byte(OP_SWITCH);
+    compiler_emit_byte((dense ? CHUNK_SWITCH_DENSE : CHUNK_SWITCH_HASHED) | (numeric ? CHUNK_SWITCH_NUMERIC : 0));
+    compiler_emit_short((uint16_t)size);
+    compiler_emit_long((uint32_t)low);
+
+    int table = chunk->count + 4;
+    int entry = dense ? 4 : 7;
+
+    for (int i = 0; i < 4 + size * entry; i++)
+        compiler_emit_byte(0xff);
+
+    for (int i = 0; i < count; i++)
     {
-        compiler_compile_expression(PARSER_CAR(expr), false);
-        if (!PARSER_IS_NULL(PARSER_CDR(expr)))
-            compiler_emit_byte(OP_POP);
+        int slot;
+
+        if (dense)
+            slot = (int)(VALUE_AS_FIXNUM(values[constants[i]]) - VALUE_AS_FIXNUM(values[low]));
+        else
+        {
+            slot = chunk_switch_hash(values[constants[i]]) & (size - 1);
+            while (((chunk->code[table + entry * slot] << 16) | (chunk->code[table + entry * slot + 1] << 8) |
+                    chunk->code[table + entry * slot + 2]) != CHUNK_SWITCH_EMPTY)
+                slot = (slot + 1) & (size - 1);
+
+            chunk->code[table + entry * slot] = (constants[i] >> 16) & 0xff;
+            chunk->code[table + entry * slot + 1] = (constants[i] >> 8) & 0xff;
+            chunk->code[table + entry * slot + 2] = constants[i] & 0xff;
+        }
+
+        handles[i] = compiler_add_jump(table + entry * slot + entry - 4, origin);
     }
 
-    // Set the return value at return index
-    compiler_emit_bytes(OP_SET_LOCAL, result);
+    int first_default = compiler_add_jump(table - 4, origin);
 
-    compiler_end_scope();
+    // The gaps of a dense table lead to the default as well.
+    for (int slot = 0; dense && slot < size; slot++)
+    {
+        bool taken = false;
+
+        for (int i = 0; i < count && !taken; i++)
+            taken = current->jumps[handles[i]].offset == table + entry * slot;
+
+        if (!taken)
+            compiler_add_jump(table + entry * slot, origin);
+    }
+
+    return first_default;
 }
 
-static void compiler_compile_begin_expression(const SExpr *sexpr, bool tail)
+// Compiles the clauses of a case or of a cond turned into one after the key
+// has been pushed. The clause owners[i] is taken for constants[i], and an
+// else clause, which may only come last, for any other key. The last
+// expression of each clause is in tail position if the switch is.
+static void compiler_compile_switch(const SExpr *clauses, const int *constants, const int *owners, int count,
+                                    bool numeric, bool tail)
 {
-    for (SExpr *expr = PARSER_CDR(sexpr); !PARSER_IS_NULL(expr); expr = PARSER_CDR(expr))
+    int *handles = MEMORY_ALLOCATE(int, count);
+    int first_default = compiler_emit_switch(constants, count, numeric, handles);
+    int last_default = current->jump_count;
+    bool has_else = false;
+
+    int clause_count = 0;
+    for (const SExpr *clause = clauses; !PARSER_IS_NULL(clause); clause = PARSER_CDR(clause))
+        clause_count++;
+
+    int *exits = MEMORY_ALLOCATE(int, clause_count);
+    int index = 0;
+
+    for (const SExpr *clause = clauses; !PARSER_IS_NULL(clause); clause = PARSER_CDR(clause), index++)
     {
-        if (!PARSER_IS_NULL(PARSER_CDR(expr)))
+        const SExpr *test = PARSER_CAAR(clause);
+
+        has_else = PARSER_IS_ATOM(test) && PARSER_AS_ATOM(test).type == TOKEN_ELSE;
+
+        if (has_else)
         {
-            compiler_compile_expression(PARSER_CAR(expr), false);
-            compiler_emit_byte(OP_POP);
+            for (int jump = first_default; jump < last_default; jump++)
+                compiler_patch_jump(jump);
+        }
+        for (int i = 0; i < count; i++)
+        {
+            if (owners[i] == index)
+                compiler_patch_jump(handles[i]);
         }
+
+        if (PARSER_IS_NULL(PARSER_CADR(clause)))
+            compiler_emit_byte(OP_TRUE);
         else
+            compiler_compile_begin_expression(PARSER_CAR(clause), tail);
+
+        exits[index] = has_else ? -1 : compiler_emit_jump(OP_JUMP);
+    }
+
+    if (!has_else)
+    {
+        for (int jump = first_default; jump < last_default; jump++)
+            compiler_patch_jump(jump);
+        compiler_emit_constant(VALUE_VOID_VAL);
+    }
+
+    for (int i = 0; i < clause_count; i++)
+    {
+        if (exits[i] != -1)
+            compiler_patch_jump(exits[i]);
+    }
+
+    MEMORY_FREE_ARRAY(int, exits, clause_count);
+    MEMORY_FREE_ARRAY(int, handles, count);
+}
+
+// Adds constant to the keys of a switch unless it's there already, in which
+// case an earlier clause takes it.
+static int compiler_add_switch_key(int *constants, int *owners, int count, int constant, int owner)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (constants[i] == constant)
+            return count;
+    }
+
+    constants[count] = constant;
+    owners[count] = owner;
+    return count + 1;
+}
+
+// Compiles (case key ((datum ...) expr ...) ... (else expr ...)) to a jump
+// table, the datums being compared with eqv?. The last expression of each
+// clause is in tail position.
+static void compiler_compile_case_expression(const SExpr *sexpr, bool tail)
+{
+    const SExpr *clauses = PARSER_CDDR(sexpr);
+    int capacity = 0;
+
+    for (const SExpr *clause = clauses; !PARSER_IS_NULL(clause); clause = PARSER_CDR(clause))
+    {
+        for (const SExpr *datum = PARSER_CAAR(clause); PARSER_IS_CONS(datum); datum = PARSER_CDR(datum))
+            capacity++;
+    }
+
+    compiler_compile_expression(PARSER_CDAR(sexpr), false);
+
+    int *constants = MEMORY_ALLOCATE(int, capacity);
+    int *owners = MEMORY_ALLOCATE(int, capacity);
+    int count = 0;
+    int index = 0;
+
+    for (const SExpr *clause = clauses; !PARSER_IS_NULL(clause); clause = PARSER_CDR(clause), index++)
+    {
+        for (const SExpr *datum = PARSER_CAAR(clause); PARSER_IS_CONS(datum); datum = PARSER_CDR(datum))
         {
-            compiler_compile_expression(PARSER_CAR(expr), tail);
+            int constant = compiler_datum_constant(PARSER_CAR(datum));
+
+            if (constant == -1)
+                compiler_failed("Unsupported datum in case clause.");
+            else
+                count = compiler_add_switch_key(constants, owners, count, constant, index);
         }
     }
+
+    compiler_compile_switch(clauses, constants, owners, count, false, tail);
+
+    MEMORY_FREE_ARRAY(int, constants, capacity);
+    MEMORY_FREE_ARRAY(int, owners, capacity);
 }
 
-static void compiler_compile_if_expression(const SExpr *sexpr)
+// The number literal of a test (= name k) or (= k name), or NULL. Sets name
+// to the other operand when it is a variable.
+static const SExpr *compiler_numeric_test(const SExpr *test, Token *name)
 {
-    SExpr *cond_expr, *then_expr, *else_expr;
+    if (!PARSER_IS_CONS(test) || !PARSER_IS_ATOM(PARSER_CAR(test)))
+        return NULL;
 
-    cond_expr = PARSER_CDAR(sexpr);
-    then_expr = PARSER_CDDAR(sexpr);
-    else_expr = PARSER_CDDDAR(sexpr);
+    Token operator = PARSER_AS_ATOM(PARSER_CAR(test));
+    const SExpr *operands = PARSER_CDR(test);
 
-    compiler_compile_expression(cond_expr, false);
+    if (operator.type != TOKEN_SYMBOL || operator.length != 1 || operator.start[0] != '=' ||
+        !PARSER_IS_CONS(operands) || !PARSER_IS_CONS(PARSER_CDR(operands)) ||
+        !PARSER_IS_NULL(PARSER_CDDR(operands)))
+        return NULL;
 
-    int then_jump = compiler_emit_jump(OP_JUMP_IF_FALSE);
+    const SExpr *left = PARSER_CAR(operands);
+    const SExpr *right = PARSER_CDAR(operands);
+
+    if (!PARSER_IS_ATOM(left) || !PARSER_IS_ATOM(right))
+        return NULL;
+
+    if (PARSER_AS_ATOM(left).type == TOKEN_SYMBOL && PARSER_AS_ATOM(right).type == TOKEN_NUMBER)
+    {
+        *name = PARSER_AS_ATOM(left);
+        return right;
+    }
+    if (PARSER_AS_ATOM(left).type == TOKEN_NUMBER && PARSER_AS_ATOM(right).type == TOKEN_SYMBOL)
+    {
+        *name = PARSER_AS_ATOM(right);
+        return left;
+    }
+
+    return NULL;
+}
+
+// Whether every test of a cond, but an else, compares one variable with a
+// number literal using =, the primitive. Sets name to that variable.
+static bool compiler_is_switch_cond(const SExpr *clauses, Token *name)
+{
+    int count = 0;
+
+    for (const SExpr *clause = clauses; !PARSER_IS_NULL(clause); clause = PARSER_CDR(clause))
+    {
+        const SExpr *test = PARSER_CAAR(clause);
+        Token variable;
+
+        if (PARSER_IS_ATOM(test) && PARSER_AS_ATOM(test).type == TOKEN_ELSE)
+            continue;
+
+        if (compiler_numeric_test(test, &variable) == NULL ||
+            (count > 0 && !compiler_identifiers_equal(name, &variable)))
+            return false;
+
+        *name = variable;
+        count++;
+    }
+
+    if (count < 2)
+        return false;
+
+    Token equal = PARSER_AS_ATOM(PARSER_CAAAR(clauses));
+    return compiler_resolve_primitive(&equal) != -1;
+}
+
+// Compiles (cond (test expr ...) ... (else expr ...)). The first clause whose
+// test isn't #f is taken, its value being the result if it has no
+// expressions. Tests of one variable against numbers use a jump table. The
+// last expression of each clause is in tail position.
+static void compiler_compile_cond_expression(const SExpr *sexpr, bool tail)
+{
+    const SExpr *clauses = PARSER_CDR(sexpr);
+    Token name;
+
+    if (compiler_is_switch_cond(clauses, &name))
+    {
+        int capacity = 0;
+        for (const SExpr *clause = clauses; !PARSER_IS_NULL(clause); clause = PARSER_CDR(clause))
+            capacity++;
+
+        int *constants = MEMORY_ALLOCATE(int, capacity);
+        int *owners = MEMORY_ALLOCATE(int, capacity);
+        int count = 0;
+        int index = 0;
+
+        compiler_compile_named_variable(name, false);
+
+        for (const SExpr *clause = clauses; !PARSER_IS_NULL(clause); clause = PARSER_CDR(clause), index++)
+        {
+            Token variable;
+            const SExpr *number = compiler_numeric_test(PARSER_CAAR(clause), &variable);
+
+            // = takes 2.0 for 2, so the key is looked up as 2.
+            if (number != NULL)
+            {
+                Value key = chunk_switch_number(compiler_number_value(PARSER_AS_ATOM(number)));
+                count = compiler_add_switch_key(constants, owners, count, compiler_make_constant(key), index);
+            }
+        }
+
+        compiler_compile_switch(clauses, constants, owners, count, true, tail);
+
+        MEMORY_FREE_ARRAY(int, constants, capacity);
+        MEMORY_FREE_ARRAY(int, owners, capacity);
+        return;
+    }
+
+    int count = 0;
+    for (const SExpr *clause = clauses; !PARSER_IS_NULL(clause); clause = PARSER_CDR(clause))
+        count++;
+
+    int *exits = MEMORY_ALLOCATE(int, count);
+    int exit_count = 0;
+    bool has_else = false;
+
+    for (const SExpr *clause = clauses; !PARSER_IS_NULL(clause); clause = PARSER_CDR(clause))
+    {
+        const SExpr *test = PARSER_CAAR(clause);
+
+        if (PARSER_IS_ATOM(test) && PARSER_AS_ATOM(test).type == TOKEN_ELSE)
+        {
+            compiler_compile_begin_expression(PARSER_CAR(clause), tail);
+            has_else = true;
+            break;
+        }
+
+        compiler_compile_expression(test, false);
+        int next_jump = compiler_emit_jump(OP_JUMP_IF_FALSE);
+
+        if (!PARSER_IS_NULL(PARSER_CADR(clause)))
+        {
+            compiler_emit_byte(OP_POP);
+            compiler_compile_begin_expression(PARSER_CAR(clause), tail);
+        }
+
+        exits[exit_count++] = compiler_emit_jump(OP_JUMP);
+        compiler_patch_jump(next_jump);
+        compiler_emit_byte(OP_POP);
+    }
+
+    if (!has_else)
+        compiler_emit_constant(VALUE_VOID_VAL);
+
+    for (int i = 0; i < exit_count; i++)
+        compiler_patch_jump(exits[i]);
+
+    MEMORY_FREE_ARRAY(int, exits, count);
+}
+
+// Compiles (and expr ...), which stops at the first expression that is #f,
+// leaving it as the result. The last expression is in tail position.
+static void compiler_compile_and_expression(const SExpr *sexpr, bool tail)
+{
+    const SExpr *expr = PARSER_CDR(sexpr);
+
+    if (PARSER_IS_NULL(expr))
+    {
+        compiler_emit_byte(OP_TRUE);
+        return;
+    }
+
+    int count = 0;
+    for (const SExpr *rest = PARSER_CDR(expr); !PARSER_IS_NULL(rest); rest = PARSER_CDR(rest))
+        count++;
+
+    int *exits = MEMORY_ALLOCATE(int, count);
+
+    for (int i = 0; i < count; i++, expr = PARSER_CDR(expr))
+    {
+        compiler_compile_expression(PARSER_CAR(expr), false);
+        exits[i] = compiler_emit_jump(OP_JUMP_IF_FALSE);
+        compiler_emit_byte(OP_POP);
+    }
+
+    compiler_compile_expression(PARSER_CAR(expr), tail);
+
+    for (int i = 0; i < count; i++)
+        compiler_patch_jump(exits[i]);
+
+    MEMORY_FREE_ARRAY(int, exits, count);
+}
+
+// Compiles (or expr ...), which stops at the first expression that isn't #f,
+// leaving it as the result. The last expression is in tail position.
+static void compiler_compile_or_expression(const SExpr *sexpr, bool tail)
+{
+    const SExpr *expr = PARSER_CDR(sexpr);
+
+    if (PARSER_IS_NULL(expr))
+    {
+        compiler_emit_byte(OP_FALSE);
+        return;
+    }
+
+    int count = 0;
+    for (const SExpr *rest = PARSER_CDR(expr); !PARSER_IS_NULL(rest); rest = PARSER_CDR(rest))
+        count++;
+
+    int *exits = MEMORY_ALLOCATE(int, count);
+
+    for (int i = 0; i < count; i++, expr = PARSER_CDR(expr))
+    {
+        compiler_compile_expression(PARSER_CAR(expr), false);
+        int next_jump = compiler_emit_jump(OP_JUMP_IF_FALSE);
+        exits[i] = compiler_emit_jump(OP_JUMP);
+        compiler_patch_jump(next_jump);
+        compiler_emit_byte(OP_POP);
+    }
+
+    compiler_compile_expression(PARSER_CAR(expr), tail);
+
+    for (int i = 0; i < count; i++)
+        compiler_patch_jump(exits[i]);
+
+    MEMORY_FREE_ARRAY(int, exits, count);
+}
+
+// Compiles (when test expr ...) and (unless test expr ...), whose value is
+// unspecified when the expressions are skipped. The last expression is in
+// tail position.
+static void compiler_compile_when_expression(const SExpr *sexpr, bool tail)
+{
+    bool when = PARSER_AS_ATOM(PARSER_CAR(sexpr)).type == TOKEN_WHEN;
+
+    compiler_compile_expression(PARSER_CDAR(sexpr), false);
+
+    int skip_jump = compiler_emit_jump(OP_JUMP_IF_FALSE);
     compiler_emit_byte(OP_POP);
 
-    compiler_compile_expression(then_expr, false);
+    if (when)
+        compiler_compile_begin_expression(PARSER_CDR(sexpr), tail);
+    else
+        compiler_emit_constant(VALUE_VOID_VAL);
 
-    int else_jump = compiler_emit_jump(OP_JUMP);
-    compiler_patch_jump(then_jump);
+    int exit_jump = compiler_emit_jump(OP_JUMP);
+    compiler_patch_jump(skip_jump);
     compiler_emit_byte(OP_POP);
 
-    compiler_compile_expression(else_expr, false);
+    if (when)
+        compiler_emit_constant(VALUE_VOID_VAL);
+    else
+        compiler_compile_begin_expression(PARSER_CDR(sexpr), tail);
 
-    compiler_patch_jump(else_jump);
+    compiler_patch_jump(exit_jump);
 }
 
 static void compiler_compile_call_cc_expression(const SExpr *sexpr)
@@ -602,20 +2726,45 @@ static void compiler_compile_call_cc_expression(const SExpr *sexpr)
 static void compiler_compile_application_expression(const SExpr *sexpr, bool tail)
 {
     const SExpr *expr = sexpr;
-    uint8_t arg_count = 0;
+    int arg_count = 0;
+    int line = compiler.line;
+
+    if (compiler_compile_loop_call(sexpr))
+        return;
+
+    if (compiler_compile_register_call(sexpr))
+        return;
+
+    if (compiler_compile_vector_call(sexpr))
+        return;
+
+    if (compiler_compile_inline_call(sexpr, tail))
+        return;
 
-    compiler_compile_expression(PARSER_CAR(expr), false);
+    // A lambda that is applied right away can't escape, unless the call is
+    // a tail call which releases the frame.
+    if (!tail && compiler_is_lambda(PARSER_CAR(expr)))
+        compiler_compile_lambda_expression(PARSER_CAR(expr), true);
+    else
+        compiler_compile_expression(PARSER_CAR(expr), false);
+    compiler_add_temporary();
 
     for (expr = PARSER_CDR(expr); !PARSER_IS_NULL(expr); expr = PARSER_CDR(expr))
     {
         compiler_compile_expression(PARSER_CAR(expr), false);
-
-        if (arg_count >= 255)
-            compiler_failed("Can't have more than 255 arguments.");
+        compiler_add_temporary();
         arg_count++;
     }
 
-    compiler_emit_bytes((tail ? OP_TAIL_CALL : OP_CALL), arg_count);
+    if (arg_count > 255)
+        compiler_failed("Can't have more than 255 arguments.");
+
+    // The call replaces the temporaries with its result.
+    current->local_count -= arg_count + 1;
+
+    // Errors in the call are reported at the line of the operator.
+    compiler.line = line;
+    compiler_emit_bytes((tail ? OP_TAIL_CALL : OP_CALL), (uint8_t)arg_count);
 }
 
 static void compiler_compile_compound_expression(const SExpr *sexpr, bool tail)
@@ -623,19 +2772,41 @@ static void compiler_compile_compound_expression(const SExpr *sexpr, bool tail)
     switch (PARSER_AS_ATOM(PARSER_CAR(sexpr)).type)
     {
     case TOKEN_LAMBDA:
-        compiler_compile_lambda_expression(sexpr);
+        compiler_compile_lambda_expression(sexpr, false);
         break;
     case TOKEN_SET:
         compiler_compile_set_expression(sexpr);
         break;
     case TOKEN_LET:
-        compiler_compile_let_expression(sexpr, tail);
+        if (PARSER_IS_ATOM(PARSER_CDAR(sexpr)))
+            compiler_compile_named_let_expression(sexpr);
+        else
+            compiler_compile_let_expression(sexpr, tail);
+        break;
+    case TOKEN_DO:
+        compiler_compile_do_expression(sexpr);
         break;
     case TOKEN_BEGIN:
         compiler_compile_begin_expression(sexpr, tail);
         break;
     case TOKEN_IF:
-        compiler_compile_if_expression(sexpr);
+        compiler_compile_if_expression(sexpr, tail);
+        break;
+    case TOKEN_CASE:
+        compiler_compile_case_expression(sexpr, tail);
+        break;
+    case TOKEN_COND:
+        compiler_compile_cond_expression(sexpr, tail);
+        break;
+    case TOKEN_AND:
+        compiler_compile_and_expression(sexpr, tail);
+        break;
+    case TOKEN_OR:
+        compiler_compile_or_expression(sexpr, tail);
+        break;
+    case TOKEN_WHEN:
+    case TOKEN_UNLESS:
+        compiler_compile_when_expression(sexpr, tail);
         break;
     case TOKEN_CALL_CC:
         compiler_compile_call_cc_expression(sexpr);
@@ -650,6 +2821,9 @@ static void compiler_compile_expression(const SExpr *sexpr, bool tail)
 {
     if (PARSER_IS_CONS(sexpr))
     {
+        if (PARSER_IS_ATOM(PARSER_CAR(sexpr)))
+            compiler.line = PARSER_AS_ATOM(PARSER_CAR(sexpr)).line;
+
         compiler_compile_compound_expression(sexpr, tail);
     }
     else
@@ -669,10 +2843,43 @@ static void compiler_define_variable(const int global)
     compiler_emit_short((uint16_t)global);
 }
 
-static void compiler_compile_define(const SExpr *sexpr)
+static void compiler_compile_define(const SExpr *sexpr, const SExpr *scope)
 {
-    int var = compiler_declare_variable(PARSER_AS_ATOM(PARSER_CDAR(sexpr)));
-    compiler_compile_expression(PARSER_CDDAR(sexpr), false);
+    Token name = PARSER_AS_ATOM(PARSER_CDAR(sexpr));
+    const SExpr *value = PARSER_CDDAR(sexpr);
+    bool fresh = current->scope_depth == 0 && compiler_resolve_global(current, &name) == -1;
+    int var = -1;
+    int start = compiler_current_chunk()->count;
+
+    // A local is only declared once its value is on the stack, so that any
+    // locals of the initializer take the slots below it, unless the value is
+    // a lambda, whose locals live in a frame of their own.
+    if (current->scope_depth == 0 || compiler_is_lambda(value))
+        var = compiler_declare_variable(name, scope);
+
+    if (scope != NULL && compiler_is_lambda(value) && compiler_is_only_called(scope, &name))
+        compiler_compile_lambda_expression(value, true);
+    else if (current->scope_depth == 0 && compiler_is_lambda(value))
+    {
+        ObjFunction *function = compiler_compile_lazy_lambda(value);
+
+        if (function == NULL)
+            function = compiler_compile_lambda_expression(value, false);
+
+        // The locals of internal definitions stay below the result when
+        // the body returns, and a copy of it wouldn't pop them.
+        if (!compiler_is_definition(PARSER_CAR(PARSER_CDDR(value))))
+            compiler_add_inline(var, function, fresh);
+    }
+    else
+        compiler_compile_expression(value, false);
+
+    if (current->scope_depth > 0 && !compiler_is_lambda(value))
+        var = compiler_declare_variable(name, scope);
+
+    if (current->scope_depth == 0)
+        compiler_define_constant(&name, var, fresh, start);
+
     compiler_define_variable(var);
 }
 
@@ -681,7 +2888,9 @@ static void compiler_compile_definition(const SExpr *sexpr)
     switch (PARSER_AS_ATOM(PARSER_CAR(sexpr)).type)
     {
     case TOKEN_DEFINE:
-        compiler_compile_define(sexpr);
+        compiler_compile_define(sexpr, NULL);
+        break;
+    default:
         break;
     }
 }
@@ -702,29 +2911,55 @@ ObjFunction *compiler_compile(const char *source)
 {
     SExpr *sexpr;
     Environment env;
+    ParseResult result;
+    int form_count = 0;
+    int inline_count = compiler.inline_count;
+
+    if (!compiler.partial && !compiler_scan_program(source))
+    {
+        compiler.definition_count = 0;
+        return NULL;
+    }
+
+    // Kept after the names are gone, for procedures compiled on first call.
+    compiler_record_redefined();
+
     parser_init_parser(source);
     compiler_init_environment(&env, TYPE_SCRIPT);
 
     compiler.failed = false;
+    compiler.line = 0;
 
-    ParseResult result = parser_parse(&sexpr);
-
-    if (result == PARSER_OK)
+    // Each form is compiled before the next one is parsed, since parsing
+    // reuses the s-expression storage. Every form leaves its value on the
+    // stack; only the last one is kept as the result of the script.
+    while ((result = parser_parse(&sexpr)) == PARSER_OK)
     {
 #ifdef DEBUG_PRINT_CODE
         printf("\ns-expr: ");
         debug_disassemble_sexpression(sexpr);
         printf("\n\n");
 #endif
+        if (form_count++ > 0)
+            compiler_emit_byte(OP_POP);
+
         compiler_compile_form(sexpr);
-        ObjFunction *function = compiler_end_environment();
-        // parser_free_sexpr();
+    }
 
-        if (!compiler.failed)
-        {
-            return function;
-        }
+    ObjFunction *function = compiler_end_environment();
+    compiler_free_environment(&env);
+    // parser_free_sexpr();
+
+    // The names point into source, which doesn't outlive the compilation.
+    compiler.definition_count = 0;
+
+    if (result == PARSER_EOF && form_count > 0 && !compiler.failed)
+    {
+        return function;
     }
+
+    // Procedures of a script that fails to compile never get defined.
+    compiler.inline_count = inline_count;
     return NULL;
 }
 
@@ -737,4 +2972,34 @@ void compiler_mark_compiler_roots()
         memory_mark_object((Obj *)env->function);
         env = env->enclosing;
     }
+
+    for (int i = 0; i < compiler.inline_count; i++)
+    {
+        memory_mark_object((Obj *)compiler.inlines[i].function);
+    }
+
+    for (int i = 0; i < compiler.definition_count; i++)
+    {
+        memory_mark_value(compiler.definitions[i].value);
+    }
+}
+
+void compiler_set_whole_program(bool whole)
+{
+    compiler.partial = !whole;
+}
+
+bool compiler_is_whole_program()
+{
+    return !compiler.partial;
+}
+
+void compiler_set_register_code(bool registers)
+{
+    compiler.registers = registers;
+}
+
+bool compiler_is_register_code()
+{
+    return compiler.registers;
 }
\ No newline at end of file
@@ -4,6 +4,20 @@
 #include <vm/vm.h>
 
 ObjFunction *compiler_compile(const char *source);
+bool compiler_compile_lazy(ObjFunction *function);
 void compiler_mark_compiler_roots();
 
+// By default each compiled source is taken to be the whole program, so that
+// globals it defines once and never assigns are treated as constants. Code
+// that other sources are compiled against later, as at the REPL or in an
+// image, must be compiled with this turned off.
+void compiler_set_whole_program(bool whole);
+bool compiler_is_whole_program();
+
+// Off by default. When on, calls of the arithmetic and comparison primitives
+// with two arguments compile to three-address instructions on frame slots,
+// provided the whole program leaves the primitives alone.
+void compiler_set_register_code(bool registers);
+bool compiler_is_register_code();
+
 #endif
\ No newline at end of file
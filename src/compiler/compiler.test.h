@@ -2,7 +2,127 @@
 #define _COMPILER_TEST_H
 
 #include <compiler/compiler.h>
+#include <chunk/chunk.h>
+#include <table/table.h>
+#include <vm/vm.h>
 #include <CUnit/Basic.h>
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// How many instructions of the chunk are op.
+static int compiler_test_count(Chunk *chunk, OpCode op)
+{
+    int count = 0;
+
+    for (int offset = 0; offset < chunk->count; offset += chunk_instruction_size(chunk, offset))
+    {
+        if (chunk->code[offset] == op)
+            count++;
+    }
+
+    return count;
+}
+
+// Compiles and runs source, and returns the value of its global result.
+static Value compiler_test_run(const char *source, ObjFunction **script)
+{
+    *script = compiler_compile(source);
+
+    if (*script == NULL)
+        return VALUE_VOID_VAL;
+
+    vm_push(VALUE_OBJ_VAL(*script));
+    InterpretResult result = vm_interpret_function(*script);
+    vm_pop();
+
+    int slot = table_find_entry(&vm.globals, "result", 6);
+    return result != VM_OK || slot == -1 ? VALUE_VOID_VAL : table_get(&vm.globals, slot);
+}
+
+void compiler_long_constant_test()
+{
+    char *source = (char *)malloc(8192);
+    int length = sprintf(source, "(define result (- (+");
+    int64_t expected = 0;
+
+    // 400 constants, twice as many as a byte can index
+    for (int i = 1000; i < 1400; i++)
+    {
+        length += sprintf(source + length, " %d%s", i, i == 1199 ? ") (+" : "");
+        expected += i < 1200 ? i : -i;
+    }
+    sprintf(source + length, ")))");
+
+    vm_init_vm();
+
+    ObjFunction *script;
+    Value result = compiler_test_run(source, &script);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(script);
+    CU_ASSERT_TRUE(compiler_test_count(&script->chunk, OP_CONSTANT) > 0);
+    CU_ASSERT_TRUE(compiler_test_count(&script->chunk, OP_CONSTANT_LONG) > 0);
+    CU_ASSERT_TRUE(VALUE_IS_FIXNUM(result));
+    CU_ASSERT_EQUAL(VALUE_AS_FIXNUM(result), expected);
+
+    vm_free_vm();
+    free(source);
+}
+
+void compiler_long_local_test()
+{
+    char *source = (char *)malloc(8192);
+    int length = sprintf(source, "(define result (let (");
+
+    // 300 locals, so the last ones are past a byte's reach
+    for (int i = 0; i < 300; i++)
+        length += sprintf(source + length, "(a%d %d) ", i, i);
+    sprintf(source + length, ") (+ a0 a150 a299)))");
+
+    vm_init_vm();
+
+    ObjFunction *script;
+    Value result = compiler_test_run(source, &script);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(script);
+    CU_ASSERT_TRUE(compiler_test_count(&script->chunk, OP_GET_LOCAL) > 0);
+    CU_ASSERT_TRUE(compiler_test_count(&script->chunk, OP_GET_LOCAL_LONG) > 0);
+    CU_ASSERT_TRUE(VALUE_IS_FIXNUM(result));
+    CU_ASSERT_EQUAL(VALUE_AS_FIXNUM(result), 449);
+
+    vm_free_vm();
+    free(source);
+}
+
+void compiler_long_jump_test()
+{
+    const char *branch = " (+ k k k k)";
+    int repeats = 8000;
+    char *source = (char *)malloc(strlen(branch) * repeats + 256);
+
+    // The first branch is too long for a 16-bit jump, the second is short
+    int length = sprintf(source, "(define k 1)\n(define x 1)\n(define result (+ (if (= x 1) (begin");
+    for (int i = 0; i < repeats; i++)
+        length += sprintf(source + length, "%s", branch);
+    sprintf(source + length, " 10) 20) (if (= x 2) 100 200)))");
+
+    vm_init_vm();
+
+    ObjFunction *script;
+    Value result = compiler_test_run(source, &script);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(script);
+    CU_ASSERT_TRUE(script->chunk.count > UINT16_MAX);
+    CU_ASSERT_TRUE(compiler_test_count(&script->chunk, OP_JUMP_LONG) +
+                       compiler_test_count(&script->chunk, OP_POP_JUMP_IF_FALSE_LONG) +
+                       compiler_test_count(&script->chunk, OP_JUMP_IF_FALSE_LONG) >
+                   0);
+    CU_ASSERT_TRUE(compiler_test_count(&script->chunk, OP_JUMP) + compiler_test_count(&script->chunk, OP_POP_JUMP_IF_FALSE) +
+                       compiler_test_count(&script->chunk, OP_JUMP_IF_FALSE) >
+                   0);
+    CU_ASSERT_TRUE(VALUE_IS_FIXNUM(result));
+    CU_ASSERT_EQUAL(VALUE_AS_FIXNUM(result), 210);
+
+    vm_free_vm();
+    free(source);
+}
 
 #endif
\ No newline at end of file
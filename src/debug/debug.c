@@ -27,6 +27,18 @@ static int debug_constant_instruction(const char *name, Chunk *chunk,
     return offset + 2;
 }
 
+static int debug_constant_long_instruction(const char *name, Chunk *chunk,
+                                           int offset)
+{
+    uint32_t constant = (chunk->code[offset + 1] << 16) |
+                        (chunk->code[offset + 2] << 8) |
+                        chunk->code[offset + 3];
+    printf("%-16s %4u '", name, (unsigned)constant);
+    value_print_value(chunk->constants.values[constant]);
+    printf("'\n");
+    return offset + 4;
+}
+
 static int debug_simple_instruction(const char *name, int offset)
 {
     printf("%s\n", name);
@@ -48,6 +60,29 @@ static int debug_short_instruction(const char *name, Chunk *chunk, int offset)
     return offset + 3;
 }
 
+static void debug_register_operand(Chunk *chunk, uint8_t operand)
+{
+    if (operand & CHUNK_REGISTER_CONSTANT)
+    {
+        printf(" '");
+        value_print_value(chunk->constants.values[operand & CHUNK_REGISTER_MAX]);
+        printf("'");
+    }
+    else
+    {
+        printf(" [%d]", operand);
+    }
+}
+
+static int debug_register_instruction(const char *name, Chunk *chunk, int offset)
+{
+    printf("%-16s %4d <-", name, chunk->code[offset + 1]);
+    debug_register_operand(chunk, chunk->code[offset + 2]);
+    debug_register_operand(chunk, chunk->code[offset + 3]);
+    printf("\n");
+    return offset + 4;
+}
+
 static int debug_jump_instruction(const char *name, int sign,
                                   Chunk *chunk, int offset)
 {
@@ -57,18 +92,120 @@ static int debug_jump_instruction(const char *name, int sign,
     return offset + 3;
 }
 
+static int debug_jump_long_instruction(const char *name, int sign,
+                                       Chunk *chunk, int offset)
+{
+    uint32_t jump = (chunk->code[offset + 1] << 16) |
+                    (chunk->code[offset + 2] << 8) |
+                    chunk->code[offset + 3];
+    printf("%-16s %4d -> %d\n", name, offset, offset + 4 + sign * (int)jump);
+    return offset + 4;
+}
+
+static int debug_closure_instruction(const char *name, Chunk *chunk,
+                                     int offset, bool wide, bool stack)
+{
+    uint32_t constant;
+    int slot = 0;
+
+    offset++;
+    if (wide)
+    {
+        constant = (chunk->code[offset] << 16) |
+                   (chunk->code[offset + 1] << 8) |
+                   chunk->code[offset + 2];
+        offset += 3;
+    }
+    else
+    {
+        constant = chunk->code[offset++];
+    }
+
+    if (stack)
+    {
+        slot = (chunk->code[offset] << 8) | chunk->code[offset + 1];
+        offset += 2;
+    }
+
+    printf("%-16s %4u ", name, (unsigned)constant);
+    value_print_value(chunk->constants.values[constant]);
+    if (stack)
+        printf(" arena %d", slot);
+    printf("\n");
+
+    ObjFunction *function = OBJECT_AS_FUNCTION(
+        chunk->constants.values[constant]);
+    for (int j = 0; j < function->upvalue_count; j++)
+    {
+        int start = offset;
+        int flags = chunk->code[offset++];
+        int index = chunk->code[offset++];
+
+        if (wide)
+            index = (index << 8) | chunk->code[offset++];
+
+        printf("%04d    |                     %s %d%s\n",
+               start, (flags & CHUNK_CAPTURE_LOCAL) ? "local" : "upvalue", index,
+               (flags & CHUNK_CAPTURE_BOXED) ? " boxed" : "");
+    }
+
+    return offset;
+}
+
+static int debug_read_u32(Chunk *chunk, int offset)
+{
+    return (chunk->code[offset] << 24) | (chunk->code[offset + 1] << 16) |
+           (chunk->code[offset + 2] << 8) | chunk->code[offset + 3];
+}
+
+static int debug_switch_instruction(const char *name, Chunk *chunk, int offset)
+{
+    bool dense = CHUNK_SWITCH_IS_DENSE(chunk->code[offset + 1]);
+    int size = (chunk->code[offset + 2] << 8) | chunk->code[offset + 3];
+    int low = (chunk->code[offset + 4] << 16) | (chunk->code[offset + 5] << 8) | chunk->code[offset + 6];
+    int entry = offset + CHUNK_SWITCH_HEADER;
+
+    printf("%-16s %4d %s %d default -> %d\n", name, offset, dense ? "dense" : "hashed",
+           size, offset + debug_read_u32(chunk, offset + 7));
+
+    for (int i = 0; i < size; i++)
+    {
+        if (dense)
+        {
+            printf("%04d    |                     ", entry);
+            value_print_value(VALUE_FIXNUM_VAL(VALUE_AS_FIXNUM(chunk->constants.values[low]) + i));
+            printf(" -> %d\n", offset + debug_read_u32(chunk, entry));
+            entry += 4;
+            continue;
+        }
+
+        int constant = (chunk->code[entry] << 16) | (chunk->code[entry + 1] << 8) | chunk->code[entry + 2];
+
+        if (constant != CHUNK_SWITCH_EMPTY)
+        {
+            printf("%04d    |                     ", entry);
+            value_print_value(chunk->constants.values[constant]);
+            printf(" -> %d\n", offset + debug_read_u32(chunk, entry + 3));
+        }
+        entry += 7;
+    }
+
+    return entry;
+}
+
 int debug_disassemble_instruction(Chunk *chunk, int offset)
 {
     printf("%04d ", offset);
 
-    if (offset > 0 &&
-        chunk->lines[offset] == chunk->lines[offset - 1])
+    int line = chunk_get_line(chunk, offset);
+
+    if (offset > 0 && line == chunk_get_line(chunk, offset - 1))
     {
         printf("   | ");
     }
     else
     {
-        printf("%4d ", chunk->lines[offset]);
+        printf("%4d ", line);
     }
 
     uint8_t instruction = chunk->code[offset];
@@ -76,6 +213,8 @@ int debug_disassemble_instruction(Chunk *chunk, int offset)
     {
     case OP_CONSTANT:
         return debug_constant_instruction("OP_CONSTANT", chunk, offset);
+    case OP_CONSTANT_LONG:
+        return debug_constant_long_instruction("OP_CONSTANT_LONG", chunk, offset);
     case OP_NULL:
         return debug_simple_instruction("OP_NULL", offset);
     case OP_TRUE:
@@ -84,50 +223,106 @@ int debug_disassemble_instruction(Chunk *chunk, int offset)
         return debug_simple_instruction("OP_FALSE", offset);
     case OP_POP:
         return debug_simple_instruction("OP_POP", offset);
+    case OP_POPN:
+        return debug_byte_instruction("OP_POPN", chunk, offset);
     case OP_GET_LOCAL:
         return debug_byte_instruction("OP_GET_LOCAL", chunk, offset);
+    case OP_GET_LOCAL_LONG:
+        return debug_short_instruction("OP_GET_LOCAL_LONG", chunk, offset);
     case OP_SET_LOCAL:
         return debug_byte_instruction("OP_SET_LOCAL", chunk, offset);
+    case OP_SET_LOCAL_LONG:
+        return debug_short_instruction("OP_SET_LOCAL_LONG", chunk, offset);
     case OP_GET_GLOBAL:
         return debug_short_instruction("OP_GET_GLOBAL", chunk, offset);
     case OP_SET_GLOBAL:
         return debug_short_instruction("OP_SET_GLOBAL", chunk, offset);
+    case OP_GLOBAL_UNCHANGED:
+        return debug_short_instruction("OP_GLOBAL_UNCHANGED", chunk, offset);
     case OP_GET_UPVALUE:
         return debug_byte_instruction("OP_GET_UPVALUE", chunk, offset);
+    case OP_GET_UPVALUE_LONG:
+        return debug_short_instruction("OP_GET_UPVALUE_LONG", chunk, offset);
+    case OP_GET_BOXED_UPVALUE:
+        return debug_byte_instruction("OP_GET_BOXED_UPVALUE", chunk, offset);
+    case OP_GET_BOXED_UPVALUE_LONG:
+        return debug_short_instruction("OP_GET_BOXED_UPVALUE_LONG", chunk, offset);
     case OP_SET_UPVALUE:
         return debug_byte_instruction("OP_SET_UPVALUE", chunk, offset);
+    case OP_SET_UPVALUE_LONG:
+        return debug_short_instruction("OP_SET_UPVALUE_LONG", chunk, offset);
+    case OP_ADD:
+        return debug_register_instruction("OP_ADD", chunk, offset);
+    case OP_SUBTRACT:
+        return debug_register_instruction("OP_SUBTRACT", chunk, offset);
+    case OP_MULTIPLY:
+        return debug_register_instruction("OP_MULTIPLY", chunk, offset);
+    case OP_EQUAL:
+        return debug_register_instruction("OP_EQUAL", chunk, offset);
+    case OP_LESS:
+        return debug_register_instruction("OP_LESS", chunk, offset);
+    case OP_GREATER:
+        return debug_register_instruction("OP_GREATER", chunk, offset);
+    case OP_LESS_EQUAL:
+        return debug_register_instruction("OP_LESS_EQUAL", chunk, offset);
+    case OP_GREATER_EQUAL:
+        return debug_register_instruction("OP_GREATER_EQUAL", chunk, offset);
+    case OP_ADD_UNCHECKED:
+        return debug_register_instruction("OP_ADD_UNCHECKED", chunk, offset);
+    case OP_SUBTRACT_UNCHECKED:
+        return debug_register_instruction("OP_SUBTRACT_UNCHECKED", chunk, offset);
+    case OP_MULTIPLY_UNCHECKED:
+        return debug_register_instruction("OP_MULTIPLY_UNCHECKED", chunk, offset);
+    case OP_EQUAL_UNCHECKED:
+        return debug_register_instruction("OP_EQUAL_UNCHECKED", chunk, offset);
+    case OP_LESS_UNCHECKED:
+        return debug_register_instruction("OP_LESS_UNCHECKED", chunk, offset);
+    case OP_GREATER_UNCHECKED:
+        return debug_register_instruction("OP_GREATER_UNCHECKED", chunk, offset);
+    case OP_LESS_EQUAL_UNCHECKED:
+        return debug_register_instruction("OP_LESS_EQUAL_UNCHECKED", chunk, offset);
+    case OP_GREATER_EQUAL_UNCHECKED:
+        return debug_register_instruction("OP_GREATER_EQUAL_UNCHECKED", chunk, offset);
+    case OP_VECTOR_REF:
+        return debug_byte_instruction("OP_VECTOR_REF", chunk, offset);
+    case OP_VECTOR_SET:
+        return debug_byte_instruction("OP_VECTOR_SET", chunk, offset);
     case OP_JUMP:
         return debug_jump_instruction("OP_JUMP", 1, chunk, offset);
+    case OP_JUMP_LONG:
+        return debug_jump_long_instruction("OP_JUMP_LONG", 1, chunk, offset);
     case OP_JUMP_IF_FALSE:
         return debug_jump_instruction("OP_JUMP_IF_FALSE", 1, chunk, offset);
+    case OP_JUMP_IF_FALSE_LONG:
+        return debug_jump_long_instruction("OP_JUMP_IF_FALSE_LONG", 1, chunk, offset);
+    case OP_POP_JUMP_IF_FALSE:
+        return debug_jump_instruction("OP_POP_JUMP_IF_FALSE", 1, chunk, offset);
+    case OP_POP_JUMP_IF_FALSE_LONG:
+        return debug_jump_long_instruction("OP_POP_JUMP_IF_FALSE_LONG", 1, chunk, offset);
+    case OP_LOOP:
+        return debug_jump_instruction("OP_LOOP", -1, chunk, offset);
+    case OP_SWITCH:
+        return debug_switch_instruction("OP_SWITCH", chunk, offset);
+    case OP_LOOP_LONG:
+        return debug_jump_long_instruction("OP_LOOP_LONG", -1, chunk, offset);
     case OP_CALL:
         return debug_byte_instruction("OP_CALL", chunk, offset);
     case OP_TAIL_CALL:
         return debug_byte_instruction("OP_TAIL_CALL", chunk, offset);
     case OP_CLOSURE:
-    {
-        offset++;
-        uint8_t constant = chunk->code[offset++];
-        printf("%-16s %4d ", "OP_CLOSURE", constant);
-        value_print_value(chunk->constants.values[constant]);
-        printf("\n");
-
-        ObjFunction *function = OBJECT_AS_FUNCTION(
-            chunk->constants.values[constant]);
-        for (int j = 0; j < function->upvalue_count; j++)
-        {
-            int is_local = chunk->code[offset++];
-            int index = chunk->code[offset++];
-            printf("%04d    |                     %s %d\n",
-                   offset - 2, is_local ? "local" : "upvalue", index);
-        }
-
-        return offset;
-    }
+        return debug_closure_instruction("OP_CLOSURE", chunk, offset, false, false);
+    case OP_CLOSURE_LONG:
+        return debug_closure_instruction("OP_CLOSURE_LONG", chunk, offset, true, false);
+    case OP_STACK_CLOSURE:
+        return debug_closure_instruction("OP_STACK_CLOSURE", chunk, offset, false, true);
+    case OP_STACK_CLOSURE_LONG:
+        return debug_closure_instruction("OP_STACK_CLOSURE_LONG", chunk, offset, true, true);
     case OP_CONTINUATION:
         return debug_simple_instruction("OP_CONTINUATION", offset);
     case OP_CLOSE_UPVALUE:
         return debug_simple_instruction("OP_CLOSE_UPVALUE", offset);
+    case OP_CLOSE_LOCAL:
+        return debug_short_instruction("OP_CLOSE_LOCAL", chunk, offset);
     case OP_RETURN:
         return debug_simple_instruction("OP_RETURN", offset);
     default:
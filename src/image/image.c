@@ -0,0 +1,676 @@
+#include <image/image.h>
+#include <serialize/serialize.h>
+#include <memory/memory.h>
+#include <object/object.h>
+#include <table/table.h>
+#include <vm/vm.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define IMAGE_MAGIC 0x474d494cu // "LIMG"
+#define IMAGE_NO_OBJECT 0xffffffffu
+
+// An image is a snapshot of every object reachable from the globals. Objects
+// are written as a table, sorted so that a closure's function is always
+// allocated before the closure itself, followed by a second pass holding the
+// references between them. Globals are written in slot order, so the slots
+// compiled into the bytecode stay valid without relinking.
+
+typedef enum
+{
+    IMAGE_TAG_NULL,
+    IMAGE_TAG_VOID,
+    IMAGE_TAG_FALSE,
+    IMAGE_TAG_TRUE,
+    IMAGE_TAG_FLONUM,
+    IMAGE_TAG_FIXNUM,
+    IMAGE_TAG_OBJECT,
+} ImageTag;
+
+// Maps each object to its index in the image. Lives outside the collected
+// heap, so dumping never triggers a garbage collection.
+typedef struct
+{
+    Obj **keys;
+    uint32_t *indices;
+    uint32_t capacity;
+    uint32_t count;
+} ImageMap;
+
+typedef struct
+{
+    Writer writer;
+    ImageMap map;
+    Obj **objects;
+    uint32_t count;
+    uint32_t capacity;
+} ImageWriter;
+
+typedef struct
+{
+    Reader reader;
+    Obj **objects;
+    uint32_t count;
+} ImageReader;
+
+/* Object map */
+
+static uint32_t image_hash_pointer(Obj *object)
+{
+    uint64_t hash = (uint64_t)(uintptr_t)object * 0x9e3779b97f4a7c15u;
+    return (uint32_t)(hash >> 32);
+}
+
+static uint32_t image_map_find(ImageMap *map, Obj *object)
+{
+    uint32_t bucket = image_hash_pointer(object) & (map->capacity - 1);
+
+    while (map->keys[bucket] != NULL && map->keys[bucket] != object)
+        bucket = (bucket + 1) & (map->capacity - 1);
+
+    return bucket;
+}
+
+static void image_map_grow(ImageMap *map)
+{
+    ImageMap grown;
+    grown.capacity = map->capacity < 64 ? 64 : map->capacity * 2;
+    grown.count = map->count;
+    grown.keys = (Obj **)calloc(grown.capacity, sizeof(Obj *));
+    grown.indices = (uint32_t *)malloc(grown.capacity * sizeof(uint32_t));
+
+    if (grown.keys == NULL || grown.indices == NULL)
+        exit(1);
+
+    for (uint32_t i = 0; i < map->capacity; i++)
+    {
+        if (map->keys[i] == NULL)
+            continue;
+
+        uint32_t bucket = image_map_find(&grown, map->keys[i]);
+        grown.keys[bucket] = map->keys[i];
+        grown.indices[bucket] = map->indices[i];
+    }
+
+    free(map->keys);
+    free(map->indices);
+    *map = grown;
+}
+
+// Returns false if the object was already in the map.
+static bool image_map_insert(ImageMap *map, Obj *object, uint32_t index)
+{
+    if ((map->count + 1) * 2 > map->capacity)
+        image_map_grow(map);
+
+    uint32_t bucket = image_map_find(map, object);
+
+    if (map->keys[bucket] != NULL)
+        return false;
+
+    map->keys[bucket] = object;
+    map->indices[bucket] = index;
+    map->count++;
+    return true;
+}
+
+static uint32_t image_map_get(ImageMap *map, Obj *object)
+{
+    if (object == NULL)
+        return IMAGE_NO_OBJECT;
+
+    return map->indices[image_map_find(map, object)];
+}
+
+/* Dumping */
+
+static void image_add_object(ImageWriter *image, Obj *object)
+{
+    if (object == NULL || !image_map_insert(&image->map, object, image->count))
+        return;
+
+    if (image->count == image->capacity)
+    {
+        image->capacity = image->capacity < 64 ? 64 : image->capacity * 2;
+        image->objects = (Obj **)realloc(image->objects, image->capacity * sizeof(Obj *));
+
+        if (image->objects == NULL)
+            exit(1);
+    }
+
+    image->objects[image->count++] = object;
+}
+
+static void image_add_value(ImageWriter *image, Value value)
+{
+    if (VALUE_IS_OBJ(value))
+        image_add_object(image, VALUE_AS_OBJ(value));
+}
+
+// Collects everything reachable from the globals, breadth first.
+static bool image_collect(ImageWriter *image)
+{
+    for (int slot = 0; slot < vm.globals.count; slot++)
+    {
+        image_add_object(image, (Obj *)vm.globals.entries[slot].key);
+        image_add_value(image, vm.globals.values[slot]);
+    }
+
+    for (uint32_t i = 0; i < image->count; i++)
+    {
+        Obj *object = image->objects[i];
+
+        switch (object->type)
+        {
+        case OBJ_CLOSURE:
+        {
+            ObjClosure *closure = (ObjClosure *)object;
+            image_add_object(image, (Obj *)closure->function);
+            for (int j = 0; j < closure->upvalue_count; j++)
+                image_add_value(image, closure->upvalues[j]);
+            break;
+        }
+        case OBJ_FUNCTION:
+        {
+            ValueArray *constants = &((ObjFunction *)object)->chunk.constants;
+            for (int j = 0; j < constants->count; j++)
+                image_add_value(image, constants->values[j]);
+            break;
+        }
+        case OBJ_UPVALUE:
+        {
+            ObjUpvalue *upvalue = (ObjUpvalue *)object;
+
+            if (upvalue->location != &upvalue->closed)
+            {
+                fprintf(stderr, "Cannot dump an image while a procedure is running.\n");
+                return false;
+            }
+
+            image_add_value(image, upvalue->closed);
+            break;
+        }
+        case OBJ_CONTINUATION:
+            fprintf(stderr, "Cannot dump a continuation into an image.\n");
+            return false;
+        case OBJ_BIGNUM:
+        case OBJ_VECTOR:
+        case OBJ_NATIVE:
+        case OBJ_STRING:
+            break;
+        }
+    }
+
+    return true;
+}
+
+// Strings, bignums, vectors and natives first, then functions, upvalues and
+// finally closures, which need their function to be allocated.
+static int image_type_rank(ObjType type)
+{
+    switch (type)
+    {
+    case OBJ_BIGNUM:
+    case OBJ_VECTOR:
+    case OBJ_STRING:
+        return 0;
+    case OBJ_NATIVE:
+        return 1;
+    case OBJ_FUNCTION:
+        return 2;
+    case OBJ_UPVALUE:
+        return 3;
+    case OBJ_CLOSURE:
+        return 4;
+    default:
+        return 5;
+    }
+}
+
+static void image_sort(ImageWriter *image)
+{
+    Obj **sorted = (Obj **)malloc((image->count + 1) * sizeof(Obj *));
+    uint32_t count = 0;
+
+    if (sorted == NULL)
+        exit(1);
+
+    for (int rank = 0; rank < 5; rank++)
+    {
+        for (uint32_t i = 0; i < image->count; i++)
+        {
+            if (image_type_rank(image->objects[i]->type) == rank)
+                sorted[count++] = image->objects[i];
+        }
+    }
+
+    free(image->objects);
+    image->objects = sorted;
+
+    for (uint32_t i = 0; i < count; i++)
+        image->map.indices[image_map_find(&image->map, sorted[i])] = i;
+}
+
+static void image_write_value(ImageWriter *image, Value value)
+{
+    Writer *writer = &image->writer;
+
+    switch (value.type)
+    {
+    case VALUE_NULL:
+        serialize_write_u8(writer, IMAGE_TAG_NULL);
+        break;
+    case VALUE_VOID:
+        serialize_write_u8(writer, IMAGE_TAG_VOID);
+        break;
+    case VALUE_BOOL:
+        serialize_write_u8(writer, VALUE_AS_BOOL(value) ? IMAGE_TAG_TRUE : IMAGE_TAG_FALSE);
+        break;
+    case VALUE_FLONUM:
+        serialize_write_u8(writer, IMAGE_TAG_FLONUM);
+        serialize_write_f64(writer, VALUE_AS_FLONUM(value));
+        break;
+    case VALUE_FIXNUM:
+        serialize_write_u8(writer, IMAGE_TAG_FIXNUM);
+        serialize_write_i64(writer, VALUE_AS_FIXNUM(value));
+        break;
+    case VALUE_OBJ:
+        serialize_write_u8(writer, IMAGE_TAG_OBJECT);
+        serialize_write_u32(writer, image_map_get(&image->map, VALUE_AS_OBJ(value)));
+        break;
+    }
+}
+
+static void image_write_object(ImageWriter *image, Obj *object)
+{
+    Writer *writer = &image->writer;
+
+    serialize_write_u8(writer, (uint8_t)object->type);
+
+    switch (object->type)
+    {
+    case OBJ_BIGNUM:
+        serialize_write_bignum(writer, (ObjBignum *)object);
+        break;
+    case OBJ_VECTOR:
+        serialize_write_vector(writer, (ObjVector *)object);
+        break;
+    case OBJ_STRING:
+    {
+        ObjString *string = (ObjString *)object;
+        serialize_write_u32(writer, (uint32_t)string->length);
+        serialize_write_bytes(writer, string->chars, string->length);
+        break;
+    }
+    case OBJ_NATIVE:
+    {
+        // Natives are written by name and looked up in the primitive table
+        // of the loading binary.
+        const char *name = ((ObjNative *)object)->name;
+        serialize_write_u32(writer, (uint32_t)strlen(name));
+        serialize_write_bytes(writer, name, strlen(name));
+        break;
+    }
+    case OBJ_FUNCTION:
+    {
+        ObjFunction *function = (ObjFunction *)object;
+        serialize_write_u32(writer, (uint32_t)function->arity);
+        serialize_write_u32(writer, (uint32_t)function->upvalue_count);
+        serialize_write_u32(writer, (uint32_t)function->arena_size);
+        serialize_write_i64(writer, (int64_t)function->id);
+        serialize_write_u32(writer, (uint32_t)function->line);
+        // The source of a function not compiled yet, empty otherwise.
+        serialize_write_u32(writer, function->source != NULL ? (uint32_t)function->source->length : 0);
+        if (function->source != NULL)
+            serialize_write_bytes(writer, function->source->chars, function->source->length);
+        serialize_write_code(writer, &function->chunk);
+        serialize_write_u32(writer, (uint32_t)function->chunk.constants.count);
+        break;
+    }
+    case OBJ_CLOSURE:
+        serialize_write_u32(writer, image_map_get(&image->map, (Obj *)((ObjClosure *)object)->function));
+        break;
+    case OBJ_UPVALUE:
+    case OBJ_CONTINUATION:
+        break;
+    }
+}
+
+static void image_write_references(ImageWriter *image, Obj *object)
+{
+    switch (object->type)
+    {
+    case OBJ_FUNCTION:
+    {
+        ValueArray *constants = &((ObjFunction *)object)->chunk.constants;
+        for (int i = 0; i < constants->count; i++)
+            image_write_value(image, constants->values[i]);
+        break;
+    }
+    case OBJ_UPVALUE:
+        image_write_value(image, ((ObjUpvalue *)object)->closed);
+        break;
+    case OBJ_CLOSURE:
+    {
+        ObjClosure *closure = (ObjClosure *)object;
+        for (int i = 0; i < closure->upvalue_count; i++)
+            image_write_value(image, closure->upvalues[i]);
+        break;
+    }
+    case OBJ_BIGNUM:
+    case OBJ_VECTOR:
+    case OBJ_NATIVE:
+    case OBJ_STRING:
+    case OBJ_CONTINUATION:
+        break;
+    }
+}
+
+bool image_dump(const char *path)
+{
+    ImageWriter image;
+    image.map.keys = NULL;
+    image.map.indices = NULL;
+    image.map.capacity = 0;
+    image.map.count = 0;
+    image.objects = NULL;
+    image.count = 0;
+    image.capacity = 0;
+    serialize_init_writer(&image.writer);
+
+    bool dumped = image_collect(&image);
+
+    if (dumped)
+    {
+        Writer *writer = &image.writer;
+
+        image_sort(&image);
+
+        serialize_write_u32(writer, IMAGE_MAGIC);
+        serialize_write_u32(writer, IMAGE_VERSION);
+        serialize_write_u32(writer, SERIALIZE_VERSION);
+        serialize_write_i64(writer, (int64_t)next_id);
+
+        serialize_write_u32(writer, image.count);
+        for (uint32_t i = 0; i < image.count; i++)
+            image_write_object(&image, image.objects[i]);
+
+        for (uint32_t i = 0; i < image.count; i++)
+            image_write_references(&image, image.objects[i]);
+
+        serialize_write_u32(writer, (uint32_t)vm.globals.count);
+        for (int slot = 0; slot < vm.globals.count; slot++)
+        {
+            serialize_write_u32(writer, image_map_get(&image.map, (Obj *)vm.globals.entries[slot].key));
+            image_write_value(&image, vm.globals.values[slot]);
+        }
+
+        dumped = serialize_write_file(writer, path);
+
+        if (!dumped)
+            fprintf(stderr, "Could not write image \"%s\".\n", path);
+    }
+
+    serialize_free_writer(&image.writer);
+    free(image.map.keys);
+    free(image.map.indices);
+    free(image.objects);
+
+    return dumped;
+}
+
+/* Loading */
+
+static Obj *image_read_object_index(ImageReader *image, ObjType type)
+{
+    uint32_t index = serialize_read_u32(&image->reader);
+
+    if (index >= image->count || image->objects[index]->type != type)
+    {
+        image->reader.failed = true;
+        return NULL;
+    }
+
+    return image->objects[index];
+}
+
+static Value image_read_value(ImageReader *image)
+{
+    Reader *reader = &image->reader;
+
+    switch (serialize_read_u8(reader))
+    {
+    case IMAGE_TAG_NULL:
+        return VALUE_NULL_VAL;
+    case IMAGE_TAG_VOID:
+        return VALUE_VOID_VAL;
+    case IMAGE_TAG_FALSE:
+        return VALUE_BOOL_VAL(false);
+    case IMAGE_TAG_TRUE:
+        return VALUE_BOOL_VAL(true);
+    case IMAGE_TAG_FLONUM:
+        return VALUE_FLONUM_VAL(serialize_read_f64(reader));
+    case IMAGE_TAG_FIXNUM:
+        return VALUE_FIXNUM_VAL(serialize_read_i64(reader));
+    case IMAGE_TAG_OBJECT:
+    {
+        uint32_t index = serialize_read_u32(reader);
+
+        if (index < image->count)
+            return VALUE_OBJ_VAL(image->objects[index]);
+        break;
+    }
+    }
+
+    reader->failed = true;
+    return VALUE_NULL_VAL;
+}
+
+static const char *image_read_chars(ImageReader *image, uint32_t *length)
+{
+    *length = serialize_read_u32(&image->reader);
+    return (const char *)serialize_read_bytes(&image->reader, *length);
+}
+
+static Obj *image_read_object(ImageReader *image)
+{
+    Reader *reader = &image->reader;
+    uint8_t type = serialize_read_u8(reader);
+
+    switch (type)
+    {
+    case OBJ_BIGNUM:
+        return (Obj *)serialize_read_bignum(reader);
+    case OBJ_VECTOR:
+        return (Obj *)serialize_read_vector(reader);
+    case OBJ_STRING:
+    {
+        uint32_t length;
+        const char *chars = image_read_chars(image, &length);
+        return chars == NULL ? NULL : (Obj *)object_copy_string(chars, (int)length);
+    }
+    case OBJ_NATIVE:
+    {
+        uint32_t length;
+        const char *name = image_read_chars(image, &length);
+
+        if (name == NULL)
+            return NULL;
+
+        ObjNative *native = vm_new_primitive(name, (int)length);
+
+        if (native == NULL)
+            fprintf(stderr, "Unknown primitive '%.*s' in image.\n", (int)length, name);
+
+        return (Obj *)native;
+    }
+    case OBJ_FUNCTION:
+    {
+        ObjFunction *function = object_new_script();
+        function->arity = (int)serialize_read_u32(reader);
+        function->upvalue_count = (int)serialize_read_u32(reader);
+        function->arena_size = (int)serialize_read_u32(reader);
+        function->id = (size_t)serialize_read_i64(reader);
+        function->line = (int)serialize_read_u32(reader);
+
+        uint32_t length = serialize_read_u32(reader);
+
+        if (length > 0)
+        {
+            const char *chars = (const char *)serialize_read_bytes(reader, length);
+
+            if (chars == NULL)
+                return NULL;
+
+            function->source = object_copy_string(chars, (int)length);
+        }
+
+        if (function->id >= next_id)
+            next_id = function->id + 1;
+
+        if (!serialize_read_code(reader, &function->chunk) ||
+            (function->chunk.count == 0 && function->source == NULL))
+            return NULL;
+
+        // Reserve the constants now, they are filled in with the references.
+        uint32_t constant_count = serialize_read_u32(reader);
+
+        for (uint32_t i = 0; i < constant_count && !reader->failed; i++)
+            value_write_value_array(&function->chunk.constants, VALUE_NULL_VAL);
+
+        return (Obj *)function;
+    }
+    case OBJ_UPVALUE:
+    {
+        ObjUpvalue *upvalue = object_new_upvalue(NULL);
+        upvalue->location = &upvalue->closed;
+        return (Obj *)upvalue;
+    }
+    case OBJ_CLOSURE:
+    {
+        ObjFunction *function = (ObjFunction *)image_read_object_index(image, OBJ_FUNCTION);
+        return function == NULL ? NULL : (Obj *)object_new_closure(function);
+    }
+    }
+
+    return NULL;
+}
+
+static void image_read_references(ImageReader *image, Obj *object)
+{
+    switch (object->type)
+    {
+    case OBJ_FUNCTION:
+    {
+        ValueArray *constants = &((ObjFunction *)object)->chunk.constants;
+        for (int i = 0; i < constants->count; i++)
+            constants->values[i] = image_read_value(image);
+        break;
+    }
+    case OBJ_UPVALUE:
+        ((ObjUpvalue *)object)->closed = image_read_value(image);
+        break;
+    case OBJ_CLOSURE:
+    {
+        ObjClosure *closure = (ObjClosure *)object;
+        for (int i = 0; i < closure->upvalue_count; i++)
+            closure->upvalues[i] = image_read_value(image);
+        break;
+    }
+    case OBJ_BIGNUM:
+    case OBJ_VECTOR:
+    case OBJ_NATIVE:
+    case OBJ_STRING:
+    case OBJ_CONTINUATION:
+        break;
+    }
+}
+
+static bool image_read_globals(ImageReader *image)
+{
+    Reader *reader = &image->reader;
+    uint32_t count = serialize_read_u32(reader);
+
+    for (uint32_t slot = 0; slot < count && !reader->failed; slot++)
+    {
+        ObjString *name = (ObjString *)image_read_object_index(image, OBJ_STRING);
+        Value value = image_read_value(image);
+
+        if (name == NULL || table_declare(&vm.globals, name) != (int)slot)
+            return false;
+
+        table_set(&vm.globals, slot, value);
+    }
+
+    return !reader->failed;
+}
+
+static bool image_read(ImageReader *image)
+{
+    Reader *reader = &image->reader;
+
+    if (serialize_read_u32(reader) != IMAGE_MAGIC ||
+        serialize_read_u32(reader) != IMAGE_VERSION ||
+        serialize_read_u32(reader) != SERIALIZE_VERSION)
+    {
+        return false;
+    }
+
+    next_id = (size_t)serialize_read_i64(reader);
+    image->count = serialize_read_u32(reader);
+
+    if (reader->failed || image->count > reader->count)
+        return false;
+
+    image->objects = (Obj **)malloc((image->count + 1) * sizeof(Obj *));
+
+    if (image->objects == NULL)
+        exit(1);
+
+    for (uint32_t i = 0; i < image->count; i++)
+    {
+        image->objects[i] = image_read_object(image);
+
+        if (image->objects[i] == NULL || reader->failed)
+        {
+            image->count = i;
+            return false;
+        }
+    }
+
+    for (uint32_t i = 0; i < image->count && !reader->failed; i++)
+        image_read_references(image, image->objects[i]);
+
+    return !reader->failed && image_read_globals(image);
+}
+
+bool image_load(const char *path)
+{
+    ImageReader image;
+    image.objects = NULL;
+    image.count = 0;
+
+    if (!serialize_map_file(path, &image.reader))
+    {
+        fprintf(stderr, "Could not open image \"%s\".\n", path);
+        return false;
+    }
+
+    // Nothing is reachable from a root until the globals are filled in.
+    memory.paused = true;
+    bool loaded = image_read(&image);
+    memory.paused = false;
+
+    if (memory.bytes_allocated > memory.next_gc)
+        memory.next_gc = memory.bytes_allocated * 2;
+
+    if (!loaded)
+        fprintf(stderr, "Invalid image \"%s\".\n", path);
+
+    serialize_unmap_file(&image.reader);
+    free(image.objects);
+
+    return loaded;
+}
\ No newline at end of file
@@ -0,0 +1,13 @@
+#ifndef _IMAGE_H
+#define _IMAGE_H
+
+#include <common/common.h>
+
+// Bump whenever the object records below change. Images also record
+// SERIALIZE_VERSION, since function records embed bytecode.
+#define IMAGE_VERSION 4
+
+bool image_dump(const char *path);
+bool image_load(const char *path);
+
+#endif
\ No newline at end of file
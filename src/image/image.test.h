@@ -0,0 +1,81 @@
+#ifndef _IMAGE_TEST_H
+#define _IMAGE_TEST_H
+
+#include <image/image.h>
+#include <bignum/bignum.h>
+#include <compiler/compiler.h>
+#include <memory/memory.h>
+#include <table/table.h>
+#include <vm/vm.h>
+#include <CUnit/Basic.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#define IMAGE_TEST_PATH "/tmp/lisb_image_test.img"
+
+// The value of the global name, void if there is none.
+static Value image_test_global(const char *name)
+{
+    int slot = table_find_entry(&vm.globals, name, (int)strlen(name));
+    return slot == -1 ? VALUE_VOID_VAL : table_get(&vm.globals, slot);
+}
+
+void image_round_trip_test()
+{
+    // Scripts run on top of an image may assign its globals, as in main.
+    compiler_set_whole_program(false);
+
+    vm_init_vm();
+    CU_ASSERT_EQUAL_FATAL(vm_interpret("(define answer 42)\n"
+                                       "(define greeting \"hello\")\n"
+                                       "(define big (* 4294967296 4294967296 4294967296))\n"
+                                       "(define adder (let ((n 5)) (lambda (x) (+ x n))))\n"),
+                          VM_OK);
+    CU_ASSERT_TRUE(image_dump(IMAGE_TEST_PATH));
+    vm_free_vm();
+
+    CU_ASSERT_TRUE_FATAL(vm_init_vm_from_image(IMAGE_TEST_PATH));
+
+    Value answer = image_test_global("answer");
+    CU_ASSERT_TRUE(VALUE_IS_FIXNUM(answer));
+    CU_ASSERT_EQUAL(VALUE_AS_FIXNUM(answer), 42);
+
+    Value greeting = image_test_global("greeting");
+    CU_ASSERT_TRUE_FATAL(OBJECT_IS_STRING(greeting));
+    CU_ASSERT_STRING_EQUAL(OBJECT_AS_STRING(greeting)->chars, "hello");
+
+    Value big = image_test_global("big");
+    CU_ASSERT_TRUE_FATAL(OBJECT_IS_BIGNUM(big));
+    int length;
+    char *chars = bignum_to_chars(big, 16, &length);
+    CU_ASSERT_STRING_EQUAL(chars, "1000000000000000000000000");
+    MEMORY_FREE_ARRAY(char, chars, length + 1);
+
+    // Closures come back with their captured variables
+    CU_ASSERT_EQUAL_FATAL(vm_interpret("(define result (adder 10))"), VM_OK);
+    Value result = image_test_global("result");
+    CU_ASSERT_TRUE(VALUE_IS_FIXNUM(result));
+    CU_ASSERT_EQUAL(VALUE_AS_FIXNUM(result), 15);
+
+    vm_free_vm();
+    remove(IMAGE_TEST_PATH);
+    compiler_set_whole_program(true);
+}
+
+void image_load_fail_test()
+{
+    FILE *file = fopen(IMAGE_TEST_PATH, "wb");
+    CU_ASSERT_PTR_NOT_NULL_FATAL(file);
+    fputs("not an image", file);
+    fclose(file);
+
+    CU_ASSERT_FALSE(vm_init_vm_from_image(IMAGE_TEST_PATH));
+    vm_free_vm();
+
+    remove(IMAGE_TEST_PATH);
+    CU_ASSERT_FALSE(vm_init_vm_from_image(IMAGE_TEST_PATH));
+    vm_free_vm();
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,1022 @@
+// MAP_ANONYMOUS isn't POSIX, so the strict flags of the Makefile hide it
+// unless it is asked for.
+#define _DEFAULT_SOURCE
+
+#include <jit/jit.h>
+#include <memory/memory.h>
+#include <table/table.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef JIT_SUPPORTED
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+static bool jit_enabled = false;
+
+void jit_set_enabled(bool enabled)
+{
+#ifdef JIT_SUPPORTED
+    jit_enabled = enabled;
+#else
+    (void)enabled;
+#endif
+}
+
+bool jit_is_enabled()
+{
+    return jit_enabled;
+}
+
+void jit_free_code(ObjFunction *function)
+{
+    JitCode *jit = function->jit;
+
+    if (jit == NULL)
+        return;
+
+    if (jit->code != NULL)
+        jit_uninstall(jit->code, jit->size);
+    MEMORY_FREE_ARRAY(int, jit->entries, jit->entry_count);
+    MEMORY_FREE(JitCode, jit);
+    function->jit = NULL;
+}
+
+void jit_attach_procedure(ObjFunction *function, JitProcedure procedure)
+{
+    JitCode *jit = MEMORY_ALLOCATE(JitCode, 1);
+    jit->code = NULL;
+    jit->size = 0;
+    jit->entries = NULL;
+    jit->entry_count = 0;
+    jit->procedure = procedure;
+
+    jit_free_code(function);
+    function->jit = jit;
+}
+
+void jit_uninstall(uint8_t *code, size_t size)
+{
+#ifdef JIT_SUPPORTED
+    munmap(code, size);
+#else
+    (void)code;
+    (void)size;
+#endif
+}
+
+#ifdef JIT_SUPPORTED
+
+typedef uint8_t *(*JitEntry)(CallFrame *frame, uint8_t *target);
+
+uint8_t *jit_run(CallFrame *frame)
+{
+    ObjFunction *function = frame->closure->function;
+
+    if (function->jit->procedure != NULL)
+        return function->jit->procedure(frame);
+
+    int entry = function->jit->entries[frame->ip - function->chunk.code];
+
+    if (entry < 0)
+        return frame->ip;
+
+    // ISO C has no cast from a data pointer to a function pointer, but POSIX
+    // has the two share a representation, so the bits are copied over.
+    JitEntry run;
+    memcpy(&run, &function->jit->code, sizeof(run));
+    return run(frame, function->jit->code + entry);
+}
+
+void jit_emit_byte(JitBuffer *buffer, uint8_t byte)
+{
+    if (buffer->capacity < buffer->count + 1)
+    {
+        int old_capacity = buffer->capacity;
+        buffer->capacity = MEMORY_GROW_CAPACITY(old_capacity);
+        buffer->code = MEMORY_GROW_ARRAY(uint8_t, buffer->code, old_capacity, buffer->capacity);
+    }
+
+    buffer->code[buffer->count++] = byte;
+}
+
+void jit_emit_bytes(JitBuffer *buffer, const uint8_t *bytes, int count)
+{
+    for (int i = 0; i < count; i++)
+        jit_emit_byte(buffer, bytes[i]);
+}
+
+void jit_emit_u32(JitBuffer *buffer, uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+        jit_emit_byte(buffer, (uint8_t)(value >> (8 * i)));
+}
+
+void jit_emit_u64(JitBuffer *buffer, uint64_t value)
+{
+    for (int i = 0; i < 8; i++)
+        jit_emit_byte(buffer, (uint8_t)(value >> (8 * i)));
+}
+
+void jit_patch_u32(JitBuffer *buffer, int position, uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+        buffer->code[position + i] = (uint8_t)(value >> (8 * i));
+}
+
+void jit_add_fixup(JitBuffer *buffer, int target, bool exit)
+{
+    if (buffer->fixup_capacity < buffer->fixup_count + 1)
+    {
+        int old_capacity = buffer->fixup_capacity;
+        buffer->fixup_capacity = MEMORY_GROW_CAPACITY(old_capacity);
+        buffer->fixups = MEMORY_GROW_ARRAY(JitFixup, buffer->fixups, old_capacity, buffer->fixup_capacity);
+    }
+
+    JitFixup *fixup = &buffer->fixups[buffer->fixup_count++];
+    fixup->position = buffer->count;
+    fixup->target = target;
+    fixup->exit = exit;
+    jit_emit_u32(buffer, 0);
+}
+
+static void jit_emit_opcode(JitBuffer *buffer, uint8_t prefix, bool wide, uint16_t opcode, int reg, int rm)
+{
+    if (prefix != 0)
+        jit_emit_byte(buffer, prefix);
+
+    uint8_t rex = 0x40 | (wide ? 0x08 : 0) | (reg & 8 ? 0x04 : 0) | (rm & 8 ? 0x01 : 0);
+
+    if (rex != 0x40)
+        jit_emit_byte(buffer, rex);
+
+    if (opcode > 0xff)
+        jit_emit_byte(buffer, (uint8_t)(opcode >> 8));
+
+    jit_emit_byte(buffer, (uint8_t)opcode);
+}
+
+void jit_emit_memory(JitBuffer *buffer, uint8_t prefix, bool wide, uint16_t opcode,
+                     int reg, int base, int32_t disp)
+{
+    jit_emit_opcode(buffer, prefix, wide, opcode, reg, base);
+
+    int mod = disp == 0 && (base & 7) != JIT_RBP ? 0 : (disp >= -128 && disp <= 127 ? 1 : 2);
+    jit_emit_byte(buffer, (uint8_t)((mod << 6) | ((reg & 7) << 3) | (base & 7)));
+
+    if ((base & 7) == JIT_RSP)
+        jit_emit_byte(buffer, 0x24);
+
+    if (mod == 1)
+        jit_emit_byte(buffer, (uint8_t)disp);
+    else if (mod == 2)
+        jit_emit_u32(buffer, (uint32_t)disp);
+}
+
+void jit_emit_register(JitBuffer *buffer, uint8_t prefix, bool wide, uint16_t opcode, int reg, int rm)
+{
+    jit_emit_opcode(buffer, prefix, wide, opcode, reg, rm);
+    jit_emit_byte(buffer, (uint8_t)(0xc0 | ((reg & 7) << 3) | (rm & 7)));
+}
+
+void jit_emit_move_immediate(JitBuffer *buffer, int reg, uint64_t value)
+{
+    jit_emit_byte(buffer, 0x48 | (reg & 8 ? 0x01 : 0));
+    jit_emit_byte(buffer, (uint8_t)(0xb8 + (reg & 7)));
+    jit_emit_u64(buffer, value);
+}
+
+// add r12, bytes
+static void jit_emit_grow_stack(JitBuffer *buffer, int32_t bytes)
+{
+    jit_emit_register(buffer, 0, true, 0x81, bytes < 0 ? 5 : 0, JIT_R12);
+    jit_emit_u32(buffer, (uint32_t)(bytes < 0 ? -bytes : bytes));
+}
+
+void jit_emit_store_type(JitBuffer *buffer, int base, int32_t disp, ValueType type)
+{
+    jit_emit_memory(buffer, 0, false, 0xc7, 0, base, disp);
+    jit_emit_u32(buffer, (uint32_t)type);
+}
+
+// Copies a value through rax.
+static void jit_emit_copy(JitBuffer *buffer, int to, int32_t to_disp, int from, int32_t from_disp)
+{
+    for (int32_t half = 0; half < (int32_t)sizeof(Value); half += 8)
+    {
+        jit_emit_memory(buffer, 0, true, 0x8b, JIT_RAX, from, from_disp + half);
+        jit_emit_memory(buffer, 0, true, 0x89, JIT_RAX, to, to_disp + half);
+    }
+}
+
+static void jit_emit_push(JitBuffer *buffer, Value value)
+{
+    uint64_t bits;
+    memcpy(&bits, &value.as, sizeof(bits));
+
+    jit_emit_store_type(buffer, JIT_R12, 0, value.type);
+    jit_emit_move_immediate(buffer, JIT_RAX, bits);
+    jit_emit_memory(buffer, 0, true, 0x89, JIT_RAX, JIT_R12, offsetof(Value, as));
+    jit_emit_grow_stack(buffer, sizeof(Value));
+}
+
+// Leaves to the interpreter at the instruction at offset.
+static void jit_emit_exit(JitBuffer *buffer, uint8_t *ip)
+{
+    jit_emit_move_immediate(buffer, JIT_RAX, (uint64_t)(uintptr_t)ip);
+    jit_emit_byte(buffer, 0xe9);
+    jit_emit_u32(buffer, (uint32_t)(buffer->epilogue - (buffer->count + 4)));
+}
+
+// Jumps to the exit of the instruction at offset when the last comparison
+// came out unequal.
+static void jit_emit_exit_unless_equal(JitBuffer *buffer, int offset)
+{
+    jit_emit_byte(buffer, 0x0f);
+    jit_emit_byte(buffer, 0x85);
+    jit_add_fixup(buffer, offset, true);
+}
+
+// Calls a helper with the frame and an operand, keeping vm.stack_top
+// in step for it.
+static void jit_emit_call(JitBuffer *buffer, void (*helper)(CallFrame *, int), int operand)
+{
+    jit_emit_memory(buffer, 0, true, 0x89, JIT_R12, JIT_R15, 0);
+    jit_emit_register(buffer, 0, true, 0x89, JIT_R13, JIT_RDI);
+    jit_emit_byte(buffer, 0xbe);
+    jit_emit_u32(buffer, (uint32_t)operand);
+    jit_emit_move_immediate(buffer, JIT_RAX, (uint64_t)(uintptr_t)helper);
+    jit_emit_register(buffer, 0, false, 0xff, 2, JIT_RAX);
+    jit_emit_memory(buffer, 0, true, 0x8b, JIT_R12, JIT_R15, 0);
+}
+
+static void jit_get_global(CallFrame *frame, int slot)
+{
+    (void)frame;
+    vm_push(table_get(&vm.globals, slot));
+}
+
+static void jit_global_unchanged(CallFrame *frame, int slot)
+{
+    (void)frame;
+    vm_push(VALUE_BOOL_VAL(table_is_unchanged(&vm.globals, slot)));
+}
+
+static void jit_set_global(CallFrame *frame, int slot)
+{
+    (void)frame;
+    table_set(&vm.globals, slot, vm.stack_top[-1]);
+}
+
+static void jit_get_upvalue(CallFrame *frame, int slot)
+{
+    vm_push(frame->closure->upvalues[slot]);
+}
+
+static void jit_get_boxed_upvalue(CallFrame *frame, int slot)
+{
+    vm_push(*OBJECT_AS_UPVALUE(frame->closure->upvalues[slot])->location);
+}
+
+static void jit_set_upvalue(CallFrame *frame, int slot)
+{
+    *OBJECT_AS_UPVALUE(frame->closure->upvalues[slot])->location = vm.stack_top[-1];
+}
+
+// A jmp, or the jcc of condition, whose rel32 jit_emit_land patches. Returns
+// the position of that rel32.
+static int jit_emit_forward_jump(JitBuffer *buffer, uint8_t condition)
+{
+    if (condition == 0)
+        jit_emit_byte(buffer, 0xe9);
+    else
+    {
+        jit_emit_byte(buffer, 0x0f);
+        jit_emit_byte(buffer, condition);
+    }
+
+    int position = buffer->count;
+    jit_emit_u32(buffer, 0);
+    return position;
+}
+
+static void jit_emit_land(JitBuffer *buffer, int position)
+{
+    jit_patch_u32(buffer, position, (uint32_t)(buffer->count - (position + 4)));
+}
+
+// Jumps, by rel32s that jit_emit_land patches, unless both operands are of
+// type. Returns the number of jumps, whose positions are put in jumps.
+static int jit_emit_unless_types(JitBuffer *buffer, uint8_t *ip, ValueType type, int *jumps)
+{
+    int count = 0;
+
+    for (int i = 2; i <= 3; i++)
+    {
+        if (ip[i] & CHUNK_REGISTER_CONSTANT)
+            continue;
+
+        // cmp dword [rbx + disp], type; jne
+        jit_emit_memory(buffer, 0, false, 0x81, 7, JIT_RBX, (int32_t)sizeof(Value) * ip[i]);
+        jit_emit_u32(buffer, (uint32_t)type);
+        jumps[count++] = jit_emit_forward_jump(buffer, 0x85);
+    }
+
+    return count;
+}
+
+// Loads a register operand whose type is known into reg, or into xmm if
+// xmm is set.
+static void jit_emit_operand(JitBuffer *buffer, Chunk *chunk, uint8_t operand, int reg, bool xmm)
+{
+    if (operand & CHUNK_REGISTER_CONSTANT)
+    {
+        Value constant = chunk->constants.values[operand & CHUNK_REGISTER_MAX];
+        uint64_t bits;
+        memcpy(&bits, &constant.as, sizeof(bits));
+
+        jit_emit_move_immediate(buffer, xmm ? JIT_RAX : reg, bits);
+
+        // movq xmm, rax
+        if (xmm)
+            jit_emit_register(buffer, 0x66, true, 0x0f6e, reg, JIT_RAX);
+        return;
+    }
+
+    int32_t disp = (int32_t)sizeof(Value) * operand + offsetof(Value, as);
+
+    // movsd xmm, [rbx + disp] / mov reg, [rbx + disp]
+    if (xmm)
+        jit_emit_memory(buffer, 0xf2, false, 0x0f10, reg, JIT_RBX, disp);
+    else
+        jit_emit_memory(buffer, 0, true, 0x8b, reg, JIT_RBX, disp);
+}
+
+// Loads a register operand of either type into xmm as a double, or returns
+// false if it is a constant that can't be one. Fixnums are converted for
+// arithmetic, where the primitives round them too, but exit from
+// comparisons, which are exact, unless they are constants that convert
+// exactly. Anything else exits too.
+static bool jit_emit_flonum_operand(JitBuffer *buffer, Chunk *chunk, int offset, uint8_t operand, int xmm,
+                                    bool arithmetic)
+{
+    if (operand & CHUNK_REGISTER_CONSTANT)
+    {
+        Value constant = chunk->constants.values[operand & CHUNK_REGISTER_MAX];
+        double number;
+
+        if (VALUE_IS_FLONUM(constant))
+            number = VALUE_AS_FLONUM(constant);
+        else if (VALUE_IS_FIXNUM(constant) &&
+                 (arithmetic || (VALUE_AS_FIXNUM(constant) >= -(INT64_C(1) << 53) &&
+                                 VALUE_AS_FIXNUM(constant) <= (INT64_C(1) << 53))))
+            number = (double)VALUE_AS_FIXNUM(constant);
+        else
+            return false;
+
+        uint64_t bits;
+        memcpy(&bits, &number, sizeof(bits));
+
+        // movq xmm, rax
+        jit_emit_move_immediate(buffer, JIT_RAX, bits);
+        jit_emit_register(buffer, 0x66, true, 0x0f6e, xmm, JIT_RAX);
+        return true;
+    }
+
+    int32_t disp = (int32_t)sizeof(Value) * operand;
+    int flonum = -1;
+    int loaded = -1;
+
+    // cmp dword [rbx + disp], VALUE_FLONUM
+    jit_emit_memory(buffer, 0, false, 0x81, 7, JIT_RBX, disp);
+    jit_emit_u32(buffer, VALUE_FLONUM);
+
+    if (arithmetic)
+    {
+        flonum = jit_emit_forward_jump(buffer, 0x84);
+
+        // cmp dword [rbx + disp], VALUE_FIXNUM
+        jit_emit_memory(buffer, 0, false, 0x81, 7, JIT_RBX, disp);
+        jit_emit_u32(buffer, VALUE_FIXNUM);
+        jit_emit_exit_unless_equal(buffer, offset);
+
+        // cvtsi2sd xmm, qword [rbx + disp + 8]
+        jit_emit_memory(buffer, 0xf2, true, 0x0f2a, xmm, JIT_RBX, disp + offsetof(Value, as));
+        loaded = jit_emit_forward_jump(buffer, 0);
+        jit_emit_land(buffer, flonum);
+    }
+    else
+        jit_emit_exit_unless_equal(buffer, offset);
+
+    // movsd xmm, [rbx + disp + 8]
+    jit_emit_memory(buffer, 0xf2, false, 0x0f10, xmm, JIT_RBX, disp + offsetof(Value, as));
+
+    if (loaded != -1)
+        jit_emit_land(buffer, loaded);
+    return true;
+}
+
+// Whether a register operand may be of type, or may be a number at all.
+static bool jit_may_be(Chunk *chunk, uint8_t operand, ValueType type)
+{
+    return !(operand & CHUNK_REGISTER_CONSTANT) || chunk->constants.values[operand & CHUNK_REGISTER_MAX].type == type;
+}
+
+static bool jit_may_be_number(Chunk *chunk, uint8_t operand)
+{
+    return !(operand & CHUNK_REGISTER_CONSTANT) ||
+           VALUE_IS_NUMBER(chunk->constants.values[operand & CHUNK_REGISTER_MAX]);
+}
+
+// Computes op of xmm0 and xmm1 into the target slot.
+static void jit_emit_flonum_op(JitBuffer *buffer, uint8_t op, int32_t target)
+{
+    if (op == OP_ADD || op == OP_SUBTRACT || op == OP_MULTIPLY)
+    {
+        uint16_t opcode = op == OP_ADD ? 0x0f58 : op == OP_SUBTRACT ? 0x0f5c : 0x0f59;
+        jit_emit_register(buffer, 0xf2, false, opcode, 0, 1);
+        jit_emit_store_type(buffer, JIT_RBX, target, VALUE_FLONUM);
+        jit_emit_memory(buffer, 0xf2, false, 0x0f11, 0, JIT_RBX, target + offsetof(Value, as));
+        return;
+    }
+
+    // ucomisd sets the carry, zero and parity flags when the operands are
+    // unordered, for which every comparison is false. The operands are
+    // swapped for < and <= so that these only need the carry and zero flags
+    // too.
+    bool swap = op == OP_LESS || op == OP_LESS_EQUAL;
+    jit_emit_register(buffer, 0x66, false, 0x0f2e, swap ? 1 : 0, swap ? 0 : 1);
+
+    static const uint8_t set_equal[] = {0x0f, 0x94, 0xc0, 0x0f, 0x9b, 0xc1, 0x20, 0xc8};
+    static const uint8_t set_above[] = {0x0f, 0x97, 0xc0};
+    static const uint8_t set_above_equal[] = {0x0f, 0x93, 0xc0};
+
+    if (op == OP_EQUAL)
+        jit_emit_bytes(buffer, set_equal, sizeof(set_equal));
+    else if (op == OP_LESS || op == OP_GREATER)
+        jit_emit_bytes(buffer, set_above, sizeof(set_above));
+    else
+        jit_emit_bytes(buffer, set_above_equal, sizeof(set_above_equal));
+
+    // movzx eax, al
+    jit_emit_register(buffer, 0, false, 0x0fb6, JIT_RAX, JIT_RAX);
+    jit_emit_store_type(buffer, JIT_RBX, target, VALUE_BOOL);
+    jit_emit_memory(buffer, 0, true, 0x89, JIT_RAX, JIT_RBX, target + offsetof(Value, as));
+}
+
+// Computes op of two fixnums in rax and rcx into the target slot. An
+// overflow exits to the interpreter, which makes a flonum of it.
+static void jit_emit_fixnum_op(JitBuffer *buffer, uint8_t op, int32_t target, int offset)
+{
+    if (op == OP_ADD || op == OP_SUBTRACT || op == OP_MULTIPLY)
+    {
+        // add rax, rcx / sub rax, rcx / imul rax, rcx; jo exit
+        if (op == OP_MULTIPLY)
+            jit_emit_register(buffer, 0, true, 0x0faf, JIT_RAX, JIT_RCX);
+        else
+            jit_emit_register(buffer, 0, true, op == OP_ADD ? 0x01 : 0x29, JIT_RCX, JIT_RAX);
+        jit_emit_byte(buffer, 0x0f);
+        jit_emit_byte(buffer, 0x80);
+        jit_add_fixup(buffer, offset, true);
+
+        jit_emit_store_type(buffer, JIT_RBX, target, VALUE_FIXNUM);
+    }
+    else
+    {
+        static const uint8_t conditions[] = {0x94, 0x9c, 0x9f, 0x9e, 0x9d};
+
+        // cmp rax, rcx; setcc al; movzx eax, al
+        jit_emit_register(buffer, 0, true, 0x39, JIT_RCX, JIT_RAX);
+        jit_emit_byte(buffer, 0x0f);
+        jit_emit_byte(buffer, conditions[op - OP_EQUAL]);
+        jit_emit_byte(buffer, 0xc0);
+        jit_emit_register(buffer, 0, false, 0x0fb6, JIT_RAX, JIT_RAX);
+
+        jit_emit_store_type(buffer, JIT_RBX, target, VALUE_BOOL);
+    }
+
+    jit_emit_memory(buffer, 0, true, 0x89, JIT_RAX, JIT_RBX, target + offsetof(Value, as));
+}
+
+// Dispatches on the types of both operands at once: two flonums go straight
+// through, two fixnums are worked on as integers, and anything else is
+// converted or exits.
+static void jit_emit_register_instruction(JitBuffer *buffer, Chunk *chunk, int offset)
+{
+    uint8_t *ip = chunk->code + offset;
+    uint8_t op = CHUNK_CHECKED_REGISTER(ip[0]);
+    int32_t target = (int32_t)sizeof(Value) * ip[1];
+    bool arithmetic = op == OP_ADD || op == OP_SUBTRACT || op == OP_MULTIPLY;
+    int dones[2];
+    int done_count = 0;
+
+    if (!jit_may_be_number(chunk, ip[2]) || !jit_may_be_number(chunk, ip[3]))
+    {
+        jit_emit_exit(buffer, ip);
+        return;
+    }
+
+    int others[2];
+    int other_count;
+
+    if (jit_may_be(chunk, ip[2], VALUE_FLONUM) && jit_may_be(chunk, ip[3], VALUE_FLONUM))
+    {
+        other_count = jit_emit_unless_types(buffer, ip, VALUE_FLONUM, others);
+
+        jit_emit_operand(buffer, chunk, ip[2], 0, true);
+        jit_emit_operand(buffer, chunk, ip[3], 1, true);
+        jit_emit_flonum_op(buffer, op, target);
+        dones[done_count++] = jit_emit_forward_jump(buffer, 0);
+
+        for (int i = 0; i < other_count; i++)
+            jit_emit_land(buffer, others[i]);
+    }
+
+    if (jit_may_be(chunk, ip[2], VALUE_FIXNUM) && jit_may_be(chunk, ip[3], VALUE_FIXNUM))
+    {
+        other_count = jit_emit_unless_types(buffer, ip, VALUE_FIXNUM, others);
+
+        jit_emit_operand(buffer, chunk, ip[2], JIT_RAX, false);
+        jit_emit_operand(buffer, chunk, ip[3], JIT_RCX, false);
+        jit_emit_fixnum_op(buffer, op, target, offset);
+        dones[done_count++] = jit_emit_forward_jump(buffer, 0);
+
+        for (int i = 0; i < other_count; i++)
+            jit_emit_land(buffer, others[i]);
+    }
+
+    if (jit_emit_flonum_operand(buffer, chunk, offset, ip[2], 0, arithmetic) &&
+        jit_emit_flonum_operand(buffer, chunk, offset, ip[3], 1, arithmetic))
+        jit_emit_flonum_op(buffer, op, target);
+    else
+        jit_emit_exit(buffer, ip);
+
+    for (int i = 0; i < done_count; i++)
+        jit_emit_land(buffer, dones[i]);
+
+    // lea r12, [rbx + target + 1]
+    jit_emit_memory(buffer, 0, true, 0x8d, JIT_R12, JIT_RBX, target + (int32_t)sizeof(Value));
+}
+
+// Exits unless the values at [r12 + disp] and [r12 + disp + 16] are a
+// vector of kind and a fixnum index in range of it, and leaves the address
+// of the element in rax. Only rax, rcx and rsi are changed.
+static void jit_emit_vector_element(JitBuffer *buffer, int offset, int32_t disp, VectorKind kind)
+{
+    int32_t index = disp + (int32_t)sizeof(Value);
+
+    // cmp dword [r12 + disp], VALUE_OBJ; jne exit
+    jit_emit_memory(buffer, 0, false, 0x81, 7, JIT_R12, disp);
+    jit_emit_u32(buffer, VALUE_OBJ);
+    jit_emit_exit_unless_equal(buffer, offset);
+
+    // mov rax, [r12 + disp + 8]; cmp dword [rax + type], OBJ_VECTOR; jne exit
+    jit_emit_memory(buffer, 0, true, 0x8b, JIT_RAX, JIT_R12, disp + offsetof(Value, as));
+    jit_emit_memory(buffer, 0, false, 0x81, 7, JIT_RAX, offsetof(Obj, type));
+    jit_emit_u32(buffer, OBJ_VECTOR);
+    jit_emit_exit_unless_equal(buffer, offset);
+
+    // cmp dword [rax + kind], kind; jne exit
+    jit_emit_memory(buffer, 0, false, 0x81, 7, JIT_RAX, offsetof(ObjVector, kind));
+    jit_emit_u32(buffer, (uint32_t)kind);
+    jit_emit_exit_unless_equal(buffer, offset);
+
+    // cmp dword [r12 + index], VALUE_FIXNUM; jne exit
+    jit_emit_memory(buffer, 0, false, 0x81, 7, JIT_R12, index);
+    jit_emit_u32(buffer, VALUE_FIXNUM);
+    jit_emit_exit_unless_equal(buffer, offset);
+
+    // mov rcx, [r12 + index + 8]; movsxd rsi, dword [rax + length];
+    // cmp rcx, rsi; jae exit, which catches negative indexes too
+    jit_emit_memory(buffer, 0, true, 0x8b, JIT_RCX, JIT_R12, index + offsetof(Value, as));
+    jit_emit_memory(buffer, 0, true, 0x63, JIT_RSI, JIT_RAX, offsetof(ObjVector, length));
+    jit_emit_register(buffer, 0, true, 0x39, JIT_RSI, JIT_RCX);
+    jit_emit_byte(buffer, 0x0f);
+    jit_emit_byte(buffer, 0x83);
+    jit_add_fixup(buffer, offset, true);
+
+    // shl rcx, log2 size; add rax, rcx
+    if (kind != VECTOR_U8)
+    {
+        jit_emit_register(buffer, 0, true, 0xc1, 4, JIT_RCX);
+        jit_emit_byte(buffer, kind == VECTOR_F64 ? 3 : 2);
+    }
+    jit_emit_register(buffer, 0, true, 0x01, JIT_RCX, JIT_RAX);
+}
+
+// Inlines vector_ref, leaving anything else to the interpreter.
+static void jit_emit_vector_ref(JitBuffer *buffer, int offset, VectorKind kind)
+{
+    int32_t disp = -2 * (int32_t)sizeof(Value);
+    int32_t element = offsetof(ObjVector, elements);
+
+    jit_emit_vector_element(buffer, offset, disp, kind);
+
+    // mov rdx, [rax + element] / movsxd rdx, dword [rax + element] /
+    // movzx edx, byte [rax + element]
+    if (kind == VECTOR_F64)
+        jit_emit_memory(buffer, 0, true, 0x8b, JIT_RDX, JIT_RAX, element);
+    else if (kind == VECTOR_S32)
+        jit_emit_memory(buffer, 0, true, 0x63, JIT_RDX, JIT_RAX, element);
+    else
+        jit_emit_memory(buffer, 0, false, 0x0fb6, JIT_RDX, JIT_RAX, element);
+
+    jit_emit_store_type(buffer, JIT_R12, disp, kind == VECTOR_F64 ? VALUE_FLONUM : VALUE_FIXNUM);
+    jit_emit_memory(buffer, 0, true, 0x89, JIT_RDX, JIT_R12, disp + offsetof(Value, as));
+    jit_emit_grow_stack(buffer, disp / 2);
+}
+
+// Inlines vector_set, leaving anything else to the interpreter. The element
+// is checked before the vector so that nothing is written before an exit.
+static void jit_emit_vector_set(JitBuffer *buffer, int offset, VectorKind kind)
+{
+    int32_t value = (int32_t)sizeof(Value);
+    int32_t disp = -3 * value;
+    int32_t element = offsetof(ObjVector, elements);
+    int flonum = -1;
+    int loaded = -1;
+
+    // cmp dword [r12 - 16], VALUE_FLONUM; je flonum
+    if (kind == VECTOR_F64)
+    {
+        jit_emit_memory(buffer, 0, false, 0x81, 7, JIT_R12, -value);
+        jit_emit_u32(buffer, VALUE_FLONUM);
+        flonum = jit_emit_forward_jump(buffer, 0x84);
+    }
+
+    // cmp dword [r12 - 16], VALUE_FIXNUM; jne exit; mov rdx, [r12 - 8]
+    jit_emit_memory(buffer, 0, false, 0x81, 7, JIT_R12, -value);
+    jit_emit_u32(buffer, VALUE_FIXNUM);
+    jit_emit_exit_unless_equal(buffer, offset);
+    jit_emit_memory(buffer, 0, true, 0x8b, JIT_RDX, JIT_R12, -value + offsetof(Value, as));
+
+    if (kind == VECTOR_F64)
+    {
+        // cvtsi2sd xmm0, rdx; jmp loaded
+        jit_emit_register(buffer, 0xf2, true, 0x0f2a, 0, JIT_RDX);
+        loaded = jit_emit_forward_jump(buffer, 0);
+
+        // movsd xmm0, [r12 - 8]
+        jit_emit_land(buffer, flonum);
+        jit_emit_memory(buffer, 0xf2, false, 0x0f10, 0, JIT_R12, -value + offsetof(Value, as));
+        jit_emit_land(buffer, loaded);
+    }
+    else if (kind == VECTOR_S32)
+    {
+        // movsxd rcx, edx; cmp rcx, rdx; jne exit
+        jit_emit_register(buffer, 0, true, 0x63, JIT_RCX, JIT_RDX);
+        jit_emit_register(buffer, 0, true, 0x39, JIT_RDX, JIT_RCX);
+        jit_emit_exit_unless_equal(buffer, offset);
+    }
+    else
+    {
+        // cmp rdx, 255; ja exit
+        jit_emit_register(buffer, 0, true, 0x81, 7, JIT_RDX);
+        jit_emit_u32(buffer, UINT8_MAX);
+        jit_emit_byte(buffer, 0x0f);
+        jit_emit_byte(buffer, 0x87);
+        jit_add_fixup(buffer, offset, true);
+    }
+
+    jit_emit_vector_element(buffer, offset, disp, kind);
+
+    // movsd [rax + element], xmm0 / mov dword [rax + element], edx /
+    // mov byte [rax + element], dl
+    if (kind == VECTOR_F64)
+        jit_emit_memory(buffer, 0xf2, false, 0x0f11, 0, JIT_RAX, element);
+    else if (kind == VECTOR_S32)
+        jit_emit_memory(buffer, 0, false, 0x89, JIT_RDX, JIT_RAX, element);
+    else
+        jit_emit_memory(buffer, 0, false, 0x88, JIT_RDX, JIT_RAX, element);
+
+    // The result is void.
+    jit_emit_store_type(buffer, JIT_R12, disp, VALUE_VOID);
+    jit_emit_memory(buffer, 0, true, 0xc7, 0, JIT_R12, disp + offsetof(Value, as));
+    jit_emit_u32(buffer, 0);
+    jit_emit_grow_stack(buffer, -2 * value);
+}
+
+// Jumps to target when the value at [r12 + disp] is #f.
+static void jit_emit_jump_if_false(JitBuffer *buffer, int32_t disp, int target)
+{
+    // cmp dword [r12 + disp], VALUE_BOOL; jne skip
+    jit_emit_memory(buffer, 0, false, 0x81, 7, JIT_R12, disp);
+    jit_emit_u32(buffer, VALUE_BOOL);
+    jit_emit_byte(buffer, 0x75);
+    int skip = buffer->count;
+    jit_emit_byte(buffer, 0);
+
+    // cmp byte [r12 + disp + 8], 0; je target
+    jit_emit_memory(buffer, 0, false, 0x80, 7, JIT_R12, disp + offsetof(Value, as));
+    jit_emit_byte(buffer, 0);
+    jit_emit_byte(buffer, 0x0f);
+    jit_emit_byte(buffer, 0x84);
+    jit_add_fixup(buffer, target, false);
+
+    buffer->code[skip] = (uint8_t)(buffer->count - (skip + 1));
+}
+
+static void jit_emit_jump(JitBuffer *buffer, int target)
+{
+    jit_emit_byte(buffer, 0xe9);
+    jit_add_fixup(buffer, target, false);
+}
+
+static void jit_emit_prologue(JitBuffer *buffer)
+{
+    // The six pushes and the return address leave the stack 8 bytes short
+    // of the alignment calls need.
+    static const uint8_t saves[] = {0x55, 0x53, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56, 0x41, 0x57,
+                                    0x48, 0x83, 0xec, 0x08};
+    jit_emit_bytes(buffer, saves, sizeof(saves));
+
+    jit_emit_register(buffer, 0, true, 0x89, JIT_RDI, JIT_R13);
+    jit_emit_memory(buffer, 0, true, 0x8b, JIT_RBX, JIT_R13, offsetof(CallFrame, slots));
+    jit_emit_move_immediate(buffer, JIT_R15, (uint64_t)(uintptr_t)&vm.stack_top);
+    jit_emit_memory(buffer, 0, true, 0x8b, JIT_R12, JIT_R15, 0);
+
+    // jmp rsi
+    jit_emit_register(buffer, 0, false, 0xff, 4, JIT_RSI);
+
+    // The exits come here with the ip to leave at in rax.
+    buffer->epilogue = buffer->count;
+    jit_emit_memory(buffer, 0, true, 0x89, JIT_R12, JIT_R15, 0);
+
+    static const uint8_t restores[] = {0x48, 0x83, 0xc4, 0x08,
+                                       0x41, 0x5f, 0x41, 0x5e, 0x41, 0x5d, 0x41, 0x5c, 0x5b, 0x5d, 0xc3};
+    jit_emit_bytes(buffer, restores, sizeof(restores));
+}
+
+static uint16_t jit_read_short(uint8_t *ip)
+{
+    return (uint16_t)((ip[1] << 8) | ip[2]);
+}
+
+static uint32_t jit_read_long(uint8_t *ip)
+{
+    return (uint32_t)((ip[1] << 16) | (ip[2] << 8) | ip[3]);
+}
+
+// Emits the instruction at offset, and returns false if it is left to the
+// interpreter.
+static bool jit_emit_instruction(JitBuffer *buffer, Chunk *chunk, int offset)
+{
+    uint8_t *ip = chunk->code + offset;
+    int32_t value = (int32_t)sizeof(Value);
+
+    switch (ip[0])
+    {
+    case OP_CONSTANT:
+        jit_emit_push(buffer, chunk->constants.values[ip[1]]);
+        return true;
+    case OP_CONSTANT_LONG:
+        jit_emit_push(buffer, chunk->constants.values[jit_read_long(ip)]);
+        return true;
+    case OP_NULL:
+        jit_emit_push(buffer, VALUE_NULL_VAL);
+        return true;
+    case OP_TRUE:
+        jit_emit_push(buffer, VALUE_BOOL_VAL(true));
+        return true;
+    case OP_FALSE:
+        jit_emit_push(buffer, VALUE_BOOL_VAL(false));
+        return true;
+    case OP_POP:
+        jit_emit_grow_stack(buffer, -value);
+        return true;
+    case OP_POPN:
+        jit_emit_grow_stack(buffer, -value * ip[1]);
+        return true;
+    case OP_GET_LOCAL:
+    case OP_GET_LOCAL_LONG:
+    {
+        int slot = ip[0] == OP_GET_LOCAL ? ip[1] : jit_read_short(ip);
+        jit_emit_copy(buffer, JIT_R12, 0, JIT_RBX, value * slot);
+        jit_emit_grow_stack(buffer, value);
+        return true;
+    }
+    case OP_SET_LOCAL:
+    case OP_SET_LOCAL_LONG:
+    {
+        int slot = ip[0] == OP_SET_LOCAL ? ip[1] : jit_read_short(ip);
+        jit_emit_copy(buffer, JIT_RBX, value * slot, JIT_R12, -value);
+        return true;
+    }
+    case OP_GET_GLOBAL:
+        jit_emit_call(buffer, jit_get_global, jit_read_short(ip));
+        return true;
+    case OP_GLOBAL_UNCHANGED:
+        jit_emit_call(buffer, jit_global_unchanged, jit_read_short(ip));
+        return true;
+    case OP_SET_GLOBAL:
+        jit_emit_call(buffer, jit_set_global, jit_read_short(ip));
+        return true;
+    case OP_GET_UPVALUE:
+    case OP_GET_UPVALUE_LONG:
+        jit_emit_call(buffer, jit_get_upvalue, ip[0] == OP_GET_UPVALUE ? ip[1] : jit_read_short(ip));
+        return true;
+    case OP_GET_BOXED_UPVALUE:
+    case OP_GET_BOXED_UPVALUE_LONG:
+        jit_emit_call(buffer, jit_get_boxed_upvalue,
+                      ip[0] == OP_GET_BOXED_UPVALUE ? ip[1] : jit_read_short(ip));
+        return true;
+    case OP_SET_UPVALUE:
+    case OP_SET_UPVALUE_LONG:
+        jit_emit_call(buffer, jit_set_upvalue, ip[0] == OP_SET_UPVALUE ? ip[1] : jit_read_short(ip));
+        return true;
+    case OP_ADD:
+    case OP_SUBTRACT:
+    case OP_MULTIPLY:
+    case OP_EQUAL:
+    case OP_LESS:
+    case OP_GREATER:
+    case OP_LESS_EQUAL:
+    case OP_GREATER_EQUAL:
+    case OP_ADD_UNCHECKED:
+    case OP_SUBTRACT_UNCHECKED:
+    case OP_MULTIPLY_UNCHECKED:
+    case OP_EQUAL_UNCHECKED:
+    case OP_LESS_UNCHECKED:
+    case OP_GREATER_UNCHECKED:
+    case OP_LESS_EQUAL_UNCHECKED:
+    case OP_GREATER_EQUAL_UNCHECKED:
+        jit_emit_register_instruction(buffer, chunk, offset);
+        return true;
+    case OP_VECTOR_REF:
+        jit_emit_vector_ref(buffer, offset, (VectorKind)ip[1]);
+        return true;
+    case OP_VECTOR_SET:
+        jit_emit_vector_set(buffer, offset, (VectorKind)ip[1]);
+        return true;
+    case OP_JUMP:
+        jit_emit_jump(buffer, offset + 3 + jit_read_short(ip));
+        return true;
+    case OP_JUMP_LONG:
+        jit_emit_jump(buffer, offset + 4 + (int)jit_read_long(ip));
+        return true;
+    case OP_LOOP:
+        jit_emit_jump(buffer, offset + 3 - jit_read_short(ip));
+        return true;
+    case OP_LOOP_LONG:
+        jit_emit_jump(buffer, offset + 4 - (int)jit_read_long(ip));
+        return true;
+    case OP_JUMP_IF_FALSE:
+        jit_emit_jump_if_false(buffer, -value, offset + 3 + jit_read_short(ip));
+        return true;
+    case OP_JUMP_IF_FALSE_LONG:
+        jit_emit_jump_if_false(buffer, -value, offset + 4 + (int)jit_read_long(ip));
+        return true;
+    case OP_POP_JUMP_IF_FALSE:
+        jit_emit_grow_stack(buffer, -value);
+        jit_emit_jump_if_false(buffer, 0, offset + 3 + jit_read_short(ip));
+        return true;
+    case OP_POP_JUMP_IF_FALSE_LONG:
+        jit_emit_grow_stack(buffer, -value);
+        jit_emit_jump_if_false(buffer, 0, offset + 4 + (int)jit_read_long(ip));
+        return true;
+    default:
+        jit_emit_exit(buffer, ip);
+        return false;
+    }
+}
+
+void jit_write_perf_map(const char *name, uint8_t *code, size_t size)
+{
+    static FILE *map = NULL;
+    static bool failed = false;
+
+    if (map == NULL && !failed)
+    {
+        char path[64];
+        snprintf(path, sizeof(path), "/tmp/perf-%d.map", (int)getpid());
+        map = fopen(path, "w");
+        failed = map == NULL;
+    }
+
+    if (map == NULL)
+        return;
+
+    fprintf(map, "%lx %zx lisb:%s\n", (unsigned long)(uintptr_t)code, size, name);
+    fflush(map);
+}
+
+uint8_t *jit_install(JitBuffer *buffer, size_t *size)
+{
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    *size = ((size_t)buffer->count + page - 1) / page * page;
+    uint8_t *code = mmap(NULL, *size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (code != MAP_FAILED)
+    {
+        memcpy(code, buffer->code, buffer->count);
+
+        if (mprotect(code, *size, PROT_READ | PROT_EXEC) != 0)
+        {
+            munmap(code, *size);
+            code = MAP_FAILED;
+        }
+    }
+
+    MEMORY_FREE_ARRAY(uint8_t, buffer->code, buffer->capacity);
+    MEMORY_FREE_ARRAY(JitFixup, buffer->fixups, buffer->fixup_capacity);
+
+    if (code == MAP_FAILED)
+    {
+        // Without executable memory nothing is compiled again, and every
+        // function stays with the interpreter.
+        jit_enabled = false;
+        return NULL;
+    }
+
+    return code;
+}
+
+bool jit_compile(ObjFunction *function)
+{
+    if (!jit_enabled || function->jit != NULL)
+        return function->jit != NULL;
+
+    Chunk *chunk = &function->chunk;
+    JitBuffer buffer = {NULL, 0, 0, NULL, 0, 0, 0};
+    int *entries = MEMORY_ALLOCATE(int, chunk->count);
+
+    for (int offset = 0; offset < chunk->count; offset++)
+        entries[offset] = -1;
+
+    jit_emit_prologue(&buffer);
+
+    int *starts = MEMORY_ALLOCATE(int, chunk->count);
+
+    for (int offset = 0; offset < chunk->count; offset += chunk_instruction_size(chunk, offset))
+    {
+        starts[offset] = buffer.count;
+
+        // Instructions left to the interpreter are not entered at, their
+        // code only leaves again.
+        if (jit_emit_instruction(&buffer, chunk, offset))
+            entries[offset] = starts[offset];
+    }
+
+    // The exits of instructions that found operands they can't handle.
+    for (int i = 0; i < buffer.fixup_count; i++)
+    {
+        JitFixup *fixup = &buffer.fixups[i];
+
+        if (fixup->exit)
+        {
+            int exit = buffer.count;
+            jit_emit_exit(&buffer, chunk->code + fixup->target);
+            fixup->target = exit;
+        }
+        else
+        {
+            fixup->target = starts[fixup->target];
+        }
+
+        jit_patch_u32(&buffer, fixup->position, (uint32_t)(fixup->target - (fixup->position + 4)));
+    }
+
+    MEMORY_FREE_ARRAY(int, starts, chunk->count);
+
+    int count = buffer.count;
+    size_t size;
+    uint8_t *code = jit_install(&buffer, &size);
+
+    if (code == NULL)
+    {
+        MEMORY_FREE_ARRAY(int, entries, chunk->count);
+        return false;
+    }
+
+    char name[32];
+    snprintf(name, sizeof(name), "procedure_%zu", function->id);
+    jit_write_perf_map(name, code, (size_t)count);
+
+    JitCode *jit = MEMORY_ALLOCATE(JitCode, 1);
+    jit->code = code;
+    jit->size = size;
+    jit->entries = entries;
+    jit->entry_count = chunk->count;
+    jit->procedure = NULL;
+    function->jit = jit;
+
+    return true;
+}
+
+#else
+
+uint8_t *jit_run(CallFrame *frame)
+{
+    JitProcedure procedure = frame->closure->function->jit->procedure;
+    return procedure != NULL ? procedure(frame) : frame->ip;
+}
+
+bool jit_compile(ObjFunction *function)
+{
+    (void)function;
+    return false;
+}
+
+#endif
\ No newline at end of file
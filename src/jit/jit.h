@@ -0,0 +1,115 @@
+#ifndef _JIT_H
+#define _JIT_H
+
+#include <common/common.h>
+#include <object/object.h>
+#include <vm/vm.h>
+
+// The JIT writes x86-64 code into anonymous mappings, which every Linux
+// has. Elsewhere --jit and --trace are ignored with a warning.
+#if defined(__x86_64__) && defined(__linux__)
+#define JIT_SUPPORTED
+#endif
+
+// The calls and backward jumps after which a function is compiled.
+#ifndef JIT_HOT_COUNT
+#define JIT_HOT_COUNT 64
+#endif
+
+// Code compiled ahead of time, see aot.h. It is entered at the frame's ip
+// and returns the ip to go on at, like the machine code.
+typedef uint8_t *(*JitProcedure)(CallFrame *frame);
+
+// Machine code of a function, with the offset into it of each instruction
+// that the code can be entered at, or -1. Or else a procedure.
+typedef struct JitCode
+{
+    uint8_t *code;
+    size_t size;
+    int *entries;
+    int entry_count;
+    JitProcedure procedure;
+} JitCode;
+
+// Off by default, and always off where there is no code generator, which is
+// everywhere but x86-64 Linux. Turned off for good when executable memory
+// can't be had.
+void jit_set_enabled(bool enabled);
+bool jit_is_enabled();
+
+bool jit_compile(ObjFunction *function);
+void jit_attach_procedure(ObjFunction *function, JitProcedure procedure);
+void jit_free_code(ObjFunction *function);
+
+// Runs the machine code of the frame's function from the frame's ip, and
+// returns the ip of the first instruction it leaves to the interpreter.
+// The code works on the VM stack and frame like the interpreter does and
+// keeps no values of its own, so continuations and the collector's roots
+// need not know about it. It leaves calls, returns and anything that
+// allocates or fails to the interpreter, which runs that one instruction
+// and then enters the code again.
+uint8_t *jit_run(CallFrame *frame);
+
+// The assembler, which the tracing compiler shares. Registers are numbered
+// as in the instruction encoding, and xmm registers by their number.
+typedef enum
+{
+    JIT_RAX,
+    JIT_RCX,
+    JIT_RDX,
+    JIT_RBX,
+    JIT_RSP,
+    JIT_RBP,
+    JIT_RSI,
+    JIT_RDI,
+    JIT_R12 = 12,
+    JIT_R13,
+    JIT_R14,
+    JIT_R15,
+} JitRegister;
+
+// A rel32 at position that must be made to reach the instruction at target,
+// or the exit that leaves to the interpreter there.
+typedef struct
+{
+    int position;
+    int target;
+    bool exit;
+} JitFixup;
+
+typedef struct
+{
+    uint8_t *code;
+    int count;
+    int capacity;
+    JitFixup *fixups;
+    int fixup_count;
+    int fixup_capacity;
+    int epilogue;
+} JitBuffer;
+
+void jit_emit_byte(JitBuffer *buffer, uint8_t byte);
+void jit_emit_bytes(JitBuffer *buffer, const uint8_t *bytes, int count);
+void jit_emit_u32(JitBuffer *buffer, uint32_t value);
+void jit_emit_u64(JitBuffer *buffer, uint64_t value);
+void jit_patch_u32(JitBuffer *buffer, int position, uint32_t value);
+void jit_add_fixup(JitBuffer *buffer, int target, bool exit);
+
+// An instruction whose operands are reg and [base + disp].
+void jit_emit_memory(JitBuffer *buffer, uint8_t prefix, bool wide, uint16_t opcode,
+                     int reg, int base, int32_t disp);
+// An instruction whose operands are both registers.
+void jit_emit_register(JitBuffer *buffer, uint8_t prefix, bool wide, uint16_t opcode, int reg, int rm);
+void jit_emit_move_immediate(JitBuffer *buffer, int reg, uint64_t value);
+// mov dword [base + disp], type
+void jit_emit_store_type(JitBuffer *buffer, int base, int32_t disp, ValueType type);
+
+// Copies the buffer to executable memory and frees it, or returns NULL and
+// turns the compiler off when there is none to be had.
+uint8_t *jit_install(JitBuffer *buffer, size_t *size);
+void jit_uninstall(uint8_t *code, size_t size);
+
+// Names code for perf in /tmp/perf-<pid>.map.
+void jit_write_perf_map(const char *name, uint8_t *code, size_t size);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,163 @@
+#ifndef _JIT_TEST_H
+#define _JIT_TEST_H
+
+#include <jit/jit.h>
+#include <compiler/compiler.h>
+#include <memory/memory.h>
+#include <table/table.h>
+#include <CUnit/Basic.h>
+
+#include <string.h>
+
+// A loop over fixnums and flonums, long enough for the JIT to compile it.
+static const char *jit_test_source = "(define result\n"
+                                     "  (let loop ((i 0) (n 0) (x 0.0))\n"
+                                     "    (if (= i 1000)\n"
+                                     "        (+ n (* x 2))\n"
+                                     "        (loop (+ i 1) (+ n (* i 3)) (+ x 0.5)))))";
+
+// Runs source and returns its global result. Sets compiled to whether the
+// script, or a function among its constants, has machine code.
+static Value jit_test_run(const char *source, bool *compiled)
+{
+    vm_init_vm();
+
+    ObjFunction *script = compiler_compile(source);
+    *compiled = false;
+
+    if (script == NULL)
+    {
+        vm_free_vm();
+        return VALUE_VOID_VAL;
+    }
+
+    vm_push(VALUE_OBJ_VAL(script));
+    CU_ASSERT_EQUAL(vm_interpret_function(script), VM_OK);
+
+    *compiled = script->jit != NULL;
+
+    for (int i = 0; i < script->chunk.constants.count; i++)
+    {
+        Value constant = script->chunk.constants.values[i];
+
+        if (OBJECT_IS_FUNCTION(constant) && OBJECT_AS_FUNCTION(constant)->jit != NULL)
+            *compiled = true;
+    }
+
+    int slot = table_find_entry(&vm.globals, "result", 6);
+    Value result = slot == -1 ? VALUE_VOID_VAL : table_get(&vm.globals, slot);
+
+    vm_free_vm();
+    return result;
+}
+
+void jit_run_test()
+{
+    bool compiled;
+    Value expected = jit_test_run(jit_test_source, &compiled);
+    CU_ASSERT_TRUE(VALUE_IS_FLONUM(expected));
+    CU_ASSERT_EQUAL(VALUE_AS_FLONUM(expected), 1499500.0);
+    CU_ASSERT_FALSE(compiled);
+
+    jit_set_enabled(true);
+
+#ifdef JIT_SUPPORTED
+    CU_ASSERT_TRUE(jit_is_enabled());
+#else
+    CU_ASSERT_FALSE(jit_is_enabled());
+#endif
+
+    // The same result from machine code, for stack and for register code
+    for (int registers = 0; registers < 2; registers++)
+    {
+        compiler_set_register_code(registers);
+
+        Value result = jit_test_run(jit_test_source, &compiled);
+        CU_ASSERT_TRUE(VALUE_IS_FLONUM(result));
+        CU_ASSERT_EQUAL(VALUE_AS_FLONUM(result), VALUE_AS_FLONUM(expected));
+        CU_ASSERT_EQUAL(compiled, jit_is_enabled());
+    }
+
+    compiler_set_register_code(false);
+    jit_set_enabled(false);
+}
+
+#ifdef JIT_SUPPORTED
+
+// Whether the buffer holds exactly the bytes, which it then forgets.
+static bool jit_test_emitted(JitBuffer *buffer, const uint8_t *bytes, int count)
+{
+    bool emitted = buffer->count == count && memcmp(buffer->code, bytes, count) == 0;
+    buffer->count = 0;
+    return emitted;
+}
+
+void jit_encoding_test()
+{
+    vm_init_vm();
+
+    JitBuffer buffer = {NULL, 0, 0, NULL, 0, 0, 0};
+
+    // mov rax, imm64 and mov r12, imm64
+    jit_emit_move_immediate(&buffer, JIT_RAX, 0x1122334455667788);
+    const uint8_t move_rax[] = {0x48, 0xb8, 0x88, 0x77, 0x66, 0x55, 0x44, 0x33, 0x22, 0x11};
+    CU_ASSERT_TRUE(jit_test_emitted(&buffer, move_rax, sizeof(move_rax)));
+
+    jit_emit_move_immediate(&buffer, JIT_R12, 1);
+    const uint8_t move_r12[] = {0x49, 0xbc, 0x01, 0, 0, 0, 0, 0, 0, 0};
+    CU_ASSERT_TRUE(jit_test_emitted(&buffer, move_r12, sizeof(move_r12)));
+
+    // mov rax, [r12 + 16], which needs a SIB byte
+    jit_emit_memory(&buffer, 0, true, 0x8b, JIT_RAX, JIT_R12, 16);
+    const uint8_t load_r12[] = {0x49, 0x8b, 0x44, 0x24, 0x10};
+    CU_ASSERT_TRUE(jit_test_emitted(&buffer, load_r12, sizeof(load_r12)));
+
+    // mov rax, [rbp], which has no form without a displacement
+    jit_emit_memory(&buffer, 0, true, 0x8b, JIT_RAX, JIT_RBP, 0);
+    const uint8_t load_rbp[] = {0x48, 0x8b, 0x45, 0x00};
+    CU_ASSERT_TRUE(jit_test_emitted(&buffer, load_rbp, sizeof(load_rbp)));
+
+    // mov r13, [rbx + 512] and mov ecx, [rdi - 8]
+    jit_emit_memory(&buffer, 0, true, 0x8b, JIT_R13, JIT_RBX, 512);
+    const uint8_t load_far[] = {0x4c, 0x8b, 0xab, 0x00, 0x02, 0x00, 0x00};
+    CU_ASSERT_TRUE(jit_test_emitted(&buffer, load_far, sizeof(load_far)));
+
+    jit_emit_memory(&buffer, 0, false, 0x8b, JIT_RCX, JIT_RDI, -8);
+    const uint8_t load_narrow[] = {0x8b, 0x4f, 0xf8};
+    CU_ASSERT_TRUE(jit_test_emitted(&buffer, load_narrow, sizeof(load_narrow)));
+
+    // add rax, rcx and addsd xmm0, xmm1
+    jit_emit_register(&buffer, 0, true, 0x01, JIT_RCX, JIT_RAX);
+    const uint8_t add[] = {0x48, 0x01, 0xc8};
+    CU_ASSERT_TRUE(jit_test_emitted(&buffer, add, sizeof(add)));
+
+    jit_emit_register(&buffer, 0xf2, false, 0x0f58, 0, 1);
+    const uint8_t addsd[] = {0xf2, 0x0f, 0x58, 0xc1};
+    CU_ASSERT_TRUE(jit_test_emitted(&buffer, addsd, sizeof(addsd)));
+
+    // mov dword [rdi + 8], VALUE_FIXNUM
+    jit_emit_store_type(&buffer, JIT_RDI, 8, VALUE_FIXNUM);
+    const uint8_t store[] = {0xc7, 0x47, 0x08, VALUE_FIXNUM, 0, 0, 0};
+    CU_ASSERT_TRUE(jit_test_emitted(&buffer, store, sizeof(store)));
+
+    // A fixup leaves room for its rel32 and remembers where
+    jit_emit_byte(&buffer, 0xe9);
+    jit_add_fixup(&buffer, 42, false);
+    CU_ASSERT_EQUAL(buffer.count, 5);
+    CU_ASSERT_EQUAL(buffer.fixup_count, 1);
+    CU_ASSERT_EQUAL(buffer.fixups[0].position, 1);
+    CU_ASSERT_EQUAL(buffer.fixups[0].target, 42);
+
+    jit_patch_u32(&buffer, 1, 0xfffffffb);
+    const uint8_t jump[] = {0xe9, 0xfb, 0xff, 0xff, 0xff};
+    CU_ASSERT_TRUE(jit_test_emitted(&buffer, jump, sizeof(jump)));
+
+    MEMORY_FREE_ARRAY(uint8_t, buffer.code, buffer.capacity);
+    MEMORY_FREE_ARRAY(JitFixup, buffer.fixups, buffer.fixup_capacity);
+
+    vm_free_vm();
+}
+
+#endif
+
+#endif
\ No newline at end of file
@@ -2,6 +2,12 @@
 #include <chunk/chunk.h>
 #include <debug/debug.h>
 #include <vm/vm.h>
+#include <compiler/compiler.h>
+#include <serialize/serialize.h>
+#include <image/image.h>
+#include <jit/jit.h>
+#include <trace/trace.h>
+#include <aot/aot.h>
 
 #include <readline/readline.h>
 #include <readline/history.h>
@@ -27,6 +33,7 @@ bool is_closed(char *str)
 
 int rlgets(char *buffer, const int n, const int line_count)
 {
+	(void)line_count;
 	char prompt[256];
 	char *line = NULL;
 	int length = 0;
@@ -47,7 +54,7 @@ int rlgets(char *buffer, const int n, const int line_count)
 			return 0;
 		}
 
-		strncpy(buffer, line, length);
+		memcpy(buffer, line, length);
 		buffer[length++] = '\n';
 		free(line);
 	}
@@ -119,36 +126,143 @@ static char *main_read_file(const char *path)
 	return buffer;
 }
 
-static void main_run_file(const char *path)
+// The .lisbc cache is skipped on top of an image: the code compiled for a
+// script depends on the globals it finds, such as whether + is still the
+// primitive, and an image's prelude may have changed them.
+static void main_run_file(const char *path, bool cache)
 {
 	char *source = main_read_file(path);
-	InterpretResult result = vm_interpret(source);
+	ObjFunction *function = cache ? serialize_read_cache(path, source) : NULL;
+
+	if (function == NULL)
+	{
+		function = compiler_compile(source);
+
+		if (function == NULL)
+		{
+			free(source);
+			exit(65);
+		}
+
+		// Failing to write the cache is not an error, the next run simply
+		// compiles again.
+		if (cache)
+		{
+			vm_push(VALUE_OBJ_VAL(function));
+			serialize_write_cache(path, source, function);
+			vm_pop();
+		}
+	}
+
 	free(source);
+	InterpretResult result = vm_interpret_function(function);
 
-	if (result == VM_COMPILE_ERROR)
-		exit(65);
 	if (result == VM_RUNTIME_ERROR)
 		exit(70);
 }
 
+static void main_emit_c(const char *path)
+{
+	char *source = main_read_file(path);
+	bool emitted = aot_emit_c(path, source, stdout);
+
+	free(source);
+
+	if (!emitted)
+		exit(65);
+}
+
+static void main_usage()
+{
+	fprintf(stderr, "Usage: lisb [--registers] [--jit] [--trace] [--image image] [path]\n"
+					"       lisb [--registers] --emit-c path\n"
+					"       lisb --dump-image image [prelude]\n");
+	exit(64);
+}
+
 int main(int argc, char **argv)
 {
-	vm_init_vm();
+	if (argc > 1 && strcmp(argv[1], "--dump-image") == 0)
+	{
+		// Runs the prelude, if any, and snapshots the resulting globals.
+		if (argc < 3 || argc > 4)
+			main_usage();
+
+		vm_init_vm();
+		// Scripts run on top of the image may assign its globals.
+		compiler_set_whole_program(false);
+
+		if (argc == 4)
+			main_run_file(argv[3], true);
 
-	if (argc == 1)
+		if (!image_dump(argv[2]))
+			exit(74);
+
+		vm_free_vm();
+		return 0;
+	}
+
+	int arg = 1;
+
+	for (; argc > arg; arg++)
 	{
+		if (strcmp(argv[arg], "--registers") == 0)
+			compiler_set_register_code(true);
+		else if (strcmp(argv[arg], "--jit") == 0)
+		{
+			jit_set_enabled(true);
+
+			if (!jit_is_enabled())
+				fprintf(stderr, "The JIT isn't supported on this platform, ignoring --jit.\n");
+		}
+		else if (strcmp(argv[arg], "--trace") == 0)
+		{
+			trace_set_enabled(true);
+
+			if (!trace_is_enabled())
+				fprintf(stderr, "The JIT isn't supported on this platform, ignoring --trace.\n");
+		}
+		else
+			break;
+	}
+
+	bool image = argc > arg && strcmp(argv[arg], "--image") == 0;
+
+	if (image)
+	{
+		if (argc < arg + 2)
+			main_usage();
+
+		if (!vm_init_vm_from_image(argv[arg + 1]))
+			exit(74);
+
+		arg += 2;
+	}
+	else
+	{
+		vm_init_vm();
+	}
+
+	if (argc == arg)
+	{
+		// Every line is compiled on its own, later ones may assign what
+		// earlier ones defined.
+		compiler_set_whole_program(false);
 		main_repl();
 	}
-	else if (argc == 2)
+	else if (argc == arg + 2 && strcmp(argv[arg], "--emit-c") == 0)
 	{
-		main_run_file(argv[1]);
+		main_emit_c(argv[arg + 1]);
+	}
+	else if (argc == arg + 1)
+	{
+		main_run_file(argv[arg], !image);
 	}
 	else
 	{
-		fprintf(stderr, "Usage: lisb [path]\n");
-		exit(64);
+		main_usage();
 	}
 
 	vm_free_vm();
 	return 0;
-}
+}
\ No newline at end of file
@@ -1,6 +1,17 @@
 #include <CUnit/Basic.h>
 #include <scanner/scanner.test.h>
 #include <parser/parser.test.h>
+#include <value/value.test.h>
+#include <bignum/bignum.test.h>
+#include <serialize/serialize.test.h>
+#include <image/image.test.h>
+#include <compiler/compiler.test.h>
+#include <chunk/chunk.test.h>
+#include <optimizer/optimizer.test.h>
+#include <jit/jit.test.h>
+#include <aot/aot.test.h>
+#include <trace/trace.test.h>
+#include <vector/vector.test.h>
 
 #define TEST_SIZE(arr) (sizeof(arr) / sizeof(TestPair))
 
@@ -27,6 +38,7 @@ int main()
 
 	TestPair scanner_tests[] = {
 		{"scanner_scan_token_test", scanner_scan_token_test},
+		{"scanner_scan_keyword_test", scanner_scan_keyword_test},
 	};
 
 	TestPair parser_tests[] = {
@@ -60,6 +72,15 @@ int main()
 		{"parser_parse_let_test_1", parser_parse_let_test_1},
 		{"parser_parse_let_test_2", parser_parse_let_test_2},
 		{"parser_parse_let_test_3", parser_parse_let_test_3},
+		{"parser_parse_named_let_test_1", parser_parse_named_let_test_1},
+		{"parser_parse_do_test_1", parser_parse_do_test_1},
+		{"parser_parse_case_test_1", parser_parse_case_test_1},
+		{"parser_parse_cond_test_1", parser_parse_cond_test_1},
+		{"parser_parse_cond_fail_test_1", parser_parse_cond_fail_test_1},
+		{"parser_parse_and_test_1", parser_parse_and_test_1},
+		{"parser_parse_or_test_1", parser_parse_or_test_1},
+		{"parser_parse_when_test_1", parser_parse_when_test_1},
+		{"parser_parse_unless_fail_test_1", parser_parse_unless_fail_test_1},
 		{"parser_parse_begin_test_1", parser_parse_begin_test_1},
 		{"parser_parse_begin_test_2", parser_parse_begin_test_2},
 		{"parser_parse_begin_fail_test_1", parser_parse_begin_fail_test_1},
@@ -78,9 +99,86 @@ int main()
 		{"parser_parse_application_test_4", parser_parse_application_test_4},
 	};
 
+	TestPair value_tests[] = {
+		{"value_format_flonum_test", value_format_flonum_test},
+	};
+
+	TestPair bignum_tests[] = {
+		{"bignum_fixnum_boundary_test", bignum_fixnum_boundary_test},
+		{"bignum_karatsuba_test", bignum_karatsuba_test},
+		{"bignum_divide_test", bignum_divide_test},
+		{"bignum_division_signs_test", bignum_division_signs_test},
+		{"bignum_radix_test", bignum_radix_test},
+	};
+
+	TestPair serialize_tests[] = {
+		{"serialize_reader_test", serialize_reader_test},
+		{"serialize_cache_test", serialize_cache_test},
+	};
+
+	TestPair image_tests[] = {
+		{"image_round_trip_test", image_round_trip_test},
+		{"image_load_fail_test", image_load_fail_test},
+	};
+
+	TestPair compiler_tests[] = {
+		{"compiler_long_constant_test", compiler_long_constant_test},
+		{"compiler_long_local_test", compiler_long_local_test},
+		{"compiler_long_jump_test", compiler_long_jump_test},
+	};
+
+	TestPair chunk_tests[] = {
+		{"chunk_switch_number_test", chunk_switch_number_test},
+		{"chunk_dense_switch_test", chunk_dense_switch_test},
+		{"chunk_hashed_switch_test", chunk_hashed_switch_test},
+		{"chunk_numeric_switch_test", chunk_numeric_switch_test},
+		{"chunk_switch_dispatch_test", chunk_switch_dispatch_test},
+	};
+
+	TestPair optimizer_tests[] = {
+		{"optimizer_thread_jumps_test", optimizer_thread_jumps_test},
+		{"optimizer_jump_chain_test", optimizer_jump_chain_test},
+		{"optimizer_fuse_conditional_pops_test", optimizer_fuse_conditional_pops_test},
+		{"optimizer_narrow_jumps_test", optimizer_narrow_jumps_test},
+	};
+
+	TestPair jit_tests[] = {
+		{"jit_run_test", jit_run_test},
+#ifdef JIT_SUPPORTED
+		{"jit_encoding_test", jit_encoding_test},
+#endif
+	};
+
+	TestPair aot_tests[] = {
+		{"aot_emit_test", aot_emit_test},
+		{"aot_emit_registers_test", aot_emit_registers_test},
+		{"aot_emit_failure_test", aot_emit_failure_test},
+	};
+
+	TestPair trace_tests[] = {
+		{"trace_run_test", trace_run_test},
+	};
+
+	TestPair vector_tests[] = {
+		{"vector_add_multiply_test", vector_add_multiply_test},
+		{"vector_sum_dot_test", vector_sum_dot_test},
+		{"vector_fill_test", vector_fill_test},
+	};
+
 	SuitPair tests[] = {
 		{"scanner_tests", scanner_tests, TEST_SIZE(scanner_tests)},
 		{"parser_tests", parser_tests, TEST_SIZE(parser_tests)},
+		{"value_tests", value_tests, TEST_SIZE(value_tests)},
+		{"bignum_tests", bignum_tests, TEST_SIZE(bignum_tests)},
+		{"serialize_tests", serialize_tests, TEST_SIZE(serialize_tests)},
+		{"image_tests", image_tests, TEST_SIZE(image_tests)},
+		{"compiler_tests", compiler_tests, TEST_SIZE(compiler_tests)},
+		{"chunk_tests", chunk_tests, TEST_SIZE(chunk_tests)},
+		{"optimizer_tests", optimizer_tests, TEST_SIZE(optimizer_tests)},
+		{"jit_tests", jit_tests, TEST_SIZE(jit_tests)},
+		{"aot_tests", aot_tests, TEST_SIZE(aot_tests)},
+		{"trace_tests", trace_tests, TEST_SIZE(trace_tests)},
+		{"vector_tests", vector_tests, TEST_SIZE(vector_tests)},
 	};
 
 	for (int i = 0; i < sizeof(tests) / sizeof(SuitPair); i++)
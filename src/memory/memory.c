@@ -1,6 +1,8 @@
 #include <memory/memory.h>
 #include <vm/vm.h>
 #include <compiler/compiler.h>
+#include <jit/jit.h>
+#include <trace/trace.h>
 
 #include <stdlib.h>
 
@@ -19,7 +21,7 @@ void *memory_reallocate(void *pointer, size_t old_size, size_t new_size)
 {
     memory.bytes_allocated += new_size - old_size;
 
-    if (new_size > old_size)
+    if (new_size > old_size && !memory.paused)
     {
 #ifdef DEBUG_STRESS_GC
         memory_collect_garbage();
@@ -45,11 +47,21 @@ void *memory_reallocate(void *pointer, size_t old_size, size_t new_size)
     return result;
 }
 
+static void memory_blacken_object(Obj *object);
+
 void memory_mark_object(Obj *object)
 {
     if (object == NULL)
         return;
 
+    // Closures in the VM arena are never swept, so they are traced right
+    // away rather than marked. They can't refer to each other.
+    if (vm_in_arena(object))
+    {
+        memory_blacken_object(object);
+        return;
+    }
+
     if (object->is_marked)
         return;
 
@@ -109,7 +121,7 @@ static void memory_blacken_object(Obj *object)
         memory_mark_object((Obj *)closure->function);
         for (int i = 0; i < closure->upvalue_count; i++)
         {
-            memory_mark_object((Obj *)closure->upvalues[i]);
+            memory_mark_value(closure->upvalues[i]);
         }
         break;
     }
@@ -122,14 +134,17 @@ static void memory_blacken_object(Obj *object)
     case OBJ_FUNCTION:
     {
         ObjFunction *function = (ObjFunction *)object;
+        memory_mark_object((Obj *)function->source);
         memory_mark_array(&function->chunk.constants);
         break;
     }
     case OBJ_UPVALUE:
         memory_mark_value(((ObjUpvalue *)object)->closed);
         break;
+    case OBJ_BIGNUM:
     case OBJ_NATIVE:
     case OBJ_STRING:
+    case OBJ_VECTOR:
         break;
     }
 }
@@ -146,11 +161,13 @@ static void memory_free_object(Obj *object)
 
     switch (object->type)
     {
+    case OBJ_BIGNUM:
+        memory_reallocate(object, sizeof(ObjBignum) + sizeof(uint32_t) * ((ObjBignum *)object)->count, 0);
+        break;
     case OBJ_CLOSURE:
     {
         ObjClosure *closure = (ObjClosure *)object;
-        MEMORY_FREE_ARRAY(ObjUpvalue *, closure->upvalues, closure->upvalue_count);
-        MEMORY_FREE(ObjClosure, object);
+        memory_reallocate(object, sizeof(ObjClosure) + sizeof(Value) * closure->upvalue_count, 0);
         break;
     }
     case OBJ_CONTINUATION:
@@ -162,6 +179,8 @@ static void memory_free_object(Obj *object)
     case OBJ_FUNCTION:
     {
         ObjFunction *function = (ObjFunction *)object;
+        jit_free_code(function);
+        trace_free_traces(function);
         chunk_free_chunk(&function->chunk);
         MEMORY_FREE(ObjFunction, object);
         break;
@@ -179,6 +198,12 @@ static void memory_free_object(Obj *object)
     case OBJ_UPVALUE:
         MEMORY_FREE(ObjUpvalue, object);
         break;
+    case OBJ_VECTOR:
+    {
+        ObjVector *vector = (ObjVector *)object;
+        memory_reallocate(object, sizeof(ObjVector) + object_vector_element_size(vector->kind) * vector->length, 0);
+        break;
+    }
     }
 }
 
@@ -191,12 +216,13 @@ static void memory_mark_roots(VM *vm)
 
     for (int i = 0; i < vm->frame_count; i++)
     {
-        memory_mark_object((Obj *)vm->call_frames[i].closure);
-    }
+        CallFrame *frame = &vm->call_frames[i];
+        memory_mark_object((Obj *)frame->closure);
 
-    for (ObjUpvalue *upvalue = vm->open_upvalues; upvalue != NULL; upvalue = upvalue->next)
-    {
-        memory_mark_object((Obj *)upvalue);
+        for (ObjUpvalue *upvalue = frame->open_upvalues; upvalue != NULL; upvalue = upvalue->next)
+        {
+            memory_mark_object((Obj *)upvalue);
+        }
     }
 
     table_mark_table(&vm->globals);
@@ -289,4 +315,5 @@ void memory_init_memory()
 
     memory.bytes_allocated = 0;
     memory.next_gc = 1024 * 1024;
+    memory.paused = false;
 }
\ No newline at end of file
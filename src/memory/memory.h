@@ -26,6 +26,9 @@ typedef struct
     int gray_capacity;
     size_t bytes_allocated;
     size_t next_gc;
+    // Set while objects are allocated that are not yet reachable from any
+    // root, such as the heap of an image being loaded.
+    bool paused;
 } Memory;
 
 extern Memory memory;
@@ -1,4 +1,6 @@
 #include <object/object.h>
+#include <bignum/bignum.h>
+#include <vector/vector.h>
 #include <memory/memory.h>
 #include <value/value.h>
 #include <table/table.h>
@@ -8,11 +10,11 @@
 #include <string.h>
 #include <stdlib.h>
 
-typedef struct ObjContinuation
+struct ObjContinuation
 {
     Obj obj;
     State state;
-} ObjContinuation;
+};
 
 size_t next_id = 1;
 
@@ -34,20 +36,59 @@ static Obj *object_allocate_object(size_t size, ObjType type)
     return object;
 }
 
+// The digits are left for the caller to fill in.
+ObjBignum *object_new_bignum(bool negative, int count)
+{
+    ObjBignum *bignum = (ObjBignum *)object_allocate_object(
+        sizeof(ObjBignum) + sizeof(uint32_t) * count, OBJ_BIGNUM);
+    bignum->negative = negative;
+    bignum->count = count;
+    return bignum;
+}
+
+// The elements start out as zeros.
+ObjVector *object_new_vector(VectorKind kind, int length)
+{
+    size_t size = object_vector_element_size(kind) * length;
+    ObjVector *vector = (ObjVector *)object_allocate_object(sizeof(ObjVector) + size, OBJ_VECTOR);
+    vector->kind = kind;
+    vector->length = length;
+    memset(vector->elements, 0, size);
+    return vector;
+}
+
 ObjClosure *object_new_closure(ObjFunction *function)
 {
-    ObjUpvalue **upvalues = MEMORY_ALLOCATE(ObjUpvalue *, function->upvalue_count);
+    // The upvalues are allocated along with the closure.
+    ObjClosure *closure = (ObjClosure *)object_allocate_object(
+        sizeof(ObjClosure) + sizeof(Value) * function->upvalue_count, OBJ_CLOSURE);
+    closure->function = function;
+    closure->upvalue_count = function->upvalue_count;
 
     for (int i = 0; i < function->upvalue_count; i++)
     {
-        upvalues[i] = NULL;
+        closure->upvalues[i] = VALUE_NULL_VAL;
     }
 
-    ObjClosure *closure = OBJECT_ALLOCATE_OBJ(ObjClosure, OBJ_CLOSURE);
+    return closure;
+}
+
+// Builds a closure in slots of the VM arena. It is not linked into the heap
+// and is released along with the frame that reserved the slots.
+ObjClosure *object_init_stack_closure(Value *slots, ObjFunction *function)
+{
+    ObjClosure *closure = (ObjClosure *)slots;
+    closure->obj.type = OBJ_CLOSURE;
+    closure->obj.is_marked = false;
+    closure->obj.next = NULL;
     closure->function = function;
-    closure->upvalues = upvalues;
     closure->upvalue_count = function->upvalue_count;
 
+    for (int i = 0; i < function->upvalue_count; i++)
+    {
+        closure->upvalues[i] = VALUE_NULL_VAL;
+    }
+
     return closure;
 }
 
@@ -58,8 +99,8 @@ ObjContinuation *object_new_continuation()
     memcpy(cont->state.call_frames, vm.call_frames, sizeof(CallFrame) * VM_FRAMES_MAX);
     memcpy(cont->state.stack, vm.stack, sizeof(Value) * VM_STACK_MAX);
     cont->state.frame_count = vm.frame_count;
-    cont->state.open_upvalues = vm.open_upvalues;
     cont->state.stack_top = vm.stack_top;
+    memcpy(cont->state.arena, vm.arena, sizeof(Value) * (vm_arena_top() - vm.arena));
 
     return cont;
 }
@@ -69,7 +110,13 @@ ObjFunction *object_new_script()
     ObjFunction *function = OBJECT_ALLOCATE_OBJ(ObjFunction, OBJ_FUNCTION);
     function->arity = 0;
     function->upvalue_count = 0;
+    function->arena_size = 0;
     function->id = 0;
+    function->source = NULL;
+    function->line = 0;
+    function->calls = 0;
+    function->jit = NULL;
+    function->traces = NULL;
     chunk_init_chunk(&function->chunk);
     return function;
 }
@@ -81,12 +128,13 @@ ObjFunction *object_new_function()
     return function;
 }
 
-static ObjString *object_allocate_string(char *chars, int length)
+static ObjString *object_allocate_string(char *chars, int length, uint32_t hash)
 {
     ObjString *string = OBJECT_ALLOCATE_OBJ(ObjString, OBJ_STRING);
 
     string->length = length;
     string->chars = chars;
+    string->hash = hash;
 
     // Push then pop the string to the constant table so it doesn't get
     // garbage collected before being interned
@@ -98,39 +146,30 @@ static ObjString *object_allocate_string(char *chars, int length)
     return string;
 }
 
-static uint32_t object_hash_string(const char *key, int length)
-{
-    uint32_t hash = 2166136261u;
-    for (int i = 0; i < length; i++)
-    {
-        hash ^= (uint8_t)key[i];
-        hash *= 16777619;
-    }
-    return hash;
-}
-
 ObjString *object_take_string(char *chars, int length)
 {
-    ObjString *interned = table_find_string(&vm.strings, chars, length);
+    uint32_t hash = table_hash_string(chars, length);
+    ObjString *interned = table_find_string(&vm.strings, chars, length, hash);
     if (interned != NULL)
     {
         MEMORY_FREE_ARRAY(char, chars, length + 1);
         return interned;
     }
 
-    return object_allocate_string(chars, length);
+    return object_allocate_string(chars, length, hash);
 }
 
 ObjString *object_copy_string(const char *chars, int length)
 {
-    ObjString *interned = table_find_string(&vm.strings, chars, length);
+    uint32_t hash = table_hash_string(chars, length);
+    ObjString *interned = table_find_string(&vm.strings, chars, length, hash);
     if (interned != NULL)
         return interned;
 
     char *heap_chars = MEMORY_ALLOCATE(char, length + 1);
     memcpy(heap_chars, chars, length);
     heap_chars[length] = '\0';
-    return object_allocate_string(heap_chars, length);
+    return object_allocate_string(heap_chars, length, hash);
 }
 
 ObjUpvalue *object_new_upvalue(Value *slot)
@@ -147,9 +186,10 @@ static void object_print_function(ObjFunction *function)
     printf("#<procedure %u>", (unsigned)function->id);
 }
 
-ObjNative *object_new_native(NativeFn function)
+ObjNative *object_new_native(const char *name, NativeFn function)
 {
     ObjNative *native = OBJECT_ALLOCATE_OBJ(ObjNative, OBJ_NATIVE);
+    native->name = name;
     native->function = function;
     return native;
 }
@@ -159,25 +199,57 @@ void object_load_continuation(ObjContinuation *cont)
     memcpy(vm.call_frames, cont->state.call_frames, sizeof(CallFrame) * VM_FRAMES_MAX);
     memcpy(vm.stack, cont->state.stack, sizeof(Value) * VM_STACK_MAX);
     vm.frame_count = cont->state.frame_count;
-    vm.open_upvalues = cont->state.open_upvalues;
     vm.stack_top = cont->state.stack_top;
+    memcpy(vm.arena, cont->state.arena, sizeof(Value) * (vm_arena_top() - vm.arena));
+
+    memset(vm.open_slots, 0, sizeof(vm.open_slots));
+
+    for (int i = 0; i < vm.frame_count; i++)
+    {
+        for (ObjUpvalue *upvalue = vm.call_frames[i].open_upvalues; upvalue != NULL; upvalue = upvalue->next)
+        {
+            if (upvalue->location != &upvalue->closed)
+                vm.open_slots[upvalue->location - vm.stack] = upvalue;
+        }
+    }
+}
+
+// The saved stack points at the arena closures of the VM, whose slots may
+// have been reused since. Their saved copies are traced instead.
+static void object_mark_continuation_object(ObjContinuation *cont, Obj *object)
+{
+    if (object == NULL || !vm_in_arena(object))
+    {
+        memory_mark_object(object);
+        return;
+    }
+
+    ObjClosure *closure = (ObjClosure *)(cont->state.arena + ((Value *)object - vm.arena));
+    memory_mark_object((Obj *)closure->function);
+
+    for (int i = 0; i < closure->upvalue_count; i++)
+    {
+        memory_mark_value(closure->upvalues[i]);
+    }
 }
 
 void object_mark_continuation(ObjContinuation *cont)
 {
     for (Value *slot = cont->state.stack; slot < cont->state.stack_top; slot++)
     {
-        memory_mark_value(*slot);
+        if (VALUE_IS_OBJ(*slot))
+            object_mark_continuation_object(cont, VALUE_AS_OBJ(*slot));
     }
 
     for (int i = 0; i < cont->state.frame_count; i++)
     {
-        memory_mark_object((Obj *)cont->state.call_frames[i].closure);
-    }
+        CallFrame *frame = &cont->state.call_frames[i];
+        object_mark_continuation_object(cont, (Obj *)frame->closure);
 
-    for (ObjUpvalue *upvalue = cont->state.open_upvalues; upvalue != NULL; upvalue = upvalue->next)
-    {
-        memory_mark_object((Obj *)upvalue);
+        for (ObjUpvalue *upvalue = frame->open_upvalues; upvalue != NULL; upvalue = upvalue->next)
+        {
+            memory_mark_object((Obj *)upvalue);
+        }
     }
 }
 
@@ -190,6 +262,9 @@ void object_print_object(Value value)
 {
     switch (OBJECT_OBJ_TYPE(value))
     {
+    case OBJ_BIGNUM:
+        bignum_print(OBJECT_AS_BIGNUM(value));
+        break;
     case OBJ_CLOSURE:
         object_print_function(OBJECT_AS_CLOSURE(value)->function);
         break;
@@ -208,5 +283,8 @@ void object_print_object(Value value)
     case OBJ_UPVALUE:
         printf("upvalue");
         break;
+    case OBJ_VECTOR:
+        vector_print(OBJECT_AS_VECTOR(value));
+        break;
     }
 }
\ No newline at end of file
@@ -7,27 +7,34 @@
 
 #define OBJECT_OBJ_TYPE(value) (VALUE_AS_OBJ(value)->type)
 
+#define OBJECT_IS_BIGNUM(value) object_is_obj_type(value, OBJ_BIGNUM)
 #define OBJECT_IS_CLOSURE(value) object_is_obj_type(value, OBJ_CLOSURE)
 #define OBJECT_IS_FUNCTION(value) object_is_obj_type(value, OBJ_FUNCTION)
 #define OBJECT_IS_NATIVE(value) object_is_obj_type(value, OBJ_NATIVE)
 #define OBJECT_IS_CONTINUATION(value) object_is_obj_type(value, OBJ_CONTINUATION)
 #define OBJECT_IS_STRING(value) object_is_obj_type(value, OBJ_STRING)
+#define OBJECT_IS_VECTOR(value) object_is_obj_type(value, OBJ_VECTOR)
 
+#define OBJECT_AS_BIGNUM(value) ((ObjBignum *)VALUE_AS_OBJ(value))
 #define OBJECT_AS_CLOSURE(value) ((ObjClosure *)VALUE_AS_OBJ(value))
 #define OBJECT_AS_FUNCTION(value) ((ObjFunction *)VALUE_AS_OBJ(value))
 #define OBJECT_AS_NATIVE(value) (((ObjNative *)VALUE_AS_OBJ(value))->function)
 #define OBJECT_AS_CONTINUATION(value) ((ObjContinuation *)VALUE_AS_OBJ(value))
 #define OBJECT_AS_STRING(value) ((ObjString *)VALUE_AS_OBJ(value))
 #define OBJECT_AS_CSTRING(value) (((ObjString *)VALUE_AS_OBJ(value))->chars)
+#define OBJECT_AS_UPVALUE(value) ((ObjUpvalue *)VALUE_AS_OBJ(value))
+#define OBJECT_AS_VECTOR(value) ((ObjVector *)VALUE_AS_OBJ(value))
 
 typedef enum
 {
+    OBJ_BIGNUM,
     OBJ_CLOSURE,
     OBJ_CONTINUATION,
     OBJ_FUNCTION,
     OBJ_NATIVE,
     OBJ_STRING,
-    OBJ_UPVALUE
+    OBJ_UPVALUE,
+    OBJ_VECTOR
 } ObjType;
 
 struct Obj
@@ -37,13 +44,61 @@ struct Obj
     struct Obj *next;
 };
 
+// An exact integer beyond the fixnums, as a sign and the magnitude in
+// 32-bit digits from the least significant one. The most significant digit
+// is never zero, see bignum.h.
+typedef struct
+{
+    Obj obj;
+    bool negative;
+    int count;
+    uint32_t digits[];
+} ObjBignum;
+
+// A homogeneous numeric vector of SRFI-4, whose elements are kept unboxed
+// one after the other, see vector.h.
+typedef enum
+{
+    VECTOR_F64,
+    VECTOR_S32,
+    VECTOR_U8,
+} VectorKind;
+
+typedef struct
+{
+    Obj obj;
+    VectorKind kind;
+    int length;
+    double elements[]; // Of the kind, declared as doubles to align them for any
+} ObjVector;
+
+#define OBJECT_VECTOR_F64(vector) ((vector)->elements)
+#define OBJECT_VECTOR_S32(vector) ((int32_t *)(vector)->elements)
+#define OBJECT_VECTOR_U8(vector) ((uint8_t *)(vector)->elements)
+
+static inline size_t object_vector_element_size(VectorKind kind)
+{
+    return kind == VECTOR_F64 ? sizeof(double) : kind == VECTOR_S32 ? sizeof(int32_t) : sizeof(uint8_t);
+}
+
 typedef struct
 {
     Obj obj;
     int arity;
     int upvalue_count;
+    int arena_size; // Arena slots for the closures it creates on the stack
     Chunk chunk;
     size_t id;
+    // Text of a lambda whose body is only compiled when it is first called,
+    // and the line it starts on. NULL once the function is compiled.
+    ObjString *source;
+    int line;
+    // Calls and backward jumps counted towards compiling it to machine code,
+    // and the machine code once it is hot.
+    int calls;
+    struct JitCode *jit;
+    // The loop headers of the function seen by the tracing compiler.
+    struct Trace *traces;
 } ObjFunction;
 
 typedef Value (*NativeFn)(int arcg_cout, Value *args);
@@ -51,6 +106,7 @@ typedef Value (*NativeFn)(int arcg_cout, Value *args);
 typedef struct
 {
     Obj obj;
+    const char *name;
     NativeFn function;
 } ObjNative;
 
@@ -70,25 +126,37 @@ typedef struct ObjUpvalue
     struct ObjUpvalue *next;
 } ObjUpvalue;
 
+// Each upvalue is either the captured value itself or, for variables that
+// are assigned, an ObjUpvalue shared with the other closures.
 typedef struct
 {
     Obj obj;
     ObjFunction *function;
-    ObjUpvalue **upvalues;
     int upvalue_count;
+    Value upvalues[];
 } ObjClosure;
 
+// The number of stack values taken by a closure allocated in the arena.
+#define OBJECT_CLOSURE_SLOTS(upvalue_count) \
+    ((sizeof(ObjClosure) + sizeof(Value) * (upvalue_count) + sizeof(Value) - 1) / sizeof(Value))
+
 // Forward declaration to avoid circular dependancies
 typedef struct ObjContinuation ObjContinuation;
 
+// The id handed to the next function, kept so loaded images do not reuse ids.
+extern size_t next_id;
+
+ObjBignum *object_new_bignum(bool negative, int count);
 ObjClosure *object_new_closure(ObjFunction *function);
+ObjClosure *object_init_stack_closure(Value *slots, ObjFunction *function);
 ObjContinuation *object_new_continuation();
 ObjFunction *object_new_script();
 ObjFunction *object_new_function();
-ObjNative *object_new_native(NativeFn function);
+ObjNative *object_new_native(const char *name, NativeFn function);
 ObjString *object_take_string(char *chars, int length);
 ObjString *object_copy_string(const char *chars, int length);
 ObjUpvalue *object_new_upvalue(Value *slot);
+ObjVector *object_new_vector(VectorKind kind, int length);
 void object_load_continuation(ObjContinuation *cont);
 void object_mark_continuation(ObjContinuation *cont);
 void object_free_continuation(ObjContinuation *cont);
@@ -99,4 +167,9 @@ static inline bool object_is_obj_type(Value value, ObjType type)
     return VALUE_IS_OBJ(value) && VALUE_AS_OBJ(value)->type == type;
 }
 
+// Exact integers are the fixnums and the bignums, and numbers the flonums
+// as well.
+#define OBJECT_IS_EXACT(value) (VALUE_IS_FIXNUM(value) || OBJECT_IS_BIGNUM(value))
+#define OBJECT_IS_NUMBER(value) (VALUE_IS_NUMBER(value) || OBJECT_IS_BIGNUM(value))
+
 #endif
\ No newline at end of file
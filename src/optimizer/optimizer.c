@@ -0,0 +1,938 @@
+#include <optimizer/optimizer.h>
+#include <memory/memory.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+// The pass decodes a finished chunk into a list of instructions in which jumps
+// refer to instructions rather than offsets, rewrites the list until nothing
+// changes, and encodes it again. Jump widths are chosen during encoding, so
+// removing code can turn long jumps back into short ones.
+
+typedef struct
+{
+    uint8_t op;
+    const uint8_t *bytes; // Encoded instruction in the original code
+    int size;             // Size of the encoded instruction, jumps excluded
+    int target;           // Index of the target of a jump, -1 otherwise
+    int *cases;           // OP_SWITCH only, see optimizer_decode_switch
+    int case_count;
+    int pops;             // Operand of OP_POPN
+    int line;
+    bool live;
+    bool wide;   // Jumps only, set while encoding
+    int offset;  // Offset in the new code
+    int jumpers; // Number of live jumps to this instruction
+} Instruction;
+
+typedef struct
+{
+    Instruction *code;
+    int count; // code[count] is a sentinel marking the end of the chunk
+} Program;
+
+static bool optimizer_is_jump(uint8_t op)
+{
+    switch (op)
+    {
+    case OP_JUMP:
+    case OP_JUMP_LONG:
+    case OP_JUMP_IF_FALSE:
+    case OP_JUMP_IF_FALSE_LONG:
+    case OP_POP_JUMP_IF_FALSE:
+    case OP_POP_JUMP_IF_FALSE_LONG:
+    case OP_LOOP:
+    case OP_LOOP_LONG:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Jumps are kept in their short form until encoding, and backward jumps are
+// kept as OP_JUMP with an earlier target.
+static uint8_t optimizer_short_jump(uint8_t op)
+{
+    switch (op)
+    {
+    case OP_JUMP_LONG:
+    case OP_LOOP:
+    case OP_LOOP_LONG:
+        return OP_JUMP;
+    case OP_JUMP_IF_FALSE_LONG:
+        return OP_JUMP_IF_FALSE;
+    case OP_POP_JUMP_IF_FALSE_LONG:
+        return OP_POP_JUMP_IF_FALSE;
+    default:
+        return op;
+    }
+}
+
+static uint8_t optimizer_long_jump(uint8_t op)
+{
+    switch (op)
+    {
+    case OP_JUMP:
+        return OP_JUMP_LONG;
+    case OP_LOOP:
+        return OP_LOOP_LONG;
+    case OP_JUMP_IF_FALSE:
+        return OP_JUMP_IF_FALSE_LONG;
+    default:
+        return OP_POP_JUMP_IF_FALSE_LONG;
+    }
+}
+
+// Instructions that push a value and do nothing else.
+static bool optimizer_is_pure_push(uint8_t op)
+{
+    switch (op)
+    {
+    case OP_CONSTANT:
+    case OP_CONSTANT_LONG:
+    case OP_NULL:
+    case OP_TRUE:
+    case OP_FALSE:
+    case OP_GET_LOCAL:
+    case OP_GET_LOCAL_LONG:
+    case OP_GET_GLOBAL:
+    case OP_GLOBAL_UNCHANGED:
+    case OP_GET_UPVALUE:
+    case OP_GET_UPVALUE_LONG:
+    case OP_GET_BOXED_UPVALUE:
+    case OP_GET_BOXED_UPVALUE_LONG:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/* Decoding */
+
+// Every entry of the table of an OP_SWITCH gets the offset of its target in
+// cases, the default last, and empty slots of a hashed table -1.
+static void optimizer_decode_switch(Chunk *chunk, int offset, Instruction *instruction)
+{
+    const uint8_t *code = &chunk->code[offset];
+    bool dense = CHUNK_SWITCH_IS_DENSE(code[1]);
+    int size = (code[2] << 8) | code[3];
+    const uint8_t *entry = code + CHUNK_SWITCH_HEADER;
+
+    instruction->case_count = size + 1;
+    instruction->cases = (int *)malloc((size + 1) * sizeof(int));
+
+    if (instruction->cases == NULL)
+        exit(1);
+
+    for (int i = 0; i <= size; i++)
+    {
+        const uint8_t *target = i == size ? code + 7 : dense ? entry + 4 * i : entry + 7 * i + 3;
+
+        if (!dense && i < size && ((target[-3] << 16) | (target[-2] << 8) | target[-1]) == CHUNK_SWITCH_EMPTY)
+            instruction->cases[i] = -1;
+        else
+            instruction->cases[i] = offset + (int)(((uint32_t)target[0] << 24) | (target[1] << 16) |
+                                                   (target[2] << 8) | target[3]);
+    }
+}
+
+static bool optimizer_decode(Chunk *chunk, Program *program)
+{
+    int *indices = (int *)malloc((chunk->count + 1) * sizeof(int));
+    int *targets = (int *)malloc((chunk->count + 1) * sizeof(int));
+    program->code = (Instruction *)malloc((chunk->count + 1) * sizeof(Instruction));
+    program->count = 0;
+
+    if (indices == NULL || targets == NULL || program->code == NULL)
+        exit(1);
+
+    for (int offset = 0; offset < chunk->count;)
+    {
+        Instruction *instruction = &program->code[program->count];
+        int size = chunk_instruction_size(chunk, offset);
+
+        instruction->op = chunk->code[offset];
+        instruction->bytes = chunk->code + offset;
+        instruction->size = size;
+        instruction->target = -1;
+        instruction->cases = NULL;
+        instruction->case_count = 0;
+        instruction->pops = 0;
+        instruction->line = chunk_get_line(chunk, offset);
+        instruction->live = true;
+        instruction->wide = false;
+
+        targets[program->count] = -1;
+
+        if (optimizer_is_jump(instruction->op))
+        {
+            const uint8_t *operand = chunk->code + offset + 1;
+            int distance = size == 3
+                               ? (operand[0] << 8) | operand[1]
+                               : (operand[0] << 16) | (operand[1] << 8) | operand[2];
+
+            if (instruction->op == OP_LOOP || instruction->op == OP_LOOP_LONG)
+                distance = -distance;
+
+            targets[program->count] = offset + size + distance;
+            instruction->op = optimizer_short_jump(instruction->op);
+        }
+        else if (instruction->op == OP_POPN)
+        {
+            instruction->pops = chunk->code[offset + 1];
+        }
+        else if (instruction->op == OP_SWITCH)
+        {
+            optimizer_decode_switch(chunk, offset, instruction);
+        }
+
+        indices[offset] = program->count++;
+        offset += size;
+
+        // Offsets inside an instruction are never jumped to.
+        for (int i = offset - size + 1; i < offset; i++)
+            indices[i] = -1;
+    }
+
+    indices[chunk->count] = program->count;
+
+    // The sentinel is a target for jumps to the end of the chunk.
+    Instruction *end = &program->code[program->count];
+    memset(end, 0, sizeof(Instruction));
+    end->op = OP_RETURN;
+    end->live = true;
+    end->target = -1;
+
+    bool valid = true;
+
+    for (int i = 0; i < program->count; i++)
+    {
+        Instruction *instruction = &program->code[i];
+
+        for (int j = 0; j < instruction->case_count; j++)
+        {
+            int target = instruction->cases[j];
+
+            if (target == -1)
+                continue;
+
+            if (target > chunk->count || indices[target] == -1)
+                valid = false;
+            else
+                instruction->cases[j] = indices[target];
+        }
+
+        if (targets[i] == -1)
+            continue;
+
+        if (targets[i] > chunk->count || indices[targets[i]] == -1)
+            valid = false;
+        else
+            instruction->target = indices[targets[i]];
+    }
+
+    free(indices);
+    free(targets);
+    return valid;
+}
+
+/* Rewriting */
+
+static int optimizer_next_live(Program *program, int index)
+{
+    while (index < program->count && !program->code[index].live)
+        index++;
+    return index;
+}
+
+static void optimizer_count_jumpers(Program *program)
+{
+    for (int i = 0; i <= program->count; i++)
+        program->code[i].jumpers = 0;
+
+    for (int i = 0; i < program->count; i++)
+    {
+        Instruction *instruction = &program->code[i];
+
+        if (instruction->live && instruction->target != -1)
+        {
+            instruction->target = optimizer_next_live(program, instruction->target);
+            program->code[instruction->target].jumpers++;
+        }
+
+        for (int j = 0; instruction->live && j < instruction->case_count; j++)
+        {
+            if (instruction->cases[j] == -1)
+                continue;
+
+            instruction->cases[j] = optimizer_next_live(program, instruction->cases[j]);
+            program->code[instruction->cases[j]].jumpers++;
+        }
+    }
+}
+
+// Points jumps past jumps they would land on. A conditional jump keeps its
+// condition on the stack, so it can also follow another conditional jump,
+// which is then certain to be taken.
+static bool optimizer_thread_jumps(Program *program)
+{
+    bool changed = false;
+
+    for (int i = 0; i < program->count; i++)
+    {
+        Instruction *instruction = &program->code[i];
+
+        if (!instruction->live || instruction->target == -1)
+            continue;
+
+        for (int hops = 0; hops < program->count; hops++)
+        {
+            int target = optimizer_next_live(program, instruction->target);
+            Instruction *next = &program->code[target];
+
+            if (target == program->count || next->target == -1 || target == i ||
+                next->target == instruction->target)
+                break;
+
+            // Only OP_JUMP has a backward form.
+            if (instruction->op != OP_JUMP && next->target <= i)
+                break;
+
+            if (next->op == OP_JUMP ||
+                (next->op == OP_JUMP_IF_FALSE && instruction->op == OP_JUMP_IF_FALSE))
+            {
+                instruction->target = next->target;
+                changed = true;
+            }
+            else
+            {
+                break;
+            }
+        }
+
+        int target = optimizer_next_live(program, instruction->target);
+
+        if (instruction->op == OP_JUMP && target < program->count &&
+            program->code[target].op == OP_RETURN)
+        {
+            // Returning directly is cheaper than jumping to a return.
+            *instruction = program->code[target];
+            changed = true;
+        }
+        else if (target == optimizer_next_live(program, i + 1))
+        {
+            // A jump to the next instruction does nothing, apart from the pop
+            // of OP_POP_JUMP_IF_FALSE.
+            if (instruction->op == OP_POP_JUMP_IF_FALSE)
+            {
+                instruction->op = OP_POP;
+                instruction->bytes = NULL;
+                instruction->size = 1;
+                instruction->target = -1;
+            }
+            else
+            {
+                instruction->live = false;
+            }
+            changed = true;
+        }
+    }
+
+    return changed;
+}
+
+// Rewrites "OP_JUMP_IF_FALSE else; OP_POP; ... else: OP_POP" as
+// "OP_POP_JUMP_IF_FALSE after; ...", where after is the instruction following
+// the pop at else. That pop is left to dead code removal.
+static bool optimizer_fuse_conditional_pops(Program *program)
+{
+    bool changed = false;
+
+    optimizer_count_jumpers(program);
+
+    for (int i = 0; i < program->count; i++)
+    {
+        Instruction *instruction = &program->code[i];
+
+        if (!instruction->live || instruction->op != OP_JUMP_IF_FALSE)
+            continue;
+
+        int next = optimizer_next_live(program, i + 1);
+        int target = instruction->target;
+
+        if (next == program->count || target == program->count ||
+            program->code[next].op != OP_POP || program->code[next].jumpers > 0 ||
+            program->code[target].op != OP_POP || target == next)
+            continue;
+
+        instruction->op = OP_POP_JUMP_IF_FALSE;
+        instruction->target = optimizer_next_live(program, target + 1);
+        program->code[next].live = false;
+        program->code[target].jumpers--;
+        changed = true;
+    }
+
+    return changed;
+}
+
+static bool optimizer_remove_dead_code(Program *program)
+{
+    bool changed = false;
+    bool *reached = (bool *)calloc(program->count + 1, sizeof(bool));
+    int *work = (int *)malloc((program->count + 1) * sizeof(int));
+    int work_count = 0;
+
+    if (reached == NULL || work == NULL)
+        exit(1);
+
+    work[work_count++] = optimizer_next_live(program, 0);
+    reached[work[0]] = true;
+
+    while (work_count > 0)
+    {
+        int index = work[--work_count];
+
+        if (index == program->count)
+            continue;
+
+        Instruction *instruction = &program->code[index];
+        int successors[2], successor_count = 0;
+
+        // OP_TAIL_CALL falls through: a native procedure called in tail
+        // position returns to the next instruction.
+        if (instruction->op != OP_JUMP && instruction->op != OP_RETURN && instruction->op != OP_SWITCH)
+            successors[successor_count++] = optimizer_next_live(program, index + 1);
+
+        for (int i = 0; i < instruction->case_count; i++)
+        {
+            int successor = instruction->cases[i] == -1 ? -1 : optimizer_next_live(program, instruction->cases[i]);
+
+            if (successor != -1 && !reached[successor])
+            {
+                reached[successor] = true;
+                work[work_count++] = successor;
+            }
+        }
+
+        if (instruction->target != -1)
+            successors[successor_count++] = optimizer_next_live(program, instruction->target);
+
+        for (int i = 0; i < successor_count; i++)
+        {
+            if (!reached[successors[i]])
+            {
+                reached[successors[i]] = true;
+                work[work_count++] = successors[i];
+            }
+        }
+    }
+
+    for (int i = 0; i < program->count; i++)
+    {
+        if (program->code[i].live && !reached[i])
+        {
+            program->code[i].live = false;
+            changed = true;
+        }
+    }
+
+    free(reached);
+    free(work);
+    return changed;
+}
+
+// Drops values that are pushed only to be popped, and merges runs of pops.
+// Neither is done across a jump target, since the stack may differ there.
+static bool optimizer_combine_pops(Program *program)
+{
+    bool changed = false;
+
+    optimizer_count_jumpers(program);
+
+    for (int i = 0; i < program->count; i++)
+    {
+        Instruction *instruction = &program->code[i];
+
+        if (!instruction->live)
+            continue;
+
+        int next = optimizer_next_live(program, i + 1);
+
+        if (next == program->count || program->code[next].jumpers > 0)
+            continue;
+
+        Instruction *following = &program->code[next];
+
+        if (optimizer_is_pure_push(instruction->op) && following->op == OP_POP)
+        {
+            instruction->live = false;
+            following->live = false;
+            changed = true;
+        }
+        else if (optimizer_is_pure_push(instruction->op) && following->op == OP_POPN)
+        {
+            instruction->live = false;
+            following->pops--;
+            if (following->pops == 1)
+            {
+                following->op = OP_POP;
+                following->bytes = NULL;
+                following->size = 1;
+            }
+            changed = true;
+        }
+        else if ((instruction->op == OP_POP || instruction->op == OP_POPN) &&
+                 (following->op == OP_POP || following->op == OP_POPN))
+        {
+            int pops = (instruction->op == OP_POP ? 1 : instruction->pops) +
+                       (following->op == OP_POP ? 1 : following->pops);
+
+            if (pops > UINT8_MAX)
+                continue;
+
+            instruction->op = OP_POPN;
+            instruction->bytes = NULL;
+            instruction->size = 2;
+            instruction->pops = pops;
+            following->live = false;
+            changed = true;
+            i--; // Try to merge the next pop too.
+        }
+    }
+
+    return changed;
+}
+
+/* Type inference */
+
+// The slots of a frame known to hold a number before an instruction, for the
+// slots that register instructions can name. A height of -1 marks
+// instructions no path has reached yet.
+typedef struct
+{
+    int height;
+    uint64_t numbers[2];
+} Types;
+
+static bool optimizer_is_number(Types *types, int slot)
+{
+    return slot >= 0 && slot <= CHUNK_REGISTER_MAX && (types->numbers[slot / 64] >> (slot % 64)) & 1;
+}
+
+static void optimizer_set_number(Types *types, int slot, bool number)
+{
+    if (slot < 0 || slot > CHUNK_REGISTER_MAX)
+        return;
+
+    uint64_t bit = (uint64_t)1 << (slot % 64);
+
+    if (number)
+        types->numbers[slot / 64] |= bit;
+    else
+        types->numbers[slot / 64] &= ~bit;
+}
+
+static bool optimizer_is_number_operand(Chunk *chunk, Types *types, uint8_t operand)
+{
+    if (operand & CHUNK_REGISTER_CONSTANT)
+        return VALUE_IS_NUMBER(chunk->constants.values[operand & CHUNK_REGISTER_MAX]);
+    return optimizer_is_number(types, operand);
+}
+
+static void optimizer_push(Types *types, bool number)
+{
+    optimizer_set_number(types, types->height++, number);
+}
+
+static int optimizer_read_operand(Instruction *instruction)
+{
+    if (instruction->size == 2)
+        return instruction->bytes[1];
+    if (instruction->size == 3)
+        return (instruction->bytes[1] << 8) | instruction->bytes[2];
+    return (instruction->bytes[1] << 16) | (instruction->bytes[2] << 8) | instruction->bytes[3];
+}
+
+// Applies an instruction to the types before it. Returns false for an
+// instruction whose effect on the stack isn't known here.
+static bool optimizer_apply(Chunk *chunk, Instruction *instruction, Types *types)
+{
+    uint8_t op = instruction->op;
+
+    if (CHUNK_IS_REGISTER(op))
+    {
+        op = CHUNK_CHECKED_REGISTER(op);
+
+        // An operand that got past the check is a number from then on, or
+        // the run has ended with an error.
+        for (int i = 2; i < 4; i++)
+        {
+            if (!(instruction->bytes[i] & CHUNK_REGISTER_CONSTANT))
+                optimizer_set_number(types, instruction->bytes[i], true);
+        }
+
+        types->height = instruction->bytes[1];
+        optimizer_push(types, op == OP_ADD || op == OP_SUBTRACT || op == OP_MULTIPLY);
+        return true;
+    }
+
+    switch (op)
+    {
+    case OP_CONSTANT:
+    case OP_CONSTANT_LONG:
+        optimizer_push(types, VALUE_IS_NUMBER(chunk->constants.values[optimizer_read_operand(instruction)]));
+        return true;
+    case OP_GET_LOCAL:
+    case OP_GET_LOCAL_LONG:
+        optimizer_push(types, optimizer_is_number(types, optimizer_read_operand(instruction)));
+        return true;
+    case OP_SET_LOCAL:
+    case OP_SET_LOCAL_LONG:
+        optimizer_set_number(types, optimizer_read_operand(instruction),
+                             optimizer_is_number(types, types->height - 1));
+        return true;
+    case OP_NULL:
+    case OP_TRUE:
+    case OP_FALSE:
+    case OP_GET_GLOBAL:
+    case OP_GLOBAL_UNCHANGED:
+    case OP_GET_UPVALUE:
+    case OP_GET_UPVALUE_LONG:
+    case OP_GET_BOXED_UPVALUE:
+    case OP_GET_BOXED_UPVALUE_LONG:
+    case OP_CLOSURE:
+    case OP_CLOSURE_LONG:
+    case OP_STACK_CLOSURE:
+    case OP_STACK_CLOSURE_LONG:
+    case OP_CONTINUATION:
+        optimizer_push(types, false);
+        return true;
+    case OP_POP:
+    case OP_POP_JUMP_IF_FALSE:
+    case OP_SWITCH:
+    case OP_CLOSE_UPVALUE:
+        types->height--;
+        return true;
+    case OP_POPN:
+        types->height -= instruction->pops;
+        return true;
+    case OP_VECTOR_REF:
+        // Every element of a numeric vector is a number.
+        types->height -= 2;
+        optimizer_push(types, true);
+        return true;
+    case OP_VECTOR_SET:
+        types->height -= 3;
+        optimizer_push(types, false);
+        return true;
+    case OP_SET_GLOBAL:
+    case OP_SET_UPVALUE:
+    case OP_SET_UPVALUE_LONG:
+    case OP_CLOSE_LOCAL:
+    case OP_JUMP:
+    case OP_JUMP_IF_FALSE:
+    case OP_RETURN:
+        return true;
+    case OP_CALL:
+    case OP_TAIL_CALL:
+        // The callee may assign any local that a closure has captured.
+        types->height -= instruction->bytes[1];
+        types->numbers[0] = types->numbers[1] = 0;
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Merges the types that reach an instruction along one more path, queueing
+// it when they change what is known there.
+static bool optimizer_merge_types(Types *types, int index, Types *incoming, int *work, int *work_count,
+                                  bool *queued)
+{
+    Types *merged = &types[index];
+
+    if (merged->height == -1)
+    {
+        *merged = *incoming;
+    }
+    else if (merged->height != incoming->height)
+    {
+        return false;
+    }
+    else if ((merged->numbers[0] & ~incoming->numbers[0]) == 0 && (merged->numbers[1] & ~incoming->numbers[1]) == 0)
+    {
+        return true;
+    }
+    else
+    {
+        merged->numbers[0] &= incoming->numbers[0];
+        merged->numbers[1] &= incoming->numbers[1];
+    }
+
+    if (!queued[index])
+    {
+        queued[index] = true;
+        work[(*work_count)++] = index;
+    }
+
+    return true;
+}
+
+// Finds the operands of register instructions that are certain to be
+// numbers, and drops the checks of the instructions whose operands both are.
+// Numbers come from numeric constants, from arithmetic, and from slots
+// already checked by an earlier register instruction, which is how a
+// parameter used only in arithmetic is checked once rather than at every use.
+// What is known at a jump target is what holds on every path to it, and calls
+// forget everything. Code with stack heights that don't agree where paths
+// meet is left as it is.
+static void optimizer_infer_types(Program *program, Chunk *chunk, int arity)
+{
+    Types *types = (Types *)malloc((program->count + 1) * sizeof(Types));
+    int *work = (int *)malloc((program->count + 1) * sizeof(int));
+    bool *queued = (bool *)calloc(program->count + 1, sizeof(bool));
+    int work_count = 0;
+    bool valid = true;
+
+    if (types == NULL || work == NULL || queued == NULL)
+        exit(1);
+
+    for (int i = 0; i <= program->count; i++)
+        types[i].height = -1;
+
+    Types entry = {arity + 1, {0, 0}};
+    valid = optimizer_merge_types(types, optimizer_next_live(program, 0), &entry, work, &work_count, queued);
+
+    while (valid && work_count > 0)
+    {
+        int index = work[--work_count];
+        queued[index] = false;
+
+        if (index == program->count)
+            continue;
+
+        Instruction *instruction = &program->code[index];
+        Types after = types[index];
+
+        if (!optimizer_apply(chunk, instruction, &after) || after.height < 0)
+        {
+            valid = false;
+            break;
+        }
+
+        // Slots above the top no longer hold anything.
+        for (int slot = after.height; slot <= CHUNK_REGISTER_MAX; slot++)
+            optimizer_set_number(&after, slot, false);
+
+        if (instruction->op != OP_JUMP && instruction->op != OP_RETURN && instruction->op != OP_SWITCH)
+            valid = optimizer_merge_types(types, optimizer_next_live(program, index + 1), &after, work,
+                                          &work_count, queued) && valid;
+
+        if (instruction->target != -1)
+            valid = optimizer_merge_types(types, instruction->target, &after, work, &work_count, queued) && valid;
+
+        for (int i = 0; i < instruction->case_count; i++)
+        {
+            if (instruction->cases[i] != -1)
+                valid = optimizer_merge_types(types, instruction->cases[i], &after, work, &work_count, queued) &&
+                        valid;
+        }
+    }
+
+    for (int i = 0; valid && i < program->count; i++)
+    {
+        Instruction *instruction = &program->code[i];
+
+        if (instruction->live && types[i].height != -1 && CHUNK_CHECKED_REGISTER(instruction->op) == instruction->op &&
+            CHUNK_IS_REGISTER(instruction->op) &&
+            optimizer_is_number_operand(chunk, &types[i], instruction->bytes[2]) &&
+            optimizer_is_number_operand(chunk, &types[i], instruction->bytes[3]))
+            instruction->op += OP_ADD_UNCHECKED - OP_ADD;
+    }
+
+    free(types);
+    free(work);
+    free(queued);
+}
+
+/* Encoding */
+
+static int optimizer_size(Instruction *instruction)
+{
+    if (instruction->target != -1)
+        return instruction->wide ? 4 : 3;
+    return instruction->size;
+}
+
+// Places the instructions, widening jumps until every distance fits.
+static bool optimizer_layout(Program *program)
+{
+    bool widened;
+
+    do
+    {
+        int offset = 0;
+
+        for (int i = 0; i < program->count; i++)
+        {
+            program->code[i].offset = offset;
+            if (program->code[i].live)
+                offset += optimizer_size(&program->code[i]);
+        }
+
+        program->code[program->count].offset = offset;
+        widened = false;
+
+        for (int i = 0; i < program->count; i++)
+        {
+            Instruction *instruction = &program->code[i];
+
+            if (!instruction->live || instruction->target == -1)
+                continue;
+
+            int distance = program->code[instruction->target].offset -
+                           (instruction->offset + optimizer_size(instruction));
+
+            // Only unconditional jumps go backward, as OP_LOOP.
+            if (distance < 0 && instruction->op != OP_JUMP)
+                return false;
+
+            if (!instruction->wide && abs(distance) > UINT16_MAX)
+            {
+                instruction->wide = true;
+                widened = true;
+            }
+        }
+    } while (widened);
+
+    return true;
+}
+
+// Copies an OP_SWITCH with the distances to its targets in the new code.
+static void optimizer_encode_switch(Program *program, Instruction *instruction, uint8_t *at)
+{
+    bool dense = CHUNK_SWITCH_IS_DENSE(instruction->bytes[1]);
+    int size = instruction->case_count - 1;
+
+    memcpy(at, instruction->bytes, instruction->size);
+
+    for (int i = 0; i <= size; i++)
+    {
+        uint8_t *target = i == size ? at + 7 : dense ? at + CHUNK_SWITCH_HEADER + 4 * i
+                                                     : at + CHUNK_SWITCH_HEADER + 7 * i + 3;
+
+        if (instruction->cases[i] == -1)
+            continue;
+
+        int distance = program->code[instruction->cases[i]].offset - instruction->offset;
+        target[0] = (distance >> 24) & 0xff;
+        target[1] = (distance >> 16) & 0xff;
+        target[2] = (distance >> 8) & 0xff;
+        target[3] = distance & 0xff;
+    }
+}
+
+static void optimizer_encode(Program *program, Chunk *chunk)
+{
+    int count = program->code[program->count].offset;
+    uint8_t *code = MEMORY_ALLOCATE(uint8_t, count);
+    Chunk encoded;
+
+    chunk_init_chunk(&encoded);
+
+    for (int i = 0; i < program->count; i++)
+    {
+        Instruction *instruction = &program->code[i];
+        uint8_t *at = code + instruction->offset;
+
+        if (!instruction->live)
+            continue;
+
+        chunk_add_line(&encoded, instruction->offset, instruction->line);
+
+        if (instruction->target != -1)
+        {
+            int distance = program->code[instruction->target].offset -
+                           (instruction->offset + optimizer_size(instruction));
+            uint8_t op = instruction->op;
+
+            if (distance < 0)
+            {
+                op = OP_LOOP;
+                distance = -distance;
+            }
+
+            if (instruction->wide)
+            {
+                at[0] = optimizer_long_jump(op);
+                at[1] = (distance >> 16) & 0xff;
+                at[2] = (distance >> 8) & 0xff;
+                at[3] = distance & 0xff;
+            }
+            else
+            {
+                at[0] = op;
+                at[1] = (distance >> 8) & 0xff;
+                at[2] = distance & 0xff;
+            }
+        }
+        else if (instruction->op == OP_POPN)
+        {
+            at[0] = OP_POPN;
+            at[1] = (uint8_t)instruction->pops;
+        }
+        else if (instruction->op == OP_SWITCH)
+        {
+            optimizer_encode_switch(program, instruction, at);
+        }
+        else if (instruction->bytes == NULL)
+        {
+            at[0] = instruction->op;
+        }
+        else
+        {
+            memcpy(at, instruction->bytes, instruction->size);
+            at[0] = instruction->op;
+        }
+    }
+
+    MEMORY_FREE_ARRAY(uint8_t, chunk->code, chunk->capacity);
+    MEMORY_FREE_ARRAY(LineRun, chunk->lines, chunk->line_capacity);
+
+    chunk->code = code;
+    chunk->count = chunk->capacity = count;
+    chunk->lines = encoded.lines;
+    chunk->line_count = encoded.line_count;
+    chunk->line_capacity = encoded.line_capacity;
+}
+
+void optimizer_optimize_chunk(Chunk *chunk, int arity)
+{
+    Program program;
+
+    if (chunk->count == 0)
+        return;
+
+    // Chunks with jumps the pass does not understand are left alone.
+    if (optimizer_decode(chunk, &program))
+    {
+        bool changed;
+
+        do
+        {
+            changed = optimizer_thread_jumps(&program);
+            changed = optimizer_fuse_conditional_pops(&program) || changed;
+            changed = optimizer_remove_dead_code(&program) || changed;
+            changed = optimizer_combine_pops(&program) || changed;
+        } while (changed);
+
+        optimizer_infer_types(&program, chunk, arity);
+
+        if (optimizer_layout(&program))
+            optimizer_encode(&program, chunk);
+    }
+
+    for (int i = 0; i < program.count; i++)
+        free(program.code[i].cases);
+    free(program.code);
+}
\ No newline at end of file
@@ -0,0 +1,10 @@
+#ifndef _OPTIMIZER_H
+#define _OPTIMIZER_H
+
+#include <chunk/chunk.h>
+
+// Rewrites the code of a function taking arity arguments, which is only
+// entered at its start.
+void optimizer_optimize_chunk(Chunk *chunk, int arity);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,128 @@
+#ifndef _OPTIMIZER_TEST_H
+#define _OPTIMIZER_TEST_H
+
+#include <optimizer/optimizer.h>
+#include <vm/vm.h>
+#include <CUnit/Basic.h>
+
+#include <string.h>
+
+// Optimizes the code of a function of one argument and checks that it
+// becomes expected.
+static void optimizer_test_rewrite(const uint8_t *code, int count, const uint8_t *expected, int expected_count)
+{
+    vm_init_vm();
+
+    Chunk chunk;
+    chunk_init_chunk(&chunk);
+
+    for (int i = 0; i < count; i++)
+        chunk_write_chunk(&chunk, code[i], 1);
+
+    optimizer_optimize_chunk(&chunk, 1);
+
+    CU_ASSERT_EQUAL(chunk.count, expected_count);
+    CU_ASSERT_TRUE(chunk.count == expected_count && memcmp(chunk.code, expected, expected_count) == 0);
+
+    chunk_free_chunk(&chunk);
+    vm_free_vm();
+}
+
+void optimizer_thread_jumps_test()
+{
+    // A conditional jump to a jump goes straight to its target, and the
+    // jump, no longer jumped to, is dead
+    const uint8_t code[] = {
+        OP_GET_LOCAL, 1,
+        OP_JUMP_IF_FALSE, 0, 4,
+        OP_POP,
+        OP_TRUE,
+        OP_RETURN,
+        OP_NULL,
+        OP_JUMP, 0, 1,
+        OP_NULL,
+        OP_RETURN,
+    };
+    const uint8_t expected[] = {
+        OP_GET_LOCAL, 1,
+        OP_JUMP_IF_FALSE, 0, 3,
+        OP_POP,
+        OP_TRUE,
+        OP_RETURN,
+        OP_RETURN,
+    };
+
+    optimizer_test_rewrite(code, sizeof(code), expected, sizeof(expected));
+}
+
+void optimizer_jump_chain_test()
+{
+    // Jumps along a chain of jumps, down to the next instruction, vanish
+    const uint8_t code[] = {
+        OP_JUMP, 0, 1,
+        OP_RETURN,
+        OP_JUMP, 0, 1,
+        OP_NULL,
+        OP_TRUE,
+        OP_RETURN,
+    };
+    const uint8_t expected[] = {
+        OP_TRUE,
+        OP_RETURN,
+    };
+
+    optimizer_test_rewrite(code, sizeof(code), expected, sizeof(expected));
+}
+
+void optimizer_fuse_conditional_pops_test()
+{
+    // (if x #t #f): both pops go into OP_POP_JUMP_IF_FALSE, and the jump
+    // over the else branch becomes a return
+    const uint8_t code[] = {
+        OP_GET_LOCAL, 1,
+        OP_JUMP_IF_FALSE, 0, 5,
+        OP_POP,
+        OP_TRUE,
+        OP_JUMP, 0, 2,
+        OP_POP,
+        OP_FALSE,
+        OP_RETURN,
+    };
+    const uint8_t expected[] = {
+        OP_GET_LOCAL, 1,
+        OP_POP_JUMP_IF_FALSE, 0, 2,
+        OP_TRUE,
+        OP_RETURN,
+        OP_FALSE,
+        OP_RETURN,
+    };
+
+    optimizer_test_rewrite(code, sizeof(code), expected, sizeof(expected));
+}
+
+void optimizer_narrow_jumps_test()
+{
+    // Long jumps that turn out short are encoded short
+    const uint8_t code[] = {
+        OP_GET_LOCAL, 1,
+        OP_JUMP_IF_FALSE_LONG, 0, 0, 3,
+        OP_POP,
+        OP_TRUE,
+        OP_RETURN,
+        OP_POP,
+        OP_FALSE,
+        OP_RETURN,
+    };
+    const uint8_t expected[] = {
+        OP_GET_LOCAL, 1,
+        OP_POP_JUMP_IF_FALSE, 0, 2,
+        OP_TRUE,
+        OP_RETURN,
+        OP_FALSE,
+        OP_RETURN,
+    };
+
+    optimizer_test_rewrite(code, sizeof(code), expected, sizeof(expected));
+}
+
+#endif
\ No newline at end of file
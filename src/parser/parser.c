@@ -5,10 +5,22 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#define PARSER_BLOCK_SIZE 512
+
+// S-expressions are handed out from a list of fixed size blocks so that
+// pointers to them stay valid as a form grows. The blocks are kept and
+// reused by the next form.
+typedef struct SExprBlock
+{
+    struct SExprBlock *next;
+    SExpr sexprs[PARSER_BLOCK_SIZE];
+} SExprBlock;
+
 typedef struct
 {
-    int count;
-    SExpr sexprs[512];
+    int count; // Used entries in the current block
+    SExprBlock *first;
+    SExprBlock *current;
 } SexprArray;
 
 typedef struct
@@ -31,6 +43,11 @@ static SExpr *parser_parse_quote();
 static SExpr *parser_parse_lambda();
 static SExpr *parser_parse_if();
 static SExpr *parser_parse_set();
+static SExpr *parser_parse_do();
+static SExpr *parser_parse_case();
+static SExpr *parser_parse_cond();
+static SExpr *parser_parse_logical();
+static SExpr *parser_parse_conditional();
 static SExpr *parser_parse_call_cc();
 static SExpr *parser_parse_application();
 static SExpr *parser_parse_expression();
@@ -89,6 +106,8 @@ static bool parser_is_definition()
         {
         case TOKEN_DEFINE:
             return true;
+        default:
+            break;
         }
 
     return false;
@@ -98,9 +117,33 @@ static bool parser_is_definition()
 
 static SExpr *parser_write_sexpr_array(SExpr value)
 {
-    parser.sexpr_array.sexprs[parser.sexpr_array.count] = value;
-    SExpr *sexpr = parser.sexpr_array.sexprs + parser.sexpr_array.count;
-    parser.sexpr_array.count++;
+    SexprArray *array = &parser.sexpr_array;
+
+    if (array->current == NULL || array->count == PARSER_BLOCK_SIZE)
+    {
+        SExprBlock *next = array->current == NULL ? array->first : array->current->next;
+
+        if (next == NULL)
+        {
+            next = (SExprBlock *)malloc(sizeof(SExprBlock));
+
+            if (next == NULL)
+                exit(1);
+
+            next->next = NULL;
+
+            if (array->current == NULL)
+                array->first = next;
+            else
+                array->current->next = next;
+        }
+
+        array->current = next;
+        array->count = 0;
+    }
+
+    SExpr *sexpr = &array->current->sexprs[array->count++];
+    *sexpr = value;
     return sexpr;
 }
 
@@ -332,6 +375,67 @@ static SExpr *parser_parse_bindings()
     return bindings;
 }
 
+static SExpr *parser_parse_iteration_spec()
+{
+    // Rule: "(" identifier expression expression? ")"
+    SExpr *id, *init, *step;
+
+    if (parser.this.type != TOKEN_LEFT_PAREN)
+        return parser_failed("Expected iteration spec.");
+    parser_advance(); // Skip the first parenthesis
+
+    if (parser.this.type != TOKEN_SYMBOL)
+        return parser_failed("Invalid do syntax. Expected symbol.");
+    id = parser_write_cons_atom(parser.this);
+
+    if ((init = parser_write_cons_rule(parser_parse_expression)) == NULL)
+        return NULL;
+    PARSER_CDR(id) = init;
+
+    if (parser.this.type != TOKEN_RIGHT_PAREN)
+    {
+        if ((step = parser_write_cons_rule(parser_parse_expression)) == NULL)
+            return NULL;
+        PARSER_CDR(init) = step;
+        init = step;
+    }
+
+    if (parser.this.type != TOKEN_RIGHT_PAREN)
+        return parser_failed("Expected ')'.");
+
+    PARSER_CDR(init) = parser_write_null();
+    parser_advance(); // Skip the trailing parenthesis
+
+    return id;
+}
+
+static SExpr *parser_parse_iteration_specs()
+{
+    // Rule: "(" iteration_spec* ")"
+
+    SExpr *specs, *previous, *current;
+    specs = NULL;
+
+    if (parser.this.type != TOKEN_LEFT_PAREN)
+        return parser_failed("Expected iteration specs.");
+    parser_advance(); // Skip the first parenthesis
+
+    for (previous = NULL; parser.this.type != TOKEN_RIGHT_PAREN; previous = current)
+    {
+        if ((current = parser_write_cons_rule(parser_parse_iteration_spec)) == NULL)
+            return NULL;
+
+        (previous == NULL) ? (specs = current)
+                           : (PARSER_CDR(previous) = current);
+    }
+    (previous == NULL) ? (specs = parser_write_null())
+                       : (PARSER_CDR(previous) = parser_write_null());
+
+    parser_advance(); // skip trailing parenthesis
+
+    return specs;
+}
+
 static SExpr *parser_parse_datum()
 {
     // Rule: constant / variable / list / vector
@@ -347,6 +451,14 @@ static SExpr *parser_parse_datum()
     case TOKEN_LAMBDA:
     case TOKEN_IF:
     case TOKEN_SET:
+    case TOKEN_DO:
+    case TOKEN_CASE:
+    case TOKEN_COND:
+    case TOKEN_ELSE:
+    case TOKEN_AND:
+    case TOKEN_OR:
+    case TOKEN_WHEN:
+    case TOKEN_UNLESS:
     case TOKEN_CALL_CC:
         return parser_write_atom(parser.this);
 
@@ -396,6 +508,8 @@ static SExpr *parser_parse_definition()
         {
         case TOKEN_DEFINE:
             return parser_parse_define();
+        default:
+            break;
         }
     }
 
@@ -453,14 +567,22 @@ static SExpr *parser_parse_lambda()
 
 static SExpr *parser_parse_let()
 {
-    // Rule: "(" "let" "(" binding_spec* ")" body ")"
-    SExpr *let, *bindings, *body;
+    // Rule: "(" "let" identifier? "(" binding_spec* ")" body ")"
+    SExpr *let, *name, *bindings, *body;
     parser_advance(); // skip first parenthesis
 
     if (parser.this.type != TOKEN_LET)
         return parser_failed("Invalid expression syntax. Expected 'lambda'.");
     let = parser_write_cons_atom(parser.this);
 
+    // A named let keeps its name between 'let' and the bindings
+    name = let;
+    if (parser.this.type == TOKEN_SYMBOL)
+    {
+        name = parser_write_cons_atom(parser.this);
+        PARSER_CDR(let) = name;
+    }
+
     if ((bindings = parser_write_cons_rule(parser_parse_bindings)) == NULL)
         return NULL;
 
@@ -470,13 +592,238 @@ static SExpr *parser_parse_let()
     if (parser.this.type != TOKEN_RIGHT_PAREN)
         return parser_failed("Invalid let syntax. Expected ')'.");
 
-    PARSER_CDR(let) = bindings;
+    PARSER_CDR(name) = bindings;
     PARSER_CDR(bindings) = body;
     parser_advance(); // skip trailing parenthesis
 
     return let;
 }
 
+static SExpr *parser_parse_do()
+{
+    // Rule: "(" "do" "(" iteration_spec* ")" "(" expression expression* ")"
+    //       expression* ")"
+    SExpr *doo, *specs, *clause, *previous, *current;
+    parser_advance(); // skip first parenthesis
+
+    if (parser.this.type != TOKEN_DO)
+        return parser_failed("Invalid expression syntax. Expected 'do'.");
+    doo = parser_write_cons_atom(parser.this);
+
+    if ((specs = parser_write_cons_rule(parser_parse_iteration_specs)) == NULL)
+        return NULL;
+
+    if (parser.this.type != TOKEN_LEFT_PAREN)
+        return parser_failed("Invalid do syntax. Expected test clause.");
+
+    // The test clause has the shape of an application
+    if ((clause = parser_write_cons_rule(parser_parse_application)) == NULL)
+        return NULL;
+
+    // Parse command*
+    for (previous = clause; parser.this.type != TOKEN_RIGHT_PAREN; previous = current)
+    {
+        if ((current = parser_write_cons_rule(parser_parse_expression)) == NULL)
+            return NULL;
+
+        PARSER_CDR(previous) = current;
+    }
+    PARSER_CDR(previous) = parser_write_null();
+
+    PARSER_CDR(doo) = specs;
+    PARSER_CDR(specs) = clause;
+    parser_advance(); // skip trailing parenthesis
+
+    return doo;
+}
+
+static SExpr *parser_parse_sequence()
+{
+    // Rule: expression expression*
+    SExpr *exprs, *previous, *current;
+
+    if ((exprs = parser_write_cons_rule(parser_parse_expression)) == NULL)
+        return NULL;
+
+    for (previous = exprs; parser.this.type != TOKEN_RIGHT_PAREN; previous = current)
+    {
+        if ((current = parser_write_cons_rule(parser_parse_expression)) == NULL)
+            return NULL;
+
+        PARSER_CDR(previous) = current;
+    }
+    PARSER_CDR(previous) = parser_write_null();
+    // Don't skip the trailing parenthesis
+
+    return exprs;
+}
+
+static SExpr *parser_parse_else_clause()
+{
+    // Rule: "(" "else" expression expression* ")"
+    SExpr *elsee, *exprs;
+    parser_advance(); // skip first parenthesis
+
+    elsee = parser_write_cons_atom(parser.this);
+
+    if ((exprs = parser_parse_sequence()) == NULL)
+        return NULL;
+
+    PARSER_CDR(elsee) = exprs;
+    parser_advance(); // skip trailing parenthesis
+
+    return elsee;
+}
+
+static SExpr *parser_parse_case_clause()
+{
+    // Rule: "(" "(" datum* ")" expression expression* ")" / else_clause
+    SExpr *data, *exprs;
+
+    if (parser.this.type != TOKEN_LEFT_PAREN)
+        return parser_failed("Invalid case syntax. Expected clause.");
+
+    if (parser.lookahead.type == TOKEN_ELSE)
+        return parser_parse_else_clause();
+    parser_advance(); // skip first parenthesis
+
+    if ((data = parser_write_cons_rule(parser_parse_list)) == NULL)
+        return NULL;
+
+    if ((exprs = parser_parse_sequence()) == NULL)
+        return NULL;
+
+    PARSER_CDR(data) = exprs;
+    parser_advance(); // skip trailing parenthesis
+
+    return data;
+}
+
+static SExpr *parser_parse_cond_clause()
+{
+    // Rule: "(" expression expression* ")" / else_clause
+    if (parser.this.type != TOKEN_LEFT_PAREN)
+        return parser_failed("Invalid cond syntax. Expected clause.");
+
+    if (parser.lookahead.type == TOKEN_ELSE)
+        return parser_parse_else_clause();
+
+    return parser_parse_application();
+}
+
+// Parses the clauses of case and cond, of which only the last may be an
+// else clause.
+static SExpr *parser_parse_clauses(SExpr *(*rule)())
+{
+    // Rule: clause clause*
+    SExpr *clauses, *previous, *current;
+    clauses = NULL;
+
+    for (previous = NULL; previous == NULL || parser.this.type != TOKEN_RIGHT_PAREN; previous = current)
+    {
+        if (previous != NULL && PARSER_IS_ATOM(PARSER_CAAR(previous)) &&
+            PARSER_AS_ATOM(PARSER_CAAR(previous)).type == TOKEN_ELSE)
+            return parser_failed("Expected ')' after else clause.");
+
+        if ((current = parser_write_cons_rule(rule)) == NULL)
+            return NULL;
+
+        (previous == NULL) ? (clauses = current)
+                           : (PARSER_CDR(previous) = current);
+    }
+    PARSER_CDR(previous) = parser_write_null();
+
+    return clauses;
+}
+
+static SExpr *parser_parse_case()
+{
+    // Rule: "(" "case" expression case_clause case_clause* ")"
+    SExpr *casee, *key, *clauses;
+    parser_advance(); // skip first parenthesis
+
+    if (parser.this.type != TOKEN_CASE)
+        return parser_failed("Invalid expression syntax. Expected 'case'.");
+    casee = parser_write_cons_atom(parser.this);
+
+    if ((key = parser_write_cons_rule(parser_parse_expression)) == NULL)
+        return NULL;
+
+    if ((clauses = parser_parse_clauses(parser_parse_case_clause)) == NULL)
+        return NULL;
+
+    PARSER_CDR(casee) = key;
+    PARSER_CDR(key) = clauses;
+    parser_advance(); // skip trailing parenthesis
+
+    return casee;
+}
+
+static SExpr *parser_parse_cond()
+{
+    // Rule: "(" "cond" cond_clause cond_clause* ")"
+    SExpr *cond, *clauses;
+    parser_advance(); // skip first parenthesis
+
+    if (parser.this.type != TOKEN_COND)
+        return parser_failed("Invalid expression syntax. Expected 'cond'.");
+    cond = parser_write_cons_atom(parser.this);
+
+    if ((clauses = parser_parse_clauses(parser_parse_cond_clause)) == NULL)
+        return NULL;
+
+    PARSER_CDR(cond) = clauses;
+    parser_advance(); // skip trailing parenthesis
+
+    return cond;
+}
+
+static SExpr *parser_parse_logical()
+{
+    // Rule: "(" ("and" / "or") expression* ")"
+    SExpr *logical, *previous, *current;
+    parser_advance(); // skip first parenthesis
+
+    if (parser.this.type != TOKEN_AND && parser.this.type != TOKEN_OR)
+        return parser_failed("Invalid expression syntax. Expected 'and' or 'or'.");
+    logical = parser_write_cons_atom(parser.this);
+
+    for (previous = logical; parser.this.type != TOKEN_RIGHT_PAREN; previous = current)
+    {
+        if ((current = parser_write_cons_rule(parser_parse_expression)) == NULL)
+            return NULL;
+
+        PARSER_CDR(previous) = current;
+    }
+    PARSER_CDR(previous) = parser_write_null();
+    parser_advance(); // skip trailing parenthesis
+
+    return logical;
+}
+
+static SExpr *parser_parse_conditional()
+{
+    // Rule: "(" ("when" / "unless") expression expression expression* ")"
+    SExpr *conditional, *test, *exprs;
+    parser_advance(); // skip first parenthesis
+
+    if (parser.this.type != TOKEN_WHEN && parser.this.type != TOKEN_UNLESS)
+        return parser_failed("Invalid expression syntax. Expected 'when' or 'unless'.");
+    conditional = parser_write_cons_atom(parser.this);
+
+    if ((test = parser_write_cons_rule(parser_parse_expression)) == NULL)
+        return NULL;
+
+    if ((exprs = parser_parse_sequence()) == NULL)
+        return NULL;
+
+    PARSER_CDR(conditional) = test;
+    PARSER_CDR(test) = exprs;
+    parser_advance(); // skip trailing parenthesis
+
+    return conditional;
+}
+
 static SExpr *parser_parse_begin()
 {
     // Rule: "(" "let" "(" binding_spec* ")" body ")"
@@ -617,7 +964,6 @@ static SExpr *parser_parse_application()
 static SExpr *parser_parse_expression()
 {
     TokenType token_type = parser.this.type;
-    SExpr *sexpr;
 
     switch (token_type)
     {
@@ -632,6 +978,18 @@ static SExpr *parser_parse_expression()
             return parser_parse_let();
         case TOKEN_BEGIN:
             return parser_parse_begin();
+        case TOKEN_DO:
+            return parser_parse_do();
+        case TOKEN_CASE:
+            return parser_parse_case();
+        case TOKEN_COND:
+            return parser_parse_cond();
+        case TOKEN_AND:
+        case TOKEN_OR:
+            return parser_parse_logical();
+        case TOKEN_WHEN:
+        case TOKEN_UNLESS:
+            return parser_parse_conditional();
         case TOKEN_IF:
             return parser_parse_if();
         case TOKEN_SET:
@@ -674,14 +1032,18 @@ void parser_reset_parser()
     };
     parser.error_token = token;
 
-    // parser.sexpr_array.capacity = 0;
     parser.sexpr_array.count = 0;
-    // parser.sexpr_array.sexprs = NULL;
+    parser.sexpr_array.current = NULL;
 }
 
 void parser_init_parser(const char *source)
 {
-    scanner_init_scanner(source);
+    parser_init_parser_at(source, 1);
+}
+
+void parser_init_parser_at(const char *source, int line)
+{
+    scanner_init_scanner_at(source, line);
     parser_reset_parser();
 
     parser.this = parser.error_token;
@@ -82,6 +82,7 @@ typedef struct SExpr
 
 Token parser_get_error_token();
 void parser_init_parser(const char *source);
+void parser_init_parser_at(const char *source, int line);
 ParseResult parser_parse(SExpr **sexpr);
 
 #endif
\ No newline at end of file
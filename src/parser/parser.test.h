@@ -686,6 +686,252 @@ void parser_parse_let_test_3()
     CU_ASSERT_TRUE_FATAL(PARSER_IS_NULL(PARSER_CDDR(bindings)));
 }
 
+void parser_parse_named_let_test_1()
+{
+    SExpr *sexpr, *bindings, *body;
+    char *input;
+    CompileResult result;
+
+    input = "(let loop ((i 0)) (loop i))";
+    parser_init_parser(input);
+    result = parser_parse(&sexpr);
+
+    CU_ASSERT_NOT_EQUAL_FATAL(sexpr, NULL);
+    CU_ASSERT_TRUE_FATAL(PARSER_IS_CONS(sexpr));
+
+    CU_ASSERT_TRUE_FATAL(PARSER_IS_ATOM(PARSER_CAR(sexpr)));
+    CU_ASSERT_EQUAL(PARSER_AS_ATOM(PARSER_CAR(sexpr)).type, TOKEN_LET);
+
+    // Check that the name follows 'let'
+    CU_ASSERT_TRUE_FATAL(PARSER_IS_CONS(PARSER_CDR(sexpr)));
+    CU_ASSERT_TRUE_FATAL(PARSER_IS_ATOM(PARSER_CDAR(sexpr)));
+    CU_ASSERT_EQUAL(PARSER_AS_ATOM(PARSER_CDAR(sexpr)).type, TOKEN_SYMBOL);
+
+    // Check that the bindings constains (i 0)
+    CU_ASSERT_TRUE_FATAL(PARSER_IS_CONS(PARSER_CDDR(sexpr)));
+    bindings = PARSER_CDDAR(sexpr);
+    CU_ASSERT_TRUE_FATAL(PARSER_IS_CONS(bindings));
+    CU_ASSERT_TRUE_FATAL(PARSER_IS_CONS(PARSER_CAR(bindings)));
+    CU_ASSERT_TRUE_FATAL(PARSER_IS_ATOM(PARSER_CAAR(bindings)));
+    CU_ASSERT_EQUAL(PARSER_AS_ATOM(PARSER_CAAR(bindings)).type, TOKEN_SYMBOL);
+    CU_ASSERT_TRUE_FATAL(PARSER_IS_NULL(PARSER_CDR(bindings)));
+
+    // Check that the body contains a single application
+    body = PARSER_CDDDR(sexpr);
+    CU_ASSERT_TRUE_FATAL(PARSER_IS_CONS(body));
+    CU_ASSERT_TRUE_FATAL(PARSER_IS_CONS(PARSER_CAR(body)));
+    CU_ASSERT_TRUE(PARSER_IS_NULL(PARSER_CDR(body)));
+}
+
+void parser_parse_do_test_1()
+{
+    SExpr *sexpr, *specs, *clause;
+    char *input;
+    CompileResult result;
+
+    input = "(do ((i 0 (+ i 1)) (x 1)) ((= i 3) x) (f i))";
+    parser_init_parser(input);
+    result = parser_parse(&sexpr);
+
+    CU_ASSERT_NOT_EQUAL_FATAL(sexpr, NULL);
+    CU_ASSERT_TRUE_FATAL(PARSER_IS_CONS(sexpr));
+
+    CU_ASSERT_TRUE_FATAL(PARSER_IS_ATOM(PARSER_CAR(sexpr)));
+    CU_ASSERT_EQUAL(PARSER_AS_ATOM(PARSER_CAR(sexpr)).type, TOKEN_DO);
+
+    // Check that the first spec has a step and the second has none
+    CU_ASSERT_TRUE_FATAL(PARSER_IS_CONS(PARSER_CDR(sexpr)));
+    specs = PARSER_CDAR(sexpr);
+    CU_ASSERT_TRUE_FATAL(PARSER_IS_CONS(specs));
+    CU_ASSERT_TRUE_FATAL(PARSER_IS_CONS(PARSER_CAR(specs)));
+    CU_ASSERT_TRUE_FATAL(PARSER_IS_CONS(PARSER_CADDR(specs)));
+    CU_ASSERT_TRUE_FATAL(PARSER_IS_NULL(PARSER_CDR(PARSER_CADDR(specs))));
+    CU_ASSERT_TRUE_FATAL(PARSER_IS_CONS(PARSER_CDAR(specs)));
+    CU_ASSERT_TRUE_FATAL(PARSER_IS_NULL(PARSER_CDDR(PARSER_CDAR(specs))));
+    CU_ASSERT_TRUE_FATAL(PARSER_IS_NULL(PARSER_CDDR(specs)));
+
+    // Check that the test clause is (test result)
+    CU_ASSERT_TRUE_FATAL(PARSER_IS_CONS(PARSER_CDDR(sexpr)));
+    clause = PARSER_CDDAR(sexpr);
+    CU_ASSERT_TRUE_FATAL(PARSER_IS_CONS(clause));
+    CU_ASSERT_TRUE_FATAL(PARSER_IS_CONS(PARSER_CAR(clause)));
+    CU_ASSERT_TRUE_FATAL(PARSER_IS_CONS(PARSER_CDR(clause)));
+    CU_ASSERT_TRUE_FATAL(PARSER_IS_NULL(PARSER_CDDR(clause)));
+
+    // Check that a single command follows
+    CU_ASSERT_TRUE_FATAL(PARSER_IS_CONS(PARSER_CDDDR(sexpr)));
+    CU_ASSERT_TRUE(PARSER_IS_NULL(PARSER_CDR(PARSER_CDDDR(sexpr))));
+}
+
+void parser_parse_case_test_1()
+{
+    SExpr *sexpr, *clauses;
+    char *input;
+    CompileResult result;
+
+    input = "(case x ((1 2) a) (else b c))";
+    parser_init_parser(input);
+    result = parser_parse(&sexpr);
+
+    CU_ASSERT_NOT_EQUAL_FATAL(sexpr, NULL);
+    CU_ASSERT_TRUE_FATAL(PARSER_IS_CONS(sexpr));
+
+    CU_ASSERT_TRUE_FATAL(PARSER_IS_ATOM(PARSER_CAR(sexpr)));
+    CU_ASSERT_EQUAL(PARSER_AS_ATOM(PARSER_CAR(sexpr)).type, TOKEN_CASE);
+
+    // Check that the key follows 'case'
+    CU_ASSERT_TRUE_FATAL(PARSER_IS_CONS(PARSER_CDR(sexpr)));
+    CU_ASSERT_TRUE_FATAL(PARSER_IS_ATOM(PARSER_CDAR(sexpr)));
+    CU_ASSERT_EQUAL(PARSER_AS_ATOM(PARSER_CDAR(sexpr)).type, TOKEN_SYMBOL);
+
+    // Check that the first clause is ((1 2) a)
+    clauses = PARSER_CDDR(sexpr);
+    CU_ASSERT_TRUE_FATAL(PARSER_IS_CONS(clauses));
+    CU_ASSERT_TRUE_FATAL(PARSER_IS_CONS(PARSER_CAR(clauses)));
+    CU_ASSERT_TRUE_FATAL(PARSER_IS_CONS(PARSER_CAAR(clauses)));
+    CU_ASSERT_TRUE_FATAL(PARSER_IS_ATOM(PARSER_CAAAR(clauses)));
+    CU_ASSERT_EQUAL(PARSER_AS_ATOM(PARSER_CAAAR(clauses)).type, TOKEN_NUMBER);
+    CU_ASSERT_TRUE_FATAL(PARSER_IS_CONS(PARSER_CADR(clauses)));
+    CU_ASSERT_TRUE(PARSER_IS_NULL(PARSER_CDR(PARSER_CADR(clauses))));
+
+    // Check that the else clause holds two expressions
+    CU_ASSERT_TRUE_FATAL(PARSER_IS_CONS(PARSER_CDR(clauses)));
+    CU_ASSERT_TRUE_FATAL(PARSER_IS_CONS(PARSER_CDAR(clauses)));
+    CU_ASSERT_TRUE_FATAL(PARSER_IS_ATOM(PARSER_CDAAR(clauses)));
+    CU_ASSERT_EQUAL(PARSER_AS_ATOM(PARSER_CDAAR(clauses)).type, TOKEN_ELSE);
+    CU_ASSERT_TRUE_FATAL(PARSER_IS_CONS(PARSER_CDADR(clauses)));
+    CU_ASSERT_TRUE_FATAL(PARSER_IS_CONS(PARSER_CDR(PARSER_CDADR(clauses))));
+    CU_ASSERT_TRUE(PARSER_IS_NULL(PARSER_CDDR(PARSER_CDADR(clauses))));
+
+    CU_ASSERT_TRUE(PARSER_IS_NULL(PARSER_CDDR(clauses)));
+}
+
+void parser_parse_cond_test_1()
+{
+    SExpr *sexpr, *clauses;
+    char *input;
+    CompileResult result;
+
+    input = "(cond ((f x) 1) (y) (else 2))";
+    parser_init_parser(input);
+    result = parser_parse(&sexpr);
+
+    CU_ASSERT_NOT_EQUAL_FATAL(sexpr, NULL);
+    CU_ASSERT_TRUE_FATAL(PARSER_IS_CONS(sexpr));
+
+    CU_ASSERT_TRUE_FATAL(PARSER_IS_ATOM(PARSER_CAR(sexpr)));
+    CU_ASSERT_EQUAL(PARSER_AS_ATOM(PARSER_CAR(sexpr)).type, TOKEN_COND);
+
+    // Check that the first clause has a test and an expression
+    clauses = PARSER_CDR(sexpr);
+    CU_ASSERT_TRUE_FATAL(PARSER_IS_CONS(clauses));
+    CU_ASSERT_TRUE_FATAL(PARSER_IS_CONS(PARSER_CAR(clauses)));
+    CU_ASSERT_TRUE_FATAL(PARSER_IS_CONS(PARSER_CAAR(clauses)));
+    CU_ASSERT_TRUE_FATAL(PARSER_IS_CONS(PARSER_CADR(clauses)));
+
+    // Check that the second clause only has a test
+    CU_ASSERT_TRUE_FATAL(PARSER_IS_CONS(PARSER_CDR(clauses)));
+    CU_ASSERT_TRUE_FATAL(PARSER_IS_ATOM(PARSER_CDAAR(clauses)));
+    CU_ASSERT_TRUE(PARSER_IS_NULL(PARSER_CDADR(clauses)));
+
+    // Check that the last clause is an else clause
+    CU_ASSERT_TRUE_FATAL(PARSER_IS_CONS(PARSER_CDDR(clauses)));
+    CU_ASSERT_TRUE_FATAL(PARSER_IS_ATOM(PARSER_CAR(PARSER_CDDAR(clauses))));
+    CU_ASSERT_EQUAL(PARSER_AS_ATOM(PARSER_CAR(PARSER_CDDAR(clauses))).type, TOKEN_ELSE);
+    CU_ASSERT_TRUE(PARSER_IS_NULL(PARSER_CDDDR(clauses)));
+}
+
+void parser_parse_cond_fail_test_1()
+{
+    SExpr *sexpr;
+    char *input;
+    CompileResult result;
+
+    // The else clause must come last
+    input = "(cond (else 1) (x 2))";
+    parser_init_parser(input);
+    result = parser_parse(&sexpr);
+
+    CU_ASSERT_EQUAL(sexpr, NULL);
+}
+
+void parser_parse_and_test_1()
+{
+    SExpr *sexpr;
+    char *input;
+    CompileResult result;
+
+    input = "(and)";
+    parser_init_parser(input);
+    result = parser_parse(&sexpr);
+
+    CU_ASSERT_NOT_EQUAL_FATAL(sexpr, NULL);
+    CU_ASSERT_TRUE_FATAL(PARSER_IS_CONS(sexpr));
+
+    CU_ASSERT_TRUE_FATAL(PARSER_IS_ATOM(PARSER_CAR(sexpr)));
+    CU_ASSERT_EQUAL(PARSER_AS_ATOM(PARSER_CAR(sexpr)).type, TOKEN_AND);
+
+    CU_ASSERT_TRUE(PARSER_IS_NULL(PARSER_CDR(sexpr)));
+}
+
+void parser_parse_or_test_1()
+{
+    SExpr *sexpr;
+    char *input;
+    CompileResult result;
+
+    input = "(or x (f y))";
+    parser_init_parser(input);
+    result = parser_parse(&sexpr);
+
+    CU_ASSERT_NOT_EQUAL_FATAL(sexpr, NULL);
+    CU_ASSERT_TRUE_FATAL(PARSER_IS_CONS(sexpr));
+
+    CU_ASSERT_TRUE_FATAL(PARSER_IS_ATOM(PARSER_CAR(sexpr)));
+    CU_ASSERT_EQUAL(PARSER_AS_ATOM(PARSER_CAR(sexpr)).type, TOKEN_OR);
+
+    CU_ASSERT_TRUE_FATAL(PARSER_IS_ATOM(PARSER_CDAR(sexpr)));
+    CU_ASSERT_TRUE_FATAL(PARSER_IS_CONS(PARSER_CDDAR(sexpr)));
+    CU_ASSERT_TRUE(PARSER_IS_NULL(PARSER_CDDDR(sexpr)));
+}
+
+void parser_parse_when_test_1()
+{
+    SExpr *sexpr;
+    char *input;
+    CompileResult result;
+
+    input = "(when x 1 2)";
+    parser_init_parser(input);
+    result = parser_parse(&sexpr);
+
+    CU_ASSERT_NOT_EQUAL_FATAL(sexpr, NULL);
+    CU_ASSERT_TRUE_FATAL(PARSER_IS_CONS(sexpr));
+
+    CU_ASSERT_TRUE_FATAL(PARSER_IS_ATOM(PARSER_CAR(sexpr)));
+    CU_ASSERT_EQUAL(PARSER_AS_ATOM(PARSER_CAR(sexpr)).type, TOKEN_WHEN);
+
+    // Check that the test is followed by two expressions
+    CU_ASSERT_TRUE_FATAL(PARSER_IS_ATOM(PARSER_CDAR(sexpr)));
+    CU_ASSERT_EQUAL(PARSER_AS_ATOM(PARSER_CDAR(sexpr)).type, TOKEN_SYMBOL);
+    CU_ASSERT_TRUE_FATAL(PARSER_IS_CONS(PARSER_CDDDR(sexpr)));
+    CU_ASSERT_TRUE(PARSER_IS_NULL(PARSER_CDR(PARSER_CDDDR(sexpr))));
+}
+
+void parser_parse_unless_fail_test_1()
+{
+    SExpr *sexpr;
+    char *input;
+    CompileResult result;
+
+    // The test must be followed by at least one expression
+    input = "(unless x)";
+    parser_init_parser(input);
+    result = parser_parse(&sexpr);
+
+    CU_ASSERT_EQUAL(sexpr, NULL);
+}
+
 void parser_parse_begin_test_1()
 {
     SExpr *sexpr, *body;
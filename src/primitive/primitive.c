@@ -1,6 +1,9 @@
 #include <primitive/primitive.h>
 #include <vm/vm.h>
+#include <bignum/bignum.h>
+#include <vector/vector.h>
 
+#include <math.h>
 #include <stdbool.h>
 #include <time.h>
 #include <stdio.h>
@@ -26,230 +29,749 @@ Value primitive_displayln(int arg_count, Value *args)
 
 Value primitive_clock(int arg_count, Value *args)
 {
-    return VALUE_NUMBER_VAL((double)clock() / CLOCKS_PER_SEC);
+    (void)arg_count;
+    (void)args;
+    return VALUE_FLONUM_VAL((double)clock() / CLOCKS_PER_SEC);
 }
 
-Value primitive_add(int arg_count, Value *args)
+// Arithmetic is exact while the operands are exact integers, whose results
+// are bignums once they no longer fit in a fixnum, and is done on doubles
+// otherwise, like the flonums it then returns.
+
+static bool primitive_check_numbers(int arg_count, Value *args, int least)
 {
-    double sum = 0;
+    if (arg_count < least)
+    {
+        vm_runtime_error("Expected at least %d argument.", least);
+        return false;
+    }
 
     for (int i = 0; i < arg_count; i++)
     {
-        if (VALUE_IS_NUMBER(args[i]))
-            sum += VALUE_AS_NUMBER(args[i]);
-        else
+        if (!OBJECT_IS_NUMBER(args[i]))
+        {
             vm_runtime_error("Expected number.");
+            return false;
+        }
     }
 
-    return VALUE_NUMBER_VAL(sum);
+    return true;
 }
 
-Value primitive_sub(int arg_count, Value *args)
+static double primitive_as_flonum(Value value)
+{
+    return OBJECT_IS_BIGNUM(value) ? bignum_to_flonum(value) : VALUE_AS_NUMBER(value);
+}
+
+static Value primitive_add_two(Value a, Value b)
 {
-    double diff;
+    int64_t result;
 
-    if (arg_count < 1)
+    if (VALUE_IS_FIXNUM(a) && VALUE_IS_FIXNUM(b) &&
+        !__builtin_add_overflow(VALUE_AS_FIXNUM(a), VALUE_AS_FIXNUM(b), &result))
+        return VALUE_FIXNUM_VAL(result);
+    if (OBJECT_IS_EXACT(a) && OBJECT_IS_EXACT(b))
+        return bignum_add(a, b);
+
+    return VALUE_FLONUM_VAL(primitive_as_flonum(a) + primitive_as_flonum(b));
+}
+
+static Value primitive_sub_two(Value a, Value b)
+{
+    int64_t result;
+
+    if (VALUE_IS_FIXNUM(a) && VALUE_IS_FIXNUM(b) &&
+        !__builtin_sub_overflow(VALUE_AS_FIXNUM(a), VALUE_AS_FIXNUM(b), &result))
+        return VALUE_FIXNUM_VAL(result);
+    if (OBJECT_IS_EXACT(a) && OBJECT_IS_EXACT(b))
+        return bignum_subtract(a, b);
+
+    return VALUE_FLONUM_VAL(primitive_as_flonum(a) - primitive_as_flonum(b));
+}
+
+static Value primitive_mup_two(Value a, Value b)
+{
+    int64_t result;
+
+    if (VALUE_IS_FIXNUM(a) && VALUE_IS_FIXNUM(b) &&
+        !__builtin_mul_overflow(VALUE_AS_FIXNUM(a), VALUE_AS_FIXNUM(b), &result))
+        return VALUE_FIXNUM_VAL(result);
+    if (OBJECT_IS_EXACT(a) && OBJECT_IS_EXACT(b))
+        return bignum_multiply(a, b);
+
+    return VALUE_FLONUM_VAL(primitive_as_flonum(a) * primitive_as_flonum(b));
+}
+
+// The quotient of two exact integers is exact when it is an integer. There
+// are no rationals, so any other quotient is a flonum.
+static bool primitive_div_two(Value a, Value b, Value *result)
+{
+    if (VALUE_IS_FIXNUM(b) && VALUE_AS_FIXNUM(b) == 0)
     {
-        vm_runtime_error("Expected at least 1 argument.");
+        vm_runtime_error("Division by zero.");
+        return false;
     }
 
-    if (VALUE_IS_NUMBER(args[0]))
-        diff = VALUE_AS_NUMBER(args[0]);
-    else
-        vm_runtime_error("Expected number.");
+    if (VALUE_IS_FIXNUM(a) && VALUE_IS_FIXNUM(b) && !(VALUE_AS_FIXNUM(a) == INT64_MIN && VALUE_AS_FIXNUM(b) == -1) &&
+        VALUE_AS_FIXNUM(a) % VALUE_AS_FIXNUM(b) == 0)
+    {
+        *result = VALUE_FIXNUM_VAL(VALUE_AS_FIXNUM(a) / VALUE_AS_FIXNUM(b));
+        return true;
+    }
+
+    if (OBJECT_IS_EXACT(a) && OBJECT_IS_EXACT(b))
+    {
+        Value remainder;
+        bignum_divide(a, b, result, &remainder);
+
+        if (VALUE_IS_FIXNUM(remainder) && VALUE_AS_FIXNUM(remainder) == 0)
+            return true;
+    }
+
+    *result = VALUE_FLONUM_VAL(primitive_as_flonum(a) / primitive_as_flonum(b));
+    return true;
+}
+
+Value primitive_add(int arg_count, Value *args)
+{
+    // Two operands of the same type, the common case, skip the general loop.
+    int64_t result;
+
+    if (arg_count == 2 && VALUE_IS_FIXNUM(args[0]) && VALUE_IS_FIXNUM(args[1]) &&
+        !__builtin_add_overflow(VALUE_AS_FIXNUM(args[0]), VALUE_AS_FIXNUM(args[1]), &result))
+        return VALUE_FIXNUM_VAL(result);
+    if (arg_count == 2 && VALUE_IS_FLONUM(args[0]) && VALUE_IS_FLONUM(args[1]))
+        return VALUE_FLONUM_VAL(VALUE_AS_FLONUM(args[0]) + VALUE_AS_FLONUM(args[1]));
+
+    if (!primitive_check_numbers(arg_count, args, 0))
+        return VALUE_VOID_VAL;
+
+    Value sum = arg_count > 0 ? args[0] : VALUE_FIXNUM_VAL(0);
+
+    // The running result is kept on the stack, where the collector sees it.
+    for (int i = 1; i < arg_count; i++)
+    {
+        vm_push(sum);
+        sum = primitive_add_two(sum, args[i]);
+        vm_pop();
+    }
+
+    return sum;
+}
+
+Value primitive_sub(int arg_count, Value *args)
+{
+    int64_t result;
+
+    if (arg_count == 2 && VALUE_IS_FIXNUM(args[0]) && VALUE_IS_FIXNUM(args[1]) &&
+        !__builtin_sub_overflow(VALUE_AS_FIXNUM(args[0]), VALUE_AS_FIXNUM(args[1]), &result))
+        return VALUE_FIXNUM_VAL(result);
+    if (arg_count == 2 && VALUE_IS_FLONUM(args[0]) && VALUE_IS_FLONUM(args[1]))
+        return VALUE_FLONUM_VAL(VALUE_AS_FLONUM(args[0]) - VALUE_AS_FLONUM(args[1]));
+
+    if (!primitive_check_numbers(arg_count, args, 1))
+        return VALUE_VOID_VAL;
 
     if (arg_count == 1)
-        return VALUE_NUMBER_VAL(-diff);
+        return VALUE_IS_FLONUM(args[0]) ? VALUE_FLONUM_VAL(-VALUE_AS_FLONUM(args[0]))
+                                        : primitive_sub_two(VALUE_FIXNUM_VAL(0), args[0]);
+
+    Value diff = args[0];
 
     for (int i = 1; i < arg_count; i++)
     {
-        if (VALUE_IS_NUMBER(args[i]))
-            diff -= VALUE_AS_NUMBER(args[i]);
-        else
-            vm_runtime_error("Expected number.");
+        vm_push(diff);
+        diff = primitive_sub_two(diff, args[i]);
+        vm_pop();
     }
 
-    return VALUE_NUMBER_VAL(diff);
+    return diff;
 }
 
 Value primitive_mup(int arg_count, Value *args)
 {
-    double prod = 1;
+    int64_t result;
 
-    for (int i = 0; i < arg_count; i++)
+    if (arg_count == 2 && VALUE_IS_FIXNUM(args[0]) && VALUE_IS_FIXNUM(args[1]) &&
+        !__builtin_mul_overflow(VALUE_AS_FIXNUM(args[0]), VALUE_AS_FIXNUM(args[1]), &result))
+        return VALUE_FIXNUM_VAL(result);
+    if (arg_count == 2 && VALUE_IS_FLONUM(args[0]) && VALUE_IS_FLONUM(args[1]))
+        return VALUE_FLONUM_VAL(VALUE_AS_FLONUM(args[0]) * VALUE_AS_FLONUM(args[1]));
+
+    if (!primitive_check_numbers(arg_count, args, 0))
+        return VALUE_VOID_VAL;
+
+    Value prod = arg_count > 0 ? args[0] : VALUE_FIXNUM_VAL(1);
+
+    for (int i = 1; i < arg_count; i++)
     {
-        if (VALUE_IS_NUMBER(args[i]))
-            prod *= VALUE_AS_NUMBER(args[i]);
-        else
-            vm_runtime_error("Expected number.");
+        vm_push(prod);
+        prod = primitive_mup_two(prod, args[i]);
+        vm_pop();
     }
 
-    return VALUE_NUMBER_VAL(prod);
+    return prod;
 }
 
 Value primitive_div(int arg_count, Value *args)
 {
-    double fract = 1;
+    if (!primitive_check_numbers(arg_count, args, 1))
+        return VALUE_VOID_VAL;
+
+    Value fract = args[0];
+
+    if (arg_count == 1 && !primitive_div_two(VALUE_FIXNUM_VAL(1), args[0], &fract))
+        return VALUE_VOID_VAL;
 
-    if (arg_count < 1)
+    for (int i = 1; i < arg_count; i++)
     {
-        vm_runtime_error("Expected at least 1 argument.");
+        vm_push(fract);
+        bool divided = primitive_div_two(fract, args[i], &fract);
+        vm_pop();
+
+        if (!divided)
+            return VALUE_VOID_VAL;
+    }
+
+    return fract;
+}
+
+// The integer division of two integers, exact or not. The quotient is
+// truncated, the remainder takes the sign of the dividend and the modulo
+// that of the divisor.
+typedef enum
+{
+    PRIMITIVE_QUOTIENT,
+    PRIMITIVE_REMAINDER,
+    PRIMITIVE_MODULO,
+} PrimitiveDivision;
+
+static Value primitive_divide_integers(int arg_count, Value *args, PrimitiveDivision division)
+{
+    if (arg_count != 2)
+    {
+        vm_runtime_error("Expected 2 arguments but got %d.", arg_count);
+        return VALUE_VOID_VAL;
     }
 
     for (int i = 0; i < arg_count; i++)
     {
-        if (VALUE_IS_NUMBER(args[i]))
-            fract /= VALUE_AS_NUMBER(args[i]);
-        else
-            vm_runtime_error("Expected number.");
+        if (!OBJECT_IS_EXACT(args[i]) &&
+            !(VALUE_IS_FLONUM(args[i]) && VALUE_AS_FLONUM(args[i]) == floor(VALUE_AS_FLONUM(args[i]))))
+        {
+            vm_runtime_error("Expected integer.");
+            return VALUE_VOID_VAL;
+        }
     }
 
-    return VALUE_NUMBER_VAL(fract);
+    Value n = args[0], d = args[1];
+
+    if ((VALUE_IS_FIXNUM(d) && VALUE_AS_FIXNUM(d) == 0) || (VALUE_IS_FLONUM(d) && VALUE_AS_FLONUM(d) == 0))
+    {
+        vm_runtime_error("Division by zero.");
+        return VALUE_VOID_VAL;
+    }
+
+    if (VALUE_IS_FLONUM(n) || VALUE_IS_FLONUM(d))
+    {
+        double x = primitive_as_flonum(n), y = primitive_as_flonum(d);
+        double remainder = fmod(x, y);
+
+        if (division == PRIMITIVE_QUOTIENT)
+            return VALUE_FLONUM_VAL((x - remainder) / y);
+        if (division == PRIMITIVE_MODULO && remainder != 0 && (remainder < 0) != (y < 0))
+            remainder += y;
+
+        return VALUE_FLONUM_VAL(remainder);
+    }
+
+    if (VALUE_IS_FIXNUM(n) && VALUE_IS_FIXNUM(d) && !(VALUE_AS_FIXNUM(n) == INT64_MIN && VALUE_AS_FIXNUM(d) == -1))
+    {
+        int64_t x = VALUE_AS_FIXNUM(n), y = VALUE_AS_FIXNUM(d);
+        int64_t remainder = x % y;
+
+        if (division == PRIMITIVE_QUOTIENT)
+            return VALUE_FIXNUM_VAL(x / y);
+        if (division == PRIMITIVE_MODULO && remainder != 0 && (remainder < 0) != (y < 0))
+            remainder += y;
+
+        return VALUE_FIXNUM_VAL(remainder);
+    }
+
+    Value result;
+
+    if (division == PRIMITIVE_QUOTIENT)
+    {
+        bignum_divide(n, d, &result, NULL);
+        return result;
+    }
+
+    bignum_divide(n, d, NULL, &result);
+
+    Value zero = VALUE_FIXNUM_VAL(0);
+
+    if (division == PRIMITIVE_MODULO && bignum_compare(result, zero) != 0 &&
+        (bignum_compare(result, zero) < 0) != (bignum_compare(d, zero) < 0))
+    {
+        vm_push(result);
+        result = bignum_add(result, d);
+        vm_pop();
+    }
+
+    return result;
 }
 
-Value primitive_num_eq(int arg_count, Value *args)
+Value primitive_quotient(int arg_count, Value *args)
 {
-    double prev;
+    return primitive_divide_integers(arg_count, args, PRIMITIVE_QUOTIENT);
+}
 
-    if (arg_count < 1)
+Value primitive_remainder(int arg_count, Value *args)
+{
+    return primitive_divide_integers(arg_count, args, PRIMITIVE_REMAINDER);
+}
+
+Value primitive_modulo(int arg_count, Value *args)
+{
+    return primitive_divide_integers(arg_count, args, PRIMITIVE_MODULO);
+}
+
+// The square root of an exact integer that is a square is exact.
+Value primitive_sqrt(int arg_count, Value *args)
+{
+    if (arg_count != 1)
     {
-        vm_runtime_error("Expected at least 1 argument.");
+        vm_runtime_error("Expected 1 arguments but got %d.", arg_count);
+        return VALUE_VOID_VAL;
     }
 
-    if (VALUE_IS_NUMBER(args[0]))
-        prev = VALUE_AS_NUMBER(args[0]);
-    // else runtime error!
+    if (!primitive_check_numbers(arg_count, args, 1))
+        return VALUE_VOID_VAL;
+
+    double root = sqrt(primitive_as_flonum(args[0]));
+    Value exact;
 
-    for (int i = 1; i < arg_count; i++)
+    if (OBJECT_IS_BIGNUM(args[0]) && !OBJECT_AS_BIGNUM(args[0])->negative &&
+        bignum_square_root(args[0], &exact))
+        return exact;
+
+    if (VALUE_IS_FIXNUM(args[0]) && VALUE_AS_FIXNUM(args[0]) >= 0)
     {
-        if (VALUE_IS_NUMBER(args[i]))
+        // The double may be off by one for squares beyond 2^53.
+        int64_t n = VALUE_AS_FIXNUM(args[0]);
+        int64_t guess = (int64_t)root;
+
+        for (int64_t candidate = guess > 0 ? guess - 1 : 0; candidate <= guess + 1; candidate++)
         {
-            if (prev != VALUE_AS_NUMBER(args[i]))
-                return VALUE_BOOL_VAL(false);
+            if (candidate <= 3037000499 && candidate * candidate == n)
+                return VALUE_FIXNUM_VAL(candidate);
         }
-        else
-            vm_runtime_error("Expected number.");
     }
 
-    return VALUE_BOOL_VAL(true);
+    return VALUE_FLONUM_VAL(root);
 }
 
-Value primitive_num_le(int arg_count, Value *args)
+// Compares two numbers exactly, an exact integer with a flonum too. Returns
+// a negative number, zero or a positive number, or PRIMITIVE_UNORDERED when
+// either is a NaN.
+#define PRIMITIVE_UNORDERED 2
+
+static int primitive_compare(Value a, Value b)
 {
-    double prev, current;
+    if (VALUE_IS_FIXNUM(a) && VALUE_IS_FIXNUM(b))
+        return (VALUE_AS_FIXNUM(a) > VALUE_AS_FIXNUM(b)) - (VALUE_AS_FIXNUM(a) < VALUE_AS_FIXNUM(b));
 
-    if (arg_count < 1)
+    if (VALUE_IS_FLONUM(a) && VALUE_IS_FLONUM(b))
     {
-        vm_runtime_error("Expected at least 1 argument.");
+        double x = VALUE_AS_FLONUM(a), y = VALUE_AS_FLONUM(b);
+        return isnan(x) || isnan(y) ? PRIMITIVE_UNORDERED : (x > y) - (x < y);
     }
 
-    if (VALUE_IS_NUMBER(args[0]))
-        prev = VALUE_AS_NUMBER(args[0]);
-    else
-        vm_runtime_error("Expected number.");
+    if (VALUE_IS_FLONUM(a))
+    {
+        int order = primitive_compare(b, a);
+        return order == PRIMITIVE_UNORDERED ? order : -order;
+    }
+
+    if (!VALUE_IS_FLONUM(b))
+        return bignum_compare(a, b);
+
+    double y = VALUE_AS_FLONUM(b);
+
+    if (isnan(y))
+        return PRIMITIVE_UNORDERED;
+    if (OBJECT_IS_BIGNUM(a))
+        return bignum_compare_flonum(a, y);
+
+    // A fixnum with a flonum, whose integral part is compared first.
+    int64_t x = VALUE_AS_FIXNUM(a);
+
+    if (y >= 0x1p63)
+        return -1;
+    if (y < -0x1p63)
+        return 1;
+
+    double whole = floor(y);
+
+    if (x != (int64_t)whole)
+        return x < (int64_t)whole ? -1 : 1;
+
+    return whole < y ? -1 : 0;
+}
+
+// Whether every argument is in the relation to the next, given as the
+// orders it holds for.
+#define PRIMITIVE_LESS (1 << 0)
+#define PRIMITIVE_EQUAL (1 << 1)
+#define PRIMITIVE_GREATER (1 << 2)
+
+static Value primitive_compare_all(int arg_count, Value *args, int orders)
+{
+    // Two fixnums or two flonums, the common case, are compared straight away.
+    if (arg_count == 2 && VALUE_IS_NUMBER(args[0]) && args[0].type == args[1].type)
+    {
+        int order = primitive_compare(args[0], args[1]);
+        return VALUE_BOOL_VAL(order != PRIMITIVE_UNORDERED && (orders & (1 << (order + 1))));
+    }
+
+    if (!primitive_check_numbers(arg_count, args, 1))
+        return VALUE_VOID_VAL;
+
+    bool holds = true;
 
     for (int i = 1; i < arg_count; i++)
     {
-        if (VALUE_IS_NUMBER(args[i]))
-        {
-            current = VALUE_AS_NUMBER(args[i]);
-            if (!(prev < current))
-                return VALUE_BOOL_VAL(false);
-            prev = current;
-        }
-        else
-            vm_runtime_error("Expected number.");
+        int order = primitive_compare(args[i - 1], args[i]);
+
+        if (order == PRIMITIVE_UNORDERED || !(orders & (1 << (order + 1))))
+            holds = false;
     }
 
-    return VALUE_BOOL_VAL(true);
+    return VALUE_BOOL_VAL(holds);
+}
+
+Value primitive_num_eq(int arg_count, Value *args)
+{
+    return primitive_compare_all(arg_count, args, PRIMITIVE_EQUAL);
+}
+
+Value primitive_num_le(int arg_count, Value *args)
+{
+    return primitive_compare_all(arg_count, args, PRIMITIVE_LESS);
 }
 
 Value primitive_num_ge(int arg_count, Value *args)
 {
-    double prev, current;
+    return primitive_compare_all(arg_count, args, PRIMITIVE_GREATER);
+}
 
-    if (arg_count < 1)
+Value primitive_num_leq(int arg_count, Value *args)
+{
+    return primitive_compare_all(arg_count, args, PRIMITIVE_LESS | PRIMITIVE_EQUAL);
+}
+
+Value primitive_num_geq(int arg_count, Value *args)
+{
+    return primitive_compare_all(arg_count, args, PRIMITIVE_GREATER | PRIMITIVE_EQUAL);
+}
+
+static bool primitive_check_number(int arg_count, Value *args)
+{
+    if (arg_count != 1)
     {
-        vm_runtime_error("Expected at least 1 argument.");
+        vm_runtime_error("Expected 1 arguments but got %d.", arg_count);
+        return false;
     }
 
-    if (VALUE_IS_NUMBER(args[0]))
-        prev = VALUE_AS_NUMBER(args[0]);
-    else
-        vm_runtime_error("Expected number.");
+    return primitive_check_numbers(arg_count, args, 1);
+}
 
-    for (int i = 1; i < arg_count; i++)
+Value primitive_is_exact(int arg_count, Value *args)
+{
+    if (!primitive_check_number(arg_count, args))
+        return VALUE_VOID_VAL;
+
+    return VALUE_BOOL_VAL(OBJECT_IS_EXACT(args[0]));
+}
+
+Value primitive_is_inexact(int arg_count, Value *args)
+{
+    if (!primitive_check_number(arg_count, args))
+        return VALUE_VOID_VAL;
+
+    return VALUE_BOOL_VAL(VALUE_IS_FLONUM(args[0]));
+}
+
+// Only integral flonums have an exact counterpart, there being no rationals.
+Value primitive_exact(int arg_count, Value *args)
+{
+    if (!primitive_check_number(arg_count, args))
+        return VALUE_VOID_VAL;
+
+    if (!VALUE_IS_FLONUM(args[0]))
+        return args[0];
+
+    double flonum = VALUE_AS_FLONUM(args[0]);
+
+    if (flonum != floor(flonum) || isinf(flonum))
     {
-        if (VALUE_IS_NUMBER(args[i]))
-        {
-            current = VALUE_AS_NUMBER(args[i]);
-            if (!(prev > current))
-                return VALUE_BOOL_VAL(false);
-            prev = current;
-        }
-        else
-            vm_runtime_error("Expected number.");
+        vm_runtime_error("No exact integer for %g.", flonum);
+        return VALUE_VOID_VAL;
     }
 
-    return VALUE_BOOL_VAL(true);
+    return bignum_from_flonum(flonum);
 }
 
-Value primitive_num_leq(int arg_count, Value *args)
+Value primitive_inexact(int arg_count, Value *args)
 {
-    double prev, current;
+    if (!primitive_check_number(arg_count, args))
+        return VALUE_VOID_VAL;
+
+    return VALUE_FLONUM_VAL(primitive_as_flonum(args[0]));
+}
 
-    if (arg_count < 1)
+/* Numeric vectors */
+
+static bool primitive_check_arguments(int arg_count, int expected)
+{
+    if (arg_count != expected)
     {
-        vm_runtime_error("Expected at least 1 argument.");
+        vm_runtime_error("Expected %d arguments but got %d.", expected, arg_count);
+        return false;
     }
 
-    if (VALUE_IS_NUMBER(args[0]))
-        prev = VALUE_AS_NUMBER(args[0]);
-    else
+    return true;
+}
+
+static bool primitive_check_vector(VectorKind kind, Value value)
+{
+    if (!vector_is_kind(value, kind))
+    {
+        vm_runtime_error("Expected %s.", vector_name(kind));
+        return false;
+    }
+
+    return true;
+}
+
+static bool primitive_check_element(VectorKind kind, Value element)
+{
+    if (vector_can_hold(kind, element))
+        return true;
+
+    if (kind == VECTOR_F64)
         vm_runtime_error("Expected number.");
+    else
+        vm_runtime_error("Expected exact integer from %ld to %ld.", kind == VECTOR_S32 ? (long)INT32_MIN : 0L,
+                         kind == VECTOR_S32 ? (long)INT32_MAX : (long)UINT8_MAX);
+    return false;
+}
 
-    for (int i = 1; i < arg_count; i++)
+// Checks that args are a vector of the kind and an index into it.
+static bool primitive_check_index(VectorKind kind, Value *args)
+{
+    if (!primitive_check_vector(kind, args[0]))
+        return false;
+
+    if (!VALUE_IS_FIXNUM(args[1]) || VALUE_AS_FIXNUM(args[1]) < 0 ||
+        VALUE_AS_FIXNUM(args[1]) >= OBJECT_AS_VECTOR(args[0])->length)
     {
-        if (VALUE_IS_NUMBER(args[i]))
+        vm_runtime_error("Index out of range.");
+        return false;
+    }
+
+    return true;
+}
+
+// Checks that args are arg_count vectors of the kind and of one length.
+static bool primitive_check_vectors(VectorKind kind, int arg_count, Value *args, int expected)
+{
+    if (!primitive_check_arguments(arg_count, expected))
+        return false;
+
+    for (int i = 0; i < arg_count; i++)
+    {
+        if (!primitive_check_vector(kind, args[i]))
+            return false;
+
+        if (OBJECT_AS_VECTOR(args[i])->length != OBJECT_AS_VECTOR(args[0])->length)
         {
-            current = VALUE_AS_NUMBER(args[i]);
-            if (!(prev <= current))
-                return VALUE_BOOL_VAL(false);
-            prev = current;
+            vm_runtime_error("Expected vectors of the same length.");
+            return false;
         }
-        else
-            vm_runtime_error("Expected number.");
     }
 
-    return VALUE_BOOL_VAL(true);
+    return true;
 }
 
-Value primitive_num_geq(int arg_count, Value *args)
+static Value primitive_make_vector(VectorKind kind, int arg_count, Value *args)
 {
-    double prev, current;
+    if (arg_count != 1 && !primitive_check_arguments(arg_count, 2))
+        return VALUE_VOID_VAL;
 
-    if (arg_count < 1)
+    if (!VALUE_IS_FIXNUM(args[0]) || VALUE_AS_FIXNUM(args[0]) < 0 || VALUE_AS_FIXNUM(args[0]) > INT32_MAX)
     {
-        vm_runtime_error("Expected at least 1 argument.");
+        vm_runtime_error("Expected length.");
+        return VALUE_VOID_VAL;
     }
 
-    if (VALUE_IS_NUMBER(args[0]))
-        prev = VALUE_AS_NUMBER(args[0]);
-    else
-        vm_runtime_error("Expected number.");
+    if (arg_count == 2 && !primitive_check_element(kind, args[1]))
+        return VALUE_VOID_VAL;
 
-    for (int i = 1; i < arg_count; i++)
+    ObjVector *vector = object_new_vector(kind, (int)VALUE_AS_FIXNUM(args[0]));
+
+    if (arg_count == 2)
+        vector_fill(vector, args[1]);
+
+    return VALUE_OBJ_VAL(vector);
+}
+
+static Value primitive_vector(VectorKind kind, int arg_count, Value *args)
+{
+    for (int i = 0; i < arg_count; i++)
     {
-        if (VALUE_IS_NUMBER(args[i]))
-        {
-            current = VALUE_AS_NUMBER(args[i]);
-            if (!(prev >= current))
-                return VALUE_BOOL_VAL(false);
-            prev = current;
-        }
-        else
-            vm_runtime_error("Expected number.");
+        if (!primitive_check_element(kind, args[i]))
+            return VALUE_VOID_VAL;
+    }
+
+    ObjVector *vector = object_new_vector(kind, arg_count);
+
+    for (int i = 0; i < arg_count; i++)
+        vector_store(vector, i, args[i]);
+
+    return VALUE_OBJ_VAL(vector);
+}
+
+static Value primitive_is_vector(VectorKind kind, int arg_count, Value *args)
+{
+    if (!primitive_check_arguments(arg_count, 1))
+        return VALUE_VOID_VAL;
+
+    return VALUE_BOOL_VAL(vector_is_kind(args[0], kind));
+}
+
+static Value primitive_vector_length(VectorKind kind, int arg_count, Value *args)
+{
+    if (!primitive_check_arguments(arg_count, 1) || !primitive_check_vector(kind, args[0]))
+        return VALUE_VOID_VAL;
+
+    return VALUE_FIXNUM_VAL(OBJECT_AS_VECTOR(args[0])->length);
+}
+
+Value primitive_vector_ref(VectorKind kind, int arg_count, Value *args)
+{
+    Value element = VALUE_VOID_VAL;
+
+    if (primitive_check_arguments(arg_count, 2) && primitive_check_index(kind, args))
+        vector_ref(args[0], args[1], kind, &element);
+
+    return element;
+}
+
+Value primitive_vector_set(VectorKind kind, int arg_count, Value *args)
+{
+    if (primitive_check_arguments(arg_count, 3) && primitive_check_index(kind, args) &&
+        primitive_check_element(kind, args[2]))
+        vector_store(OBJECT_AS_VECTOR(args[0]), (int)VALUE_AS_FIXNUM(args[1]), args[2]);
+
+    return VALUE_VOID_VAL;
+}
+
+static Value primitive_vector_fill(VectorKind kind, int arg_count, Value *args)
+{
+    if (primitive_check_arguments(arg_count, 2) && primitive_check_vector(kind, args[0]) &&
+        primitive_check_element(kind, args[1]))
+        vector_fill(OBJECT_AS_VECTOR(args[0]), args[1]);
+
+    return VALUE_VOID_VAL;
+}
+
+// The element-wise sum or product, in a new vector.
+static Value primitive_vector_map(VectorKind kind, int arg_count, Value *args,
+                                  void (*map)(ObjVector *, ObjVector *, ObjVector *))
+{
+    if (!primitive_check_vectors(kind, arg_count, args, 2))
+        return VALUE_VOID_VAL;
+
+    ObjVector *result = object_new_vector(kind, OBJECT_AS_VECTOR(args[0])->length);
+    map(result, OBJECT_AS_VECTOR(args[0]), OBJECT_AS_VECTOR(args[1]));
+    return VALUE_OBJ_VAL(result);
+}
+
+static Value primitive_vector_add(VectorKind kind, int arg_count, Value *args)
+{
+    return primitive_vector_map(kind, arg_count, args, vector_add);
+}
+
+static Value primitive_vector_mul(VectorKind kind, int arg_count, Value *args)
+{
+    return primitive_vector_map(kind, arg_count, args, vector_multiply);
+}
+
+static Value primitive_vector_dot(VectorKind kind, int arg_count, Value *args)
+{
+    if (!primitive_check_vectors(kind, arg_count, args, 2))
+        return VALUE_VOID_VAL;
+
+    return vector_dot(OBJECT_AS_VECTOR(args[0]), OBJECT_AS_VECTOR(args[1]));
+}
+
+static Value primitive_vector_sum(VectorKind kind, int arg_count, Value *args)
+{
+    if (!primitive_check_vectors(kind, arg_count, args, 1))
+        return VALUE_VOID_VAL;
+
+    return vector_sum(OBJECT_AS_VECTOR(args[0]));
+}
+
+// The primitives of each kind, named as in SRFI-4 with the bulk operations
+// after the same pattern.
+#define PRIMITIVE_VECTOR_PRIMITIVES(name, kind)                 \
+    Value primitive_make_##name(int arg_count, Value *args)     \
+    {                                                           \
+        return primitive_make_vector(kind, arg_count, args);    \
+    }                                                           \
+    Value primitive_##name(int arg_count, Value *args)          \
+    {                                                           \
+        return primitive_vector(kind, arg_count, args);         \
+    }                                                           \
+    Value primitive_is_##name(int arg_count, Value *args)       \
+    {                                                           \
+        return primitive_is_vector(kind, arg_count, args);      \
+    }                                                           \
+    Value primitive_##name##_length(int arg_count, Value *args) \
+    {                                                           \
+        return primitive_vector_length(kind, arg_count, args);  \
+    }                                                           \
+    Value primitive_##name##_ref(int arg_count, Value *args)    \
+    {                                                           \
+        return primitive_vector_ref(kind, arg_count, args);     \
+    }                                                           \
+    Value primitive_##name##_set(int arg_count, Value *args)    \
+    {                                                           \
+        return primitive_vector_set(kind, arg_count, args);     \
+    }                                                           \
+    Value primitive_##name##_fill(int arg_count, Value *args)   \
+    {                                                           \
+        return primitive_vector_fill(kind, arg_count, args);    \
+    }                                                           \
+    Value primitive_##name##_add(int arg_count, Value *args)    \
+    {                                                           \
+        return primitive_vector_add(kind, arg_count, args);     \
+    }                                                           \
+    Value primitive_##name##_mul(int arg_count, Value *args)    \
+    {                                                           \
+        return primitive_vector_mul(kind, arg_count, args);     \
+    }                                                           \
+    Value primitive_##name##_dot(int arg_count, Value *args)    \
+    {                                                           \
+        return primitive_vector_dot(kind, arg_count, args);     \
+    }                                                           \
+    Value primitive_##name##_sum(int arg_count, Value *args)    \
+    {                                                           \
+        return primitive_vector_sum(kind, arg_count, args);     \
     }
 
-    return VALUE_BOOL_VAL(true);
-}
\ No newline at end of file
+PRIMITIVE_VECTOR_PRIMITIVES(f64vector, VECTOR_F64)
+PRIMITIVE_VECTOR_PRIMITIVES(s32vector, VECTOR_S32)
+PRIMITIVE_VECTOR_PRIMITIVES(u8vector, VECTOR_U8)
\ No newline at end of file
@@ -2,6 +2,7 @@
 #define _PRIMITIVE_H
 
 #include <value/value.h>
+#include <object/object.h>
 
 Value primitive_clock(int arg_count, Value *args);
 Value primitive_display(int arg_count, Value *args);
@@ -11,6 +12,10 @@ Value primitive_add(int arg_count, Value *args);
 Value primitive_sub(int arg_count, Value *args);
 Value primitive_mup(int arg_count, Value *args);
 Value primitive_div(int arg_count, Value *args);
+Value primitive_quotient(int arg_count, Value *args);
+Value primitive_remainder(int arg_count, Value *args);
+Value primitive_modulo(int arg_count, Value *args);
+Value primitive_sqrt(int arg_count, Value *args);
 
 Value primitive_num_eq(int arg_count, Value *args);
 Value primitive_num_le(int arg_count, Value *args);
@@ -18,4 +23,31 @@ Value primitive_num_ge(int arg_count, Value *args);
 Value primitive_num_leq(int arg_count, Value *args);
 Value primitive_num_geq(int arg_count, Value *args);
 
+Value primitive_is_exact(int arg_count, Value *args);
+Value primitive_is_inexact(int arg_count, Value *args);
+Value primitive_exact(int arg_count, Value *args);
+Value primitive_inexact(int arg_count, Value *args);
+
+// What OP_VECTOR_REF and OP_VECTOR_SET do with anything the instructions
+// don't do themselves, see vector.h.
+Value primitive_vector_ref(VectorKind kind, int arg_count, Value *args);
+Value primitive_vector_set(VectorKind kind, int arg_count, Value *args);
+
+#define PRIMITIVE_DECLARE_VECTOR_PRIMITIVES(name)                \
+    Value primitive_make_##name(int arg_count, Value *args);     \
+    Value primitive_##name(int arg_count, Value *args);          \
+    Value primitive_is_##name(int arg_count, Value *args);       \
+    Value primitive_##name##_length(int arg_count, Value *args); \
+    Value primitive_##name##_ref(int arg_count, Value *args);    \
+    Value primitive_##name##_set(int arg_count, Value *args);    \
+    Value primitive_##name##_fill(int arg_count, Value *args);   \
+    Value primitive_##name##_add(int arg_count, Value *args);    \
+    Value primitive_##name##_mul(int arg_count, Value *args);    \
+    Value primitive_##name##_dot(int arg_count, Value *args);    \
+    Value primitive_##name##_sum(int arg_count, Value *args);
+
+PRIMITIVE_DECLARE_VECTOR_PRIMITIVES(f64vector)
+PRIMITIVE_DECLARE_VECTOR_PRIMITIVES(s32vector)
+PRIMITIVE_DECLARE_VECTOR_PRIMITIVES(u8vector)
+
 #endif
\ No newline at end of file
@@ -22,6 +22,8 @@ bool readlines_is_closed(const char *str)
 
 int readlines_bind_cr(int count, int key)
 {
+    (void)count;
+    (void)key;
     rl_insert_text("\n");
 
     if (readlines_is_closed(rl_line_buffer))
@@ -33,12 +35,15 @@ int readlines_bind_cr(int count, int key)
     {
         // printf(">");
     }
+
+    return 0;
 }
 
 int readlines_startup_hook(void)
 {
     rl_bind_key('\n', readlines_bind_cr);
     rl_bind_key('\r', readlines_bind_cr);
+    return 0;
 }
 
 void readlines_init()
@@ -57,4 +62,5 @@ char *readlines(const char *prompt)
     }
 
     printf("\"%s\"\n", line);
+    return line;
 }
\ No newline at end of file
@@ -0,0 +1,22 @@
+#ifndef _KEYWORD_HASH_H
+#define _KEYWORD_HASH_H
+
+#include <stdint.h>
+
+// Shared by the scanner and by tools/keyword_hash.c, which searches for the
+// per-bucket seeds that make this function collision free over the keyword
+// list. Changing it requires no other edits; the tables are regenerated on
+// the next build.
+static inline uint32_t keyword_hash(const char *chars, int length, uint32_t seed)
+{
+    uint32_t hash = 2166136261u ^ (seed * 0x9e3779b9u);
+    for (int i = 0; i < length; i++)
+    {
+        hash ^= (uint8_t)chars[i];
+        hash *= 16777619;
+    }
+    hash ^= hash >> 15;
+    return hash;
+}
+
+#endif
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include <scanner/scanner.h>
+#include <scanner/keyword_hash.h>
 
 #include <stdio.h>
 #include <string.h>
@@ -12,13 +13,29 @@ typedef struct
     const char *line_begin;
 } Scanner;
 
+typedef struct
+{
+    const char *chars;
+    int length;
+    TokenType type;
+} Keyword;
+
+// Generated from scanner/keywords.txt by tools/keyword_hash.c.
+#include <scanner/keywords.h>
+
 Scanner scanner;
 
 void scanner_init_scanner(const char *source)
+{
+    scanner_init_scanner_at(source, 1);
+}
+
+// Scans source as if it started on the given line of a larger file.
+void scanner_init_scanner_at(const char *source, int line)
 {
     scanner.start = source;
     scanner.current = source;
-    scanner.line = 1;
+    scanner.line = line;
     scanner.line_begin = source;
 }
 
@@ -131,48 +148,23 @@ static void scanner_skip_whitespace()
     }
 }
 
-static TokenType scanner_check_keyword(int start, int length, const char *rest, TokenType type)
+static TokenType scanner_identifier_type()
 {
-    if (scanner.current - scanner.start == start + length &&
-        memcmp(scanner.start + start, rest, length) == 0)
-        return type;
+    int length = (int)(scanner.current - scanner.start);
 
-    return TOKEN_SYMBOL;
-}
+    if (length > SCANNER_KEYWORD_MAX_LENGTH)
+        return TOKEN_SYMBOL;
 
-static TokenType scanner_identifier_type()
-{
+    // The first hash picks a bucket, whose seed makes the second hash land on
+    // the only slot the symbol can match. One comparison confirms the hit.
+    uint32_t bucket = keyword_hash(scanner.start, length, 0) % SCANNER_KEYWORD_BUCKETS;
+    uint32_t slot = keyword_hash(scanner.start, length, scanner_keyword_seeds[bucket]) %
+                    SCANNER_KEYWORD_COUNT;
+    const Keyword *keyword = &scanner_keywords[slot];
 
-    switch (scanner.start[0])
-    {
-#define SCANNER_LENGTH(str) (sizeof(str) - 1)
-#define SCANNER_ARGS(str1, str2) SCANNER_LENGTH(str1), SCANNER_LENGTH(str2), str2
-    case '.':
-        return scanner_check_keyword(SCANNER_ARGS(".", ""), TOKEN_DOT);
-    case 'b':
-        return scanner_check_keyword(SCANNER_ARGS("b", "egin"), TOKEN_BEGIN);
-    case 'c':
-        return scanner_check_keyword(SCANNER_ARGS("c", "all/cc"), TOKEN_CALL_CC);
-    case 'd':
-        return scanner_check_keyword(SCANNER_ARGS("d", "efine"), TOKEN_DEFINE);
-    case 'i':
-        return scanner_check_keyword(SCANNER_ARGS("i", "f"), TOKEN_IF);
-    case 'l':
-        if (scanner.current - scanner.start > 1)
-            switch (scanner.start[1])
-            {
-            case 'a':
-                return scanner_check_keyword(SCANNER_ARGS("la", "mbda"), TOKEN_LAMBDA);
-            case 'e':
-                return scanner_check_keyword(SCANNER_ARGS("le", "t"), TOKEN_LET);
-            }
-    case 'q':
-        return scanner_check_keyword(SCANNER_ARGS("q", "uote"), TOKEN_QUOTE);
-    case 's':
-        return scanner_check_keyword(SCANNER_ARGS("s", "et!"), TOKEN_SET);
-#undef SCANNER_LENGTH
-#undef SCANNER_ARGS
-    }
+    if (keyword->length == length &&
+        memcmp(scanner.start, keyword->chars, length) == 0)
+        return keyword->type;
 
     return TOKEN_SYMBOL;
 }
@@ -26,8 +26,18 @@ typedef enum
     TOKEN_LET,
     TOKEN_BEGIN,
     TOKEN_IF,
+    TOKEN_DO,
+    TOKEN_CASE,
+    TOKEN_COND,
+    TOKEN_AND,
+    TOKEN_OR,
+    TOKEN_WHEN,
+    TOKEN_UNLESS,
     TOKEN_CALL_CC,
 
+    // Auxiliary syntax.
+    TOKEN_ELSE,
+
     // Other.
     TOKEN_FAIL,
     TOKEN_EOF
@@ -43,6 +53,7 @@ typedef struct
 } Token;
 
 void scanner_init_scanner(const char *source);
+void scanner_init_scanner_at(const char *source, int line);
 Token scanner_scan_token();
 
 #endif
\ No newline at end of file
@@ -8,7 +8,7 @@ void scanner_scan_token_test()
 {
     const char *input =
         "-.!$%&*+-./:<=>?@^_~abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789 \
-         -1234567890 #t #f . \"string\" ( ) call/cc define if lambda let begin quote set! #";
+         -1234567890 #t #f . \"string\" ( ) call/cc define if lambda let begin do case cond else and or when unless quote set! #";
 
     scanner_init_scanner(input);
 
@@ -26,6 +26,14 @@ void scanner_scan_token_test()
     CU_ASSERT_EQUAL(scanner_scan_token().type, TOKEN_LAMBDA);
     CU_ASSERT_EQUAL(scanner_scan_token().type, TOKEN_LET);
     CU_ASSERT_EQUAL(scanner_scan_token().type, TOKEN_BEGIN);
+    CU_ASSERT_EQUAL(scanner_scan_token().type, TOKEN_DO);
+    CU_ASSERT_EQUAL(scanner_scan_token().type, TOKEN_CASE);
+    CU_ASSERT_EQUAL(scanner_scan_token().type, TOKEN_COND);
+    CU_ASSERT_EQUAL(scanner_scan_token().type, TOKEN_ELSE);
+    CU_ASSERT_EQUAL(scanner_scan_token().type, TOKEN_AND);
+    CU_ASSERT_EQUAL(scanner_scan_token().type, TOKEN_OR);
+    CU_ASSERT_EQUAL(scanner_scan_token().type, TOKEN_WHEN);
+    CU_ASSERT_EQUAL(scanner_scan_token().type, TOKEN_UNLESS);
     CU_ASSERT_EQUAL(scanner_scan_token().type, TOKEN_QUOTE);
     CU_ASSERT_EQUAL(scanner_scan_token().type, TOKEN_SET);
 
@@ -37,4 +45,19 @@ void scanner_scan_token_test()
     CU_ASSERT_EQUAL(scanner_scan_token().type, TOKEN_EOF);
 }
 
+void scanner_scan_keyword_test()
+{
+    // Prefixes, extensions and near misses of keywords are plain symbols
+    const char *input = "l le lets lambda! q quot quotes iff i set defines .. call/c d dos cas conds elsewhere an ore whenever unles begin do";
+
+    scanner_init_scanner(input);
+
+    for (int i = 0; i < 22; i++)
+        CU_ASSERT_EQUAL(scanner_scan_token().type, TOKEN_SYMBOL);
+
+    CU_ASSERT_EQUAL(scanner_scan_token().type, TOKEN_BEGIN);
+    CU_ASSERT_EQUAL(scanner_scan_token().type, TOKEN_DO);
+    CU_ASSERT_EQUAL(scanner_scan_token().type, TOKEN_EOF);
+}
+
 #endif
\ No newline at end of file
@@ -0,0 +1,751 @@
+#include <serialize/serialize.h>
+#include <memory/memory.h>
+#include <table/table.h>
+#include <vm/vm.h>
+#include <compiler/compiler.h>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define SERIALIZE_MAGIC 0x4253494cu // "LISB"
+#define SERIALIZE_PATH_MAX 4096
+
+typedef enum
+{
+    SERIALIZE_TAG_NULL,
+    SERIALIZE_TAG_VOID,
+    SERIALIZE_TAG_FALSE,
+    SERIALIZE_TAG_TRUE,
+    SERIALIZE_TAG_FLONUM,
+    SERIALIZE_TAG_FIXNUM,
+    SERIALIZE_TAG_BIGNUM,
+    SERIALIZE_TAG_STRING,
+    SERIALIZE_TAG_FUNCTION,
+    SERIALIZE_TAG_CLOSURE,
+} SerializeTag;
+
+typedef struct
+{
+    Writer *writer;
+    int *indices; // vm.globals slot -> index into names, or -1
+    ObjString **names;
+    int name_count;
+} CacheWriter;
+
+typedef struct
+{
+    Reader *reader;
+    uint16_t *slots; // index in the file's global table -> vm.globals slot
+    int slot_count;
+} CacheReader;
+
+/* Writing */
+
+void serialize_init_writer(Writer *writer)
+{
+    writer->bytes = NULL;
+    writer->count = 0;
+    writer->capacity = 0;
+}
+
+void serialize_free_writer(Writer *writer)
+{
+    // The buffer lives outside the collected heap so that writing never
+    // triggers a garbage collection halfway through an object graph.
+    free(writer->bytes);
+    serialize_init_writer(writer);
+}
+
+void serialize_write_bytes(Writer *writer, const void *bytes, size_t count)
+{
+    // Nothing to copy, and bytes may be NULL, as the body of an empty
+    // writer is.
+    if (count == 0)
+        return;
+
+    if (writer->capacity < writer->count + count)
+    {
+        size_t capacity = writer->capacity < 256 ? 256 : writer->capacity;
+
+        while (capacity < writer->count + count)
+            capacity *= 2;
+
+        writer->bytes = (uint8_t *)realloc(writer->bytes, capacity);
+
+        if (writer->bytes == NULL)
+            exit(1);
+
+        writer->capacity = capacity;
+    }
+
+    memcpy(writer->bytes + writer->count, bytes, count);
+    writer->count += count;
+}
+
+void serialize_write_u8(Writer *writer, uint8_t value)
+{
+    serialize_write_bytes(writer, &value, sizeof(value));
+}
+
+void serialize_write_u32(Writer *writer, uint32_t value)
+{
+    serialize_write_bytes(writer, &value, sizeof(value));
+}
+
+void serialize_write_i64(Writer *writer, int64_t value)
+{
+    serialize_write_bytes(writer, &value, sizeof(value));
+}
+
+void serialize_write_f64(Writer *writer, double value)
+{
+    serialize_write_bytes(writer, &value, sizeof(value));
+}
+
+bool serialize_write_file(Writer *writer, const char *path)
+{
+    char temp_path[SERIALIZE_PATH_MAX];
+
+    // Write to a private file first and rename it into place, so concurrent
+    // runs never map a half-written file.
+    if (snprintf(temp_path, sizeof(temp_path), "%s.%ld.tmp", path, (long)getpid()) >= (int)sizeof(temp_path))
+        return false;
+
+    FILE *file = fopen(temp_path, "wb");
+
+    if (file == NULL)
+        return false;
+
+    bool written = fwrite(writer->bytes, 1, writer->count, file) == writer->count;
+    written = (fclose(file) == 0) && written;
+
+    if (!written || rename(temp_path, path) != 0)
+    {
+        remove(temp_path);
+        return false;
+    }
+
+    return true;
+}
+
+/* Reading */
+
+bool serialize_map_file(const char *path, Reader *reader)
+{
+    struct stat info;
+    int fd = open(path, O_RDONLY);
+
+    if (fd == -1)
+        return false;
+
+    if (fstat(fd, &info) != 0 || info.st_size == 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    void *bytes = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (bytes == MAP_FAILED)
+        return false;
+
+    reader->bytes = (const uint8_t *)bytes;
+    reader->count = (size_t)info.st_size;
+    reader->offset = 0;
+    reader->failed = false;
+    return true;
+}
+
+void serialize_unmap_file(Reader *reader)
+{
+    munmap((void *)reader->bytes, reader->count);
+    reader->bytes = NULL;
+    reader->count = 0;
+}
+
+const uint8_t *serialize_read_bytes(Reader *reader, size_t count)
+{
+    if (reader->failed || reader->count - reader->offset < count)
+    {
+        reader->failed = true;
+        return NULL;
+    }
+
+    const uint8_t *bytes = reader->bytes + reader->offset;
+    reader->offset += count;
+    return bytes;
+}
+
+#define SERIALIZE_READ(type, reader)                                      \
+    do                                                                    \
+    {                                                                     \
+        type value = 0;                                                   \
+        const uint8_t *bytes = serialize_read_bytes(reader, sizeof(type)); \
+        if (bytes != NULL)                                                \
+            memcpy(&value, bytes, sizeof(type));                          \
+        return value;                                                     \
+    } while (false)
+
+uint8_t serialize_read_u8(Reader *reader)
+{
+    SERIALIZE_READ(uint8_t, reader);
+}
+
+uint32_t serialize_read_u32(Reader *reader)
+{
+    SERIALIZE_READ(uint32_t, reader);
+}
+
+int64_t serialize_read_i64(Reader *reader)
+{
+    SERIALIZE_READ(int64_t, reader);
+}
+
+double serialize_read_f64(Reader *reader)
+{
+    SERIALIZE_READ(double, reader);
+}
+
+#undef SERIALIZE_READ
+
+/* Chunks */
+
+size_t serialize_write_code(Writer *writer, Chunk *chunk)
+{
+    serialize_write_u32(writer, (uint32_t)chunk->count);
+
+    size_t code = writer->count;
+    serialize_write_bytes(writer, chunk->code, chunk->count);
+
+    serialize_write_u32(writer, (uint32_t)chunk->line_count);
+    for (int i = 0; i < chunk->line_count; i++)
+    {
+        serialize_write_u32(writer, (uint32_t)chunk->lines[i].offset);
+        serialize_write_u32(writer, (uint32_t)chunk->lines[i].line);
+    }
+
+    return code;
+}
+
+bool serialize_read_code(Reader *reader, Chunk *chunk)
+{
+    uint32_t count = serialize_read_u32(reader);
+    const uint8_t *code = serialize_read_bytes(reader, count);
+
+    if (code == NULL)
+        return false;
+
+    // Functions that are compiled on their first call have no code yet.
+    if (count > 0)
+    {
+        uint8_t *chunk_code = MEMORY_ALLOCATE(uint8_t, count);
+        memcpy(chunk_code, code, count);
+        chunk->code = chunk_code;
+        chunk->count = chunk->capacity = (int)count;
+    }
+
+    uint32_t line_count = serialize_read_u32(reader);
+
+    for (uint32_t i = 0; i < line_count && !reader->failed; i++)
+    {
+        uint32_t offset = serialize_read_u32(reader);
+        uint32_t line = serialize_read_u32(reader);
+        chunk_add_line(chunk, (int)offset, (int)line);
+    }
+
+    return !reader->failed;
+}
+
+/* Bignums */
+
+void serialize_write_bignum(Writer *writer, ObjBignum *bignum)
+{
+    serialize_write_u8(writer, bignum->negative);
+    serialize_write_u32(writer, (uint32_t)bignum->count);
+    serialize_write_bytes(writer, bignum->digits, sizeof(uint32_t) * bignum->count);
+}
+
+ObjBignum *serialize_read_bignum(Reader *reader)
+{
+    bool negative = serialize_read_u8(reader) != 0;
+    uint32_t count = serialize_read_u32(reader);
+    const uint8_t *digits = serialize_read_bytes(reader, sizeof(uint32_t) * (size_t)count);
+
+    if (digits == NULL || count == 0)
+        return NULL;
+
+    ObjBignum *bignum = object_new_bignum(negative, (int)count);
+    memcpy(bignum->digits, digits, sizeof(uint32_t) * count);
+    return bignum;
+}
+
+/* Numeric vectors */
+
+void serialize_write_vector(Writer *writer, ObjVector *vector)
+{
+    serialize_write_u8(writer, (uint8_t)vector->kind);
+    serialize_write_u32(writer, (uint32_t)vector->length);
+    serialize_write_bytes(writer, vector->elements, object_vector_element_size(vector->kind) * vector->length);
+}
+
+ObjVector *serialize_read_vector(Reader *reader)
+{
+    uint8_t kind = serialize_read_u8(reader);
+    uint32_t length = serialize_read_u32(reader);
+
+    if (kind > VECTOR_U8 || length > INT32_MAX)
+        return NULL;
+
+    size_t size = object_vector_element_size((VectorKind)kind) * length;
+    const uint8_t *elements = serialize_read_bytes(reader, size);
+
+    if (elements == NULL)
+        return NULL;
+
+    ObjVector *vector = object_new_vector((VectorKind)kind, (int)length);
+    memcpy(vector->elements, elements, size);
+    return vector;
+}
+
+/* Bytecode cache -- writing */
+
+static bool serialize_write_function(CacheWriter *cache, ObjFunction *function);
+
+static int serialize_global_index(CacheWriter *cache, int slot)
+{
+    if (cache->indices[slot] == -1)
+    {
+        cache->names[cache->name_count] = vm.globals.entries[slot].key;
+        cache->indices[slot] = cache->name_count++;
+    }
+
+    return cache->indices[slot];
+}
+
+static bool serialize_write_value(CacheWriter *cache, Value value)
+{
+    Writer *writer = cache->writer;
+
+    switch (value.type)
+    {
+    case VALUE_NULL:
+        serialize_write_u8(writer, SERIALIZE_TAG_NULL);
+        return true;
+    case VALUE_VOID:
+        serialize_write_u8(writer, SERIALIZE_TAG_VOID);
+        return true;
+    case VALUE_BOOL:
+        serialize_write_u8(writer, VALUE_AS_BOOL(value) ? SERIALIZE_TAG_TRUE : SERIALIZE_TAG_FALSE);
+        return true;
+    case VALUE_FLONUM:
+        serialize_write_u8(writer, SERIALIZE_TAG_FLONUM);
+        serialize_write_f64(writer, VALUE_AS_FLONUM(value));
+        return true;
+    case VALUE_FIXNUM:
+        serialize_write_u8(writer, SERIALIZE_TAG_FIXNUM);
+        serialize_write_i64(writer, VALUE_AS_FIXNUM(value));
+        return true;
+    case VALUE_OBJ:
+        switch (OBJECT_OBJ_TYPE(value))
+        {
+        case OBJ_BIGNUM:
+            serialize_write_u8(writer, SERIALIZE_TAG_BIGNUM);
+            serialize_write_bignum(writer, OBJECT_AS_BIGNUM(value));
+            return true;
+        case OBJ_STRING:
+        {
+            ObjString *string = OBJECT_AS_STRING(value);
+            serialize_write_u8(writer, SERIALIZE_TAG_STRING);
+            serialize_write_u32(writer, (uint32_t)string->length);
+            serialize_write_bytes(writer, string->chars, string->length);
+            return true;
+        }
+        case OBJ_FUNCTION:
+            serialize_write_u8(writer, SERIALIZE_TAG_FUNCTION);
+            return serialize_write_function(cache, OBJECT_AS_FUNCTION(value));
+        case OBJ_CLOSURE:
+            // Lambdas without free variables are compiled to a closure.
+            if (OBJECT_AS_CLOSURE(value)->upvalue_count > 0)
+                return false;
+            serialize_write_u8(writer, SERIALIZE_TAG_CLOSURE);
+            return serialize_write_function(cache, OBJECT_AS_CLOSURE(value)->function);
+        default:
+            return false; // Only literals and code appear in constant tables.
+        }
+    }
+
+    return false;
+}
+
+static bool serialize_write_function(CacheWriter *cache, ObjFunction *function)
+{
+    Writer *writer = cache->writer;
+    Chunk *chunk = &function->chunk;
+
+    serialize_write_u32(writer, (uint32_t)function->arity);
+    serialize_write_u32(writer, (uint32_t)function->upvalue_count);
+    serialize_write_u32(writer, (uint32_t)function->arena_size);
+    serialize_write_u32(writer, (uint32_t)function->line);
+
+    // A function not compiled yet is written as its source and stays lazy.
+    if (!serialize_write_value(cache, function->source != NULL ? VALUE_OBJ_VAL(function->source) : VALUE_NULL_VAL))
+        return false;
+
+    // Global slots depend on the order in which names were declared, so they
+    // are written as indices into the file's table of global names.
+    size_t code = serialize_write_code(writer, chunk);
+
+    for (int offset = 0; offset < chunk->count; offset += chunk_instruction_size(chunk, offset))
+    {
+        if (chunk->code[offset] == OP_GET_GLOBAL || chunk->code[offset] == OP_SET_GLOBAL ||
+            chunk->code[offset] == OP_GLOBAL_UNCHANGED)
+        {
+            int slot = (chunk->code[offset + 1] << 8) | chunk->code[offset + 2];
+            int index = serialize_global_index(cache, slot);
+            writer->bytes[code + offset + 1] = (index >> 8) & 0xff;
+            writer->bytes[code + offset + 2] = index & 0xff;
+        }
+    }
+
+    serialize_write_u32(writer, (uint32_t)chunk->constants.count);
+
+    for (int i = 0; i < chunk->constants.count; i++)
+    {
+        if (!serialize_write_value(cache, chunk->constants.values[i]))
+            return false;
+    }
+
+    return true;
+}
+
+/* Bytecode cache -- reading */
+
+static ObjFunction *serialize_read_function(CacheReader *cache, bool script);
+
+static bool serialize_read_value(CacheReader *cache, Value *value)
+{
+    Reader *reader = cache->reader;
+
+    switch (serialize_read_u8(reader))
+    {
+    case SERIALIZE_TAG_NULL:
+        *value = VALUE_NULL_VAL;
+        break;
+    case SERIALIZE_TAG_VOID:
+        *value = VALUE_VOID_VAL;
+        break;
+    case SERIALIZE_TAG_FALSE:
+        *value = VALUE_BOOL_VAL(false);
+        break;
+    case SERIALIZE_TAG_TRUE:
+        *value = VALUE_BOOL_VAL(true);
+        break;
+    case SERIALIZE_TAG_FLONUM:
+        *value = VALUE_FLONUM_VAL(serialize_read_f64(reader));
+        break;
+    case SERIALIZE_TAG_FIXNUM:
+        *value = VALUE_FIXNUM_VAL(serialize_read_i64(reader));
+        break;
+    case SERIALIZE_TAG_BIGNUM:
+    {
+        ObjBignum *bignum = serialize_read_bignum(reader);
+
+        if (bignum == NULL)
+            return false;
+
+        *value = VALUE_OBJ_VAL(bignum);
+        break;
+    }
+    case SERIALIZE_TAG_STRING:
+    {
+        uint32_t length = serialize_read_u32(reader);
+        const char *chars = (const char *)serialize_read_bytes(reader, length);
+
+        if (chars == NULL)
+            return false;
+
+        *value = VALUE_OBJ_VAL(object_copy_string(chars, (int)length));
+        break;
+    }
+    case SERIALIZE_TAG_FUNCTION:
+    {
+        ObjFunction *function = serialize_read_function(cache, false);
+
+        if (function == NULL)
+            return false;
+
+        *value = VALUE_OBJ_VAL(function);
+        break;
+    }
+    case SERIALIZE_TAG_CLOSURE:
+    {
+        ObjFunction *function = serialize_read_function(cache, false);
+
+        if (function == NULL || function->upvalue_count > 0)
+            return false;
+
+        vm_push(VALUE_OBJ_VAL(function));
+        *value = VALUE_OBJ_VAL(object_new_closure(function));
+        vm_pop();
+        break;
+    }
+    default:
+        return false;
+    }
+
+    return !reader->failed;
+}
+
+static bool serialize_link_globals(CacheReader *cache, Chunk *chunk)
+{
+    for (int offset = 0; offset < chunk->count;)
+    {
+        uint8_t instruction = chunk->code[offset];
+
+        if (instruction == OP_CLOSURE || instruction == OP_CLOSURE_LONG ||
+            instruction == OP_STACK_CLOSURE || instruction == OP_STACK_CLOSURE_LONG)
+        {
+            int constant = chunk->constants.count;
+            bool wide = instruction == OP_CLOSURE_LONG || instruction == OP_STACK_CLOSURE_LONG;
+
+            if (!wide && offset + 1 < chunk->count)
+                constant = chunk->code[offset + 1];
+            else if (wide && offset + 3 < chunk->count)
+                constant = (chunk->code[offset + 1] << 16) |
+                           (chunk->code[offset + 2] << 8) |
+                           chunk->code[offset + 3];
+
+            if (constant >= chunk->constants.count ||
+                !OBJECT_IS_FUNCTION(chunk->constants.values[constant]))
+                return false;
+        }
+
+        if (instruction == OP_SWITCH && offset + CHUNK_SWITCH_HEADER > chunk->count)
+            return false;
+
+        int size = chunk_instruction_size(chunk, offset);
+
+        if (offset + size > chunk->count)
+            return false;
+
+        if (instruction == OP_GET_GLOBAL || instruction == OP_SET_GLOBAL ||
+            instruction == OP_GLOBAL_UNCHANGED)
+        {
+            int index = (chunk->code[offset + 1] << 8) | chunk->code[offset + 2];
+
+            if (index >= cache->slot_count)
+                return false;
+
+            chunk->code[offset + 1] = (cache->slots[index] >> 8) & 0xff;
+            chunk->code[offset + 2] = cache->slots[index] & 0xff;
+        }
+
+        offset += size;
+    }
+
+    return true;
+}
+
+static ObjFunction *serialize_read_function(CacheReader *cache, bool script)
+{
+    Reader *reader = cache->reader;
+    ObjFunction *function = script ? object_new_script() : object_new_function();
+    Chunk *chunk = &function->chunk;
+
+    // Keep the function reachable while its constants are allocated.
+    vm_push(VALUE_OBJ_VAL(function));
+
+    function->arity = (int)serialize_read_u32(reader);
+    function->upvalue_count = (int)serialize_read_u32(reader);
+    function->arena_size = (int)serialize_read_u32(reader);
+    function->line = (int)serialize_read_u32(reader);
+
+    Value source;
+
+    if (!serialize_read_value(cache, &source) || !serialize_read_code(reader, chunk))
+    {
+        vm_pop();
+        return NULL;
+    }
+
+    if (OBJECT_IS_STRING(source))
+        function->source = OBJECT_AS_STRING(source);
+    else if (chunk->count == 0)
+    {
+        vm_pop();
+        return NULL;
+    }
+
+    uint32_t constant_count = serialize_read_u32(reader);
+
+    for (uint32_t i = 0; i < constant_count && !reader->failed; i++)
+    {
+        Value value;
+
+        if (!serialize_read_value(cache, &value))
+        {
+            vm_pop();
+            return NULL;
+        }
+
+        // Written straight to the array: the indices in the code must not
+        // move.
+        vm_push(value);
+        value_write_value_array(&chunk->constants, value);
+        vm_pop();
+    }
+
+    vm_pop();
+
+    if (reader->failed || !serialize_link_globals(cache, chunk))
+        return NULL;
+
+    return function;
+}
+
+static uint64_t serialize_hash_source(const char *source)
+{
+    uint64_t hash = 14695981039346656037u;
+    for (const char *c = source; *c != '\0'; c++)
+    {
+        hash ^= (uint8_t)*c;
+        hash *= 1099511628211u;
+    }
+    return hash;
+}
+
+static bool serialize_cache_path(const char *source_path, char *buffer, size_t size)
+{
+    const char *slash = strrchr(source_path, '/');
+    const char *dot = strrchr(source_path, '.');
+    size_t stem = (dot != NULL && (slash == NULL || dot > slash))
+                      ? (size_t)(dot - source_path)
+                      : strlen(source_path);
+
+    return snprintf(buffer, size, "%.*s.lisbc", (int)stem, source_path) < (int)size;
+}
+
+ObjFunction *serialize_read_program(Reader *reader)
+{
+    ObjFunction *function = NULL;
+    CacheReader cache = {reader, NULL, 0};
+    uint32_t global_count = serialize_read_u32(reader);
+
+    if (reader->failed || global_count > UINT16_COUNT)
+        return NULL;
+
+    cache.slots = (uint16_t *)malloc(sizeof(uint16_t) * (global_count + 1));
+
+    // Re-link the globals by name, declaring the ones not yet known.
+    for (uint32_t i = 0; i < global_count && !reader->failed; i++)
+    {
+        uint32_t length = serialize_read_u32(reader);
+        const char *chars = (const char *)serialize_read_bytes(reader, length);
+
+        if (chars != NULL)
+            cache.slots[cache.slot_count++] =
+                (uint16_t)table_declare(&vm.globals, object_copy_string(chars, (int)length));
+    }
+
+    if (!reader->failed)
+        function = serialize_read_function(&cache, true);
+
+    free(cache.slots);
+    return function;
+}
+
+ObjFunction *serialize_read_cache(const char *source_path, const char *source)
+{
+    char path[SERIALIZE_PATH_MAX];
+    Reader reader;
+
+    if (!serialize_cache_path(source_path, path, sizeof(path)) ||
+        !serialize_map_file(path, &reader))
+        return NULL;
+
+    // The cache is only valid for the exact source text it was built from.
+    // Hashing the text is cheap next to compiling it, and unlike timestamps
+    // it can't be fooled by edits within the same second.
+    if (serialize_read_u32(&reader) != SERIALIZE_MAGIC ||
+        serialize_read_u32(&reader) != SERIALIZE_VERSION ||
+        serialize_read_i64(&reader) != (int64_t)strlen(source) ||
+        serialize_read_i64(&reader) != (int64_t)serialize_hash_source(source) ||
+        serialize_read_u8(&reader) != compiler_is_whole_program() ||
+        serialize_read_u8(&reader) != compiler_is_register_code())
+    {
+        serialize_unmap_file(&reader);
+        return NULL;
+    }
+
+    ObjFunction *function = serialize_read_program(&reader);
+    serialize_unmap_file(&reader);
+    return function;
+}
+
+bool serialize_write_program(Writer *writer, ObjFunction *function)
+{
+    Writer body;
+    CacheWriter cache;
+    cache.writer = &body;
+    cache.indices = (int *)malloc(sizeof(int) * UINT16_COUNT);
+    cache.names = (ObjString **)malloc(sizeof(ObjString *) * UINT16_COUNT);
+    cache.name_count = 0;
+
+    for (int i = 0; i < UINT16_COUNT; i++)
+        cache.indices[i] = -1;
+
+    serialize_init_writer(&body);
+
+    bool written = serialize_write_function(&cache, function);
+
+    if (written)
+    {
+        serialize_write_u32(writer, (uint32_t)cache.name_count);
+
+        for (int i = 0; i < cache.name_count; i++)
+        {
+            serialize_write_u32(writer, (uint32_t)cache.names[i]->length);
+            serialize_write_bytes(writer, cache.names[i]->chars, cache.names[i]->length);
+        }
+
+        serialize_write_bytes(writer, body.bytes, body.count);
+    }
+
+    serialize_free_writer(&body);
+    free(cache.indices);
+    free(cache.names);
+
+    return written;
+}
+
+bool serialize_write_cache(const char *source_path, const char *source, ObjFunction *function)
+{
+    char path[SERIALIZE_PATH_MAX];
+    Writer file;
+
+    if (!serialize_cache_path(source_path, path, sizeof(path)))
+        return false;
+
+    serialize_init_writer(&file);
+
+    serialize_write_u32(&file, SERIALIZE_MAGIC);
+    serialize_write_u32(&file, SERIALIZE_VERSION);
+    serialize_write_i64(&file, (int64_t)strlen(source));
+    serialize_write_i64(&file, (int64_t)serialize_hash_source(source));
+    // Code compiled as the whole program assumes no other code assigns
+    // its globals, so it can't be reused where that doesn't hold.
+    serialize_write_u8(&file, compiler_is_whole_program());
+    // Keeps runs of either backend from picking up the other's code.
+    serialize_write_u8(&file, compiler_is_register_code());
+
+    bool written = serialize_write_program(&file, function) && serialize_write_file(&file, path);
+
+    serialize_free_writer(&file);
+    return written;
+}
\ No newline at end of file
@@ -0,0 +1,60 @@
+#ifndef _SERIALIZE_H
+#define _SERIALIZE_H
+
+#include <common/common.h>
+#include <object/object.h>
+
+// Bump whenever the bytecode or the file layout changes, so that stale
+// .lisbc files are recompiled instead of misread.
+#define SERIALIZE_VERSION 17
+
+typedef struct
+{
+    uint8_t *bytes;
+    size_t count;
+    size_t capacity;
+} Writer;
+
+typedef struct
+{
+    const uint8_t *bytes;
+    size_t count;
+    size_t offset;
+    bool failed;
+} Reader;
+
+void serialize_init_writer(Writer *writer);
+void serialize_free_writer(Writer *writer);
+void serialize_write_bytes(Writer *writer, const void *bytes, size_t count);
+void serialize_write_u8(Writer *writer, uint8_t value);
+void serialize_write_u32(Writer *writer, uint32_t value);
+void serialize_write_i64(Writer *writer, int64_t value);
+void serialize_write_f64(Writer *writer, double value);
+bool serialize_write_file(Writer *writer, const char *path);
+
+bool serialize_map_file(const char *path, Reader *reader);
+void serialize_unmap_file(Reader *reader);
+const uint8_t *serialize_read_bytes(Reader *reader, size_t count);
+uint8_t serialize_read_u8(Reader *reader);
+uint32_t serialize_read_u32(Reader *reader);
+int64_t serialize_read_i64(Reader *reader);
+double serialize_read_f64(Reader *reader);
+
+size_t serialize_write_code(Writer *writer, Chunk *chunk);
+bool serialize_read_code(Reader *reader, Chunk *chunk);
+
+void serialize_write_bignum(Writer *writer, ObjBignum *bignum);
+ObjBignum *serialize_read_bignum(Reader *reader);
+
+void serialize_write_vector(Writer *writer, ObjVector *vector);
+ObjVector *serialize_read_vector(Reader *reader);
+
+// A program is its table of global names followed by the script function
+// and, through its constants, every function nested in it.
+bool serialize_write_program(Writer *writer, ObjFunction *function);
+ObjFunction *serialize_read_program(Reader *reader);
+
+ObjFunction *serialize_read_cache(const char *source_path, const char *source);
+bool serialize_write_cache(const char *source_path, const char *source, ObjFunction *function);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,97 @@
+#ifndef _SERIALIZE_TEST_H
+#define _SERIALIZE_TEST_H
+
+#include <serialize/serialize.h>
+#include <compiler/compiler.h>
+#include <table/table.h>
+#include <vm/vm.h>
+#include <CUnit/Basic.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#define SERIALIZE_TEST_SOURCE "/tmp/lisb_serialize_test.scm"
+#define SERIALIZE_TEST_CACHE "/tmp/lisb_serialize_test.lisbc"
+
+// The value of the global name after a program has run.
+static Value serialize_test_global(const char *name)
+{
+    int slot = table_find_entry(&vm.globals, name, (int)strlen(name));
+    return slot == -1 ? VALUE_VOID_VAL : table_get(&vm.globals, slot);
+}
+
+void serialize_reader_test()
+{
+    Writer writer;
+    serialize_init_writer(&writer);
+
+    serialize_write_u8(&writer, 0xab);
+    serialize_write_u32(&writer, 0xdeadbeef);
+    serialize_write_i64(&writer, -5);
+    serialize_write_f64(&writer, 0.1);
+    serialize_write_bytes(&writer, "abc", 3);
+    serialize_write_bytes(&writer, NULL, 0);
+
+    Reader reader = {writer.bytes, writer.count, 0, false};
+
+    CU_ASSERT_EQUAL(serialize_read_u8(&reader), 0xab);
+    CU_ASSERT_EQUAL(serialize_read_u32(&reader), 0xdeadbeef);
+    CU_ASSERT_EQUAL(serialize_read_i64(&reader), -5);
+    CU_ASSERT_EQUAL(serialize_read_f64(&reader), 0.1);
+    CU_ASSERT_EQUAL(memcmp(serialize_read_bytes(&reader, 3), "abc", 3), 0);
+    CU_ASSERT_FALSE(reader.failed);
+
+    // Reading past the end fails, and keeps failing
+    CU_ASSERT_EQUAL(serialize_read_u32(&reader), 0);
+    CU_ASSERT_TRUE(reader.failed);
+    CU_ASSERT_PTR_NULL(serialize_read_bytes(&reader, 1));
+
+    serialize_free_writer(&writer);
+}
+
+void serialize_cache_test()
+{
+    const char *source = "(define result (let loop ((i 0) (sum 0)) (if (= i 10) sum (loop (+ i 1) (+ sum i)))))";
+    const char *edited = "(define result (let loop ((i 0) (sum 0)) (if (= i 11) sum (loop (+ i 1) (+ sum i)))))";
+
+    vm_init_vm();
+    remove(SERIALIZE_TEST_CACHE);
+
+    // Nothing is read before the cache has been written
+    CU_ASSERT_PTR_NULL(serialize_read_cache(SERIALIZE_TEST_SOURCE, source));
+
+    ObjFunction *compiled = compiler_compile(source);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(compiled);
+    vm_push(VALUE_OBJ_VAL(compiled));
+    CU_ASSERT_TRUE(serialize_write_cache(SERIALIZE_TEST_SOURCE, source, compiled));
+
+    // The same code comes back, and runs
+    ObjFunction *read = serialize_read_cache(SERIALIZE_TEST_SOURCE, source);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(read);
+    vm_push(VALUE_OBJ_VAL(read));
+    CU_ASSERT_EQUAL(read->chunk.count, compiled->chunk.count);
+    CU_ASSERT_EQUAL(memcmp(read->chunk.code, compiled->chunk.code, compiled->chunk.count), 0);
+    CU_ASSERT_EQUAL(read->chunk.constants.count, compiled->chunk.constants.count);
+    vm_pop();
+    vm_pop();
+
+    CU_ASSERT_EQUAL(vm_interpret_function(read), VM_OK);
+    Value result = serialize_test_global("result");
+    CU_ASSERT_TRUE(VALUE_IS_FIXNUM(result));
+    CU_ASSERT_EQUAL(VALUE_AS_FIXNUM(result), 45);
+
+    // An edit that keeps the length of the source is still noticed
+    CU_ASSERT_EQUAL(strlen(edited), strlen(source));
+    CU_ASSERT_PTR_NULL(serialize_read_cache(SERIALIZE_TEST_SOURCE, edited));
+    CU_ASSERT_PTR_NULL(serialize_read_cache(SERIALIZE_TEST_SOURCE, "(define result 45)"));
+
+    // As is code for the other backend
+    compiler_set_register_code(true);
+    CU_ASSERT_PTR_NULL(serialize_read_cache(SERIALIZE_TEST_SOURCE, source));
+    compiler_set_register_code(false);
+
+    remove(SERIALIZE_TEST_CACHE);
+    vm_free_vm();
+}
+
+#endif
\ No newline at end of file
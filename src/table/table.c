@@ -10,6 +10,11 @@
 void table_init_table(Table *table)
 {
     table->count = 0;
+    memset(table->index, 0xff, sizeof(table->index));
+    // Declared slots are marked before they are set, so values left by an
+    // earlier VM must not survive it.
+    memset(table->values, 0, sizeof(table->values));
+    memset(table->assignments, 0, sizeof(table->assignments));
 }
 
 void table_free_table(Table *table)
@@ -17,21 +22,48 @@ void table_free_table(Table *table)
     table_init_table(table);
 }
 
-int table_find_entry(Table *table, const char *chars, int length)
+uint32_t table_hash_string(const char *chars, int length)
 {
-    for (int i = 0; i < table->count; i++)
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < length; i++)
     {
-        Entry *entry = &table->entries[i];
+        hash ^= (uint8_t)chars[i];
+        hash *= 16777619;
+    }
+    return hash;
+}
+
+// Returns the bucket holding the key, or the empty bucket that ends its probe
+// sequence.
+static uint32_t table_find_bucket(Table *table, const char *chars, int length, uint32_t hash)
+{
+    uint32_t bucket = hash & (TABLE_INDEX_SIZE - 1);
+
+    for (;;)
+    {
+        int32_t slot = table->index[bucket];
+
+        if (slot == -1)
+            return bucket;
+
+        Entry *entry = &table->entries[slot];
 
         if (entry->key != NULL &&
+            entry->key->hash == hash &&
             entry->key->length == length &&
             memcmp(entry->key->chars, chars, length) == 0)
         {
-            return i;
+            return bucket;
         }
+
+        bucket = (bucket + 1) & (TABLE_INDEX_SIZE - 1);
     }
+}
 
-    return -1;
+int table_find_entry(Table *table, const char *chars, int length)
+{
+    uint32_t hash = table_hash_string(chars, length);
+    return table->index[table_find_bucket(table, chars, length, hash)];
 }
 
 Value table_get(Table *table, int slot)
@@ -42,11 +74,21 @@ Value table_get(Table *table, int slot)
 void table_set(Table *table, int slot, Value value)
 {
     table->values[slot] = value;
+
+    if (table->assignments[slot] < 2)
+        table->assignments[slot]++;
+}
+
+// Whether the slot was set exactly once.
+bool table_is_unchanged(Table *table, int slot)
+{
+    return table->assignments[slot] == 1;
 }
 
 int table_declare(Table *table, ObjString *key)
 {
-    int slot = table_find_entry(table, key->chars, key->length);
+    uint32_t bucket = table_find_bucket(table, key->chars, key->length, key->hash);
+    int slot = table->index[bucket];
 
     if (slot == -1)
     {
@@ -59,15 +101,16 @@ int table_declare(Table *table, ObjString *key)
         slot = table->count;
         table->entries[slot].key = key;
         table->entries[slot].slot = slot;
+        table->index[bucket] = slot;
         table->count++;
     }
 
     return slot;
 }
 
-ObjString *table_find_string(Table *table, const char *chars, int length)
+ObjString *table_find_string(Table *table, const char *chars, int length, uint32_t hash)
 {
-    int slot = table_find_entry(table, chars, length);
+    int slot = table->index[table_find_bucket(table, chars, length, hash)];
 
     if (slot != -1)
         return table->entries[slot].key;
@@ -10,11 +10,19 @@ typedef struct
     int slot;
 } Entry;
 
+#define TABLE_INDEX_SIZE (UINT16_COUNT * 2)
+
 typedef struct
 {
     int count;
     Entry entries[UINT16_COUNT];
     Value values[UINT16_COUNT];
+    // How many times each slot was set, saturating at two, so inlined code
+    // can check that a global still holds the value it was defined with.
+    uint8_t assignments[UINT16_COUNT];
+    // Open addressed hash index from key to slot, -1 marks an empty bucket.
+    // Slots are never reused, so deleted entries keep their bucket.
+    int32_t index[TABLE_INDEX_SIZE];
 } Table;
 
 void table_init_table(Table *table);
@@ -23,8 +31,10 @@ int table_find_entry(Table *table, const char *chars, int length);
 int table_declare(Table *table, ObjString *key);
 Value table_get(Table *table, int slot);
 void table_set(Table *table, int slot, Value value);
+bool table_is_unchanged(Table *table, int slot);
 void table_remove_white(Table *table);
 void table_mark_table(Table *table);
-ObjString *table_find_string(Table *table, const char *chars, int length);
+ObjString *table_find_string(Table *table, const char *chars, int length, uint32_t hash);
+uint32_t table_hash_string(const char *chars, int length);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,1298 @@
+#include <trace/trace.h>
+#include <jit/jit.h>
+#include <memory/memory.h>
+#include <primitive/primitive.h>
+#include <table/table.h>
+
+#include <stdio.h>
+#include <string.h>
+
+static bool trace_enabled = false;
+
+void trace_set_enabled(bool enabled)
+{
+#ifdef JIT_SUPPORTED
+    trace_enabled = enabled;
+#else
+    (void)enabled;
+#endif
+}
+
+bool trace_is_enabled()
+{
+    return trace_enabled;
+}
+
+void trace_free_traces(ObjFunction *function)
+{
+    Trace *trace = function->traces;
+
+    while (trace != NULL)
+    {
+        Trace *next = trace->next;
+
+        if (trace->code != NULL)
+            jit_uninstall(trace->code, trace->size);
+
+        MEMORY_FREE(Trace, trace);
+        trace = next;
+    }
+
+    function->traces = NULL;
+}
+
+#ifdef JIT_SUPPORTED
+
+typedef uint8_t *(*TraceEntry)(CallFrame *frame);
+
+// Where the value of a slot is while the trace runs. Slots in memory hold
+// their value as the interpreter would. The others hold a stale value, and
+// their own is in the slot's xmm register, is a constant, is a copy of a
+// global or is the outcome of the last comparison in the flags. An exit
+// taken before the trace first reads a slot finds it as it was at the loop
+// header, which may be in its register. A register holds the 64 bits of a
+// fixnum or a flonum, whichever the slot had when it was recorded.
+typedef enum
+{
+    TRACE_HEADER,
+    TRACE_MEMORY,
+    TRACE_REGISTER,
+    TRACE_CONSTANT,
+    TRACE_GLOBAL,
+    TRACE_FLAGS,
+} TraceKind;
+
+typedef struct
+{
+    TraceKind kind;
+    bool number; // A slot in memory known to hold a number
+    // The type of that number or of the one in the register, or of the
+    // operands of the comparison in the flags.
+    ValueType type;
+    uint8_t condition;
+    int global;
+    Value constant;
+} TraceSlot;
+
+// What the code assumes about a slot at the loop header: nothing, or that
+// it holds a number of its entry type, which is unboxed into its register
+// when it has one.
+typedef enum
+{
+    TRACE_ENTRY_NONE,
+    TRACE_ENTRY_MEMORY,
+    TRACE_ENTRY_REGISTER,
+} TraceEntryKind;
+
+// The conditions of jcc and setcc, each of which is the negation of the one
+// it differs from in the lowest bit. Flonums are compared unsigned, and
+// fixnums signed.
+typedef enum
+{
+    TRACE_OVERFLOW = 0x0,
+    TRACE_BELOW = 0x2,
+    TRACE_ABOVE_EQUAL = 0x3,
+    TRACE_EQUAL = 0x4,
+    TRACE_NOT_EQUAL = 0x5,
+    TRACE_BELOW_EQUAL = 0x6,
+    TRACE_ABOVE = 0x7,
+    TRACE_PARITY = 0xa,
+    TRACE_NO_PARITY = 0xb,
+    TRACE_LESS = 0xc,
+    TRACE_GREATER_EQUAL = 0xd,
+    TRACE_LESS_EQUAL = 0xe,
+    TRACE_GREATER = 0xf,
+    TRACE_ALWAYS = 0xff,
+} TraceCondition;
+
+// A side exit: the instruction to leave to the interpreter at, and the
+// slots below the stack top there.
+typedef struct
+{
+    uint8_t *ip;
+    int depth;
+    TraceSlot *slots;
+} TraceExit;
+
+typedef enum
+{
+    TRACE_NEXT,
+    TRACE_CLOSED,
+    TRACE_ABORTED,
+} TraceStep;
+
+// xmm0 and xmm1 are scratch, the others are given to slots as they first
+// get a number and keep them for the whole trace.
+#define TRACE_FIRST_REGISTER 2
+#define TRACE_LAST_REGISTER 15
+
+typedef struct
+{
+    CallFrame *frame;
+    Chunk *chunk;
+    uint8_t *header;
+    int header_depth;
+    // The instruction being recorded and the stack depth before it.
+    uint8_t *ip;
+    int depth;
+    int length;
+    JitBuffer buffer;
+    int loop;
+    TraceSlot slots[TRACE_SLOTS_MAX];
+    bool touched[TRACE_SLOTS_MAX];
+    TraceEntryKind entries[TRACE_SLOTS_MAX];
+    ValueType entry_types[TRACE_SLOTS_MAX];
+    int registers[TRACE_SLOTS_MAX];
+    int next_register;
+    TraceExit *exits;
+    int exit_count;
+    int exit_capacity;
+} TraceRecorder;
+
+#define TRACE_DISP(slot) ((int32_t)sizeof(Value) * (slot))
+#define TRACE_AS(slot) (TRACE_DISP(slot) + (int32_t)offsetof(Value, as))
+
+static uint16_t trace_read_short(uint8_t *ip)
+{
+    return (uint16_t)((ip[1] << 8) | ip[2]);
+}
+
+static uint32_t trace_read_long(uint8_t *ip)
+{
+    return (uint32_t)((ip[1] << 16) | (ip[2] << 8) | ip[3]);
+}
+
+static uint64_t trace_bits(Value value)
+{
+    uint64_t bits;
+    memcpy(&bits, &value.as, sizeof(bits));
+    return bits;
+}
+
+// Remembers the slots as they are now for a guard of the current
+// instruction, and returns the exit's number.
+static int trace_add_exit(TraceRecorder *recorder, uint8_t *ip, int depth)
+{
+    if (recorder->exit_capacity < recorder->exit_count + 1)
+    {
+        int old_capacity = recorder->exit_capacity;
+        recorder->exit_capacity = MEMORY_GROW_CAPACITY(old_capacity);
+        recorder->exits = MEMORY_GROW_ARRAY(TraceExit, recorder->exits, old_capacity, recorder->exit_capacity);
+    }
+
+    TraceExit *exit = &recorder->exits[recorder->exit_count];
+    exit->ip = ip;
+    exit->depth = depth;
+    exit->slots = MEMORY_ALLOCATE(TraceSlot, depth);
+    memcpy(exit->slots, recorder->slots, sizeof(TraceSlot) * depth);
+
+    for (int slot = 0; slot < depth; slot++)
+    {
+        if (!recorder->touched[slot])
+            exit->slots[slot].kind = TRACE_HEADER;
+    }
+
+    return recorder->exit_count++;
+}
+
+static void trace_emit_jump_to_exit(TraceRecorder *recorder, TraceCondition condition, int exit)
+{
+    if (condition == TRACE_ALWAYS)
+    {
+        jit_emit_byte(&recorder->buffer, 0xe9);
+    }
+    else
+    {
+        jit_emit_byte(&recorder->buffer, 0x0f);
+        jit_emit_byte(&recorder->buffer, (uint8_t)(0x80 | condition));
+    }
+
+    jit_add_fixup(&recorder->buffer, exit, true);
+}
+
+// Leaves at the current instruction when condition holds.
+static void trace_emit_guard(TraceRecorder *recorder, TraceCondition condition)
+{
+    int exit = trace_add_exit(recorder, recorder->ip, recorder->depth);
+    trace_emit_jump_to_exit(recorder, condition, exit);
+}
+
+// cmp dword [base + disp], type
+static void trace_emit_compare_type(JitBuffer *buffer, int base, int32_t disp, ValueType type)
+{
+    jit_emit_memory(buffer, 0, false, 0x81, 7, base, disp);
+    jit_emit_u32(buffer, (uint32_t)type);
+}
+
+// movabs rax, &vm.globals.values[global]
+static void trace_emit_global_address(JitBuffer *buffer, int global)
+{
+    jit_emit_move_immediate(buffer, JIT_RAX, (uint64_t)(uintptr_t)&vm.globals.values[global]);
+}
+
+static void trace_emit_number(JitBuffer *buffer, int xmm, Value number)
+{
+    // movq xmm, rax
+    jit_emit_move_immediate(buffer, JIT_RAX, trace_bits(number));
+    jit_emit_register(buffer, 0x66, true, 0x0f6e, xmm, JIT_RAX);
+}
+
+static void trace_emit_box(JitBuffer *buffer, int slot, int xmm, ValueType type)
+{
+    jit_emit_store_type(buffer, JIT_RBX, TRACE_DISP(slot), type);
+    jit_emit_memory(buffer, 0xf2, false, 0x0f11, xmm, JIT_RBX, TRACE_AS(slot));
+}
+
+// Sets al to the outcome of the last comparison, of operands of type.
+static void trace_emit_set_condition(JitBuffer *buffer, TraceCondition condition, ValueType type)
+{
+    if (condition == TRACE_EQUAL && type == VALUE_FLONUM)
+    {
+        // sete al; setnp cl; and al, cl
+        static const uint8_t set_equal[] = {0x0f, 0x94, 0xc0, 0x0f, 0x9b, 0xc1, 0x20, 0xc8};
+        jit_emit_bytes(buffer, set_equal, sizeof(set_equal));
+        return;
+    }
+
+    jit_emit_byte(buffer, 0x0f);
+    jit_emit_byte(buffer, (uint8_t)(0x90 | condition));
+    jit_emit_byte(buffer, 0xc0);
+}
+
+// Brings the slot's value into memory as state describes it.
+static void trace_emit_materialize(TraceRecorder *recorder, int slot, const TraceSlot *state)
+{
+    JitBuffer *buffer = &recorder->buffer;
+
+    switch (state->kind)
+    {
+    case TRACE_HEADER:
+        if (recorder->entries[slot] == TRACE_ENTRY_REGISTER)
+            trace_emit_box(buffer, slot, recorder->registers[slot], recorder->entry_types[slot]);
+        break;
+    case TRACE_MEMORY:
+        break;
+    case TRACE_REGISTER:
+        trace_emit_box(buffer, slot, recorder->registers[slot], state->type);
+        break;
+    case TRACE_CONSTANT:
+        jit_emit_store_type(buffer, JIT_RBX, TRACE_DISP(slot), state->constant.type);
+        jit_emit_move_immediate(buffer, JIT_RAX, trace_bits(state->constant));
+        jit_emit_memory(buffer, 0, true, 0x89, JIT_RAX, JIT_RBX, TRACE_AS(slot));
+        break;
+    case TRACE_GLOBAL:
+        trace_emit_global_address(buffer, state->global);
+
+        for (int32_t half = 0; half < (int32_t)sizeof(Value); half += 8)
+        {
+            jit_emit_memory(buffer, 0, true, 0x8b, JIT_RCX, JIT_RAX, half);
+            jit_emit_memory(buffer, 0, true, 0x89, JIT_RCX, JIT_RBX, TRACE_DISP(slot) + half);
+        }
+        break;
+    case TRACE_FLAGS:
+        trace_emit_set_condition(buffer, (TraceCondition)state->condition, state->type);
+        // movzx eax, al
+        jit_emit_register(buffer, 0, false, 0x0fb6, JIT_RAX, JIT_RAX);
+        jit_emit_store_type(buffer, JIT_RBX, TRACE_DISP(slot), VALUE_BOOL);
+        jit_emit_memory(buffer, 0, true, 0x89, JIT_RAX, JIT_RBX, TRACE_AS(slot));
+        break;
+    }
+}
+
+static void trace_spill(TraceRecorder *recorder, int slot)
+{
+    TraceSlot *state = &recorder->slots[slot];
+    trace_emit_materialize(recorder, slot, state);
+
+    if (state->kind == TRACE_CONSTANT)
+        state->type = state->constant.type;
+
+    state->number = state->kind == TRACE_REGISTER ||
+                    (state->kind == TRACE_MEMORY && state->number) ||
+                    (state->kind == TRACE_CONSTANT && VALUE_IS_NUMBER(state->constant));
+    state->kind = TRACE_MEMORY;
+}
+
+// Returns the register of the slot, giving it one if there is one left.
+static int trace_allocate(TraceRecorder *recorder, int slot)
+{
+    if (recorder->registers[slot] < 0 && recorder->next_register <= TRACE_LAST_REGISTER)
+        recorder->registers[slot] = recorder->next_register++;
+
+    return recorder->registers[slot];
+}
+
+// The first read of a slot that the trace has not written yet finds the
+// value it had at the loop header, so what the read assumes about it
+// becomes an assumption of the whole trace, checked once on entry. A number
+// is assumed to keep the type it has now.
+static void trace_read_entry(TraceRecorder *recorder, int slot, bool number)
+{
+    if (recorder->touched[slot])
+        return;
+
+    recorder->touched[slot] = true;
+
+    if (!number)
+        return;
+
+    TraceSlot *state = &recorder->slots[slot];
+    recorder->entry_types[slot] = recorder->frame->slots[slot].type;
+    state->type = recorder->entry_types[slot];
+
+    if (trace_allocate(recorder, slot) >= 0)
+    {
+        recorder->entries[slot] = TRACE_ENTRY_REGISTER;
+        state->kind = TRACE_REGISTER;
+    }
+    else
+    {
+        recorder->entries[slot] = TRACE_ENTRY_MEMORY;
+        state->number = true;
+    }
+}
+
+// Gets the number in the slot into an xmm register, guarding its type where
+// that isn't known, and returns the register: the slot's own or scratch.
+// The number keeps the type it has now.
+static int trace_load_number(TraceRecorder *recorder, int slot, int scratch)
+{
+    JitBuffer *buffer = &recorder->buffer;
+    TraceSlot *state = &recorder->slots[slot];
+    ValueType type = recorder->frame->slots[slot].type;
+
+    trace_read_entry(recorder, slot, true);
+
+    switch (state->kind)
+    {
+    case TRACE_REGISTER:
+        return recorder->registers[slot];
+    case TRACE_CONSTANT:
+        trace_emit_number(buffer, scratch, state->constant);
+        return scratch;
+    case TRACE_GLOBAL:
+        trace_emit_global_address(buffer, state->global);
+        trace_emit_compare_type(buffer, JIT_RAX, 0, type);
+        trace_emit_guard(recorder, TRACE_NOT_EQUAL);
+        jit_emit_memory(buffer, 0xf2, false, 0x0f10, scratch, JIT_RAX, offsetof(Value, as));
+        return scratch;
+    default:
+        break;
+    }
+
+    if (!state->number)
+    {
+        trace_emit_compare_type(buffer, JIT_RBX, TRACE_DISP(slot), type);
+        trace_emit_guard(recorder, TRACE_NOT_EQUAL);
+        state->number = true;
+        state->type = type;
+    }
+
+    // Numbers read from memory stay unboxed in the slot's register if it
+    // has one, memory keeping the same value.
+    int xmm = recorder->registers[slot] >= 0 ? recorder->registers[slot] : scratch;
+    jit_emit_memory(buffer, 0xf2, false, 0x0f10, xmm, JIT_RBX, TRACE_AS(slot));
+
+    if (xmm != scratch)
+        state->kind = TRACE_REGISTER;
+
+    return xmm;
+}
+
+static void trace_write(TraceRecorder *recorder, int slot, TraceSlot state)
+{
+    recorder->touched[slot] = true;
+    recorder->slots[slot] = state;
+}
+
+static void trace_store_number(TraceRecorder *recorder, int slot, int xmm, ValueType type)
+{
+    JitBuffer *buffer = &recorder->buffer;
+    int reg = trace_allocate(recorder, slot);
+
+    recorder->touched[slot] = true;
+
+    if (reg < 0)
+    {
+        trace_emit_box(buffer, slot, xmm, type);
+        recorder->slots[slot] = (TraceSlot){TRACE_MEMORY, true, type, 0, 0, VALUE_NULL_VAL};
+        return;
+    }
+
+    // movapd reg, xmm
+    if (reg != xmm)
+        jit_emit_register(buffer, 0x66, false, 0x0f28, reg, xmm);
+
+    recorder->slots[slot] = (TraceSlot){TRACE_REGISTER, false, type, 0, 0, VALUE_NULL_VAL};
+}
+
+static void trace_copy(TraceRecorder *recorder, int from, int to)
+{
+    Value value = recorder->frame->slots[from];
+    TraceSlot *source = &recorder->slots[from];
+
+    if (source->kind == TRACE_FLAGS)
+        trace_spill(recorder, from);
+
+    if (VALUE_IS_NUMBER(value))
+    {
+        trace_store_number(recorder, to, trace_load_number(recorder, from, 0), value.type);
+        return;
+    }
+
+    trace_read_entry(recorder, from, false);
+
+    if (source->kind == TRACE_MEMORY)
+    {
+        for (int32_t half = 0; half < (int32_t)sizeof(Value); half += 8)
+        {
+            jit_emit_memory(&recorder->buffer, 0, true, 0x8b, JIT_RAX, JIT_RBX, TRACE_DISP(from) + half);
+            jit_emit_memory(&recorder->buffer, 0, true, 0x89, JIT_RAX, JIT_RBX, TRACE_DISP(to) + half);
+        }
+    }
+
+    trace_write(recorder, to, *source);
+}
+
+// Operands are slots, or the constants of register instructions, which are
+// numbered from -1 down.
+static Value trace_operand_value(TraceRecorder *recorder, int operand)
+{
+    return operand >= 0 ? recorder->frame->slots[operand] : recorder->chunk->constants.values[-1 - operand];
+}
+
+// Whether the operand is a constant, or a slot known to hold one.
+static bool trace_is_constant(TraceRecorder *recorder, int operand)
+{
+    return operand < 0 || recorder->slots[operand].kind == TRACE_CONSTANT;
+}
+
+static int trace_load_operand(TraceRecorder *recorder, int operand, int scratch)
+{
+    if (operand >= 0)
+        return trace_load_number(recorder, operand, scratch);
+
+    trace_emit_number(&recorder->buffer, scratch, trace_operand_value(recorder, operand));
+    return scratch;
+}
+
+// Loads the operand as a flonum, converting a fixnum the way the primitives
+// do, and returns its register.
+static int trace_load_flonum(TraceRecorder *recorder, int operand, int scratch)
+{
+    JitBuffer *buffer = &recorder->buffer;
+    Value value = trace_operand_value(recorder, operand);
+
+    if (VALUE_IS_FLONUM(value))
+        return trace_load_operand(recorder, operand, scratch);
+
+    if (trace_is_constant(recorder, operand))
+    {
+        trace_emit_number(buffer, scratch, VALUE_FLONUM_VAL((double)VALUE_AS_FIXNUM(value)));
+        return scratch;
+    }
+
+    // movq rax, xmm; cvtsi2sd scratch, rax
+    jit_emit_register(buffer, 0x66, true, 0x0f7e, trace_load_operand(recorder, operand, scratch), JIT_RAX);
+    jit_emit_register(buffer, 0xf2, true, 0x0f2a, scratch, JIT_RAX);
+    return scratch;
+}
+
+// The operations the trace computes itself. ucomisd sets the carry, zero
+// and parity flags when the operands are unordered, for which every
+// comparison is false, so < and <= swap their operands and test above.
+// Fixnums swap them the same way and test greater.
+typedef enum
+{
+    TRACE_OP_ADD,
+    TRACE_OP_SUBTRACT,
+    TRACE_OP_MULTIPLY,
+    TRACE_OP_RECIPROCAL,
+    TRACE_OP_DIVIDE,
+    TRACE_OP_SQRT,
+    TRACE_OP_EQUAL,
+    TRACE_OP_LESS,
+    TRACE_OP_GREATER,
+    TRACE_OP_LESS_EQUAL,
+    TRACE_OP_GREATER_EQUAL,
+} TraceOp;
+
+// Whether the trace can compute op of args as the primitive does. Fixnums
+// are added, subtracted, multiplied and compared as integers. Whether the
+// quotient or square root of fixnums is exact depends on their values, as
+// does whether a fixnum divisor is zero, unless it is a constant. A fixnum
+// compared with a flonum has to be a constant that converts exactly.
+static bool trace_can_compute(TraceRecorder *recorder, TraceOp op, const int *operands, const Value *args)
+{
+    bool unary = op == TRACE_OP_RECIPROCAL || op == TRACE_OP_SQRT;
+    bool fixnums = VALUE_IS_FIXNUM(args[0]) && (unary || VALUE_IS_FIXNUM(args[1]));
+
+    switch (op)
+    {
+    case TRACE_OP_ADD:
+    case TRACE_OP_SUBTRACT:
+    case TRACE_OP_MULTIPLY:
+        return true;
+    case TRACE_OP_RECIPROCAL:
+    case TRACE_OP_SQRT:
+        return !fixnums;
+    case TRACE_OP_DIVIDE:
+        return !fixnums && (!VALUE_IS_FIXNUM(args[1]) ||
+                            (trace_is_constant(recorder, operands[1]) && VALUE_AS_FIXNUM(args[1]) != 0));
+    default:
+        if (fixnums || VALUE_IS_FLONUM(args[0]) == VALUE_IS_FLONUM(args[1]))
+            return true;
+
+        for (int i = 0; i < 2; i++)
+        {
+            if (VALUE_IS_FIXNUM(args[i]) &&
+                (!trace_is_constant(recorder, operands[i]) || VALUE_AS_FIXNUM(args[i]) < -(INT64_C(1) << 53) ||
+                 VALUE_AS_FIXNUM(args[i]) > (INT64_C(1) << 53)))
+                return false;
+        }
+
+        return true;
+    }
+}
+
+// Computes op of the operands into the target slot. The recorder has
+// already checked that it can.
+static void trace_emit_op(TraceRecorder *recorder, TraceOp op, int target, const int *operands, bool fixnums)
+{
+    JitBuffer *buffer = &recorder->buffer;
+    bool swap = op == TRACE_OP_LESS || op == TRACE_OP_LESS_EQUAL;
+
+    if (fixnums)
+    {
+        int a = trace_load_operand(recorder, operands[0], 0);
+        int b = trace_load_operand(recorder, operands[1], 1);
+
+        // movq rax, a; movq rcx, b
+        jit_emit_register(buffer, 0x66, true, 0x0f7e, a, JIT_RAX);
+        jit_emit_register(buffer, 0x66, true, 0x0f7e, b, JIT_RCX);
+
+        switch (op)
+        {
+        case TRACE_OP_ADD:
+        case TRACE_OP_SUBTRACT:
+        case TRACE_OP_MULTIPLY:
+            // add rax, rcx / sub rax, rcx / imul rax, rcx; jo exit
+            if (op == TRACE_OP_MULTIPLY)
+                jit_emit_register(buffer, 0, true, 0x0faf, JIT_RAX, JIT_RCX);
+            else
+                jit_emit_register(buffer, 0, true, op == TRACE_OP_ADD ? 0x01 : 0x29, JIT_RCX, JIT_RAX);
+            trace_emit_guard(recorder, TRACE_OVERFLOW);
+
+            // movq xmm0, rax
+            jit_emit_register(buffer, 0x66, true, 0x0f6e, 0, JIT_RAX);
+            trace_store_number(recorder, target, 0, VALUE_FIXNUM);
+            return;
+        default:
+        {
+            // cmp rax, rcx
+            jit_emit_register(buffer, 0, true, 0x39, swap ? JIT_RAX : JIT_RCX, swap ? JIT_RCX : JIT_RAX);
+
+            TraceCondition condition = op == TRACE_OP_EQUAL                                  ? TRACE_EQUAL
+                                       : op == TRACE_OP_LESS || op == TRACE_OP_GREATER ? TRACE_GREATER
+                                                                                       : TRACE_GREATER_EQUAL;
+            trace_write(recorder, target, (TraceSlot){TRACE_FLAGS, false, VALUE_FIXNUM, condition, 0, VALUE_NULL_VAL});
+            return;
+        }
+        }
+    }
+
+    if (op == TRACE_OP_RECIPROCAL || op == TRACE_OP_DIVIDE)
+    {
+        int a = trace_load_flonum(recorder, operands[0], 1);
+
+        if (op == TRACE_OP_RECIPROCAL)
+        {
+            trace_emit_number(buffer, 0, VALUE_FLONUM_VAL(1));
+            jit_emit_register(buffer, 0xf2, false, 0x0f5e, 0, a);
+        }
+        else
+        {
+            // movapd xmm0, a
+            if (a != 0)
+                jit_emit_register(buffer, 0x66, false, 0x0f28, 0, a);
+            jit_emit_register(buffer, 0xf2, false, 0x0f5e, 0, trace_load_flonum(recorder, operands[1], 1));
+        }
+
+        trace_store_number(recorder, target, 0, VALUE_FLONUM);
+        return;
+    }
+
+    int a = trace_load_flonum(recorder, operands[0], 0);
+    int b = op == TRACE_OP_SQRT ? a : trace_load_flonum(recorder, operands[1], 1);
+
+    switch (op)
+    {
+    case TRACE_OP_ADD:
+    case TRACE_OP_SUBTRACT:
+    case TRACE_OP_MULTIPLY:
+    {
+        uint16_t opcode = op == TRACE_OP_ADD ? 0x0f58 : op == TRACE_OP_SUBTRACT ? 0x0f5c : 0x0f59;
+
+        // movapd xmm0, a
+        if (a != 0)
+            jit_emit_register(buffer, 0x66, false, 0x0f28, 0, a);
+
+        jit_emit_register(buffer, 0xf2, false, opcode, 0, b);
+        trace_store_number(recorder, target, 0, VALUE_FLONUM);
+        return;
+    }
+    case TRACE_OP_SQRT:
+        jit_emit_register(buffer, 0xf2, false, 0x0f51, 0, a);
+        trace_store_number(recorder, target, 0, VALUE_FLONUM);
+        return;
+    default:
+    {
+        jit_emit_register(buffer, 0x66, false, 0x0f2e, swap ? b : a, swap ? a : b);
+
+        TraceCondition condition = op == TRACE_OP_EQUAL                                  ? TRACE_EQUAL
+                                   : op == TRACE_OP_LESS || op == TRACE_OP_GREATER ? TRACE_ABOVE
+                                                                                   : TRACE_ABOVE_EQUAL;
+        trace_write(recorder, target, (TraceSlot){TRACE_FLAGS, false, VALUE_FLONUM, condition, 0, VALUE_NULL_VAL});
+        return;
+    }
+    }
+}
+
+// The primitive each operation does, which the recorder calls to run it.
+static const NativeFn trace_primitives[] = {
+    [TRACE_OP_ADD] = primitive_add,
+    [TRACE_OP_SUBTRACT] = primitive_sub,
+    [TRACE_OP_MULTIPLY] = primitive_mup,
+    [TRACE_OP_RECIPROCAL] = primitive_div,
+    [TRACE_OP_DIVIDE] = primitive_div,
+    [TRACE_OP_SQRT] = primitive_sqrt,
+    [TRACE_OP_EQUAL] = primitive_num_eq,
+    [TRACE_OP_LESS] = primitive_num_le,
+    [TRACE_OP_GREATER] = primitive_num_ge,
+    [TRACE_OP_LESS_EQUAL] = primitive_num_leq,
+    [TRACE_OP_GREATER_EQUAL] = primitive_num_geq,
+};
+
+// Finds the operation of a call of a primitive with arg_count arguments, or
+// returns false.
+static bool trace_find_op(NativeFn native, int arg_count, TraceOp *op)
+{
+    for (int i = 0; i < (int)(sizeof(trace_primitives) / sizeof(NativeFn)); i++)
+    {
+        int arity = i == TRACE_OP_RECIPROCAL || i == TRACE_OP_SQRT ? 1 : 2;
+
+        if (trace_primitives[i] == native && arity == arg_count)
+        {
+            *op = (TraceOp)i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool trace_is_branch(uint8_t *ip)
+{
+    return ip[0] == OP_JUMP_IF_FALSE || ip[0] == OP_JUMP_IF_FALSE_LONG ||
+           ip[0] == OP_POP_JUMP_IF_FALSE || ip[0] == OP_POP_JUMP_IF_FALSE_LONG;
+}
+
+// Records op of operands into target and runs it. A comparison is left in
+// the flags for a branch right after it.
+static bool trace_record_op(TraceRecorder *recorder, TraceOp op, int target, const int *operands,
+                            int operand_count, uint8_t *next)
+{
+    Value args[2];
+
+    for (int i = 0; i < operand_count; i++)
+    {
+        args[i] = trace_operand_value(recorder, operands[i]);
+
+        if (!VALUE_IS_NUMBER(args[i]))
+            return false;
+    }
+
+    if (!trace_can_compute(recorder, op, operands, args))
+        return false;
+
+    bool fixnums = VALUE_IS_FIXNUM(args[0]) && operand_count == 2 && VALUE_IS_FIXNUM(args[1]);
+    Value result = trace_primitives[op](operand_count, args);
+
+    // The trace leaves when fixnums overflow, so the trip recorded can't.
+    if (fixnums && op <= TRACE_OP_MULTIPLY && !VALUE_IS_FIXNUM(result))
+        return false;
+
+    trace_emit_op(recorder, op, target, operands, fixnums);
+
+    if (recorder->slots[target].kind == TRACE_FLAGS && !trace_is_branch(next))
+        trace_spill(recorder, target);
+
+    recorder->frame->slots[target] = result;
+    vm.stack_top = recorder->frame->slots + target + 1;
+    return true;
+}
+
+// Checks that the callee in the slot is still the native.
+static bool trace_record_callee(TraceRecorder *recorder, int slot, NativeFn native)
+{
+    JitBuffer *buffer = &recorder->buffer;
+    TraceSlot *state = &recorder->slots[slot];
+    int base = JIT_RAX;
+    int32_t disp = 0;
+
+    switch (state->kind)
+    {
+    case TRACE_CONSTANT:
+        return true;
+    case TRACE_GLOBAL:
+        trace_emit_global_address(buffer, state->global);
+        break;
+    case TRACE_MEMORY:
+        trace_read_entry(recorder, slot, false);
+        base = JIT_RBX;
+        disp = TRACE_DISP(slot);
+        break;
+    default:
+        return false;
+    }
+
+    trace_emit_compare_type(buffer, base, disp, VALUE_OBJ);
+    trace_emit_guard(recorder, TRACE_NOT_EQUAL);
+
+    // mov rax, [base + disp + 8]; cmp dword [rax + type], OBJ_NATIVE
+    jit_emit_memory(buffer, 0, true, 0x8b, JIT_RAX, base, disp + offsetof(Value, as));
+    jit_emit_memory(buffer, 0, false, 0x81, 7, JIT_RAX, offsetof(Obj, type));
+    jit_emit_u32(buffer, OBJ_NATIVE);
+    trace_emit_guard(recorder, TRACE_NOT_EQUAL);
+
+    // movabs rcx, native; cmp [rax + function], rcx
+    jit_emit_move_immediate(buffer, JIT_RCX, (uint64_t)(uintptr_t)native);
+    jit_emit_memory(buffer, 0, true, 0x39, JIT_RCX, JIT_RAX, offsetof(ObjNative, function));
+    trace_emit_guard(recorder, TRACE_NOT_EQUAL);
+    return true;
+}
+
+// Records a call, which the trace only does of the arithmetic primitives.
+static bool trace_record_call(TraceRecorder *recorder, int arg_count, uint8_t *next)
+{
+    int slot = recorder->depth - arg_count - 1;
+    Value callee = recorder->frame->slots[slot];
+    TraceOp op;
+
+    if (!VALUE_IS_OBJ(callee) || !OBJECT_IS_NATIVE(callee) ||
+        !trace_find_op(OBJECT_AS_NATIVE(callee), arg_count, &op))
+        return false;
+
+    for (int i = 1; i <= arg_count; i++)
+    {
+        if (!VALUE_IS_NUMBER(recorder->frame->slots[slot + i]))
+            return false;
+    }
+
+    if (!trace_record_callee(recorder, slot, OBJECT_AS_NATIVE(callee)))
+        return false;
+
+    int operands[] = {slot + 1, slot + 2};
+    return trace_record_op(recorder, op, slot, operands, arg_count, next);
+}
+
+// Records a branch on the value on top of the stack, which leaves the trace
+// for the way the recording did not go.
+static void trace_record_branch(TraceRecorder *recorder, bool pop, uint8_t *target, uint8_t *next)
+{
+    JitBuffer *buffer = &recorder->buffer;
+    int slot = recorder->depth - 1;
+    TraceSlot *state = &recorder->slots[slot];
+    bool falsey = VALUE_IS_BOOL(vm.stack_top[-1]) && !VALUE_AS_BOOL(vm.stack_top[-1]);
+    uint8_t *other = falsey ? next : target;
+    int depth = pop ? slot : recorder->depth;
+
+    switch (state->kind)
+    {
+    case TRACE_FLAGS:
+    {
+        TraceCondition condition = (TraceCondition)state->condition;
+
+        // Kept, the comparison is known at either end of the branch.
+        bool unordered = condition == TRACE_EQUAL && state->type == VALUE_FLONUM;
+
+        if (!pop)
+            *state = (TraceSlot){TRACE_CONSTANT, false, VALUE_BOOL, 0, 0, VALUE_BOOL_VAL(falsey)};
+
+        int exit = trace_add_exit(recorder, other, depth);
+
+        if (falsey && unordered)
+        {
+            // jp skip; je exit; skip:
+            jit_emit_byte(buffer, 0x7a);
+            jit_emit_byte(buffer, 0x06);
+            trace_emit_jump_to_exit(recorder, TRACE_EQUAL, exit);
+        }
+        else if (falsey)
+        {
+            trace_emit_jump_to_exit(recorder, condition, exit);
+        }
+        else if (unordered)
+        {
+            trace_emit_jump_to_exit(recorder, TRACE_PARITY, exit);
+            trace_emit_jump_to_exit(recorder, TRACE_NOT_EQUAL, exit);
+        }
+        else
+        {
+            trace_emit_jump_to_exit(recorder, (TraceCondition)(condition ^ 1), exit);
+        }
+
+        if (!pop)
+            state->constant = VALUE_BOOL_VAL(!falsey);
+        break;
+    }
+    case TRACE_MEMORY:
+    case TRACE_GLOBAL:
+    {
+        if (state->kind == TRACE_MEMORY && state->number)
+            break;
+
+        int base = JIT_RBX;
+        int32_t disp = TRACE_DISP(slot);
+
+        if (state->kind == TRACE_GLOBAL)
+        {
+            trace_emit_global_address(buffer, state->global);
+            base = JIT_RAX;
+            disp = 0;
+        }
+        else
+        {
+            trace_read_entry(recorder, slot, false);
+        }
+
+        int exit = trace_add_exit(recorder, other, depth);
+        trace_emit_compare_type(buffer, base, disp, VALUE_BOOL);
+
+        if (falsey)
+        {
+            trace_emit_jump_to_exit(recorder, TRACE_NOT_EQUAL, exit);
+            jit_emit_memory(buffer, 0, false, 0x80, 7, base, disp + offsetof(Value, as));
+            jit_emit_byte(buffer, 0);
+            trace_emit_jump_to_exit(recorder, TRACE_NOT_EQUAL, exit);
+            break;
+        }
+
+        // jne skip; cmp byte [base + disp + 8], 0; je exit; skip:
+        jit_emit_byte(buffer, 0x75);
+        int skip = buffer->count;
+        jit_emit_byte(buffer, 0);
+        jit_emit_memory(buffer, 0, false, 0x80, 7, base, disp + offsetof(Value, as));
+        jit_emit_byte(buffer, 0);
+        trace_emit_jump_to_exit(recorder, TRACE_EQUAL, exit);
+        buffer->code[skip] = (uint8_t)(buffer->count - (skip + 1));
+        break;
+    }
+    default:
+        // Constants are known, and numbers are true.
+        break;
+    }
+
+    if (pop)
+        vm.stack_top--;
+
+    recorder->frame->ip = falsey ? target : next;
+}
+
+// Records the instruction at the frame's ip and runs it.
+static TraceStep trace_step(TraceRecorder *recorder)
+{
+    CallFrame *frame = recorder->frame;
+    Chunk *chunk = recorder->chunk;
+    uint8_t *ip = frame->ip;
+    uint8_t *next = ip + chunk_instruction_size(chunk, (int)(ip - chunk->code));
+    int depth = (int)(vm.stack_top - frame->slots);
+
+    recorder->ip = ip;
+    recorder->depth = depth;
+
+    if (++recorder->length > TRACE_LENGTH_MAX || depth + 1 >= TRACE_SLOTS_MAX)
+        return TRACE_ABORTED;
+
+    switch (ip[0])
+    {
+    case OP_CONSTANT:
+    case OP_CONSTANT_LONG:
+    case OP_NULL:
+    case OP_TRUE:
+    case OP_FALSE:
+    {
+        Value constant = ip[0] == OP_CONSTANT        ? chunk->constants.values[ip[1]]
+                         : ip[0] == OP_CONSTANT_LONG ? chunk->constants.values[trace_read_long(ip)]
+                         : ip[0] == OP_NULL          ? VALUE_NULL_VAL
+                                                     : VALUE_BOOL_VAL(ip[0] == OP_TRUE);
+        trace_write(recorder, depth, (TraceSlot){TRACE_CONSTANT, false, constant.type, 0, 0, constant});
+        vm_push(constant);
+        break;
+    }
+    case OP_POP:
+        vm.stack_top--;
+        break;
+    case OP_POPN:
+        vm.stack_top -= ip[1];
+        break;
+    case OP_GET_LOCAL:
+    case OP_GET_LOCAL_LONG:
+    {
+        int slot = ip[0] == OP_GET_LOCAL ? ip[1] : trace_read_short(ip);
+        trace_copy(recorder, slot, depth);
+        vm_push(frame->slots[slot]);
+        break;
+    }
+    case OP_SET_LOCAL:
+    case OP_SET_LOCAL_LONG:
+    {
+        int slot = ip[0] == OP_SET_LOCAL ? ip[1] : trace_read_short(ip);
+
+        if (slot >= TRACE_SLOTS_MAX)
+            return TRACE_ABORTED;
+
+        trace_copy(recorder, depth - 1, slot);
+        frame->slots[slot] = vm.stack_top[-1];
+        break;
+    }
+    case OP_GET_GLOBAL:
+    {
+        int global = trace_read_short(ip);
+        trace_write(recorder, depth, (TraceSlot){TRACE_GLOBAL, false, VALUE_NULL, 0, global, VALUE_NULL_VAL});
+        vm_push(table_get(&vm.globals, global));
+        break;
+    }
+    case OP_GLOBAL_UNCHANGED:
+    {
+        int global = trace_read_short(ip);
+        bool unchanged = table_is_unchanged(&vm.globals, global);
+
+        // movabs rax, &assignments[global]; cmp byte [rax], 1
+        jit_emit_move_immediate(&recorder->buffer, JIT_RAX, (uint64_t)(uintptr_t)&vm.globals.assignments[global]);
+        jit_emit_memory(&recorder->buffer, 0, false, 0x80, 7, JIT_RAX, 0);
+        jit_emit_byte(&recorder->buffer, 1);
+        trace_emit_guard(recorder, unchanged ? TRACE_NOT_EQUAL : TRACE_EQUAL);
+
+        trace_write(recorder, depth, (TraceSlot){TRACE_CONSTANT, false, VALUE_BOOL, 0, 0, VALUE_BOOL_VAL(unchanged)});
+        vm_push(VALUE_BOOL_VAL(unchanged));
+        break;
+    }
+    case OP_ADD:
+    case OP_SUBTRACT:
+    case OP_MULTIPLY:
+    case OP_EQUAL:
+    case OP_LESS:
+    case OP_GREATER:
+    case OP_LESS_EQUAL:
+    case OP_GREATER_EQUAL:
+    case OP_ADD_UNCHECKED:
+    case OP_SUBTRACT_UNCHECKED:
+    case OP_MULTIPLY_UNCHECKED:
+    case OP_EQUAL_UNCHECKED:
+    case OP_LESS_UNCHECKED:
+    case OP_GREATER_UNCHECKED:
+    case OP_LESS_EQUAL_UNCHECKED:
+    case OP_GREATER_EQUAL_UNCHECKED:
+    {
+        static const TraceOp ops[] = {TRACE_OP_ADD, TRACE_OP_SUBTRACT, TRACE_OP_MULTIPLY, TRACE_OP_EQUAL,
+                                      TRACE_OP_LESS, TRACE_OP_GREATER, TRACE_OP_LESS_EQUAL,
+                                      TRACE_OP_GREATER_EQUAL};
+        int operands[2];
+
+        for (int i = 0; i < 2; i++)
+        {
+            uint8_t operand = ip[2 + i];
+            operands[i] = operand & CHUNK_REGISTER_CONSTANT ? -1 - (operand & CHUNK_REGISTER_MAX) : operand;
+        }
+
+        if (!trace_record_op(recorder, ops[CHUNK_CHECKED_REGISTER(ip[0]) - OP_ADD], ip[1], operands, 2, next))
+            return TRACE_ABORTED;
+        break;
+    }
+    case OP_CALL:
+        if (!trace_record_call(recorder, ip[1], next))
+            return TRACE_ABORTED;
+        break;
+    case OP_JUMP:
+        frame->ip = next + trace_read_short(ip);
+        return TRACE_NEXT;
+    case OP_JUMP_LONG:
+        frame->ip = next + trace_read_long(ip);
+        return TRACE_NEXT;
+    case OP_JUMP_IF_FALSE:
+    case OP_POP_JUMP_IF_FALSE:
+        trace_record_branch(recorder, ip[0] == OP_POP_JUMP_IF_FALSE, next + trace_read_short(ip), next);
+        return TRACE_NEXT;
+    case OP_JUMP_IF_FALSE_LONG:
+    case OP_POP_JUMP_IF_FALSE_LONG:
+        trace_record_branch(recorder, ip[0] == OP_POP_JUMP_IF_FALSE_LONG, next + trace_read_long(ip), next);
+        return TRACE_NEXT;
+    case OP_LOOP:
+    case OP_LOOP_LONG:
+    {
+        // Inner loops are traced on their own.
+        uint8_t *target = next - (ip[0] == OP_LOOP ? trace_read_short(ip) : trace_read_long(ip));
+
+        if (target != recorder->header)
+            return TRACE_ABORTED;
+
+        frame->ip = target;
+        return TRACE_CLOSED;
+    }
+    default:
+        return TRACE_ABORTED;
+    }
+
+    frame->ip = next;
+    return TRACE_NEXT;
+}
+
+// Brings the slots back to what the code at the loop header assumes of
+// them, or returns false if the trip recorded can't be repeated.
+static bool trace_close(TraceRecorder *recorder)
+{
+    JitBuffer *buffer = &recorder->buffer;
+    CallFrame *frame = recorder->frame;
+
+    recorder->ip = recorder->header;
+    recorder->depth = recorder->header_depth;
+
+    if (vm.stack_top != frame->slots + recorder->header_depth)
+        return false;
+
+    for (int slot = 0; slot < recorder->header_depth; slot++)
+    {
+        TraceSlot *state = &recorder->slots[slot];
+
+        if (recorder->entries[slot] == TRACE_ENTRY_NONE)
+        {
+            trace_spill(recorder, slot);
+            continue;
+        }
+
+        // The registers keep the types the loop was entered with.
+        if (frame->slots[slot].type != recorder->entry_types[slot])
+            return false;
+
+        if (recorder->entries[slot] == TRACE_ENTRY_REGISTER)
+        {
+            int reg = recorder->registers[slot];
+            int xmm = trace_load_number(recorder, slot, 0);
+
+            // movapd reg, xmm
+            if (xmm != reg)
+                jit_emit_register(buffer, 0x66, false, 0x0f28, reg, xmm);
+
+            state->kind = TRACE_REGISTER;
+        }
+        else if (state->kind != TRACE_MEMORY || !state->number)
+        {
+            trace_emit_box(buffer, slot, trace_load_number(recorder, slot, 0), recorder->entry_types[slot]);
+            *state = (TraceSlot){TRACE_MEMORY, true, recorder->entry_types[slot], 0, 0, VALUE_NULL_VAL};
+        }
+    }
+
+    // jmp loop
+    jit_emit_byte(buffer, 0xe9);
+    jit_emit_u32(buffer, (uint32_t)(recorder->loop - (buffer->count + 4)));
+    return true;
+}
+
+// The code is laid out as the prologue, the loop, the entry to it that
+// checks and unboxes the slots it assumes to be numbers, and the exits.
+static void trace_assemble(TraceRecorder *recorder, int entry_jump)
+{
+    JitBuffer *buffer = &recorder->buffer;
+
+    jit_patch_u32(buffer, entry_jump, (uint32_t)(buffer->count - (entry_jump + 4)));
+
+    // Nothing has changed when the entry fails.
+    int entry_exit = trace_add_exit(recorder, recorder->header, recorder->header_depth);
+
+    for (int slot = 0; slot < recorder->header_depth; slot++)
+        recorder->exits[entry_exit].slots[slot].kind = TRACE_MEMORY;
+
+    for (int slot = 0; slot < recorder->header_depth; slot++)
+    {
+        if (recorder->entries[slot] == TRACE_ENTRY_NONE)
+            continue;
+
+        trace_emit_compare_type(buffer, JIT_RBX, TRACE_DISP(slot), recorder->entry_types[slot]);
+        trace_emit_jump_to_exit(recorder, TRACE_NOT_EQUAL, entry_exit);
+
+        if (recorder->entries[slot] == TRACE_ENTRY_REGISTER)
+            jit_emit_memory(buffer, 0xf2, false, 0x0f10, recorder->registers[slot], JIT_RBX, TRACE_AS(slot));
+    }
+
+    jit_emit_byte(buffer, 0xe9);
+    jit_emit_u32(buffer, (uint32_t)(recorder->loop - (buffer->count + 4)));
+
+    int *stubs = MEMORY_ALLOCATE(int, recorder->exit_count);
+
+    for (int i = 0; i < recorder->exit_count; i++)
+    {
+        TraceExit *exit = &recorder->exits[i];
+        stubs[i] = buffer->count;
+
+        for (int slot = 0; slot < exit->depth; slot++)
+            trace_emit_materialize(recorder, slot, &exit->slots[slot]);
+
+        // lea rax, [rbx + depth]; movabs rcx, &vm.stack_top; mov [rcx], rax
+        jit_emit_memory(buffer, 0, true, 0x8d, JIT_RAX, JIT_RBX, TRACE_DISP(exit->depth));
+        jit_emit_move_immediate(buffer, JIT_RCX, (uint64_t)(uintptr_t)&vm.stack_top);
+        jit_emit_memory(buffer, 0, true, 0x89, JIT_RAX, JIT_RCX, 0);
+
+        // movabs rax, ip; pop rbx; ret
+        jit_emit_move_immediate(buffer, JIT_RAX, (uint64_t)(uintptr_t)exit->ip);
+        jit_emit_byte(buffer, 0x5b);
+        jit_emit_byte(buffer, 0xc3);
+    }
+
+    for (int i = 0; i < buffer->fixup_count; i++)
+    {
+        JitFixup *fixup = &buffer->fixups[i];
+        jit_patch_u32(buffer, fixup->position, (uint32_t)(stubs[fixup->target] - (fixup->position + 4)));
+    }
+
+    MEMORY_FREE_ARRAY(int, stubs, recorder->exit_count);
+}
+
+// Records one trip around the loop at the frame's ip and compiles it.
+// Leaves the frame at the header when the trip was recorded whole, and
+// otherwise at the instruction the recording stopped at.
+static void trace_record(CallFrame *frame, Trace *trace)
+{
+    TraceRecorder *recorder = MEMORY_ALLOCATE(TraceRecorder, 1);
+    JitBuffer *buffer = &recorder->buffer;
+
+    recorder->frame = frame;
+    recorder->chunk = &frame->closure->function->chunk;
+    recorder->header = frame->ip;
+    recorder->header_depth = (int)(vm.stack_top - frame->slots);
+    recorder->length = 0;
+    *buffer = (JitBuffer){NULL, 0, 0, NULL, 0, 0, 0};
+    recorder->next_register = TRACE_FIRST_REGISTER;
+    recorder->exits = NULL;
+    recorder->exit_count = 0;
+    recorder->exit_capacity = 0;
+
+    for (int slot = 0; slot < TRACE_SLOTS_MAX; slot++)
+    {
+        recorder->slots[slot] = (TraceSlot){TRACE_MEMORY, false, VALUE_NULL, 0, 0, VALUE_NULL_VAL};
+        recorder->touched[slot] = false;
+        recorder->entries[slot] = TRACE_ENTRY_NONE;
+        recorder->entry_types[slot] = VALUE_NULL;
+        recorder->registers[slot] = -1;
+    }
+
+    // push rbx; mov rbx, [rdi + slots]; jmp entry
+    jit_emit_byte(buffer, 0x53);
+    jit_emit_memory(buffer, 0, true, 0x8b, JIT_RBX, JIT_RDI, offsetof(CallFrame, slots));
+    jit_emit_byte(buffer, 0xe9);
+    int entry_jump = buffer->count;
+    jit_emit_u32(buffer, 0);
+    recorder->loop = buffer->count;
+
+    TraceStep step = recorder->header_depth < TRACE_SLOTS_MAX ? TRACE_NEXT : TRACE_ABORTED;
+
+    while (step == TRACE_NEXT)
+        step = trace_step(recorder);
+
+    trace->failed = true;
+
+    if (step == TRACE_CLOSED && trace_close(recorder))
+    {
+        trace_assemble(recorder, entry_jump);
+
+        int count = buffer->count;
+        trace->code = jit_install(buffer, &trace->size);
+        trace->failed = trace->code == NULL;
+
+        if (trace->code != NULL)
+        {
+            char name[48];
+            snprintf(name, sizeof(name), "trace_%zu_%d", frame->closure->function->id, trace->header);
+            jit_write_perf_map(name, trace->code, (size_t)count);
+        }
+        else
+        {
+            trace_enabled = false;
+        }
+    }
+    else
+    {
+        MEMORY_FREE_ARRAY(uint8_t, buffer->code, buffer->capacity);
+        MEMORY_FREE_ARRAY(JitFixup, buffer->fixups, buffer->fixup_capacity);
+    }
+
+    for (int i = 0; i < recorder->exit_count; i++)
+        MEMORY_FREE_ARRAY(TraceSlot, recorder->exits[i].slots, recorder->exits[i].depth);
+
+    MEMORY_FREE_ARRAY(TraceExit, recorder->exits, recorder->exit_capacity);
+    MEMORY_FREE(TraceRecorder, recorder);
+}
+
+uint8_t *trace_loop(CallFrame *frame)
+{
+    ObjFunction *function = frame->closure->function;
+    int header = (int)(frame->ip - function->chunk.code);
+    Trace *trace = function->traces;
+
+    while (trace != NULL && trace->header != header)
+        trace = trace->next;
+
+    if (trace == NULL)
+    {
+        trace = MEMORY_ALLOCATE(Trace, 1);
+        trace->header = header;
+        trace->count = 0;
+        trace->misses = 0;
+        trace->recordings = 0;
+        trace->failed = false;
+        trace->code = NULL;
+        trace->size = 0;
+        trace->next = function->traces;
+        function->traces = trace;
+    }
+
+    if (trace->code == NULL)
+    {
+        if (trace->failed || ++trace->count < TRACE_HOT_COUNT)
+            return frame->ip;
+
+        trace->recordings++;
+        trace_record(frame, trace);
+
+        if (trace->code == NULL || frame->ip != function->chunk.code + header)
+            return frame->ip;
+    }
+
+    // The code is called through a copy of its address, as in jit_run.
+    TraceEntry run;
+    memcpy(&run, &trace->code, sizeof(run));
+    uint8_t *ip = run(frame);
+
+    // A number that has become a flonum, say, fails the guards of a trace
+    // at once and leaves it at the header. The loop is traced again with
+    // the types it has now when that keeps happening.
+    if (ip == function->chunk.code + header && ++trace->misses >= TRACE_HOT_COUNT)
+    {
+        jit_uninstall(trace->code, trace->size);
+        trace->code = NULL;
+        trace->count = 0;
+        trace->misses = 0;
+        trace->failed = trace->recordings >= TRACE_RECORDINGS_MAX;
+    }
+
+    return ip;
+}
+
+#else
+
+uint8_t *trace_loop(CallFrame *frame)
+{
+    return frame->ip;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,54 @@
+#ifndef _TRACE_H
+#define _TRACE_H
+
+#include <common/common.h>
+#include <object/object.h>
+#include <vm/vm.h>
+
+// The jumps back to a loop header after which its loop is traced.
+#ifndef TRACE_HOT_COUNT
+#define TRACE_HOT_COUNT 64
+#endif
+
+// A loop is traced again at most as many times once the types its trace
+// assumes have changed.
+#define TRACE_RECORDINGS_MAX 4
+
+// Traces are kept for as many instructions and slots at most.
+#define TRACE_LENGTH_MAX 2000
+#define TRACE_SLOTS_MAX 256
+
+// A loop header of a function, found by the offset a backward jump goes to,
+// with its machine code once it has been traced.
+typedef struct Trace
+{
+    int header;
+    int count;
+    int misses; // Runs that left at the header, the types having changed
+    int recordings;
+    bool failed; // Left to the interpreter for good
+    uint8_t *code;
+    size_t size;
+    struct Trace *next;
+} Trace;
+
+// Off by default, and always off where the JIT is, see jit.h.
+void trace_set_enabled(bool enabled);
+bool trace_is_enabled();
+
+// Called by the interpreter after a jump back to the frame's ip. Counts the
+// loop there, records one trip around it once it is hot and runs the code
+// compiled from that. Returns the ip to go on at.
+//
+// Recording interprets the trip itself, one instruction at a time, and
+// gives up at anything it can't compile, leaving the rest of the trip to
+// the interpreter. What it compiles is that one path through the loop, with
+// the numbers in the frame's slots unboxed into xmm registers and a guard
+// wherever a later trip could take another path or find another type. A
+// guard that fails boxes the registers back into the slots and leaves to
+// the interpreter at the instruction it guarded.
+uint8_t *trace_loop(CallFrame *frame);
+
+void trace_free_traces(ObjFunction *function);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,96 @@
+#ifndef _TRACE_TEST_H
+#define _TRACE_TEST_H
+
+#include <trace/trace.h>
+#include <compiler/compiler.h>
+#include <table/table.h>
+#include <CUnit/Basic.h>
+
+// A loop whose branches and types change halfway through, so its trace
+// leaves through guards and is recorded again.
+static const char *trace_test_source = "(define result\n"
+                                       "  (let loop ((i 0) (n 0) (x 0))\n"
+                                       "    (if (= i 2000)\n"
+                                       "        (+ n x)\n"
+                                       "        (loop (+ i 1)\n"
+                                       "              (if (< i 1000) (+ n (* i 3)) (- n i))\n"
+                                       "              (if (< i 1500) (+ x 1) (+ x 0.5))))))";
+
+static bool trace_test_has_code(ObjFunction *function)
+{
+    for (Trace *trace = function->traces; trace != NULL; trace = trace->next)
+    {
+        if (trace->code != NULL)
+            return true;
+    }
+
+    return false;
+}
+
+// Runs source and returns its global result. Sets traced to whether the
+// script, or a function among its constants, has a compiled trace.
+static Value trace_test_run(const char *source, bool *traced)
+{
+    vm_init_vm();
+
+    ObjFunction *script = compiler_compile(source);
+    *traced = false;
+
+    if (script == NULL)
+    {
+        vm_free_vm();
+        return VALUE_VOID_VAL;
+    }
+
+    vm_push(VALUE_OBJ_VAL(script));
+    CU_ASSERT_EQUAL(vm_interpret_function(script), VM_OK);
+
+    *traced = trace_test_has_code(script);
+
+    for (int i = 0; i < script->chunk.constants.count; i++)
+    {
+        Value constant = script->chunk.constants.values[i];
+
+        if (OBJECT_IS_FUNCTION(constant) && trace_test_has_code(OBJECT_AS_FUNCTION(constant)))
+            *traced = true;
+    }
+
+    int slot = table_find_entry(&vm.globals, "result", 6);
+    Value result = slot == -1 ? VALUE_VOID_VAL : table_get(&vm.globals, slot);
+
+    vm_free_vm();
+    return result;
+}
+
+void trace_run_test()
+{
+    bool traced;
+    Value expected = trace_test_run(trace_test_source, &traced);
+    CU_ASSERT_TRUE(VALUE_IS_FLONUM(expected));
+    CU_ASSERT_EQUAL(VALUE_AS_FLONUM(expected), 750.0);
+    CU_ASSERT_FALSE(traced);
+
+    trace_set_enabled(true);
+
+#ifdef JIT_SUPPORTED
+    CU_ASSERT_TRUE(trace_is_enabled());
+#else
+    CU_ASSERT_FALSE(trace_is_enabled());
+#endif
+
+    // The same result through the traces, for stack and for register code
+    for (int registers = 0; registers < 2; registers++)
+    {
+        compiler_set_register_code(registers);
+
+        Value result = trace_test_run(trace_test_source, &traced);
+        CU_ASSERT_TRUE(VALUE_IS_FLONUM(result));
+        CU_ASSERT_EQUAL(VALUE_AS_FLONUM(result), VALUE_AS_FLONUM(expected));
+        CU_ASSERT_EQUAL(traced, trace_is_enabled());
+    }
+
+    compiler_set_register_code(false);
+    trace_set_enabled(false);
+}
+
+#endif
\ No newline at end of file
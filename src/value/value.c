@@ -1,8 +1,13 @@
 #include <value/value.h>
 #include <memory/memory.h>
 #include <object/object.h>
+#include <bignum/bignum.h>
 
+#include <inttypes.h>
+#include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 void value_init_value_array(ValueArray *array)
 {
@@ -30,6 +35,46 @@ void value_free_value_array(ValueArray *array)
     value_init_value_array(array);
 }
 
+// Takes the fewest significant digits that read back exactly, 17 at most,
+// and writes them out in full rather than with an exponent unless the
+// number is very large or small.
+void value_format_flonum(double flonum, char *text, size_t size)
+{
+    if (!isfinite(flonum))
+    {
+        snprintf(text, size, "%g", flonum);
+        return;
+    }
+
+    int digits = 1;
+
+    for (; digits < 17; digits++)
+    {
+        snprintf(text, size, "%.*e", digits - 1, flonum);
+
+        if (strtod(text, NULL) == flonum)
+            break;
+    }
+
+    snprintf(text, size, "%.*e", digits - 1, flonum);
+    int exponent = atoi(strchr(text, 'e') + 1);
+
+    if (exponent >= -4 && exponent < 17 && exponent + 1 > digits)
+        digits = exponent + 1;
+
+    snprintf(text, size, "%.*g", digits, flonum);
+
+    if (strpbrk(text, ".einf") == NULL)
+        strncat(text, ".0", size - strlen(text) - 1);
+}
+
+static void value_print_flonum(double flonum)
+{
+    char text[32];
+    value_format_flonum(flonum, text, sizeof(text));
+    printf("%s", text);
+}
+
 void value_print_value(Value value)
 {
     switch (value.type)
@@ -43,8 +88,11 @@ void value_print_value(Value value)
     case VALUE_VOID:
         printf("#<void>");
         break;
-    case VALUE_NUMBER:
-        printf("%g", VALUE_AS_NUMBER(value));
+    case VALUE_FLONUM:
+        value_print_flonum(VALUE_AS_FLONUM(value));
+        break;
+    case VALUE_FIXNUM:
+        printf("%" PRId64, VALUE_AS_FIXNUM(value));
         break;
     case VALUE_OBJ:
         object_print_object(value);
@@ -64,9 +112,71 @@ bool value_values_equal(Value a, Value b)
         return true;
     case VALUE_VOID:
         return true;
-    case VALUE_NUMBER:
-        return VALUE_AS_NUMBER(a) == VALUE_AS_NUMBER(b);
+    case VALUE_FLONUM:
+        return VALUE_AS_FLONUM(a) == VALUE_AS_FLONUM(b);
+    case VALUE_FIXNUM:
+        return VALUE_AS_FIXNUM(a) == VALUE_AS_FIXNUM(b);
     default:
         return false; // Unreachable.
     }
+}
+
+// Identity as seen by eqv?: flonums compare by bit pattern, so 0.0 and -0.0
+// differ and a NaN equals itself, and objects by address. Interned strings
+// are therefore identical exactly when their contents are equal, and so are
+// bignums. A fixnum and a flonum are never identical, whatever their values.
+bool value_values_identical(Value a, Value b)
+{
+    if (a.type != b.type)
+        return false;
+
+    switch (a.type)
+    {
+    case VALUE_FLONUM:
+    {
+        double x = VALUE_AS_FLONUM(a), y = VALUE_AS_FLONUM(b);
+        return memcmp(&x, &y, sizeof(double)) == 0;
+    }
+    case VALUE_OBJ:
+        if (OBJECT_IS_BIGNUM(a) && OBJECT_IS_BIGNUM(b))
+            return bignum_equal(OBJECT_AS_BIGNUM(a), OBJECT_AS_BIGNUM(b));
+        return VALUE_AS_OBJ(a) == VALUE_AS_OBJ(b);
+    default:
+        return value_values_equal(a, b);
+    }
+}
+
+uint32_t value_hash_value(Value value)
+{
+    uint64_t bits = 0;
+
+    switch (value.type)
+    {
+    case VALUE_BOOL:
+        bits = VALUE_AS_BOOL(value) ? 1 : 0;
+        break;
+    case VALUE_FLONUM:
+    {
+        double flonum = VALUE_AS_FLONUM(value);
+        memcpy(&bits, &flonum, sizeof(bits));
+        break;
+    }
+    case VALUE_FIXNUM:
+        bits = (uint64_t)VALUE_AS_FIXNUM(value);
+        break;
+    case VALUE_OBJ:
+        if (OBJECT_IS_BIGNUM(value))
+            bits = bignum_hash(OBJECT_AS_BIGNUM(value));
+        else
+            bits = (uint64_t)(uintptr_t)VALUE_AS_OBJ(value);
+        break;
+    default:
+        break;
+    }
+
+    // Mix in the type and fold the high bits down, so that pointers and
+    // small doubles with empty low bits still spread over the buckets.
+    bits ^= (uint64_t)value.type << 56;
+    bits *= 0x9e3779b97f4a7c15u;
+    return (uint32_t)(bits >> 32);
 }
\ No newline at end of file
@@ -6,12 +6,16 @@
 typedef struct Obj Obj;
 typedef struct ObjString ObjString;
 
+// Numbers are exact integers, fixnums, as long as they fit in 64 bits, and
+// bignums beyond that, see bignum.h, or inexact flonums. Only the fixnums
+// and flonums are immediate, and VALUE_IS_NUMBER stands for those.
 typedef enum
 {
     VALUE_BOOL,
     VALUE_NULL,
     VALUE_VOID,
-    VALUE_NUMBER,
+    VALUE_FLONUM,
+    VALUE_FIXNUM,
     VALUE_OBJ,
 } ValueType;
 
@@ -21,7 +25,8 @@ typedef struct
     union
     {
         bool boolean;
-        double number;
+        double flonum;
+        int64_t fixnum;
         Obj *obj;
     } as;
 } Value;
@@ -29,17 +34,23 @@ typedef struct
 #define VALUE_IS_BOOL(value) ((value).type == VALUE_BOOL)
 #define VALUE_IS_NULL(value) ((value).type == VALUE_NULL)
 #define VALUE_IS_VOID(value) ((value).type == VALUE_VOID)
-#define VALUE_IS_NUMBER(value) ((value).type == VALUE_NUMBER)
+#define VALUE_IS_FLONUM(value) ((value).type == VALUE_FLONUM)
+#define VALUE_IS_FIXNUM(value) ((value).type == VALUE_FIXNUM)
+#define VALUE_IS_NUMBER(value) (VALUE_IS_FLONUM(value) || VALUE_IS_FIXNUM(value))
 #define VALUE_IS_OBJ(value) ((value).type == VALUE_OBJ)
 
 #define VALUE_AS_OBJ(value) ((value).as.obj)
 #define VALUE_AS_BOOL(value) ((value).as.boolean)
-#define VALUE_AS_NUMBER(value) ((value).as.number)
+#define VALUE_AS_FLONUM(value) ((value).as.flonum)
+#define VALUE_AS_FIXNUM(value) ((value).as.fixnum)
+// Any number as a double, which is inexact for fixnums beyond 2^53.
+#define VALUE_AS_NUMBER(value) (VALUE_IS_FIXNUM(value) ? (double)VALUE_AS_FIXNUM(value) : VALUE_AS_FLONUM(value))
 
 #define VALUE_BOOL_VAL(value) ((Value){VALUE_BOOL, {.boolean = value}})
-#define VALUE_NULL_VAL ((Value){VALUE_NULL, {.number = 0}})
-#define VALUE_VOID_VAL ((Value){VALUE_VOID, {.number = 0}})
-#define VALUE_NUMBER_VAL(value) ((Value){VALUE_NUMBER, {.number = value}})
+#define VALUE_NULL_VAL ((Value){VALUE_NULL, {.fixnum = 0}})
+#define VALUE_VOID_VAL ((Value){VALUE_VOID, {.fixnum = 0}})
+#define VALUE_FLONUM_VAL(value) ((Value){VALUE_FLONUM, {.flonum = value}})
+#define VALUE_FIXNUM_VAL(value) ((Value){VALUE_FIXNUM, {.fixnum = value}})
 #define VALUE_OBJ_VAL(object) ((Value){VALUE_OBJ, {.obj = (Obj *)object}})
 
 typedef struct
@@ -52,7 +63,12 @@ typedef struct
 void value_init_value_array(ValueArray *array);
 void value_write_value_array(ValueArray *array, Value value);
 void value_free_value_array(ValueArray *array);
+// Writes the shortest text that reads back as the same flonum, with a
+// decimal point so that 2.0 isn't taken for 2.
+void value_format_flonum(double flonum, char *text, size_t size);
 void value_print_value(Value value);
 bool value_values_equal(Value a, Value b);
+bool value_values_identical(Value a, Value b);
+uint32_t value_hash_value(Value value);
 
 #endif
\ No newline at end of file
@@ -4,5 +4,46 @@
 #include <value/value.h>
 #include <CUnit/Basic.h>
 
+#include <math.h>
+
+void value_format_flonum_test()
+{
+    char text[32];
+
+    // Integral flonums keep a decimal point
+    value_format_flonum(2.0, text, sizeof(text));
+    CU_ASSERT_STRING_EQUAL(text, "2.0");
+    value_format_flonum(-0.0, text, sizeof(text));
+    CU_ASSERT_STRING_EQUAL(text, "-0.0");
+    value_format_flonum(100000.0, text, sizeof(text));
+    CU_ASSERT_STRING_EQUAL(text, "100000.0");
+    value_format_flonum(1e16, text, sizeof(text));
+    CU_ASSERT_STRING_EQUAL(text, "10000000000000000.0");
+
+    // Every digit needed to read the number back is printed
+    value_format_flonum(499000.5, text, sizeof(text));
+    CU_ASSERT_STRING_EQUAL(text, "499000.5");
+    value_format_flonum(1234567.25, text, sizeof(text));
+    CU_ASSERT_STRING_EQUAL(text, "1234567.25");
+    value_format_flonum(0.1, text, sizeof(text));
+    CU_ASSERT_STRING_EQUAL(text, "0.1");
+    value_format_flonum(1.0 / 3.0, text, sizeof(text));
+    CU_ASSERT_STRING_EQUAL(text, "0.3333333333333333");
+    value_format_flonum(0.1 + 0.2, text, sizeof(text));
+    CU_ASSERT_STRING_EQUAL(text, "0.30000000000000004");
+
+    // Very large and small numbers take an exponent
+    value_format_flonum(1e21, text, sizeof(text));
+    CU_ASSERT_STRING_EQUAL(text, "1e+21");
+    value_format_flonum(1.5e-7, text, sizeof(text));
+    CU_ASSERT_STRING_EQUAL(text, "1.5e-07");
+    value_format_flonum(-1.7976931348623157e308, text, sizeof(text));
+    CU_ASSERT_STRING_EQUAL(text, "-1.7976931348623157e+308");
+
+    value_format_flonum(INFINITY, text, sizeof(text));
+    CU_ASSERT_STRING_EQUAL(text, "inf");
+    value_format_flonum(-INFINITY, text, sizeof(text));
+    CU_ASSERT_STRING_EQUAL(text, "-inf");
+}
 
 #endif
\ No newline at end of file
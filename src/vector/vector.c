@@ -0,0 +1,547 @@
+#include <vector/vector.h>
+#include <bignum/bignum.h>
+#include <vm/vm.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define VECTOR_X86
+#endif
+
+const char *vector_name(VectorKind kind)
+{
+    static const char *names[VECTOR_KINDS] = {"f64vector", "s32vector", "u8vector"};
+    return names[kind];
+}
+
+bool vector_can_hold(VectorKind kind, Value element)
+{
+    switch (kind)
+    {
+    case VECTOR_F64:
+        return OBJECT_IS_NUMBER(element);
+    case VECTOR_S32:
+        return VALUE_IS_FIXNUM(element) && VALUE_AS_FIXNUM(element) >= INT32_MIN &&
+               VALUE_AS_FIXNUM(element) <= INT32_MAX;
+    case VECTOR_U8:
+        return VALUE_IS_FIXNUM(element) && VALUE_AS_FIXNUM(element) >= 0 && VALUE_AS_FIXNUM(element) <= UINT8_MAX;
+    }
+
+    return false;
+}
+
+void vector_store(ObjVector *vector, int index, Value element)
+{
+    switch (vector->kind)
+    {
+    case VECTOR_F64:
+        OBJECT_VECTOR_F64(vector)[index] =
+            OBJECT_IS_BIGNUM(element) ? bignum_to_flonum(element) : VALUE_AS_NUMBER(element);
+        break;
+    case VECTOR_S32:
+        OBJECT_VECTOR_S32(vector)[index] = (int32_t)VALUE_AS_FIXNUM(element);
+        break;
+    case VECTOR_U8:
+        OBJECT_VECTOR_U8(vector)[index] = (uint8_t)VALUE_AS_FIXNUM(element);
+        break;
+    }
+}
+
+/* Kernels */
+
+// Only the operations that gain from SIMD have kernels of their own. The
+// integer ones work on unsigned elements, whose arithmetic wraps around.
+typedef struct
+{
+    void (*add_f64)(double *to, const double *a, const double *b, int length);
+    void (*multiply_f64)(double *to, const double *a, const double *b, int length);
+    double (*sum_f64)(const double *a, int length);
+    double (*dot_f64)(const double *a, const double *b, int length);
+    void (*add_s32)(uint32_t *to, const uint32_t *a, const uint32_t *b, int length);
+    void (*multiply_s32)(uint32_t *to, const uint32_t *a, const uint32_t *b, int length);
+    void (*add_u8)(uint8_t *to, const uint8_t *a, const uint8_t *b, int length);
+    int64_t (*sum_u8)(const uint8_t *a, int length);
+} VectorKernels;
+
+static void vector_add_f64_scalar(double *to, const double *a, const double *b, int length)
+{
+    for (int i = 0; i < length; i++)
+        to[i] = a[i] + b[i];
+}
+
+static void vector_multiply_f64_scalar(double *to, const double *a, const double *b, int length)
+{
+    for (int i = 0; i < length; i++)
+        to[i] = a[i] * b[i];
+}
+
+static double vector_sum_f64_scalar(const double *a, int length)
+{
+    double sum = 0;
+
+    for (int i = 0; i < length; i++)
+        sum += a[i];
+
+    return sum;
+}
+
+static double vector_dot_f64_scalar(const double *a, const double *b, int length)
+{
+    double sum = 0;
+
+    for (int i = 0; i < length; i++)
+        sum += a[i] * b[i];
+
+    return sum;
+}
+
+static void vector_add_s32_scalar(uint32_t *to, const uint32_t *a, const uint32_t *b, int length)
+{
+    for (int i = 0; i < length; i++)
+        to[i] = a[i] + b[i];
+}
+
+static void vector_multiply_s32_scalar(uint32_t *to, const uint32_t *a, const uint32_t *b, int length)
+{
+    for (int i = 0; i < length; i++)
+        to[i] = a[i] * b[i];
+}
+
+static void vector_add_u8_scalar(uint8_t *to, const uint8_t *a, const uint8_t *b, int length)
+{
+    for (int i = 0; i < length; i++)
+        to[i] = (uint8_t)(a[i] + b[i]);
+}
+
+static int64_t vector_sum_u8_scalar(const uint8_t *a, int length)
+{
+    int64_t sum = 0;
+
+    for (int i = 0; i < length; i++)
+        sum += a[i];
+
+    return sum;
+}
+
+#ifndef VECTOR_X86
+static const VectorKernels vector_scalar_kernels = {
+    vector_add_f64_scalar,
+    vector_multiply_f64_scalar,
+    vector_sum_f64_scalar,
+    vector_dot_f64_scalar,
+    vector_add_s32_scalar,
+    vector_multiply_s32_scalar,
+    vector_add_u8_scalar,
+    vector_sum_u8_scalar,
+};
+#else
+
+// SSE2 is part of x86-64, so these need no check. The loops do a register
+// at a time and leave the last few elements to the scalar kernels. Sums
+// keep two accumulators, so that one addition need not wait for the last.
+
+static void vector_add_f64_sse2(double *to, const double *a, const double *b, int length)
+{
+    int i = 0;
+
+    for (; i + 2 <= length; i += 2)
+        _mm_storeu_pd(to + i, _mm_add_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+
+    vector_add_f64_scalar(to + i, a + i, b + i, length - i);
+}
+
+static void vector_multiply_f64_sse2(double *to, const double *a, const double *b, int length)
+{
+    int i = 0;
+
+    for (; i + 2 <= length; i += 2)
+        _mm_storeu_pd(to + i, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+
+    vector_multiply_f64_scalar(to + i, a + i, b + i, length - i);
+}
+
+static double vector_sum_sse2_lanes(__m128d sum)
+{
+    double lanes[2];
+    _mm_storeu_pd(lanes, sum);
+    return lanes[0] + lanes[1];
+}
+
+static double vector_sum_f64_sse2(const double *a, int length)
+{
+    __m128d sums[2] = {_mm_setzero_pd(), _mm_setzero_pd()};
+    int i = 0;
+
+    for (; i + 4 <= length; i += 4)
+    {
+        sums[0] = _mm_add_pd(sums[0], _mm_loadu_pd(a + i));
+        sums[1] = _mm_add_pd(sums[1], _mm_loadu_pd(a + i + 2));
+    }
+
+    return vector_sum_sse2_lanes(_mm_add_pd(sums[0], sums[1])) + vector_sum_f64_scalar(a + i, length - i);
+}
+
+static double vector_dot_f64_sse2(const double *a, const double *b, int length)
+{
+    __m128d sums[2] = {_mm_setzero_pd(), _mm_setzero_pd()};
+    int i = 0;
+
+    for (; i + 4 <= length; i += 4)
+    {
+        sums[0] = _mm_add_pd(sums[0], _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+        sums[1] = _mm_add_pd(sums[1], _mm_mul_pd(_mm_loadu_pd(a + i + 2), _mm_loadu_pd(b + i + 2)));
+    }
+
+    return vector_sum_sse2_lanes(_mm_add_pd(sums[0], sums[1])) +
+           vector_dot_f64_scalar(a + i, b + i, length - i);
+}
+
+static void vector_add_s32_sse2(uint32_t *to, const uint32_t *a, const uint32_t *b, int length)
+{
+    int i = 0;
+
+    for (; i + 4 <= length; i += 4)
+        _mm_storeu_si128((__m128i *)(to + i),
+                         _mm_add_epi32(_mm_loadu_si128((const __m128i *)(a + i)),
+                                       _mm_loadu_si128((const __m128i *)(b + i))));
+
+    vector_add_s32_scalar(to + i, a + i, b + i, length - i);
+}
+
+static void vector_add_u8_sse2(uint8_t *to, const uint8_t *a, const uint8_t *b, int length)
+{
+    int i = 0;
+
+    for (; i + 16 <= length; i += 16)
+        _mm_storeu_si128((__m128i *)(to + i),
+                         _mm_add_epi8(_mm_loadu_si128((const __m128i *)(a + i)),
+                                      _mm_loadu_si128((const __m128i *)(b + i))));
+
+    vector_add_u8_scalar(to + i, a + i, b + i, length - i);
+}
+
+// psadbw sums each eight bytes, as their distances from zero, into a
+// 64-bit lane.
+static int64_t vector_sum_u8_sse2(const uint8_t *a, int length)
+{
+    __m128i sum = _mm_setzero_si128();
+    int i = 0;
+
+    for (; i + 16 <= length; i += 16)
+        sum = _mm_add_epi64(sum, _mm_sad_epu8(_mm_loadu_si128((const __m128i *)(a + i)), _mm_setzero_si128()));
+
+    int64_t lanes[2];
+    _mm_storeu_si128((__m128i *)lanes, sum);
+    return lanes[0] + lanes[1] + vector_sum_u8_scalar(a + i, length - i);
+}
+
+// pmulld came with SSE4.1, so 32-bit products are left to the scalar kernel.
+static const VectorKernels vector_sse2_kernels = {
+    vector_add_f64_sse2,
+    vector_multiply_f64_sse2,
+    vector_sum_f64_sse2,
+    vector_dot_f64_sse2,
+    vector_add_s32_sse2,
+    vector_multiply_s32_scalar,
+    vector_add_u8_sse2,
+    vector_sum_u8_sse2,
+};
+
+// The AVX2 kernels are compiled for it whatever the flags of the build, and
+// only called once the CPU is known to have it.
+#define VECTOR_AVX2 __attribute__((target("avx2")))
+
+VECTOR_AVX2 static void vector_add_f64_avx2(double *to, const double *a, const double *b, int length)
+{
+    int i = 0;
+
+    for (; i + 4 <= length; i += 4)
+        _mm256_storeu_pd(to + i, _mm256_add_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+
+    vector_add_f64_scalar(to + i, a + i, b + i, length - i);
+}
+
+VECTOR_AVX2 static void vector_multiply_f64_avx2(double *to, const double *a, const double *b, int length)
+{
+    int i = 0;
+
+    for (; i + 4 <= length; i += 4)
+        _mm256_storeu_pd(to + i, _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+
+    vector_multiply_f64_scalar(to + i, a + i, b + i, length - i);
+}
+
+VECTOR_AVX2 static double vector_sum_avx2_lanes(__m256d sum)
+{
+    double lanes[4];
+    _mm256_storeu_pd(lanes, sum);
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+VECTOR_AVX2 static double vector_sum_f64_avx2(const double *a, int length)
+{
+    __m256d sums[2] = {_mm256_setzero_pd(), _mm256_setzero_pd()};
+    int i = 0;
+
+    for (; i + 8 <= length; i += 8)
+    {
+        sums[0] = _mm256_add_pd(sums[0], _mm256_loadu_pd(a + i));
+        sums[1] = _mm256_add_pd(sums[1], _mm256_loadu_pd(a + i + 4));
+    }
+
+    return vector_sum_avx2_lanes(_mm256_add_pd(sums[0], sums[1])) + vector_sum_f64_scalar(a + i, length - i);
+}
+
+VECTOR_AVX2 static double vector_dot_f64_avx2(const double *a, const double *b, int length)
+{
+    __m256d sums[2] = {_mm256_setzero_pd(), _mm256_setzero_pd()};
+    int i = 0;
+
+    for (; i + 8 <= length; i += 8)
+    {
+        sums[0] = _mm256_add_pd(sums[0], _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+        sums[1] = _mm256_add_pd(sums[1], _mm256_mul_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4)));
+    }
+
+    return vector_sum_avx2_lanes(_mm256_add_pd(sums[0], sums[1])) +
+           vector_dot_f64_scalar(a + i, b + i, length - i);
+}
+
+VECTOR_AVX2 static void vector_add_s32_avx2(uint32_t *to, const uint32_t *a, const uint32_t *b, int length)
+{
+    int i = 0;
+
+    for (; i + 8 <= length; i += 8)
+        _mm256_storeu_si256((__m256i *)(to + i),
+                            _mm256_add_epi32(_mm256_loadu_si256((const __m256i *)(a + i)),
+                                             _mm256_loadu_si256((const __m256i *)(b + i))));
+
+    vector_add_s32_scalar(to + i, a + i, b + i, length - i);
+}
+
+VECTOR_AVX2 static void vector_multiply_s32_avx2(uint32_t *to, const uint32_t *a, const uint32_t *b, int length)
+{
+    int i = 0;
+
+    for (; i + 8 <= length; i += 8)
+        _mm256_storeu_si256((__m256i *)(to + i),
+                            _mm256_mullo_epi32(_mm256_loadu_si256((const __m256i *)(a + i)),
+                                               _mm256_loadu_si256((const __m256i *)(b + i))));
+
+    vector_multiply_s32_scalar(to + i, a + i, b + i, length - i);
+}
+
+VECTOR_AVX2 static void vector_add_u8_avx2(uint8_t *to, const uint8_t *a, const uint8_t *b, int length)
+{
+    int i = 0;
+
+    for (; i + 32 <= length; i += 32)
+        _mm256_storeu_si256((__m256i *)(to + i),
+                            _mm256_add_epi8(_mm256_loadu_si256((const __m256i *)(a + i)),
+                                            _mm256_loadu_si256((const __m256i *)(b + i))));
+
+    vector_add_u8_scalar(to + i, a + i, b + i, length - i);
+}
+
+VECTOR_AVX2 static int64_t vector_sum_u8_avx2(const uint8_t *a, int length)
+{
+    __m256i sum = _mm256_setzero_si256();
+    int i = 0;
+
+    for (; i + 32 <= length; i += 32)
+        sum = _mm256_add_epi64(sum,
+                               _mm256_sad_epu8(_mm256_loadu_si256((const __m256i *)(a + i)), _mm256_setzero_si256()));
+
+    int64_t lanes[4];
+    _mm256_storeu_si256((__m256i *)lanes, sum);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + vector_sum_u8_scalar(a + i, length - i);
+}
+
+static const VectorKernels vector_avx2_kernels = {
+    vector_add_f64_avx2,
+    vector_multiply_f64_avx2,
+    vector_sum_f64_avx2,
+    vector_dot_f64_avx2,
+    vector_add_s32_avx2,
+    vector_multiply_s32_avx2,
+    vector_add_u8_avx2,
+    vector_sum_u8_avx2,
+};
+
+#endif
+
+static const VectorKernels *vector_kernels()
+{
+    static const VectorKernels *kernels = NULL;
+
+    if (kernels == NULL)
+    {
+#ifdef VECTOR_X86
+        __builtin_cpu_init();
+        kernels = __builtin_cpu_supports("avx2") ? &vector_avx2_kernels : &vector_sse2_kernels;
+#else
+        kernels = &vector_scalar_kernels;
+#endif
+    }
+
+    return kernels;
+}
+
+/* Bulk operations */
+
+void vector_add(ObjVector *to, ObjVector *a, ObjVector *b)
+{
+    const VectorKernels *kernels = vector_kernels();
+
+    switch (to->kind)
+    {
+    case VECTOR_F64:
+        kernels->add_f64(OBJECT_VECTOR_F64(to), OBJECT_VECTOR_F64(a), OBJECT_VECTOR_F64(b), to->length);
+        break;
+    case VECTOR_S32:
+        kernels->add_s32((uint32_t *)to->elements, (const uint32_t *)a->elements, (const uint32_t *)b->elements,
+                         to->length);
+        break;
+    case VECTOR_U8:
+        kernels->add_u8(OBJECT_VECTOR_U8(to), OBJECT_VECTOR_U8(a), OBJECT_VECTOR_U8(b), to->length);
+        break;
+    }
+}
+
+void vector_multiply(ObjVector *to, ObjVector *a, ObjVector *b)
+{
+    const VectorKernels *kernels = vector_kernels();
+
+    switch (to->kind)
+    {
+    case VECTOR_F64:
+        kernels->multiply_f64(OBJECT_VECTOR_F64(to), OBJECT_VECTOR_F64(a), OBJECT_VECTOR_F64(b), to->length);
+        break;
+    case VECTOR_S32:
+        kernels->multiply_s32((uint32_t *)to->elements, (const uint32_t *)a->elements,
+                              (const uint32_t *)b->elements, to->length);
+        break;
+    case VECTOR_U8:
+        for (int i = 0; i < to->length; i++)
+            OBJECT_VECTOR_U8(to)[i] = (uint8_t)(OBJECT_VECTOR_U8(a)[i] * OBJECT_VECTOR_U8(b)[i]);
+        break;
+    }
+}
+
+void vector_fill(ObjVector *vector, Value element)
+{
+    if (vector->kind == VECTOR_U8)
+    {
+        memset(vector->elements, (int)VALUE_AS_FIXNUM(element), vector->length);
+        return;
+    }
+
+    if (vector->length > 0)
+        vector_store(vector, 0, element);
+
+    // Doubles the filled part with each copy.
+    size_t size = object_vector_element_size(vector->kind);
+
+    for (int filled = 1; filled < vector->length; filled *= 2)
+    {
+        int count = filled < vector->length - filled ? filled : vector->length - filled;
+        memcpy((uint8_t *)vector->elements + size * filled, vector->elements, size * count);
+    }
+}
+
+Value vector_sum(ObjVector *vector)
+{
+    const VectorKernels *kernels = vector_kernels();
+
+    switch (vector->kind)
+    {
+    case VECTOR_F64:
+        return VALUE_FLONUM_VAL(kernels->sum_f64(OBJECT_VECTOR_F64(vector), vector->length));
+    case VECTOR_S32:
+    {
+        // No sum of fewer than 2^32 elements overflows.
+        int64_t sum = 0;
+
+        for (int i = 0; i < vector->length; i++)
+            sum += OBJECT_VECTOR_S32(vector)[i];
+
+        return VALUE_FIXNUM_VAL(sum);
+    }
+    case VECTOR_U8:
+        return VALUE_FIXNUM_VAL(kernels->sum_u8(OBJECT_VECTOR_U8(vector), vector->length));
+    }
+
+    return VALUE_VOID_VAL;
+}
+
+// Products of two s32 elements fit in 63 bits, but their sum may not. The
+// part summed so far goes on in a bignum then.
+static Value vector_dot_s32(const int32_t *a, const int32_t *b, int length)
+{
+    Value total = VALUE_FIXNUM_VAL(0);
+    int64_t partial = 0;
+
+    for (int i = 0; i < length; i++)
+    {
+        int64_t product = (int64_t)a[i] * b[i];
+        int64_t sum;
+
+        if (__builtin_add_overflow(partial, product, &sum))
+        {
+            vm_push(total);
+            total = bignum_add(total, VALUE_FIXNUM_VAL(partial));
+            vm_pop();
+            sum = product;
+        }
+
+        partial = sum;
+    }
+
+    vm_push(total);
+    total = bignum_add(total, VALUE_FIXNUM_VAL(partial));
+    vm_pop();
+    return total;
+}
+
+Value vector_dot(ObjVector *a, ObjVector *b)
+{
+    switch (a->kind)
+    {
+    case VECTOR_F64:
+        return VALUE_FLONUM_VAL(vector_kernels()->dot_f64(OBJECT_VECTOR_F64(a), OBJECT_VECTOR_F64(b), a->length));
+    case VECTOR_S32:
+        return vector_dot_s32(OBJECT_VECTOR_S32(a), OBJECT_VECTOR_S32(b), a->length);
+    case VECTOR_U8:
+    {
+        int64_t sum = 0;
+
+        for (int i = 0; i < a->length; i++)
+            sum += OBJECT_VECTOR_U8(a)[i] * OBJECT_VECTOR_U8(b)[i];
+
+        return VALUE_FIXNUM_VAL(sum);
+    }
+    }
+
+    return VALUE_VOID_VAL;
+}
+
+// As #f64(1.0 2.5), the external representation of SRFI-4.
+void vector_print(ObjVector *vector)
+{
+    static const char *tags[VECTOR_KINDS] = {"f64", "s32", "u8"};
+    printf("#%s(", tags[vector->kind]);
+
+    for (int i = 0; i < vector->length; i++)
+    {
+        Value element;
+        vector_ref(VALUE_OBJ_VAL(vector), VALUE_FIXNUM_VAL(i), vector->kind, &element);
+
+        if (i > 0)
+            printf(" ");
+        value_print_value(element);
+    }
+
+    printf(")");
+}
\ No newline at end of file
@@ -0,0 +1,113 @@
+#ifndef _VECTOR_H
+#define _VECTOR_H
+
+#include <common/common.h>
+#include <object/object.h>
+
+// The numeric vectors of SRFI-4: f64vectors of flonums, and s32vectors and
+// u8vectors of exact integers in the range of their C types. Elements are
+// stored unboxed, so a vector of a million flonums takes eight megabytes
+// and the bulk operations below run over plain C arrays.
+//
+// f64vector-ref and f64vector-set!, and those of the other kinds, compile
+// to OP_VECTOR_REF and OP_VECTOR_SET, whose operand is the kind. These
+// inline the common case, vector_ref and vector_set, and leave anything
+// else to the primitives, which convert the other numbers an element may
+// be stored from or report the error.
+
+#define VECTOR_KINDS 3
+
+// "f64vector" and so on.
+const char *vector_name(VectorKind kind);
+
+// Whether the element can be stored in a vector of the kind: any number in
+// an f64vector, where it is converted to a flonum, and only exact integers
+// in range in the others.
+bool vector_can_hold(VectorKind kind, Value element);
+// Stores an element that vector_can_hold.
+void vector_store(ObjVector *vector, int index, Value element);
+
+static inline bool vector_is_kind(Value value, VectorKind kind)
+{
+    return OBJECT_IS_VECTOR(value) && OBJECT_AS_VECTOR(value)->kind == kind;
+}
+
+// Reads element index of a vector of the kind, or returns false if vector
+// isn't one or index isn't a fixnum in range.
+static inline bool vector_ref(Value vector, Value index, VectorKind kind, Value *element)
+{
+    if (!vector_is_kind(vector, kind) || !VALUE_IS_FIXNUM(index) ||
+        (uint64_t)VALUE_AS_FIXNUM(index) >= (uint64_t)OBJECT_AS_VECTOR(vector)->length)
+        return false;
+
+    ObjVector *elements = OBJECT_AS_VECTOR(vector);
+    int64_t i = VALUE_AS_FIXNUM(index);
+
+    switch (kind)
+    {
+    case VECTOR_F64:
+        *element = VALUE_FLONUM_VAL(OBJECT_VECTOR_F64(elements)[i]);
+        break;
+    case VECTOR_S32:
+        *element = VALUE_FIXNUM_VAL(OBJECT_VECTOR_S32(elements)[i]);
+        break;
+    case VECTOR_U8:
+        *element = VALUE_FIXNUM_VAL(OBJECT_VECTOR_U8(elements)[i]);
+        break;
+    }
+
+    return true;
+}
+
+// Writes a fixnum, in range for the integer kinds, or a flonum to an
+// f64vector, to element index of a vector of the kind. Returns false,
+// writing nothing, for anything else.
+static inline bool vector_set(Value vector, Value index, VectorKind kind, Value element)
+{
+    if (!vector_is_kind(vector, kind) || !VALUE_IS_FIXNUM(index) ||
+        (uint64_t)VALUE_AS_FIXNUM(index) >= (uint64_t)OBJECT_AS_VECTOR(vector)->length)
+        return false;
+
+    ObjVector *elements = OBJECT_AS_VECTOR(vector);
+    int64_t i = VALUE_AS_FIXNUM(index);
+
+    switch (kind)
+    {
+    case VECTOR_F64:
+        if (!VALUE_IS_NUMBER(element))
+            return false;
+        OBJECT_VECTOR_F64(elements)[i] = VALUE_AS_NUMBER(element);
+        return true;
+    case VECTOR_S32:
+        if (!VALUE_IS_FIXNUM(element) || VALUE_AS_FIXNUM(element) != (int32_t)VALUE_AS_FIXNUM(element))
+            return false;
+        OBJECT_VECTOR_S32(elements)[i] = (int32_t)VALUE_AS_FIXNUM(element);
+        return true;
+    case VECTOR_U8:
+        if (!VALUE_IS_FIXNUM(element) || (uint64_t)VALUE_AS_FIXNUM(element) > UINT8_MAX)
+            return false;
+        OBJECT_VECTOR_U8(elements)[i] = (uint8_t)VALUE_AS_FIXNUM(element);
+        return true;
+    }
+
+    return false;
+}
+
+// The bulk operations, on vectors of one kind and length. Each runs in a
+// SIMD kernel chosen for the CPU the first time any of them is used: AVX2
+// where the CPU has it, SSE2 on any other x86-64, and plain loops
+// elsewhere. Integer elements wrap around like the machine's own, and the
+// flonums of a sum or dot product are added in an order of the kernel's
+// own, which may round differently from adding them one by one.
+void vector_add(ObjVector *to, ObjVector *a, ObjVector *b);
+void vector_multiply(ObjVector *to, ObjVector *a, ObjVector *b);
+void vector_fill(ObjVector *vector, Value element);
+// A flonum, or an exact integer for the integer kinds. The dot product of
+// two s32vectors may be a bignum, so a and b must be reachable by the
+// collector.
+Value vector_sum(ObjVector *vector);
+Value vector_dot(ObjVector *a, ObjVector *b);
+
+void vector_print(ObjVector *vector);
+
+#endif
\ No newline at end of file
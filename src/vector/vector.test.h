@@ -0,0 +1,198 @@
+#ifndef _VECTOR_TEST_H
+#define _VECTOR_TEST_H
+
+#include <vector/vector.h>
+#include <bignum/bignum.h>
+#include <vm/vm.h>
+#include <CUnit/Basic.h>
+
+#include <string.h>
+
+// Lengths around the widths of the kernels, so that each runs its tail.
+static const int vector_test_lengths[] = {0, 1, 3, 7, 16, 37, 100, 257};
+
+static uint32_t vector_test_seed = 12345;
+
+static uint32_t vector_test_random()
+{
+    vector_test_seed = vector_test_seed * 1103515245 + 12345;
+    return vector_test_seed >> 8;
+}
+
+// A vector of the kind with random elements, kept on the VM stack until
+// vm_free_vm. Flonums are halves, whose sums and products below are exact
+// in any order.
+static ObjVector *vector_test_random_vector(VectorKind kind, int length)
+{
+    ObjVector *vector = object_new_vector(kind, length);
+    vm_push(VALUE_OBJ_VAL(vector));
+
+    for (int i = 0; i < length; i++)
+    {
+        uint32_t random = vector_test_random();
+
+        switch (kind)
+        {
+        case VECTOR_F64:
+            OBJECT_VECTOR_F64(vector)[i] = ((int)(random % 2001) - 1000) / 2.0;
+            break;
+        case VECTOR_S32:
+            OBJECT_VECTOR_S32(vector)[i] = (int32_t)(random * 2654435761u);
+            break;
+        case VECTOR_U8:
+            OBJECT_VECTOR_U8(vector)[i] = (uint8_t)random;
+            break;
+        }
+    }
+
+    return vector;
+}
+
+void vector_add_multiply_test()
+{
+    vm_init_vm();
+
+    for (size_t l = 0; l < sizeof(vector_test_lengths) / sizeof(int); l++)
+    {
+        int length = vector_test_lengths[l];
+
+        for (int kind = 0; kind < VECTOR_KINDS; kind++)
+        {
+            ObjVector *a = vector_test_random_vector(kind, length);
+            ObjVector *b = vector_test_random_vector(kind, length);
+            ObjVector *sum = vector_test_random_vector(kind, length);
+            ObjVector *product = vector_test_random_vector(kind, length);
+
+            vector_add(sum, a, b);
+            vector_multiply(product, a, b);
+
+            // Integers wrap around
+            int wrong = 0;
+
+            for (int i = 0; i < length; i++)
+            {
+                switch (kind)
+                {
+                case VECTOR_F64:
+                    wrong += OBJECT_VECTOR_F64(sum)[i] != OBJECT_VECTOR_F64(a)[i] + OBJECT_VECTOR_F64(b)[i];
+                    wrong += OBJECT_VECTOR_F64(product)[i] != OBJECT_VECTOR_F64(a)[i] * OBJECT_VECTOR_F64(b)[i];
+                    break;
+                case VECTOR_S32:
+                    wrong += (uint32_t)OBJECT_VECTOR_S32(sum)[i] !=
+                             (uint32_t)OBJECT_VECTOR_S32(a)[i] + (uint32_t)OBJECT_VECTOR_S32(b)[i];
+                    wrong += (uint32_t)OBJECT_VECTOR_S32(product)[i] !=
+                             (uint32_t)OBJECT_VECTOR_S32(a)[i] * (uint32_t)OBJECT_VECTOR_S32(b)[i];
+                    break;
+                case VECTOR_U8:
+                    wrong += OBJECT_VECTOR_U8(sum)[i] != (uint8_t)(OBJECT_VECTOR_U8(a)[i] + OBJECT_VECTOR_U8(b)[i]);
+                    wrong += OBJECT_VECTOR_U8(product)[i] != (uint8_t)(OBJECT_VECTOR_U8(a)[i] * OBJECT_VECTOR_U8(b)[i]);
+                    break;
+                }
+            }
+
+            CU_ASSERT_EQUAL(wrong, 0);
+
+            // Writing over an operand
+            vector_add(a, a, b);
+            CU_ASSERT_EQUAL(memcmp(a->elements, sum->elements, length * object_vector_element_size(kind)), 0);
+        }
+    }
+
+    vm_free_vm();
+}
+
+void vector_sum_dot_test()
+{
+    vm_init_vm();
+
+    for (size_t l = 0; l < sizeof(vector_test_lengths) / sizeof(int); l++)
+    {
+        int length = vector_test_lengths[l];
+
+        ObjVector *a = vector_test_random_vector(VECTOR_F64, length);
+        ObjVector *b = vector_test_random_vector(VECTOR_F64, length);
+        double sum = 0, dot = 0;
+
+        for (int i = 0; i < length; i++)
+        {
+            sum += OBJECT_VECTOR_F64(a)[i];
+            dot += OBJECT_VECTOR_F64(a)[i] * OBJECT_VECTOR_F64(b)[i];
+        }
+
+        Value value = vector_sum(a);
+        CU_ASSERT_TRUE(VALUE_IS_FLONUM(value) && VALUE_AS_FLONUM(value) == sum);
+        value = vector_dot(a, b);
+        CU_ASSERT_TRUE(VALUE_IS_FLONUM(value) && VALUE_AS_FLONUM(value) == dot);
+
+        ObjVector *c = vector_test_random_vector(VECTOR_U8, length);
+        ObjVector *d = vector_test_random_vector(VECTOR_U8, length);
+        int64_t total = 0, products = 0;
+
+        for (int i = 0; i < length; i++)
+        {
+            total += OBJECT_VECTOR_U8(c)[i];
+            products += OBJECT_VECTOR_U8(c)[i] * OBJECT_VECTOR_U8(d)[i];
+        }
+
+        value = vector_sum(c);
+        CU_ASSERT_TRUE(VALUE_IS_FIXNUM(value) && VALUE_AS_FIXNUM(value) == total);
+        value = vector_dot(c, d);
+        CU_ASSERT_TRUE(VALUE_IS_FIXNUM(value) && VALUE_AS_FIXNUM(value) == products);
+
+        ObjVector *e = vector_test_random_vector(VECTOR_S32, length);
+        total = 0;
+
+        for (int i = 0; i < length; i++)
+            total += OBJECT_VECTOR_S32(e)[i];
+
+        value = vector_sum(e);
+        CU_ASSERT_TRUE(VALUE_IS_FIXNUM(value) && VALUE_AS_FIXNUM(value) == total);
+    }
+
+    // A dot product of s32vectors beyond the fixnums is a bignum
+    ObjVector *big = object_new_vector(VECTOR_S32, 37);
+    vm_push(VALUE_OBJ_VAL(big));
+    vector_fill(big, VALUE_FIXNUM_VAL(INT32_MIN));
+
+    Value dot = vector_dot(big, big);
+    vm_push(dot);
+    Value expected = bignum_multiply(VALUE_FIXNUM_VAL(37), VALUE_FIXNUM_VAL((int64_t)1 << 62));
+    vm_push(expected);
+    CU_ASSERT_TRUE(OBJECT_IS_BIGNUM(dot));
+    CU_ASSERT_EQUAL(bignum_compare(dot, expected), 0);
+
+    vm_free_vm();
+}
+
+void vector_fill_test()
+{
+    vm_init_vm();
+
+    for (size_t l = 0; l < sizeof(vector_test_lengths) / sizeof(int); l++)
+    {
+        int length = vector_test_lengths[l];
+        ObjVector *f64 = vector_test_random_vector(VECTOR_F64, length);
+        ObjVector *s32 = vector_test_random_vector(VECTOR_S32, length);
+        ObjVector *u8 = vector_test_random_vector(VECTOR_U8, length);
+
+        // An exact integer is stored as a flonum in an f64vector
+        vector_fill(f64, VALUE_FIXNUM_VAL(3));
+        vector_fill(s32, VALUE_FIXNUM_VAL(-7));
+        vector_fill(u8, VALUE_FIXNUM_VAL(200));
+
+        int wrong = 0;
+
+        for (int i = 0; i < length; i++)
+        {
+            wrong += OBJECT_VECTOR_F64(f64)[i] != 3.0;
+            wrong += OBJECT_VECTOR_S32(s32)[i] != -7;
+            wrong += OBJECT_VECTOR_U8(u8)[i] != 200;
+        }
+
+        CU_ASSERT_EQUAL(wrong, 0);
+    }
+
+    vm_free_vm();
+}
+
+#endif
\ No newline at end of file
@@ -5,6 +5,10 @@
 #include <compiler/compiler.h>
 #include <memory/memory.h>
 #include <primitive/primitive.h>
+#include <image/image.h>
+#include <jit/jit.h>
+#include <trace/trace.h>
+#include <vector/vector.h>
 
 #include <stdarg.h>
 #include <stdio.h>
@@ -16,7 +20,7 @@ static void vm_reset_stack()
 {
     vm.stack_top = vm.stack;
     vm.frame_count = 0;
-    vm.open_upvalues = NULL;
+    memset(vm.open_slots, 0, sizeof(vm.open_slots));
 }
 
 void vm_free_vm()
@@ -57,49 +61,142 @@ void vm_runtime_error(const char *format, ...)
         ObjFunction *function = frame->closure->function;
         size_t instruction = frame->ip - function->chunk.code - 1;
 
-        fprintf(stderr, "[line %d] in ", function->chunk.lines[instruction]);
+        fprintf(stderr, "[line %d] in ", chunk_get_line(&function->chunk, (int)instruction));
         printf("#<procedure %u>\n", (unsigned)function->id);
     }
 
     vm_reset_stack();
 }
 
+typedef struct
+{
+    const char *name;
+    NativeFn function;
+} Primitive;
+
+static const Primitive vm_primitives[] = {
+    {"clock", primitive_clock},
+    {"display", primitive_display},
+    {"displayln", primitive_displayln},
+
+    {"+", primitive_add},
+    {"-", primitive_sub},
+    {"*", primitive_mup},
+    {"/", primitive_div},
+    {"quotient", primitive_quotient},
+    {"remainder", primitive_remainder},
+    {"modulo", primitive_modulo},
+    {"sqrt", primitive_sqrt},
+
+    {"=", primitive_num_eq},
+    {"<", primitive_num_le},
+    {">", primitive_num_ge},
+    {"<=", primitive_num_leq},
+    {">=", primitive_num_geq},
+
+    {"exact?", primitive_is_exact},
+    {"inexact?", primitive_is_inexact},
+    {"exact", primitive_exact},
+    {"inexact", primitive_inexact},
+
+    {"make-f64vector", primitive_make_f64vector},
+    {"f64vector", primitive_f64vector},
+    {"f64vector?", primitive_is_f64vector},
+    {"f64vector-length", primitive_f64vector_length},
+    {"f64vector-ref", primitive_f64vector_ref},
+    {"f64vector-set!", primitive_f64vector_set},
+    {"f64vector-fill!", primitive_f64vector_fill},
+    {"f64vector-add", primitive_f64vector_add},
+    {"f64vector-mul", primitive_f64vector_mul},
+    {"f64vector-dot", primitive_f64vector_dot},
+    {"f64vector-sum", primitive_f64vector_sum},
+    {"make-s32vector", primitive_make_s32vector},
+    {"s32vector", primitive_s32vector},
+    {"s32vector?", primitive_is_s32vector},
+    {"s32vector-length", primitive_s32vector_length},
+    {"s32vector-ref", primitive_s32vector_ref},
+    {"s32vector-set!", primitive_s32vector_set},
+    {"s32vector-fill!", primitive_s32vector_fill},
+    {"s32vector-add", primitive_s32vector_add},
+    {"s32vector-mul", primitive_s32vector_mul},
+    {"s32vector-dot", primitive_s32vector_dot},
+    {"s32vector-sum", primitive_s32vector_sum},
+    {"make-u8vector", primitive_make_u8vector},
+    {"u8vector", primitive_u8vector},
+    {"u8vector?", primitive_is_u8vector},
+    {"u8vector-length", primitive_u8vector_length},
+    {"u8vector-ref", primitive_u8vector_ref},
+    {"u8vector-set!", primitive_u8vector_set},
+    {"u8vector-fill!", primitive_u8vector_fill},
+    {"u8vector-add", primitive_u8vector_add},
+    {"u8vector-mul", primitive_u8vector_mul},
+    {"u8vector-dot", primitive_u8vector_dot},
+    {"u8vector-sum", primitive_u8vector_sum},
+};
+
 static void vm_define_primitive(const char *name, NativeFn function)
 {
     vm_push(VALUE_OBJ_VAL(object_copy_string(name, (int)strlen(name))));
-    vm_push(VALUE_OBJ_VAL(object_new_native(function)));
+    vm_push(VALUE_OBJ_VAL(object_new_native(name, function)));
     int slot = table_declare(&vm.globals, OBJECT_AS_STRING(vm.stack[0]));
     table_set(&vm.globals, slot, vm.stack[1]);
     vm_pop();
     vm_pop();
 }
 
-void vm_init_vm()
+ObjNative *vm_new_primitive(const char *name, int length)
+{
+    for (size_t i = 0; i < sizeof(vm_primitives) / sizeof(Primitive); i++)
+    {
+        if ((int)strlen(vm_primitives[i].name) == length &&
+            memcmp(vm_primitives[i].name, name, length) == 0)
+            return object_new_native(vm_primitives[i].name, vm_primitives[i].function);
+    }
+
+    return NULL;
+}
+
+static void vm_init_state()
 {
     vm_reset_stack();
     memory_init_memory();
 
     table_init_table(&vm.globals);
     table_init_table(&vm.strings);
+}
 
-    vm_define_primitive("clock", primitive_clock);
-    vm_define_primitive("display", primitive_display);
-    vm_define_primitive("displayln", primitive_displayln);
+void vm_init_vm()
+{
+    vm_init_state();
 
-    vm_define_primitive("+", primitive_add);
-    vm_define_primitive("-", primitive_sub);
-    vm_define_primitive("*", primitive_mup);
-    vm_define_primitive("/", primitive_div);
+    for (size_t i = 0; i < sizeof(vm_primitives) / sizeof(Primitive); i++)
+    {
+        vm_define_primitive(vm_primitives[i].name, vm_primitives[i].function);
+    }
+}
 
-    vm_define_primitive("=", primitive_num_eq);
-    vm_define_primitive("<", primitive_num_le);
-    vm_define_primitive(">", primitive_num_ge);
-    vm_define_primitive("<=", primitive_num_leq);
-    vm_define_primitive(">=", primitive_num_geq);
+bool vm_init_vm_from_image(const char *path)
+{
+    vm_init_state();
+    return image_load(path);
+}
+
+// Counts a call of the function, or a jump back in it, towards compiling it
+// to machine code.
+static void vm_count_call(ObjFunction *function)
+{
+    if (function->calls < JIT_HOT_COUNT && ++function->calls == JIT_HOT_COUNT && jit_is_enabled())
+        jit_compile(function);
 }
 
 static bool vm_call(ObjClosure *closure, int arg_count)
 {
+    if (closure->function->source != NULL && !compiler_compile_lazy(closure->function))
+    {
+        vm_runtime_error("Could not compile procedure.");
+        return false;
+    }
+
     if (arg_count != closure->function->arity)
     {
         vm_runtime_error("Expected %d arguments but got %d.",
@@ -107,17 +204,24 @@ static bool vm_call(ObjClosure *closure, int arg_count)
         return false;
     }
 
-    if (vm.frame_count == VM_FRAMES_MAX)
+    Value *arena = vm_arena_top();
+
+    if (vm.frame_count == VM_FRAMES_MAX ||
+        arena + closure->function->arena_size > vm.arena + VM_ARENA_MAX)
     {
         vm_runtime_error("Stack overflow.");
         return false;
     }
 
+    vm_count_call(closure->function);
+
     CallFrame *frame = &vm.call_frames[vm.frame_count++];
 
     frame->closure = closure;
     frame->ip = closure->function->chunk.code;
     frame->slots = vm.stack_top - arg_count - 1;
+    frame->arena = arena;
+    frame->open_upvalues = NULL;
 
     return true;
 }
@@ -136,6 +240,11 @@ static bool vm_call_value(Value callee, int arg_count)
         {
             NativeFn native = OBJECT_AS_NATIVE(callee);
             Value result = native(arg_count, vm.stack_top - arg_count);
+
+            // An error has already been reported, and the stack reset.
+            if (vm.frame_count == 0)
+                return false;
+
             vm.stack_top -= arg_count + 1;
             vm_push(result);
             return true;
@@ -169,47 +278,62 @@ static bool vm_call_value(Value callee, int arg_count)
     return false;
 }
 
-static ObjUpvalue *vm_capture_upvalue(Value *local)
+static bool vm_is_open(ObjUpvalue *upvalue)
 {
-    ObjUpvalue *prev_upvalue = NULL;
-    ObjUpvalue *upvalue = vm.open_upvalues;
+    return upvalue->location != &upvalue->closed;
+}
 
-    while (upvalue != NULL && upvalue->location > local)
-    {
-        prev_upvalue = upvalue;
-        upvalue = upvalue->next;
-    }
+static ObjUpvalue *vm_capture_upvalue(CallFrame *frame, Value *local)
+{
+    ObjUpvalue **open = &vm.open_slots[local - vm.stack];
 
-    if (upvalue != NULL && upvalue->location == local)
+    if (*open != NULL)
     {
-        return upvalue;
+        return *open;
     }
 
     ObjUpvalue *created_upvalue = object_new_upvalue(local);
-    created_upvalue->next = upvalue;
+    created_upvalue->next = frame->open_upvalues;
+    frame->open_upvalues = created_upvalue;
+    *open = created_upvalue;
+
+    return created_upvalue;
+}
+
+static void vm_close_upvalue(ObjUpvalue *upvalue)
+{
+    vm.open_slots[upvalue->location - vm.stack] = NULL;
+    upvalue->closed = *upvalue->location;
+    upvalue->location = &upvalue->closed;
+}
 
-    if (prev_upvalue == NULL)
+// Closes the upvalue of the slot, if it was captured. The upvalue stays in
+// the frame's list, which is only trimmed from the front so that the lists
+// saved in continuations are left intact.
+static void vm_close_slot(CallFrame *frame, Value *slot)
+{
+    ObjUpvalue *upvalue = vm.open_slots[slot - vm.stack];
+
+    if (upvalue != NULL)
     {
-        vm.open_upvalues = created_upvalue;
+        vm_close_upvalue(upvalue);
     }
-    else
+
+    while (frame->open_upvalues != NULL && !vm_is_open(frame->open_upvalues))
     {
-        prev_upvalue->next = created_upvalue;
+        frame->open_upvalues = frame->open_upvalues->next;
     }
-
-    return created_upvalue;
 }
 
-static void vm_close_upvalues(Value *last)
+static void vm_close_frame(CallFrame *frame)
 {
-    while (vm.open_upvalues != NULL &&
-           vm.open_upvalues->location >= last)
+    for (ObjUpvalue *upvalue = frame->open_upvalues; upvalue != NULL; upvalue = upvalue->next)
     {
-        ObjUpvalue *upvalue = vm.open_upvalues;
-        upvalue->closed = *upvalue->location;
-        upvalue->location = &upvalue->closed;
-        vm.open_upvalues = upvalue->next;
+        if (vm_is_open(upvalue))
+            vm_close_upvalue(upvalue);
     }
+
+    frame->open_upvalues = NULL;
 }
 
 static bool vm_is_falsey(Value value)
@@ -217,21 +341,6 @@ static bool vm_is_falsey(Value value)
     return VALUE_IS_BOOL(value) && !VALUE_AS_BOOL(value);
 }
 
-static void vm_concatenate()
-{
-    ObjString *b = OBJECT_AS_STRING(vm_pop());
-    ObjString *a = OBJECT_AS_STRING(vm_pop());
-
-    int length = a->length + b->length;
-    char *chars = MEMORY_ALLOCATE(char, length + 1);
-    memcpy(chars, a->chars, a->length);
-    memcpy(chars + a->length, b->chars, b->length);
-    chars[length] = '\0';
-
-    ObjString *result = object_take_string(chars, length);
-    vm_push(VALUE_OBJ_VAL(result));
-}
-
 static InterpretResult vm_run()
 {
     CallFrame *frame = &vm.call_frames[vm.frame_count - 1];
@@ -239,7 +348,68 @@ static InterpretResult vm_run()
 #define VM_READ_BYTE() (*frame->ip++)
 #define VM_READ_CONSTANT() (frame->closure->function->chunk.constants.values[VM_READ_BYTE()])
 #define VM_READ_SHORT() (frame->ip += 2, (uint16_t)((frame->ip[-2] << 8) | frame->ip[-1]))
+#define VM_READ_LONG() (frame->ip += 3, (uint32_t)((frame->ip[-3] << 16) | (frame->ip[-2] << 8) | frame->ip[-1]))
+#define VM_READ_CONSTANT_LONG() (frame->closure->function->chunk.constants.values[VM_READ_LONG()])
 #define VM_READ_STRING() OBJECT_AS_STRING(VM_READ_CONSTANT())
+#define VM_READ_REGISTER()                                                                      \
+    ((frame->ip[0] & CHUNK_REGISTER_CONSTANT)                                                   \
+         ? frame->closure->function->chunk.constants.values[*frame->ip++ & CHUNK_REGISTER_MAX] \
+         : frame->slots[*frame->ip++])
+// Fixnums and flonums each have a fast path, and anything else goes to the
+// primitive, once the operands are known to be numbers. Fixnum arithmetic
+// that overflows does too, and goes on in bignums there.
+#define VM_ARITHMETIC_OP(overflow, op, primitive, checked)                                      \
+    do                                                                                          \
+    {                                                                                           \
+        uint8_t target = VM_READ_BYTE();                                                        \
+        Value operands[2] = {VM_READ_REGISTER(), VM_READ_REGISTER()};                           \
+        int64_t result;                                                                         \
+        if (VALUE_IS_FIXNUM(operands[0]) && VALUE_IS_FIXNUM(operands[1]) &&                     \
+            !overflow(VALUE_AS_FIXNUM(operands[0]), VALUE_AS_FIXNUM(operands[1]), &result))     \
+            frame->slots[target] = VALUE_FIXNUM_VAL(result);                                    \
+        else if (VALUE_IS_FLONUM(operands[0]) && VALUE_IS_FLONUM(operands[1]))                  \
+            frame->slots[target] =                                                              \
+                VALUE_FLONUM_VAL(VALUE_AS_FLONUM(operands[0]) op VALUE_AS_FLONUM(operands[1])); \
+        else if (!checked || (OBJECT_IS_NUMBER(operands[0]) && OBJECT_IS_NUMBER(operands[1])))  \
+            frame->slots[target] = primitive(2, operands);                                      \
+        else                                                                                    \
+        {                                                                                       \
+            vm_runtime_error("Expected number.");                                               \
+            return VM_RUNTIME_ERROR;                                                            \
+        }                                                                                       \
+        vm.stack_top = frame->slots + target + 1;                                               \
+    } while (false)
+#define VM_COMPARISON_OP(op, primitive, checked)                                               \
+    do                                                                                         \
+    {                                                                                          \
+        uint8_t target = VM_READ_BYTE();                                                       \
+        Value operands[2] = {VM_READ_REGISTER(), VM_READ_REGISTER()};                          \
+        if (VALUE_IS_FIXNUM(operands[0]) && VALUE_IS_FIXNUM(operands[1]))                      \
+            frame->slots[target] =                                                             \
+                VALUE_BOOL_VAL(VALUE_AS_FIXNUM(operands[0]) op VALUE_AS_FIXNUM(operands[1]));  \
+        else if (VALUE_IS_FLONUM(operands[0]) && VALUE_IS_FLONUM(operands[1]))                 \
+            frame->slots[target] =                                                             \
+                VALUE_BOOL_VAL(VALUE_AS_FLONUM(operands[0]) op VALUE_AS_FLONUM(operands[1]));  \
+        else if (!checked || (OBJECT_IS_NUMBER(operands[0]) && OBJECT_IS_NUMBER(operands[1]))) \
+            frame->slots[target] = primitive(2, operands);                                     \
+        else                                                                                   \
+        {                                                                                      \
+            vm_runtime_error("Expected number.");                                              \
+            return VM_RUNTIME_ERROR;                                                           \
+        }                                                                                      \
+        vm.stack_top = frame->slots + target + 1;                                              \
+    } while (false)
+// The interpreter hands over to machine code when the run starts and after
+// the instructions that the machine code leaves to it.
+#define VM_ENTER_JIT()                                   \
+    do                                                   \
+    {                                                    \
+        if (frame->closure->function->jit != NULL)       \
+            frame->ip = jit_run(frame);                  \
+    } while (false)
+
+    VM_ENTER_JIT();
+
     for (;;)
     {
 #ifdef DEBUG_TRACE_EXECUTION
@@ -265,6 +435,12 @@ static InterpretResult vm_run()
             vm_push(constant);
             break;
         }
+        case OP_CONSTANT_LONG:
+        {
+            Value constant = VM_READ_CONSTANT_LONG();
+            vm_push(constant);
+            break;
+        }
         case OP_NULL:
         {
             vm_push(VALUE_NULL_VAL);
@@ -285,22 +461,57 @@ static InterpretResult vm_run()
             vm_pop();
             break;
         }
+        case OP_POPN:
+        {
+            vm.stack_top -= VM_READ_BYTE();
+            break;
+        }
         case OP_GET_LOCAL:
         {
             uint8_t slot = VM_READ_BYTE();
             vm_push(frame->slots[slot]);
             break;
         }
+        case OP_GET_LOCAL_LONG:
+        {
+            uint16_t slot = VM_READ_SHORT();
+            vm_push(frame->slots[slot]);
+            break;
+        }
         case OP_GET_GLOBAL:
         {
             uint16_t slot = VM_READ_SHORT();
             vm_push(table_get(&vm.globals, slot));
             break;
         }
+        case OP_GLOBAL_UNCHANGED:
+        {
+            uint16_t slot = VM_READ_SHORT();
+            vm_push(VALUE_BOOL_VAL(table_is_unchanged(&vm.globals, slot)));
+            break;
+        }
         case OP_GET_UPVALUE:
         {
             uint8_t slot = VM_READ_BYTE();
-            vm_push(*frame->closure->upvalues[slot]->location);
+            vm_push(frame->closure->upvalues[slot]);
+            break;
+        }
+        case OP_GET_UPVALUE_LONG:
+        {
+            uint16_t slot = VM_READ_SHORT();
+            vm_push(frame->closure->upvalues[slot]);
+            break;
+        }
+        case OP_GET_BOXED_UPVALUE:
+        {
+            uint8_t slot = VM_READ_BYTE();
+            vm_push(*OBJECT_AS_UPVALUE(frame->closure->upvalues[slot])->location);
+            break;
+        }
+        case OP_GET_BOXED_UPVALUE_LONG:
+        {
+            uint16_t slot = VM_READ_SHORT();
+            vm_push(*OBJECT_AS_UPVALUE(frame->closure->upvalues[slot])->location);
             break;
         }
         case OP_SET_LOCAL:
@@ -309,6 +520,12 @@ static InterpretResult vm_run()
             frame->slots[slot] = vm_peek(0);
             break;
         }
+        case OP_SET_LOCAL_LONG:
+        {
+            uint16_t slot = VM_READ_SHORT();
+            frame->slots[slot] = vm_peek(0);
+            break;
+        }
         case OP_SET_GLOBAL:
         {
             uint16_t slot = VM_READ_SHORT();
@@ -318,7 +535,92 @@ static InterpretResult vm_run()
         case OP_SET_UPVALUE:
         {
             uint8_t slot = VM_READ_BYTE();
-            *frame->closure->upvalues[slot]->location = vm_peek(0);
+            *OBJECT_AS_UPVALUE(frame->closure->upvalues[slot])->location = vm_peek(0);
+            break;
+        }
+        case OP_SET_UPVALUE_LONG:
+        {
+            uint16_t slot = VM_READ_SHORT();
+            *OBJECT_AS_UPVALUE(frame->closure->upvalues[slot])->location = vm_peek(0);
+            break;
+        }
+        case OP_ADD:
+            VM_ARITHMETIC_OP(__builtin_add_overflow, +, primitive_add, true);
+            break;
+        case OP_SUBTRACT:
+            VM_ARITHMETIC_OP(__builtin_sub_overflow, -, primitive_sub, true);
+            break;
+        case OP_MULTIPLY:
+            VM_ARITHMETIC_OP(__builtin_mul_overflow, *, primitive_mup, true);
+            break;
+        case OP_EQUAL:
+            VM_COMPARISON_OP(==, primitive_num_eq, true);
+            break;
+        case OP_LESS:
+            VM_COMPARISON_OP(<, primitive_num_le, true);
+            break;
+        case OP_GREATER:
+            VM_COMPARISON_OP(>, primitive_num_ge, true);
+            break;
+        case OP_LESS_EQUAL:
+            VM_COMPARISON_OP(<=, primitive_num_leq, true);
+            break;
+        case OP_GREATER_EQUAL:
+            VM_COMPARISON_OP(>=, primitive_num_geq, true);
+            break;
+        case OP_ADD_UNCHECKED:
+            VM_ARITHMETIC_OP(__builtin_add_overflow, +, primitive_add, false);
+            break;
+        case OP_SUBTRACT_UNCHECKED:
+            VM_ARITHMETIC_OP(__builtin_sub_overflow, -, primitive_sub, false);
+            break;
+        case OP_MULTIPLY_UNCHECKED:
+            VM_ARITHMETIC_OP(__builtin_mul_overflow, *, primitive_mup, false);
+            break;
+        case OP_EQUAL_UNCHECKED:
+            VM_COMPARISON_OP(==, primitive_num_eq, false);
+            break;
+        case OP_LESS_UNCHECKED:
+            VM_COMPARISON_OP(<, primitive_num_le, false);
+            break;
+        case OP_GREATER_UNCHECKED:
+            VM_COMPARISON_OP(>, primitive_num_ge, false);
+            break;
+        case OP_LESS_EQUAL_UNCHECKED:
+            VM_COMPARISON_OP(<=, primitive_num_leq, false);
+            break;
+        case OP_GREATER_EQUAL_UNCHECKED:
+            VM_COMPARISON_OP(>=, primitive_num_geq, false);
+            break;
+        case OP_VECTOR_REF:
+        {
+            VectorKind kind = (VectorKind)VM_READ_BYTE();
+            Value element;
+
+            if (!vector_ref(vm_peek(1), vm_peek(0), kind, &element))
+            {
+                element = primitive_vector_ref(kind, 2, vm.stack_top - 2);
+                if (vm.frame_count == 0)
+                    return VM_RUNTIME_ERROR;
+            }
+
+            vm.stack_top -= 2;
+            vm_push(element);
+            break;
+        }
+        case OP_VECTOR_SET:
+        {
+            VectorKind kind = (VectorKind)VM_READ_BYTE();
+
+            if (!vector_set(vm_peek(2), vm_peek(1), kind, vm_peek(0)))
+            {
+                primitive_vector_set(kind, 3, vm.stack_top - 3);
+                if (vm.frame_count == 0)
+                    return VM_RUNTIME_ERROR;
+            }
+
+            vm.stack_top -= 3;
+            vm_push(VALUE_VOID_VAL);
             break;
         }
         case OP_JUMP:
@@ -327,6 +629,12 @@ static InterpretResult vm_run()
             frame->ip += offset;
             break;
         }
+        case OP_JUMP_LONG:
+        {
+            uint32_t offset = VM_READ_LONG();
+            frame->ip += offset;
+            break;
+        }
         case OP_JUMP_IF_FALSE:
         {
             uint16_t offset = VM_READ_SHORT();
@@ -334,6 +642,64 @@ static InterpretResult vm_run()
                 frame->ip += offset;
             break;
         }
+        case OP_JUMP_IF_FALSE_LONG:
+        {
+            uint32_t offset = VM_READ_LONG();
+            if (vm_is_falsey(vm_peek(0)))
+                frame->ip += offset;
+            break;
+        }
+        case OP_POP_JUMP_IF_FALSE:
+        {
+            uint16_t offset = VM_READ_SHORT();
+            if (vm_is_falsey(vm_pop()))
+                frame->ip += offset;
+            break;
+        }
+        case OP_POP_JUMP_IF_FALSE_LONG:
+        {
+            uint32_t offset = VM_READ_LONG();
+            if (vm_is_falsey(vm_pop()))
+                frame->ip += offset;
+            break;
+        }
+        case OP_SWITCH:
+        {
+            uint8_t *start = frame->ip - 1;
+            Chunk *chunk = &frame->closure->function->chunk;
+            Value key = vm_pop();
+
+            // A switch over = tests fails where the first = would have.
+            if ((start[1] & CHUNK_SWITCH_NUMERIC) && !OBJECT_IS_NUMBER(key))
+            {
+                vm_runtime_error("Expected number.");
+                return VM_RUNTIME_ERROR;
+            }
+
+            frame->ip = start + chunk_switch_distance(chunk, (int)(start - chunk->code), key);
+            VM_ENTER_JIT();
+            break;
+        }
+        case OP_LOOP:
+        {
+            uint16_t offset = VM_READ_SHORT();
+            frame->ip -= offset;
+            vm_count_call(frame->closure->function);
+            if (trace_is_enabled())
+                frame->ip = trace_loop(frame);
+            VM_ENTER_JIT();
+            break;
+        }
+        case OP_LOOP_LONG:
+        {
+            uint32_t offset = VM_READ_LONG();
+            frame->ip -= offset;
+            vm_count_call(frame->closure->function);
+            if (trace_is_enabled())
+                frame->ip = trace_loop(frame);
+            VM_ENTER_JIT();
+            break;
+        }
         case OP_CALL:
         {
             int arg_count = VM_READ_BYTE();
@@ -343,17 +709,34 @@ static InterpretResult vm_run()
                 return VM_RUNTIME_ERROR;
             }
             frame = &vm.call_frames[vm.frame_count - 1];
+            VM_ENTER_JIT();
             break;
         }
         case OP_TAIL_CALL:
         {
             int arg_count = VM_READ_BYTE();
+            Value callee = vm_peek(arg_count);
+
+            // The frame's arena is released by the call, so a closure
+            // living there is moved to the heap first.
+            if (VALUE_IS_OBJ(callee) && vm_in_arena(VALUE_AS_OBJ(callee)) &&
+                (Value *)VALUE_AS_OBJ(callee) >= frame->arena)
+            {
+                ObjClosure *stack_closure = OBJECT_AS_CLOSURE(callee);
+                ObjClosure *closure = object_new_closure(stack_closure->function);
+
+                for (int i = 0; i < closure->upvalue_count; i++)
+                    closure->upvalues[i] = stack_closure->upvalues[i];
+
+                vm.stack_top[-1 - arg_count] = VALUE_OBJ_VAL(closure);
+            }
 
             // Close upvalues
-            vm_close_upvalues(frame->slots);
+            vm_close_frame(frame);
 
-            // Shift the arguments plus closure to be called
-            memcpy(frame->slots,
+            // Shift the arguments plus closure to be called. The ranges
+            // overlap when the frame has fewer slots than the call.
+            memmove(frame->slots,
                    vm.stack_top - (arg_count + 1),
                    sizeof(Value) * (arg_count + 1));
 
@@ -368,46 +751,73 @@ static InterpretResult vm_run()
                 return VM_RUNTIME_ERROR;
             }
             frame = &vm.call_frames[vm.frame_count - 1];
+            VM_ENTER_JIT();
             break;
         }
         case OP_CLOSURE:
+        case OP_CLOSURE_LONG:
+        case OP_STACK_CLOSURE:
+        case OP_STACK_CLOSURE_LONG:
         {
-            ObjFunction *function = OBJECT_AS_FUNCTION(VM_READ_CONSTANT());
-            ObjClosure *closure = object_new_closure(function);
+            bool wide = instruction == OP_CLOSURE_LONG || instruction == OP_STACK_CLOSURE_LONG;
+            ObjFunction *function = OBJECT_AS_FUNCTION(wide ? VM_READ_CONSTANT_LONG() : VM_READ_CONSTANT());
+            ObjClosure *closure;
+
+            if (instruction == OP_STACK_CLOSURE || instruction == OP_STACK_CLOSURE_LONG)
+                closure = object_init_stack_closure(frame->arena + VM_READ_SHORT(), function);
+            else
+                closure = object_new_closure(function);
+
             vm_push(VALUE_OBJ_VAL(closure));
 
             for (int i = 0; i < closure->upvalue_count; i++)
             {
-                uint8_t is_local = VM_READ_BYTE();
-                uint8_t index = VM_READ_BYTE();
+                uint8_t flags = VM_READ_BYTE();
+                uint16_t index = wide ? VM_READ_SHORT() : VM_READ_BYTE();
 
-                if (is_local)
+                if (!(flags & CHUNK_CAPTURE_LOCAL))
+                {
+                    closure->upvalues[i] = frame->closure->upvalues[index];
+                }
+                else if (flags & CHUNK_CAPTURE_BOXED)
                 {
-                    closure->upvalues[i] = vm_capture_upvalue(frame->slots + index);
+                    closure->upvalues[i] = VALUE_OBJ_VAL(vm_capture_upvalue(frame, frame->slots + index));
                 }
                 else
                 {
-                    closure->upvalues[i] = frame->closure->upvalues[index];
+                    closure->upvalues[i] = frame->slots[index];
                 }
             }
+            VM_ENTER_JIT();
             break;
         }
         case OP_CONTINUATION:
         {
             ObjContinuation *cont = object_new_continuation((struct VM *)&vm);
             vm_push(VALUE_OBJ_VAL(cont));
+            VM_ENTER_JIT();
             break;
         }
         case OP_CLOSE_UPVALUE:
         {
-            vm_close_upvalues(vm.stack_top - 1);
+            vm_close_slot(frame, vm.stack_top - 1);
             vm_pop();
+            VM_ENTER_JIT();
+            break;
+        }
+        case OP_CLOSE_LOCAL:
+        {
+            // A loop variable is about to take the value of the next
+            // iteration; closures made in this one keep the current value.
+            uint16_t slot = VM_READ_SHORT();
+            vm_close_slot(frame, frame->slots + slot);
+            VM_ENTER_JIT();
             break;
         }
         case OP_RETURN:
         {
             Value result = vm_pop();
-            vm_close_upvalues(frame->slots);
+            vm_close_frame(frame);
             vm.frame_count--;
 
             if (vm.frame_count == 0)
@@ -421,6 +831,7 @@ static InterpretResult vm_run()
             vm.stack_top = frame->slots;
             vm_push(result);
             frame = &vm.call_frames[vm.frame_count - 1];
+            VM_ENTER_JIT();
             break;
         }
         }
@@ -429,15 +840,17 @@ static InterpretResult vm_run()
 #undef VM_READ_BYTE
 #undef VM_READ_CONSTANT
 #undef VM_READ_SHORT
+#undef VM_READ_LONG
+#undef VM_READ_CONSTANT_LONG
 #undef VM_READ_STRING
+#undef VM_READ_REGISTER
+#undef VM_ARITHMETIC_OP
+#undef VM_COMPARISON_OP
+#undef VM_ENTER_JIT
 }
 
-InterpretResult vm_interpret(const char *source)
+InterpretResult vm_interpret_function(ObjFunction *function)
 {
-    ObjFunction *function = compiler_compile(source);
-    if (function == NULL)
-        return VM_COMPILE_ERROR;
-
     vm_push(VALUE_OBJ_VAL(function));
     ObjClosure *closure = object_new_closure(function);
     vm_pop();
@@ -445,4 +858,13 @@ InterpretResult vm_interpret(const char *source)
     vm_call(closure, 0);
 
     return vm_run();
+}
+
+InterpretResult vm_interpret(const char *source)
+{
+    ObjFunction *function = compiler_compile(source);
+    if (function == NULL)
+        return VM_COMPILE_ERROR;
+
+    return vm_interpret_function(function);
 }
\ No newline at end of file
@@ -9,12 +9,15 @@
 
 #define VM_FRAMES_MAX 64
 #define VM_STACK_MAX (VM_FRAMES_MAX * UINT8_COUNT)
+#define VM_ARENA_MAX VM_STACK_MAX
 
 typedef struct
 {
     ObjClosure *closure;
     uint8_t *ip;
     Value *slots;
+    Value *arena; // Region of the frame's non-escaping closures
+    ObjUpvalue *open_upvalues; // Captured slots of the frame, newest first
 } CallFrame;
 
 typedef struct
@@ -25,7 +28,7 @@ typedef struct
     Value stack[VM_STACK_MAX];
     Value *stack_top;
 
-    ObjUpvalue *open_upvalues;
+    Value arena[VM_ARENA_MAX];
 } State;
 
 typedef struct
@@ -36,7 +39,14 @@ typedef struct
     Value stack[VM_STACK_MAX];
     Value *stack_top;
 
-    ObjUpvalue *open_upvalues;
+    // The open upvalue of each stack slot, or NULL. Rebuilt from the frames
+    // when a continuation is resumed.
+    ObjUpvalue *open_slots[VM_STACK_MAX];
+
+    // Closures that the compiler proved can't outlive their frame live here
+    // instead of on the heap. Each frame reserves the arena_size of its
+    // function above the region of its caller.
+    Value arena[VM_ARENA_MAX];
 
     Table strings;
     Table globals;
@@ -51,9 +61,28 @@ typedef enum
 
 extern VM vm;
 
+// Arena closures are not owned by the collector, which only traces them.
+static inline bool vm_in_arena(Obj *object)
+{
+    return (Value *)object >= vm.arena && (Value *)object < vm.arena + VM_ARENA_MAX;
+}
+
+// The end of the arena regions reserved by the frames.
+static inline Value *vm_arena_top()
+{
+    if (vm.frame_count == 0)
+        return vm.arena;
+
+    CallFrame *frame = &vm.call_frames[vm.frame_count - 1];
+    return frame->arena + frame->closure->function->arena_size;
+}
+
 void vm_init_vm();
+bool vm_init_vm_from_image(const char *path);
+ObjNative *vm_new_primitive(const char *name, int length);
 void vm_free_vm();
 InterpretResult vm_interpret(const char *source);
+InterpretResult vm_interpret_function(ObjFunction *function);
 
 Value vm_pop();
 void vm_push(Value value);
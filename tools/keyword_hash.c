@@ -0,0 +1,201 @@
+// Generates the scanner's keyword table as a minimal perfect hash.
+//
+// Usage: keyword_hash <keywords.txt> <output.h>
+//
+// Keywords are first spread over (n + 1) / 2 buckets with seed 0. Buckets are
+// then placed largest first, searching for the smallest seed that maps every
+// keyword in the bucket to a free slot of the n-entry table (hash and
+// displace). A lookup is therefore two hashes and one comparison no matter how
+// many keywords there are.
+
+#include <scanner/keyword_hash.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#define KEYWORD_HASH_MAX 256
+#define KEYWORD_HASH_MAX_LENGTH 64
+#define KEYWORD_HASH_SEED_LIMIT 1000000u
+
+typedef struct
+{
+    char name[KEYWORD_HASH_MAX_LENGTH];
+    char type[KEYWORD_HASH_MAX_LENGTH];
+    int length;
+    int bucket;
+} Keyword;
+
+static Keyword keywords[KEYWORD_HASH_MAX];
+static int keyword_count = 0;
+
+static int keyword_hash_read(const char *path)
+{
+    char line[256];
+    FILE *file = fopen(path, "r");
+
+    if (file == NULL)
+    {
+        fprintf(stderr, "keyword_hash: could not open \"%s\".\n", path);
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        char name[KEYWORD_HASH_MAX_LENGTH], type[KEYWORD_HASH_MAX_LENGTH];
+
+        if (line[0] == '#' || sscanf(line, "%63s %63s", name, type) != 2)
+            continue;
+
+        if (keyword_count == KEYWORD_HASH_MAX)
+        {
+            fprintf(stderr, "keyword_hash: too many keywords.\n");
+            fclose(file);
+            return -1;
+        }
+
+        for (int i = 0; i < keyword_count; i++)
+        {
+            if (strcmp(keywords[i].name, name) == 0)
+            {
+                fprintf(stderr, "keyword_hash: duplicate keyword '%s'.\n", name);
+                fclose(file);
+                return -1;
+            }
+        }
+
+        Keyword *keyword = &keywords[keyword_count++];
+        strcpy(keyword->name, name);
+        strcpy(keyword->type, type);
+        keyword->length = (int)strlen(name);
+    }
+
+    fclose(file);
+    return keyword_count;
+}
+
+static bool keyword_hash_try_seed(int bucket, uint32_t seed, int *slots)
+{
+    int placed[KEYWORD_HASH_MAX];
+    int placed_count = 0;
+
+    for (int i = 0; i < keyword_count; i++)
+    {
+        if (keywords[i].bucket != bucket)
+            continue;
+
+        int slot = keyword_hash(keywords[i].name, keywords[i].length, seed) % keyword_count;
+        bool taken = slots[slot] != -1;
+
+        for (int j = 0; j < placed_count && !taken; j++)
+            taken = placed[j] == slot;
+
+        if (taken)
+            return false;
+
+        placed[placed_count++] = slot;
+    }
+
+    // Commit the slots only once the whole bucket fits.
+    placed_count = 0;
+    for (int i = 0; i < keyword_count; i++)
+    {
+        if (keywords[i].bucket == bucket)
+            slots[placed[placed_count++]] = i;
+    }
+
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 3)
+    {
+        fprintf(stderr, "Usage: keyword_hash <keywords.txt> <output.h>\n");
+        return 64;
+    }
+
+    if (keyword_hash_read(argv[1]) <= 0)
+    {
+        fprintf(stderr, "keyword_hash: no keywords in \"%s\".\n", argv[1]);
+        return 65;
+    }
+
+    int bucket_count = (keyword_count + 1) / 2;
+    int bucket_sizes[KEYWORD_HASH_MAX] = {0};
+    int order[KEYWORD_HASH_MAX];
+    uint32_t seeds[KEYWORD_HASH_MAX] = {0};
+    int slots[KEYWORD_HASH_MAX];
+    int max_length = 0;
+
+    for (int i = 0; i < keyword_count; i++)
+    {
+        keywords[i].bucket = keyword_hash(keywords[i].name, keywords[i].length, 0) % bucket_count;
+        bucket_sizes[keywords[i].bucket]++;
+        if (keywords[i].length > max_length)
+            max_length = keywords[i].length;
+    }
+
+    for (int i = 0; i < keyword_count; i++)
+        slots[i] = -1;
+
+    // Place the largest buckets first while the table is still mostly empty.
+    for (int i = 0; i < bucket_count; i++)
+        order[i] = i;
+
+    for (int i = 1; i < bucket_count; i++)
+    {
+        for (int j = i; j > 0 && bucket_sizes[order[j]] > bucket_sizes[order[j - 1]]; j--)
+        {
+            int swap = order[j];
+            order[j] = order[j - 1];
+            order[j - 1] = swap;
+        }
+    }
+
+    for (int i = 0; i < bucket_count && bucket_sizes[order[i]] > 0; i++)
+    {
+        uint32_t seed = 1;
+
+        while (!keyword_hash_try_seed(order[i], seed, slots))
+        {
+            if (++seed == KEYWORD_HASH_SEED_LIMIT)
+            {
+                fprintf(stderr, "keyword_hash: no perfect hash found.\n");
+                return 70;
+            }
+        }
+
+        seeds[order[i]] = seed;
+    }
+
+    FILE *out = fopen(argv[2], "w");
+
+    if (out == NULL)
+    {
+        fprintf(stderr, "keyword_hash: could not write \"%s\".\n", argv[2]);
+        return 73;
+    }
+
+    fprintf(out, "// Generated by tools/keyword_hash.c from %s. Do not edit.\n\n", argv[1]);
+    fprintf(out, "#define SCANNER_KEYWORD_COUNT %d\n", keyword_count);
+    fprintf(out, "#define SCANNER_KEYWORD_BUCKETS %d\n", bucket_count);
+    fprintf(out, "#define SCANNER_KEYWORD_MAX_LENGTH %d\n\n", max_length);
+
+    fprintf(out, "static const uint32_t scanner_keyword_seeds[SCANNER_KEYWORD_BUCKETS] = {\n");
+    for (int i = 0; i < bucket_count; i++)
+        fprintf(out, "    %uu,\n", (unsigned)seeds[i]);
+    fprintf(out, "};\n\n");
+
+    fprintf(out, "static const Keyword scanner_keywords[SCANNER_KEYWORD_COUNT] = {\n");
+    for (int i = 0; i < keyword_count; i++)
+    {
+        Keyword *keyword = &keywords[slots[i]];
+        fprintf(out, "    {\"%s\", %d, %s},\n", keyword->name, keyword->length, keyword->type);
+    }
+    fprintf(out, "};\n");
+
+    fclose(out);
+    return 0;
+}
\ No newline at end of file